@@ -30,6 +30,7 @@ CALLIN_LIST = {
 	"GameStart",
 	"GameOver",
 	"GameFrame",
+	"GameFramePost",
 	"GamePaused",
 	"GameProgress",
 	"GameID",
@@ -55,6 +56,7 @@ CALLIN_LIST = {
 	"UnitCmdDone",
 	"UnitPreDamaged",
 	"UnitDamaged",
+	"UnitDamagedBatch",        -- batched UnitDamaged, flushed at GameFramePost and before UnitDestroyed
 	"UnitStunned",
 	"UnitTaken",
 	"UnitGiven",
@@ -115,6 +117,7 @@ CALLIN_LIST = {
 	"AllowBuilderHoldFire",
 	"AllowWeaponTargetCheck",
 	"AllowWeaponTarget",
+	"AllowWeaponTargets",
 	"AllowWeaponInterceptTarget",
 
 	"Explosion",
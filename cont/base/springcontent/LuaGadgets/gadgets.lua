@@ -296,6 +296,7 @@ function gadgetHandler:NewGadget()
   gh.RemoveGadget = function (_) self:RemoveGadget(gadget)     end
   gh.GetViewSizes = function (_) return self:GetViewSizes()    end
   gh.GetHourTimer = function (_) return self:GetHourTimer()    end
+  gh.GetCallInStats = function (_) return self:GetCallInStats() end
   gh.IsSyncedCode = function (_) return IsSyncedCode()         end
 
   gh.UpdateCallIn = function (_, name)
@@ -812,6 +813,49 @@ function gadgetHandler:GetHourTimer()
 end
 
 
+--
+--  per-gadget call and event counts for the per-event and batched
+--  UnitDamaged call-ins; times (in ms) are only measured in unsynced code
+--  collection starts with the first GetCallInStats call, until then the
+--  call-ins do not touch any of this
+--
+
+local spGetTimer = (not isSyncedCode) and Spring.GetTimer or nil
+local spDiffTimers = Spring.DiffTimers
+
+local callInStats = {}
+local callInStatsEnabled = false
+
+local function AddCallInStats(gadget, ciName, numEvents, startTimer)
+  local gadgetStats = callInStats[gadget.ghInfo.name]
+
+  if (gadgetStats == nil) then
+    gadgetStats = {}
+    callInStats[gadget.ghInfo.name] = gadgetStats
+  end
+
+  local stats = gadgetStats[ciName]
+
+  if (stats == nil) then
+    stats = {calls = 0, events = 0, time = 0}
+    gadgetStats[ciName] = stats
+  end
+
+  stats.calls = stats.calls + 1
+  stats.events = stats.events + numEvents
+
+  if (startTimer ~= nil) then
+    stats.time = stats.time + spDiffTimers(spGetTimer(), startTimer, true)
+  end
+end
+
+
+function gadgetHandler:GetCallInStats()
+  callInStatsEnabled = true
+  return callInStats
+end
+
+
 function gadgetHandler:GetViewSizes()
   return self.xViewSize, self.yViewSize
 end
@@ -878,6 +922,12 @@ function gadgetHandler:GameFrame(frameNum)
   end
 end
 
+function gadgetHandler:GameFramePost(frameNum)
+  for _,g in r_ipairs(self.GameFramePostList) do
+    g:GameFramePost(frameNum)
+  end
+end
+
 function gadgetHandler:GamePaused(playerID, paused)
   for _,g in r_ipairs(self.GamePausedList) do
     g:GamePaused(playerID, paused)
@@ -1346,6 +1396,27 @@ function gadgetHandler:AllowWeaponTarget(attackerID, targetID, attackerWeaponNum
 	return allowed, priority
 end
 
+function gadgetHandler:AllowWeaponTargets(attackerIDs, targetIDs, attackerWeaponNums, attackerWeaponDefIDs, targetPriorities)
+	-- while this callin is defined the engine does not call AllowWeaponTarget
+	-- for auto-target candidates, so dispatch those to per-candidate gadgets
+	if (#self.AllowWeaponTargetList > 0) then
+		for i = 1, #targetIDs do
+			local allowed, priority = self:AllowWeaponTarget(attackerIDs[i], targetIDs[i], attackerWeaponNums[i], attackerWeaponDefIDs[i], targetPriorities[i])
+
+			if (allowed) then
+				targetPriorities[i] = priority
+			else
+				targetPriorities[i] = false
+			end
+		end
+	end
+
+	-- gadgets modify targetPriorities in-place; a non-number entry rejects that target
+	for _, g in r_ipairs(self.AllowWeaponTargetsList) do
+		g:AllowWeaponTargets(attackerIDs, targetIDs, attackerWeaponNums, attackerWeaponDefIDs, targetPriorities)
+	end
+end
+
 function gadgetHandler:AllowWeaponInterceptTarget(interceptorUnitID, interceptorWeaponNum, interceptorTargetID)
 	for _, g in r_ipairs(self.AllowWeaponInterceptTargetList) do
 		if (not g:AllowWeaponInterceptTarget(interceptorUnitID, interceptorWeaponNum, interceptorTargetID)) then
@@ -1492,10 +1563,52 @@ function gadgetHandler:UnitDamaged(
   attackerDefID,
   attackerTeam
 )
+  if (not callInStatsEnabled) then
+    for _,g in r_ipairs(self.UnitDamagedList) do
+      g:UnitDamaged(unitID, unitDefID, unitTeam,
+                    damage, paralyzer, weaponDefID, projectileID,
+                    attackerID, attackerDefID, attackerTeam)
+    end
+    return
+  end
+
   for _,g in r_ipairs(self.UnitDamagedList) do
+    local startTimer = spGetTimer and spGetTimer()
+
     g:UnitDamaged(unitID, unitDefID, unitTeam,
                   damage, paralyzer, weaponDefID, projectileID,
                   attackerID, attackerDefID, attackerTeam)
+
+    AddCallInStats(g, "UnitDamaged", 1, startTimer)
+  end
+end
+
+-- each argument after numEvents is an array holding the respective
+-- UnitDamaged argument for every event; the arrays are shared by all
+-- gadgets and must not be modified
+function gadgetHandler:UnitDamagedBatch(
+  numEvents,
+  unitIDs,
+  unitDefIDs,
+  unitTeams,
+  damages,
+  paralyzers,
+  weaponDefIDs,
+  projectileIDs,
+  attackerIDs,
+  attackerDefIDs,
+  attackerTeams
+)
+  for _,g in r_ipairs(self.UnitDamagedBatchList) do
+    local startTimer = callInStatsEnabled and spGetTimer and spGetTimer()
+
+    g:UnitDamagedBatch(numEvents, unitIDs, unitDefIDs, unitTeams,
+                       damages, paralyzers, weaponDefIDs, projectileIDs,
+                       attackerIDs, attackerDefIDs, attackerTeams)
+
+    if (callInStatsEnabled) then
+      AddCallInStats(g, "UnitDamagedBatch", numEvents, startTimer)
+    end
   end
 end
 
@@ -27,6 +27,9 @@ public:
 	//! if this client is the server player, the port over which we accept incoming connections
 	int hostPort;
 
+	//! if watching a demo, the frame to start from (see /seekdemo)
+	int demoStartFrame;
+
 	bool isHost;
 };
 
@@ -46,6 +46,7 @@
 #include "Rendering/UnitDrawer.h"
 #include "Rendering/Map/InfoTexture/IInfoTextureHandler.h"
 #include "Rendering/Textures/NamedTextures.h"
+#include "Lua/LuaDefsCache.h"
 #include "Lua/LuaGaia.h"
 #include "Lua/LuaHandle.h"
 #include "Lua/LuaInputReceiver.h"
@@ -103,6 +104,7 @@
 #include "UI/TooltipConsole.h"
 #include "UI/ProfileDrawer.h"
 #include "UI/Groups/GroupHandler.h"
+#include "System/CRC.h"
 #include "System/Config/ConfigHandler.h"
 #include "System/EventHandler.h"
 #include "System/Exceptions.h"
@@ -110,8 +112,12 @@
 #include "System/SafeUtil.h"
 #include "System/SpringExitCode.h"
 #include "System/SpringMath.h"
+#include "System/StringUtil.h"
+#include "System/FileSystem/DataDirsAccess.h"
+#include "System/FileSystem/FileQueryFlags.h"
 #include "System/FileSystem/FileSystem.h"
 #include "System/LoadSave/LoadSaveHandler.h"
+#include "System/LoadSave/CregLoadSaveHandler.h"
 #include "System/LoadSave/DemoRecorder.h"
 #include "System/Log/ILog.h"
 #include "System/Platform/Misc.h"
@@ -119,12 +125,16 @@
 #include "System/Sound/ISound.h"
 #include "System/Sound/ISoundChannels.h"
 #include "System/Sync/DumpState.h"
+#include "System/Sync/SyncChecker.h"
 #include "System/TimeProfiler.h"
 
 
 #undef CreateDirectory
 
 CONFIG(bool, GameEndOnConnectionLoss).defaultValue(true);
+CONFIG(int, ProfileTraceEvents).defaultValue(0).minimumValue(0).description("Per-thread capacity of the profiler's trace ring-buffers. If non-zero, trace recording starts with the game (see /ProfileTrace).");
+CONFIG(int, ProfileTraceLagDump).defaultValue(0).minimumValue(0).description("Sim frames that take longer than this many milliseconds automatically dump the profiler trace (at most once per minute) while tracing, 0 disables.");
+CONFIG(int, DemoKeyFrameInterval).defaultValue(0).minimumValue(0).description("Game-seconds between savestate keyframes stored in recorded demos, which let replays jump to them (see /seekdemo). Saving a keyframe stalls the simulation and can take megabytes, 0 disables.");
 // CONFIG(bool, LuaCollectGarbageOnSimFrame).defaultValue(true);
 
 CONFIG(bool, WindowedEdgeMove).defaultValue(true).description("Sets whether moving the mouse cursor to the screen edge will move the camera across the map.");
@@ -199,6 +209,10 @@ CR_REG_METADATA(CGame, (
 
 	CR_MEMBER(speedControl),
 	CR_MEMBER(luaGCControl),
+	CR_IGNORED(demoKeyFrameInterval),
+	CR_IGNORED(joinSnapshotFrame),
+	CR_IGNORED(profileTraceLagDump),
+	CR_IGNORED(lastProfileTraceDumpTime),
 
 	CR_IGNORED(jobDispatcher),
 	CR_IGNORED(curKeyChain),
@@ -241,6 +255,11 @@ CGame::CGame(const std::string& mapFileName, const std::string& modFileName, ILo
 	showSpeed = configHandler->GetBool("ShowSpeed");
 
 	speedControl = configHandler->GetInt("SpeedControl");
+	demoKeyFrameInterval = configHandler->GetInt("DemoKeyFrameInterval") * GAME_SPEED;
+	profileTraceLagDump = configHandler->GetInt("ProfileTraceLagDump");
+
+	if (configHandler->GetInt("ProfileTraceEvents") > 0)
+		profiler.StartTrace(configHandler->GetInt("ProfileTraceEvents"));
 
 	playerRoster.SetSortTypeByCode((PlayerRoster::SortType)configHandler->GetInt("ShowPlayerInfo"));
 
@@ -488,8 +507,8 @@ void CGame::LoadDefs(LuaParser* defsParser)
 		defsParser->AddFunc("GetMapOptions", LuaSyncedRead::GetMapOptions);
 		defsParser->EndTable();
 
-		// run the parser
-		if (!defsParser->Execute())
+		// run the parser, or restore what it returned last time
+		if (!LuaDefsCache::Execute(defsParser))
 			throw content_error("Defs-Parser: " + defsParser->GetErrorLog());
 
 		const LuaTable& root = defsParser->GetRoot();
@@ -1482,6 +1501,8 @@ void CGame::SimFrame() {
 	gs->frameNum += 1;
 	lastFrameTime = spring_gettime();
 
+	profiler.SetTraceFrame(gs->frameNum);
+
 	// clear allocator statistics periodically
 	// note: allocator itself should do this (so that
 	// stats are reliable when paused) but see LuaUser
@@ -1540,12 +1561,25 @@ void CGame::SimFrame() {
 
 		teamHandler.GameFrame(gs->frameNum);
 		playerHandler.GameFrame(gs->frameNum);
+
+		{
+			SCOPED_TIMER("Sim::GameFramePost");
+			// also flushes batched Lua callins (eg. UnitDamagedBatch)
+			eventHandler.GameFramePost(gs->frameNum);
+		}
 	}
 
 	lastSimFrameTime = spring_gettime();
 	gu->avgSimFrameTime = mix(gu->avgSimFrameTime, (lastSimFrameTime - lastFrameTime).toMilliSecsf(), 0.05f);
 	gu->avgSimFrameTime = std::max(gu->avgSimFrameTime, 0.001f);
 
+	if (profileTraceLagDump > 0 && profiler.IsTracing() && (lastSimFrameTime - lastFrameTime).toMilliSecsi() > profileTraceLagDump) {
+		if (!spring_istime(lastProfileTraceDumpTime) || (lastSimFrameTime - lastProfileTraceDumpTime).toSecsi() >= 60) {
+			lastProfileTraceDumpTime = lastSimFrameTime;
+			DumpProfileTrace("");
+		}
+	}
+
 	eventHandler.DbgTimingInfo(TIMING_SIM, lastFrameTime, lastSimFrameTime);
 
 	#ifdef HEADLESS
@@ -1569,6 +1603,86 @@ void CGame::SimFrame() {
 }
 
 
+bool CGame::DumpProfileTrace(const std::string& fileName) const
+{
+	std::string traceFileName = fileName;
+
+	if (traceFileName.empty())
+		traceFileName = "profile-trace-" + IntToString(gs->frameNum) + ".json";
+
+	// names come from chat commands, keep them inside the write-dir
+	if (FileSystem::IsAbsolutePath(traceFileName) || !FileSystem::CheckFile(traceFileName)) {
+		LOG_L(L_ERROR, "[Game::%s] trace file \"%s\" must be a relative path without \"..\"", __func__, traceFileName.c_str());
+		return false;
+	}
+
+	return (profiler.DumpTrace(dataDirsAccess.LocateFile(traceFileName, FileQueryFlags::WRITE)));
+}
+
+
+void CGame::SaveDemoKeyFrame()
+{
+	if (demoKeyFrameInterval <= 0 || gs->frameNum <= 0 || (gs->frameNum % demoKeyFrameInterval) != 0)
+		return;
+
+	CDemoRecorder* recorder = clientNet->GetDemoRecorder();
+
+	if (!recorder->IsValid())
+		return;
+
+	CCregLoadSaveHandler lsh;
+	std::string data;
+
+	lsh.SaveInfo(gameSetup->mapName, gameSetup->modName);
+
+	if (!lsh.SaveGameState(data))
+		return;
+
+	recorder->AddKeyFrame(gs->frameNum, data);
+}
+
+
+void CGame::SaveJoinSnapshot()
+{
+	if (gs->frameNum != joinSnapshotFrame)
+		return;
+
+	joinSnapshotFrame = -1;
+
+	CCregLoadSaveHandler lsh;
+	std::string data;
+
+	lsh.SaveInfo(gameSetup->mapName, gameSetup->modName);
+
+	if (!lsh.SaveGameState(data, true))
+		return;
+
+	const std::vector<std::uint8_t> deflData = zlib::deflate(reinterpret_cast<const std::uint8_t*>(data.data()), data.size());
+
+	if (deflData.empty())
+		return;
+
+	// must equal our sync-response for this frame, the server compares them
+	uint32_t syncChecksum = 0;
+
+	#ifdef SYNCCHECK
+	syncChecksum = CSyncChecker::GetChecksum();
+	#endif
+
+	const uint32_t dataChecksum = CRC::CalcDigest(deflData.data(), deflData.size());
+	const uint32_t dataSize = deflData.size();
+
+	// keep chunks well below the 64K packet limit
+	constexpr uint32_t chunkSize = 32 * 1024;
+
+	for (uint32_t offset = 0; offset < dataSize; offset += chunkSize) {
+		clientNet->Send(CBaseNetProtocol::Get().SendJoinSnapshot(gu->myPlayerNum, gs->frameNum, syncChecksum, dataChecksum, dataSize, offset, &deflData[offset], std::min(chunkSize, dataSize - offset)));
+	}
+
+	LOG("[Game::%s] uploaded savestate of frame %d (%u bytes)", __func__, gs->frameNum, dataSize);
+}
+
+
 void CGame::GameEnd(const std::vector<unsigned char>& winningAllyTeams, bool timeout)
 {
 	if (gameOver)
@@ -107,6 +107,9 @@ public:
 	void SetDrawMode(GameDrawMode mode) { gameDrawMode = mode; }
 	GameDrawMode GetDrawMode() const { return gameDrawMode; }
 
+	/// writes the profiler's trace, to profile-trace-<frame>.json if fileName is empty
+	bool DumpProfileTrace(const std::string& fileName) const;
+
 private:
 	bool Draw() override;
 	bool Update() override;
@@ -141,6 +144,8 @@ private:
 	void UpdateNumQueuedSimFrames();
 	void UpdateNetMessageProcessingTimeLeft();
 	void SimFrame();
+	void SaveDemoKeyFrame();
+	void SaveJoinSnapshot();
 	void StartPlaying();
 
 public:
@@ -210,6 +215,15 @@ public:
 	// 0 := 1/f rate, 1 := 30/s rate
 	int luaGCControl = 0;
 
+	// frames between savestates stored in the recorded demo, 0 := none
+	int demoKeyFrameInterval = 0;
+	// frame whose savestate the server asked us to upload for late joiners
+	int joinSnapshotFrame = -1;
+
+	// sim frames longer than this (ms) dump the profiler trace, 0 := never
+	int profileTraceLagDump = 0;
+	spring_time lastProfileTraceDumpTime;
+
 private:
 	JobDispatcher jobDispatcher;
 
@@ -37,7 +37,11 @@
 #include "Sim/Weapons/Weapon.h"
 #include "System/EventHandler.h"
 #include "System/SpringMath.h"
+#include "System/TimeProfiler.h"
 #include "System/Sound/ISoundChannels.h"
+#include "System/Threading/ThreadPool.h" // for_mt
+
+#include <limits>
 
 
 static CGameHelper gGameHelper;
@@ -632,38 +636,112 @@ namespace {
 
 
 
-size_t CGameHelper::GenerateWeaponTargets(const CWeapon* weapon, const CUnit* avoidUnit, std::vector<std::pair<float, CUnit*>>& targets)
+static bool IsDeadWeaponTarget(const std::pair<float, CUnit*>& p) { return (p.second->isDead); }
+
+// [0] := default, [1,2,3,4,5,6] := target is {avoidee, in bad category, crashing, last attacker, paralyzed, outside unboosted range}
+static constexpr float tgtPriorityMults[] = {1.0f, 10.0f, 100.0f, 1000.0f, 0.5f, 4.0f, 100000.0f};
+
+CGameHelper::WeaponTargetParams::WeaponTargetParams(const CWeapon* w, const CUnit* avoidee): weapon(w), avoidUnit(avoidee)
 {
-	const CUnit*  weaponOwner = weapon->owner;
-	const CUnit* lastAttacker = ((weaponOwner->lastAttackFrame + 200) <= gs->frameNum) ? weaponOwner->lastAttacker : nullptr;
+	const CUnit* weaponOwner = weapon->owner;
 
 	const      WeaponDef* weaponDef = weapon->weaponDef;
 	const DynDamageArray* weaponDmg = weapon->damages;
 
-	const float3& ownerPos = weaponOwner->pos;
-	const float3 testPos;
-
-	const float aimPosHeight = weapon->aimFromPos.y;
 	const float minMapHeight = std::max(0.0f, readMap->GetCurrMinHeight());
 
+	lastAttacker = ((weaponOwner->lastAttackFrame + 200) <= gs->frameNum) ? weaponOwner->lastAttacker : nullptr;
+
+	aimPosHeight = weapon->aimFromPos.y;
 	// how much damage the weapon deals over 1 second
-	const float secDamage = weaponDmg->GetDefault() * weapon->salvoSize / weapon->reloadTime * GAME_SPEED;
-	const float heightMod = weaponDef->heightmod;
+	secDamage = weaponDmg->GetDefault() * weapon->salvoSize / weapon->reloadTime * GAME_SPEED;
+	heightMod = weaponDef->heightmod;
 
-	const float  baseRange = weapon->range;
-	const float rangeBoost = weapon->autoTargetRangeBoost;
+	baseRange = weapon->range;
+	rangeBoost = weapon->autoTargetRangeBoost;
 	// find theoretical maximum range based on height above lowest point on map
-	// const float scanRadius = weapon->GetRange2D(rangeBoost, (minMapHeight - aimPosHeight) * heightMod);
-	const float scanRadius = baseRange + rangeBoost + (aimPosHeight - minMapHeight) * heightMod;
+	// scanRadius = weapon->GetRange2D(rangeBoost, (minMapHeight - aimPosHeight) * heightMod);
+	scanRadius = baseRange + rangeBoost + (aimPosHeight - minMapHeight) * heightMod;
+
+	paralyzer = (weaponDmg->paralyzeDamageTime != 0);
+}
+
+
+bool CGameHelper::CalcBaseWeaponTargetPriority(const WeaponTargetParams& params, const CUnit* targetUnit, unsigned short targetLOSState, float& targetPriority)
+{
+	const CWeapon* weapon = params.weapon;
+	const WeaponDef* weaponDef = weapon->weaponDef;
+
+	const float3& ownerPos = weapon->owner->pos;
+	      float3 targetPos;
+
+	targetPriority = tgtPriorityMults[(targetUnit == params.avoidUnit) * 1];
+
+	if (targetLOSState & LOS_INLOS) {
+		targetPos = targetUnit->aimPos;
+	} else if (targetLOSState & LOS_INRADAR) {
+		targetPos = weapon->GetUnitPositionWithError(targetUnit);
+		targetPriority *= tgtPriorityMults[1];
+	} else {
+		return false;
+	}
+
+	const float modRange = weapon->GetRange2D(params.rangeBoost, (targetPos.y - params.aimPosHeight) * params.heightMod);
+	const float sqDist2D = ownerPos.SqDistance2D(targetPos);
+
+	if (sqDist2D > Square(modRange))
+		return false;
+
+	const float dist2D = math::sqrt(sqDist2D);
+	const float rangeMul = (dist2D * weaponDef->proximityPriority + modRange * 0.4f + 100.0f);
 
-	// [0] := default, [1,2,3,4,5,6] := target is {avoidee, in bad category, crashing, last attacker, paralyzed, outside unboosted range}
-	constexpr float tgtPriorityMults[] = {1.0f, 10.0f, 100.0f, 1000.0f, 0.5f, 4.0f, 100000.0f};
+	targetPriority *= rangeMul;
+	targetPriority *= tgtPriorityMults[(dist2D > params.baseRange) * 6];
 
-	const bool paralyzer = (weaponDmg->paralyzeDamageTime != 0);
+	if (targetLOSState & LOS_INLOS) {
+		targetPriority *= (params.secDamage + targetUnit->health);
+
+		if (params.paralyzer && targetUnit->paralyzeDamage > (modInfo.paralyzeOnMaxHealth? targetUnit->maxHealth: targetUnit->health))
+			targetPriority *= tgtPriorityMults[5];
+
+	} else {
+		targetPriority *= (params.secDamage + 10000.0f);
+	}
+
+	return true;
+}
+
+float CGameHelper::CalcWeaponTargetPriority(const WeaponTargetParams& params, const CUnit* targetUnit, unsigned short targetLOSState, float targetPriority)
+{
+	const CWeapon* weapon = params.weapon;
+
+	if ((targetLOSState & LOS_INLOS) && weapon->hasTargetWeight)
+		targetPriority *= weapon->TargetWeight(targetUnit);
+
+	if ((targetLOSState & LOS_PREVLOS) == 0)
+		return targetPriority;
+
+	const float damageMul = weapon->damages->Get(targetUnit->armorType) * targetUnit->curArmorMultiple;
+
+	targetPriority /= (damageMul * targetUnit->power * (0.7f + gsRNG.NextFloat() * 0.6f));
+	targetPriority *= tgtPriorityMults[((targetUnit->category & weapon->badTargetCategory) != 0) * 2];
+	targetPriority *= tgtPriorityMults[(targetUnit->IsCrashing()) * 3];
+	targetPriority *= tgtPriorityMults[(targetUnit == params.lastAttacker) * 4];
+	return targetPriority;
+}
+
+
+size_t CGameHelper::GenerateWeaponTargets(const CWeapon* weapon, const CUnit* avoidUnit, std::vector<std::pair<float, CUnit*>>& targets)
+{
+	const CUnit* weaponOwner = weapon->owner;
+	const WeaponDef* weaponDef = weapon->weaponDef;
+
+	const WeaponTargetParams params(weapon, avoidUnit);
+	const float3 testPos;
 
 	// copy on purpose since the below calls lua
 	QuadFieldQuery qfQuery;
-	quadField.GetQuads(qfQuery, ownerPos, scanRadius);
+	quadField.GetQuads(qfQuery, weaponOwner->pos, params.scanRadius);
 
 	targets.clear();
 	targets.reserve(32);
@@ -688,66 +766,244 @@ size_t CGameHelper::GenerateWeaponTargets(const CWeapon* weapon, const CUnit* av
 
 				const unsigned short targetLOSState = targetUnit->losStatus[weaponOwner->allyteam];
 
-				float targetPriority = tgtPriorityMults[(targetUnit == avoidUnit) * 1];
-				float3 targetPos;
+				float targetPriority = 0.0f;
 
-				if (targetLOSState & LOS_INLOS) {
-					targetPos = targetUnit->aimPos;
-				} else if (targetLOSState & LOS_INRADAR) {
-					targetPos = weapon->GetUnitPositionWithError(targetUnit);
-					targetPriority *= tgtPriorityMults[1];
-				} else {
+				if (!CalcBaseWeaponTargetPriority(params, targetUnit, targetLOSState, targetPriority))
 					continue;
-				}
 
-				const float modRange = weapon->GetRange2D(rangeBoost, (targetPos.y - aimPosHeight) * heightMod);
-				const float sqDist2D = ownerPos.SqDistance2D(targetPos);
+				targetPriority = CalcWeaponTargetPriority(params, targetUnit, targetLOSState, targetPriority);
+
+				const bool allowTarget = eventHandler.AllowWeaponTarget(weaponOwner->id, targetUnit->id, weapon->weaponNum, weaponDef->id, &targetPriority);
+
+				// Lua call may have changed tempNum, so needs to be set again
+				targetUnit->tempNum = tempNum;
 
-				if (sqDist2D > Square(modRange))
+				if (!allowTarget)
 					continue;
 
-				const float dist2D = math::sqrt(sqDist2D);
-				const float rangeMul = (dist2D * weaponDef->proximityPriority + modRange * 0.4f + 100.0f);
-				const float damageMul = weaponDmg->Get(targetUnit->armorType) * targetUnit->curArmorMultiple;
+				targets.emplace_back(targetPriority, targetUnit);
+			}
+		}
+	}
 
-				targetPriority *= rangeMul;
-				targetPriority *= tgtPriorityMults[(dist2D > baseRange) * 6];
+	if (eventHandler.HaveAllowWeaponTargets()) {
+		std::vector<SWeaponTargetCandidate> candidates;
+		candidates.reserve(targets.size());
 
-				if (targetLOSState & LOS_INLOS) {
-					targetPriority *= (secDamage + targetUnit->health);
+		FilterWeaponTargets(weapon, targets, candidates);
+	}
 
-					if (paralyzer && targetUnit->paralyzeDamage > (modInfo.paralyzeOnMaxHealth? targetUnit->maxHealth: targetUnit->health))
-						targetPriority *= tgtPriorityMults[5];
+	std::stable_sort(targets.begin(), targets.end(), [](const std::pair<float, CUnit*>& a, const std::pair<float, CUnit*>& b) { return (a.first < b.first); });
+	return (targets.size());
+}
 
-					if (weapon->hasTargetWeight)
-						targetPriority *= weapon->TargetWeight(targetUnit);
 
-				} else {
-					targetPriority *= (secDamage + 10000.0f);
-				}
+void CGameHelper::FilterWeaponTargets(const CWeapon* weapon, std::vector<std::pair<float, CUnit*>>& targets, std::vector<SWeaponTargetCandidate>& candidates)
+{
+	candidates.clear();
+	targets.erase(std::remove_if(targets.begin(), targets.end(), IsDeadWeaponTarget), targets.end());
 
-				if (targetLOSState & LOS_PREVLOS) {
-					targetPriority /= (damageMul * targetUnit->power * (0.7f + gsRNG.NextFloat() * 0.6f));
-					targetPriority *= tgtPriorityMults[((targetUnit->category & weapon->badTargetCategory) != 0) * 2];
-					targetPriority *= tgtPriorityMults[(targetUnit->IsCrashing()) * 3];
-					targetPriority *= tgtPriorityMults[(targetUnit == lastAttacker) * 4];
-				}
+	if (weapon->owner->isDead || targets.empty())
+		return;
 
-				const bool allowTarget = eventHandler.AllowWeaponTarget(weaponOwner->id, targetUnit->id, weapon->weaponNum, weaponDef->id, &targetPriority);
+	for (const auto& target: targets) {
+		candidates.push_back({weapon, target.second, target.first, true});
+	}
 
-				// Lua call may have changed tempNum, so needs to be set again
-				targetUnit->tempNum = tempNum;
+	eventHandler.AllowWeaponTargets(candidates);
 
-				if (!allowTarget)
+	size_t numTargets = 0;
+
+	for (size_t j = 0, n = targets.size(); j < n; j++) {
+		// the callin may also have killed some of the candidates
+		if (!candidates[j].allowed || targets[j].second->isDead)
+			continue;
+
+		targets[numTargets++] = {candidates[j].priority, targets[j].second};
+	}
+
+	targets.resize(numTargets);
+}
+
+
+bool CGameHelper::QueueWeaponTargets(CWeapon* weapon, const CUnit* avoidUnit)
+{
+	if (!inWeaponTargetBatch)
+		return false;
+
+	// already pending, the job will pick for it
+	if (!queuedTargetWeapons.insert(weapon).second)
+		return true;
+
+	if (numWeaponTargetJobs == weaponTargetJobs.size())
+		weaponTargetJobs.emplace_back();
+
+	WeaponTargetJob& job = weaponTargetJobs[numWeaponTargetJobs++];
+
+	// gather the quads at queue time, same as the immediate path would
+	QuadFieldQuery qfQuery;
+
+	job.weapon = weapon;
+	job.params = WeaponTargetParams(weapon, avoidUnit);
+
+	quadField.GetQuads(qfQuery, weapon->owner->pos, job.params.scanRadius);
+	job.quads.assign(qfQuery.quads->begin(), qfQuery.quads->end());
+	return true;
+}
+
+void CGameHelper::ScanWeaponTargets(WeaponTargetJob& job, std::vector<int>& unitMarks, int mark)
+{
+	const CWeapon* weapon = job.weapon;
+	const CUnit* weaponOwner = weapon->owner;
+
+	const float3 testPos;
+
+	job.targets.clear();
+	job.targetLosStates.clear();
+
+	for (int t = 0; t < teamHandler.ActiveAllyTeams(); ++t) {
+		if (teamHandler.Ally(weaponOwner->allyteam, t))
+			continue;
+
+		for (const int qi: job.quads) {
+			for (CUnit* targetUnit: quadField.GetQuad(qi).teamUnits[t]) {
+				// per-thread replacement for tempNum
+				if (unitMarks[targetUnit->id] == mark)
 					continue;
 
-				targets.emplace_back(targetPriority, targetUnit);
+				unitMarks[targetUnit->id] = mark;
+
+				if (!weapon->TestTarget(testPos, SWeaponTarget(targetUnit)))
+					continue;
+
+				const unsigned short targetLOSState = targetUnit->losStatus[weaponOwner->allyteam];
+
+				float targetPriority = 0.0f;
+
+				if (!CalcBaseWeaponTargetPriority(job.params, targetUnit, targetLOSState, targetPriority))
+					continue;
+
+				job.targets.emplace_back(targetPriority, targetUnit);
+				job.targetLosStates.push_back(targetLOSState);
 			}
 		}
 	}
+}
 
-	std::stable_sort(targets.begin(), targets.end(), [](const std::pair<float, CUnit*>& a, const std::pair<float, CUnit*>& b) { return (a.first < b.first); });
-	return (targets.size());
+void CGameHelper::EndWeaponTargetBatch()
+{
+	inWeaponTargetBatch = false;
+
+	if (numWeaponTargetJobs == 0)
+		return;
+
+	SCOPED_TIMER("Sim::Unit::Weapon::AutoTarget");
+
+	{
+		// marks must be unique per job across batches; reset them before the counter wraps
+		if (weaponTargetMarkBase > (std::numeric_limits<int>::max() - int(numWeaponTargetJobs) - 1)) {
+			for (auto& unitMarks: weaponTargetUnitMarks) {
+				std::fill(unitMarks.begin(), unitMarks.end(), 0);
+			}
+
+			weaponTargetMarkBase = 0;
+		}
+
+		weaponTargetUnitMarks.resize(ThreadPool::MAX_THREADS);
+
+		for_mt(0, numWeaponTargetJobs, [&](const int i) {
+			std::vector<int>& unitMarks = weaponTargetUnitMarks[ThreadPool::GetThreadNum()];
+
+			if (unitMarks.size() < unitHandler.MaxUnits())
+				unitMarks.resize(unitHandler.MaxUnits(), 0);
+
+			ScanWeaponTargets(weaponTargetJobs[i], unitMarks, weaponTargetMarkBase + i + 1);
+		});
+
+		weaponTargetMarkBase += numWeaponTargetJobs;
+	}
+
+	// script TargetWeight calls, synced RNG draws and per-candidate callins happen in job order
+	// owners and targets can die during the stagger loop or in any callin, so skip dead ones
+	// before handing them to scripts or Lua
+	for (size_t i = 0; i < numWeaponTargetJobs; i++) {
+		WeaponTargetJob& job = weaponTargetJobs[i];
+
+		const CWeapon* weapon = job.weapon;
+		const CUnit* weaponOwner = weapon->owner;
+
+		size_t numTargets = 0;
+
+		for (size_t j = 0, n = job.targets.size(); j < n && !weaponOwner->isDead; j++) {
+			CUnit* targetUnit = job.targets[j].second;
+
+			if (targetUnit->isDead)
+				continue;
+
+			float targetPriority = CalcWeaponTargetPriority(job.params, targetUnit, job.targetLosStates[j], job.targets[j].first);
+
+			if (!eventHandler.AllowWeaponTarget(weaponOwner->id, targetUnit->id, weapon->weaponNum, weapon->weaponDef->id, &targetPriority))
+				continue;
+
+			job.targets[numTargets++] = {targetPriority, targetUnit};
+		}
+
+		job.targets.resize(numTargets);
+	}
+
+	if (eventHandler.HaveAllowWeaponTargets()) {
+		weaponTargetCandidates.clear();
+
+		// one Lua call for all candidates generated this frame
+		for (size_t i = 0; i < numWeaponTargetJobs; i++) {
+			WeaponTargetJob& job = weaponTargetJobs[i];
+
+			if (job.weapon->owner->isDead) {
+				job.targets.clear();
+				continue;
+			}
+
+			job.targets.erase(std::remove_if(job.targets.begin(), job.targets.end(), IsDeadWeaponTarget), job.targets.end());
+
+			for (const auto& target: job.targets) {
+				weaponTargetCandidates.push_back({job.weapon, target.second, target.first, true});
+			}
+		}
+
+		eventHandler.AllowWeaponTargets(weaponTargetCandidates);
+
+		for (size_t i = 0, k = 0; i < numWeaponTargetJobs; i++) {
+			WeaponTargetJob& job = weaponTargetJobs[i];
+
+			size_t numTargets = 0;
+
+			for (size_t j = 0, n = job.targets.size(); j < n; j++, k++) {
+				const SWeaponTargetCandidate& candidate = weaponTargetCandidates[k];
+
+				if (!candidate.allowed)
+					continue;
+
+				job.targets[numTargets++] = {candidate.priority, job.targets[j].second};
+			}
+
+			job.targets.resize(numTargets);
+		}
+	}
+
+	for (size_t i = 0; i < numWeaponTargetJobs; i++) {
+		WeaponTargetJob& job = weaponTargetJobs[i];
+
+		// Lua may have killed the owner or targets in any of the above callins
+		if (job.weapon->owner->isDead)
+			continue;
+
+		job.targets.erase(std::remove_if(job.targets.begin(), job.targets.end(), IsDeadWeaponTarget), job.targets.end());
+
+		std::stable_sort(job.targets.begin(), job.targets.end(), [](const std::pair<float, CUnit*>& a, const std::pair<float, CUnit*>& b) { return (a.first < b.first); });
+		job.weapon->PickAutoTarget(job.targets);
+	}
+
+	numWeaponTargetJobs = 0;
 }
 
 
@@ -6,8 +6,10 @@
 #include "Sim/Misc/DamageArray.h"
 #include "Sim/Projectiles/ExplosionListener.h"
 #include "Sim/Units/CommandAI/Command.h"
+#include "Sim/Weapons/WeaponTarget.h"
 #include "System/float3.h"
 #include "System/type2.h"
+#include "System/UnorderedSet.hpp"
 
 #include <array>
 #include <vector>
@@ -128,6 +130,14 @@ public:
 
 	static size_t GenerateWeaponTargets(const CWeapon* weapon, const CUnit* avoidUnit, std::vector<std::pair<float, CUnit*>>& targets);
 
+	// batched variant of CWeapon::AutoTarget; weapons queued between Begin and
+	// End have their candidates scored in parallel and targets applied serially
+	// (in queueing order) by End, which also batches the Lua AllowWeaponTargets
+	// each weapon is queued at most once per batch
+	void BeginWeaponTargetBatch() { numWeaponTargetJobs = 0; queuedTargetWeapons.clear(); inWeaponTargetBatch = true; }
+	void EndWeaponTargetBatch();
+	bool QueueWeaponTargets(CWeapon* weapon, const CUnit* avoidUnit);
+
 	void Init();
 	void Update();
 
@@ -179,9 +189,55 @@ private:
 		float3 impulse;
 	};
 
+	struct WeaponTargetParams {
+		WeaponTargetParams() = default;
+		WeaponTargetParams(const CWeapon* weapon, const CUnit* avoidUnit);
+
+		const CWeapon* weapon = nullptr;
+		const CUnit* avoidUnit = nullptr;
+		const CUnit* lastAttacker = nullptr;
+
+		float aimPosHeight = 0.0f;
+		float secDamage = 0.0f;
+		float heightMod = 0.0f;
+		float baseRange = 0.0f;
+		float rangeBoost = 0.0f;
+		float scanRadius = 0.0f;
+
+		bool paralyzer = false;
+	};
+
+	struct WeaponTargetJob {
+		CWeapon* weapon = nullptr;
+		WeaponTargetParams params;
+
+		std::vector<int> quads;
+		std::vector<std::pair<float, CUnit*>> targets;
+		std::vector<unsigned short> targetLosStates;
+	};
+
+	// thread-safe part of the target priority; false if <targetUnit> is not a candidate
+	static bool CalcBaseWeaponTargetPriority(const WeaponTargetParams& params, const CUnit* targetUnit, unsigned short targetLOSState, float& targetPriority);
+	// must be called serially and in a deterministic order (script and synced RNG calls)
+	static float CalcWeaponTargetPriority(const WeaponTargetParams& params, const CUnit* targetUnit, unsigned short targetLOSState, float targetPriority);
+
+	static void ScanWeaponTargets(WeaponTargetJob& job, std::vector<int>& unitMarks, int mark);
+	// removes dead targets and, for clients with the batched callin, the ones they reject
+	static void FilterWeaponTargets(const CWeapon* weapon, std::vector<std::pair<float, CUnit*>>& targets, std::vector<SWeaponTargetCandidate>& candidates);
+
 	// note: size must be a power of two
 	std::array<std::vector<WaitingDamage>, 128> waitingDamages;
 
+	std::vector<WeaponTargetJob> weaponTargetJobs;
+	std::vector<SWeaponTargetCandidate> weaponTargetCandidates;
+	std::vector<std::vector<int>> weaponTargetUnitMarks; // per-thread; indexed by unit ID
+
+	spring::unordered_set<const CWeapon*> queuedTargetWeapons;
+
+	size_t numWeaponTargetJobs = 0;
+	int weaponTargetMarkBase = 0;
+	bool inWeaponTargetBatch = false;
+
 public:
 	std::vector<int> targetUnitIDs; // GetEnemyUnits{NoLosTest}
 	std::vector<std::pair<float, CUnit*>> targetPairs; // GenerateWeaponTargets
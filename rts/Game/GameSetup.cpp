@@ -40,6 +40,7 @@ CR_REG_METADATA(CGameSetup, (
 	CR_IGNORED(gameStartDelay),
 
 	CR_IGNORED(numDemoPlayers),
+	CR_IGNORED(demoStartFrame),
 	CR_IGNORED(maxUnitsPerTeam),
 
 	CR_IGNORED(minSpeed),
@@ -182,6 +183,7 @@ void CGameSetup::ResetState()
 
 	gameStartDelay = 0;
 	numDemoPlayers = 0;
+	demoStartFrame = 0;
 	maxUnitsPerTeam = 0;
 
 	maxSpeed = 0.0f;
@@ -588,6 +590,7 @@ bool CGameSetup::Init(const std::string& buf)
 	hostDemo    = !demoName.empty();
 
 	file.GetTDef(gameStartDelay, 4u, "GAME\\GameStartDelay");
+	file.GetTDef(demoStartFrame, 0, "GAME\\DemoStartFrame");
 
 	file.GetDef(recordDemo,          "1", "GAME\\RecordDemo");
 	file.GetDef(useLuaGaia,          "1", "GAME\\ModOptions\\LuaGaia");
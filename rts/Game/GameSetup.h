@@ -48,6 +48,7 @@ public:
 		gameStartDelay = gs.gameStartDelay;
 
 		numDemoPlayers = gs.numDemoPlayers;
+		demoStartFrame = gs.demoStartFrame;
 		maxUnitsPerTeam = gs.maxUnitsPerTeam;
 
 		maxSpeed = gs.maxSpeed;
@@ -200,6 +201,8 @@ public:
 	unsigned int gameStartDelay;
 
 	int numDemoPlayers;
+	/// frame a demo is watched from (its state comes from a demo keyframe), 0 if from the start
+	int demoStartFrame;
 	int maxUnitsPerTeam;
 
 	float maxSpeed;
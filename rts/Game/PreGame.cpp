@@ -30,10 +30,12 @@
 #include "Sim/Misc/GlobalSynced.h"
 #include "Sim/Misc/GlobalConstants.h"
 #include "Sim/Misc/TeamHandler.h"
+#include "System/CRC.h"
 #include "System/Config/ConfigHandler.h"
 #include "System/Exceptions.h"
 #include "System/SafeUtil.h"
 #include "System/SpringExitCode.h"
+#include "System/StringUtil.h"
 #include "System/TimeProfiler.h"
 #include "System/TdfParser.h"
 #include "System/Input/KeyInput.h"
@@ -43,6 +45,7 @@
 #include "System/LoadSave/DemoRecorder.h"
 #include "System/LoadSave/DemoReader.h"
 #include "System/LoadSave/LoadSaveHandler.h"
+#include "System/LoadSave/CregLoadSaveHandler.h"
 #include "System/Log/ILog.h"
 #include "System/Net/RawPacket.h"
 #include "System/Net/UnpackPacket.h"
@@ -376,6 +379,12 @@ void CPreGame::UpdateClientNet()
 				}
 			} break;
 
+			case NETMSG_JOIN_SNAPSHOT: {
+				// server sends these before gamedata if the game is running
+				// and a savestate of it is available, see NETMSG_SETPLAYERNUM
+				JoinSnapshotReceived(packet);
+			} break;
+
 			case NETMSG_GAMEDATA: {
 				// server first sends this to let us know about teams, allyteams
 				// etc. (not if we are joining mid-game as an extra player), see
@@ -403,6 +412,9 @@ void CPreGame::UpdateClientNet()
 				CLIENT_NETLOG(gu->myPlayerNum, LOG_LEVEL_INFO, mapChecksumMsgBuf);
 				CLIENT_NETLOG(gu->myPlayerNum, LOG_LEVEL_INFO, modChecksumMsgBuf);
 
+				if (!joinSnapshotData.empty())
+					LoadJoinSnapshot();
+
 				CLoadScreen::CreateDeleteInstance(std::move(gameSetup->MapFileName()), std::move(modFileName), saveFileHandler);
 
 				assert(pregame == this);
@@ -440,6 +452,10 @@ void CPreGame::StartServerForDemo(const std::string& demoName)
 		tgame->remove("SourcePort", false);
 		//tgame->remove("IsHost", false);
 
+		// tells the server to continue the stream from the keyframe
+		if (saveFileHandler != nullptr)
+			tgame->AddPair("DemoStartFrame", clientSetup->demoStartFrame);
+
 		for (auto& section: tgame->sections) {
 			if (section.first.size() > 6 && section.first.substr(0, 6) == "player") {
 				section.second->AddPair("isfromdemo", 1);
@@ -485,6 +501,9 @@ void CPreGame::ReadDataFromDemo(const std::string& demoName)
 		assert(gameData->GetSetupText() == scanner.GetSetupScript());
 
 		if (CGameSetup::LoadReceivedScript(gameData->GetSetupText(), true)) {
+			if (clientSetup->demoStartFrame > 0)
+				LoadDemoKeyFrame(scanner, clientSetup->demoStartFrame);
+
 			StartServerForDemo(demoName);
 		} else {
 			throw content_error("Demo contains incorrect script");
@@ -494,6 +513,105 @@ void CPreGame::ReadDataFromDemo(const std::string& demoName)
 	assert(gameServer != nullptr);
 }
 
+void CPreGame::LoadDemoKeyFrame(CDemoReader& demoReader, int frameNum)
+{
+	const int keyFrameIdx = demoReader.FindKeyFrame(frameNum);
+
+	std::string data;
+
+	if (keyFrameIdx < 0 || !demoReader.ReadKeyFrame(keyFrameIdx, data)) {
+		LOG_L(L_WARNING, "[PreGame::%s] demo has no keyframe before frame %d, playing from the start", __func__, frameNum);
+		return;
+	}
+
+	CCregLoadSaveHandler* lsh = new CCregLoadSaveHandler();
+
+	if (!lsh->LoadGameStateStartInfo(data, "demo keyframe") && !configHandler->GetBool("LoadBadSaves")) {
+		LOG_L(L_ERROR, "[PreGame::%s] incompatible demo keyframe, playing from the start", __func__);
+		delete lsh;
+		return;
+	}
+
+	LOG("[PreGame::%s] loading keyframe of frame %d (%u bytes)", __func__, demoReader.GetKeyFrames()[keyFrameIdx].frameNum, unsigned(data.size()));
+
+	// CGame loads the state like a savegame, GameServer::PostLoad continues the stream
+	saveFileHandler = lsh;
+}
+
+void CPreGame::JoinSnapshotReceived(std::shared_ptr<const netcode::RawPacket> packet)
+{
+	try {
+		netcode::UnpackPacket pckt(packet, sizeof(uint8_t));
+
+		uint16_t packetSize;
+		uint8_t  playerNum;
+		int32_t  frameNum;
+		uint32_t syncChecksum;
+		uint32_t dataChecksum;
+		uint32_t dataSize;
+		uint32_t dataOffset;
+
+		pckt >> packetSize;
+		pckt >> playerNum;
+		pckt >> frameNum;
+		pckt >> syncChecksum;
+		pckt >> dataChecksum;
+		pckt >> dataSize;
+		pckt >> dataOffset;
+
+		if (packetSize != packet->length)
+			throw netcode::UnpackPacketException("invalid packet-size");
+		if (dataOffset != joinSnapshotData.size() || (dataOffset > 0 && frameNum != joinSnapshotFrame))
+			throw netcode::UnpackPacketException("unexpected chunk");
+
+		std::vector<std::uint8_t> chunk(packetSize - (1 + sizeof(packetSize) + sizeof(playerNum) + sizeof(frameNum) + sizeof(syncChecksum) + sizeof(dataChecksum) + sizeof(dataSize) + sizeof(dataOffset)));
+
+		if ((dataOffset + chunk.size()) > dataSize)
+			throw netcode::UnpackPacketException("chunk exceeds savestate size");
+
+		if (!chunk.empty())
+			pckt >> chunk;
+
+		if (joinSnapshotData.empty())
+			joinSnapshotData.reserve(dataSize);
+
+		joinSnapshotData.insert(joinSnapshotData.end(), chunk.begin(), chunk.end());
+		joinSnapshotChecksum = dataChecksum;
+		joinSnapshotFrame = frameNum;
+	} catch (const netcode::UnpackPacketException& ex) {
+		throw content_error(std::string("invalid savestate received: ") + ex.what());
+	}
+}
+
+void CPreGame::LoadJoinSnapshot()
+{
+	ScopedOnceTimer timer("PreGame::LoadJoinSnapshot");
+
+	// the server skips all frames before the savestate, no way to recover
+	if (CRC::CalcDigest(joinSnapshotData.data(), joinSnapshotData.size()) != joinSnapshotChecksum)
+		throw content_error("corrupt savestate received from server");
+
+	const std::vector<std::uint8_t> inflData = zlib::inflate(joinSnapshotData);
+
+	if (inflData.empty())
+		throw content_error("could not decompress savestate received from server");
+
+	CCregLoadSaveHandler* lsh = new CCregLoadSaveHandler();
+
+	if (!lsh->LoadGameStateStartInfo(std::string(inflData.begin(), inflData.end()), "join savestate", true) && !configHandler->GetBool("LoadBadSaves")) {
+		delete lsh;
+		throw content_error("incompatible savestate received from server");
+	}
+
+	LOG("[PreGame::%s] loading savestate of frame %d (%u bytes)", __func__, joinSnapshotFrame, unsigned(joinSnapshotData.size()));
+
+	joinSnapshotData.clear();
+	joinSnapshotData.shrink_to_fit();
+
+	// CGame loads the state like a savegame and continues with the frames following it
+	saveFileHandler = lsh;
+}
+
 void CPreGame::GameDataReceived(std::shared_ptr<const netcode::RawPacket> packet)
 {
 	ScopedOnceTimer timer("PreGame::GameDataReceived");
@@ -3,13 +3,16 @@
 #ifndef PREGAME_H
 #define PREGAME_H
 
+#include <cinttypes>
 #include <string>
 #include <memory>
+#include <vector>
 
 #include "GameController.h"
 #include "System/Misc/SpringTime.h"
 
 class ILoadSaveHandler;
+class CDemoReader;
 class GameData;
 class CGameSetup;
 class ClientSetup;
@@ -58,11 +61,16 @@ private:
 
 	/// reads out map, mod and script from demos (with or without a gameSetupScript)
 	void ReadDataFromDemo(const std::string& demoName);
+	/// sets up loading the state of the last keyframe before frameNum
+	void LoadDemoKeyFrame(CDemoReader& demoReader, int frameNum);
 
 	/// receive network traffic
 	void UpdateClientNet();
 
 	void GameDataReceived(std::shared_ptr<const netcode::RawPacket> packet);
+	void JoinSnapshotReceived(std::shared_ptr<const netcode::RawPacket> packet);
+	/// sets up loading the savestate the server sent when joining a running game
+	void LoadJoinSnapshot();
 
 private:
 	/**
@@ -76,6 +84,11 @@ private:
 	std::string modFileName;
 	ILoadSaveHandler* saveFileHandler;
 
+	/// compressed savestate received in chunks, see NETMSG_JOIN_SNAPSHOT
+	std::vector<std::uint8_t> joinSnapshotData;
+	std::uint32_t joinSnapshotChecksum = 0;
+	std::int32_t joinSnapshotFrame = -1;
+
 	spring_time connectTimer;
 
 	bool wantDemo;
@@ -23,6 +23,7 @@
 #include "ExternalAI/AILibraryManager.h"
 #include "ExternalAI/SkirmishAIHandler.h"
 
+#include "Game/ClientSetup.h"
 #include "Game/Players/Player.h"
 #include "Game/Players/PlayerHandler.h"
 #include "Game/UI/CommandColors.h"
@@ -92,6 +93,7 @@
 #include "System/EventHandler.h"
 #include "System/GlobalConfig.h"
 #include "System/SafeUtil.h"
+#include "System/StringUtil.h"
 #include "System/TimeProfiler.h"
 #include "System/Log/ILog.h"
 #include "System/Config/ConfigHandler.h"
@@ -100,6 +102,8 @@
 #include "System/Sound/ISoundChannels.h"
 #include "System/Sync/DumpState.h"
 
+#include <sstream>
+
 #include <SDL_events.h>
 #include <SDL_video.h>
 
@@ -2002,6 +2006,60 @@ public:
 };
 
 
+class SeekDemoActionExecutor : public IUnsyncedActionExecutor {
+public:
+	SeekDemoActionExecutor() : IUnsyncedActionExecutor(
+		"SeekDemo",
+		"Jumps to a game-second (or frame, if prefixed by f) of the demo being watched by reloading the demo from its nearest keyframe"
+	) {
+	}
+
+	bool Execute(const UnsyncedAction& action) const final {
+		if (gameServer == nullptr || !gameSetup->hostDemo || action.GetArgs().empty()) {
+			LOG_L(L_WARNING, "/%s: not watching a demo or wrong syntax", GetCommand().c_str());
+			return true;
+		}
+
+		std::string timeStr = action.GetArgs();
+
+		const bool seekFrames = (timeStr[0] == 'f');
+
+		if (seekFrames)
+			timeStr.erase(0, 1);
+
+		const int amount = atoi(timeStr.c_str());
+		const int targetFrame = seekFrames? amount: (GAME_SPEED * amount);
+		const int keyFrameNum = gameServer->GetDemoKeyFrame(targetFrame);
+
+		// forward seeks that would not pass a keyframe are cheaper as a /skip
+		if (keyFrameNum < 0 || (targetFrame >= gs->frameNum && keyFrameNum <= gs->frameNum)) {
+			LOG_L(L_WARNING, "/%s: no demo keyframe between frames %d and %d, use /skip", GetCommand().c_str(), gs->frameNum, targetFrame);
+			return true;
+		}
+
+		// SpringApp::LoadDemoFile appends this again
+		std::string playerName = gameServer->GetClientSetup()->myPlayerName;
+
+		if (StringEndsWith(playerName, " (spec)"))
+			playerName.resize(playerName.size() - 7);
+
+		std::ostringstream script;
+		script << "[GAME]\n{\n";
+		script << "\tDemoFile=" << gameSetup->demoName << ";\n";
+		script << "\tDemoStartFrame=" << targetFrame << ";\n";
+		script << "\tMyPlayerName=" << playerName << ";\n";
+		script << "\tIsHost=1;\n";
+		script << "}\n";
+
+		LOG("[SeekDemoAction] reloading demo from keyframe %d to reach frame %d", keyFrameNum, targetFrame);
+
+		gameSetup->reloadScript = script.str();
+		gu->globalReload = true;
+		return true;
+	}
+};
+
+
 
 class IncreaseGUIOpacityActionExecutor : public IUnsyncedActionExecutor {
 public:
@@ -3126,6 +3184,43 @@ public:
 
 
 
+class ProfileTraceActionExecutor : public IUnsyncedActionExecutor {
+public:
+	ProfileTraceActionExecutor() : IUnsyncedActionExecutor(
+		"ProfileTrace",
+		"Start or stop recording profiler trace-events, or dump them as Chrome trace JSON: start [eventsPerThread] | stop | dump [fileName]"
+	) {
+	}
+
+	bool Execute(const UnsyncedAction& action) const final {
+		const std::vector<std::string>& args = _local_strSpaceTokenize(action.GetArgs());
+
+		if (args.empty()) {
+			LOG_L(L_WARNING, "/ProfileTrace: wrong syntax (use \"start [eventsPerThread]\", \"stop\" or \"dump [fileName]\")");
+			return true;
+		}
+
+		switch (hashString(args[0].c_str())) {
+			case hashString("start"): {
+				profiler.StartTrace((args.size() > 1)? std::max(atoi(args[1].c_str()), 1): 65536);
+			} break;
+			case hashString("stop"): {
+				profiler.StopTrace();
+			} break;
+			case hashString("dump"): {
+				game->DumpProfileTrace((args.size() > 1)? args[1]: "");
+			} break;
+			default: {
+				LOG_L(L_WARNING, "/ProfileTrace: unknown argument \"%s\"", args[0].c_str());
+			} break;
+		}
+
+		return true;
+	}
+};
+
+
+
 class RedirectToSyncedActionExecutor : public IUnsyncedActionExecutor {
 public:
 	RedirectToSyncedActionExecutor(const std::string& command): IUnsyncedActionExecutor(
@@ -3420,6 +3515,7 @@ void UnsyncedGameCommands::AddDefaultActionExecutors()
 	AddActionExecutor(AllocActionExecutor<QuitMenuActionExecutor>());
 	AddActionExecutor(AllocActionExecutor<QuitActionExecutor>());
 	AddActionExecutor(AllocActionExecutor<ReloadActionExecutor>());
+	AddActionExecutor(AllocActionExecutor<SeekDemoActionExecutor>());
 	AddActionExecutor(AllocActionExecutor<IncreaseGUIOpacityActionExecutor>());
 	AddActionExecutor(AllocActionExecutor<DecreaseGUIOpacityActionExecutor>());
 	AddActionExecutor(AllocActionExecutor<ScreenShotActionExecutor>());
@@ -3482,6 +3578,7 @@ void UnsyncedGameCommands::AddDefaultActionExecutors()
 	AddActionExecutor(AllocActionExecutor<ReloadGameActionExecutor>());
 	AddActionExecutor(AllocActionExecutor<ReloadShadersActionExecutor>());
 	AddActionExecutor(AllocActionExecutor<DebugInfoActionExecutor>());
+	AddActionExecutor(AllocActionExecutor<ProfileTraceActionExecutor>());
 
 	// XXX are these redirects really required?
 	AddActionExecutor(AllocActionExecutor<RedirectToSyncedActionExecutor>("ATM"));
@@ -0,0 +1,267 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "LuaDefsCache.h"
+#include "LuaParser.h"
+
+#include "Game/GameSetup.h"
+#include "Game/GameVersion.h"
+#include "System/Config/ConfigHandler.h"
+#include "System/FileSystem/ArchiveScanner.h"
+#include "System/FileSystem/DataDirsAccess.h"
+#include "System/FileSystem/FileQueryFlags.h"
+#include "System/FileSystem/FileSystem.h"
+#include "System/FileSystem/MappedFile.h"
+#include "System/Log/ILog.h"
+#include "System/Sync/SHA512.hpp"
+#include "System/TimeProfiler.h"
+
+CONFIG(bool, UseDefsCache).defaultValue(true).description("If the gamedata definitions returned by defs.lua should be cached, skipping their post-processing on the next start of the same game and map.");
+
+
+/*
+ * Layout (native byte-order):
+ *
+ *   uint32 magic, uint32 DEFS_CACHE_VER, raw_digest key
+ *   uint32 executionTime (ms), uint32 rootSize, raw_digest rootHash
+ *   {root} (LuaParser::SerializeRoot)
+ *   uint32 magic
+ *
+ * The key covers everything defs.lua can read besides archive content,
+ * which is covered by the checksums; the hash guards against partially
+ * written or otherwise damaged files.
+ */
+constexpr static std::uint32_t DEFS_CACHE_MAGIC = 0x43464544; // "DEFC"
+constexpr static std::uint32_t DEFS_CACHE_VER = 1;
+
+struct DefsCacheReader {
+	template<typename T> T Read() {
+		T v = {};
+
+		if ((valid &= (size_t(end - pos) >= sizeof(T))))
+			std::memcpy(&v, pos, sizeof(T));
+
+		pos += (sizeof(T) * valid);
+		return v;
+	}
+	const std::uint8_t* Skip(size_t size) {
+		if (!(valid &= (size_t(end - pos) >= size)))
+			return nullptr;
+
+		pos += size;
+		return (pos - size);
+	}
+
+	const std::uint8_t* pos;
+	const std::uint8_t* end;
+
+	bool valid;
+};
+
+struct DefsCacheWriter {
+	template<typename T> void Write(T v) {
+		const std::uint8_t* p = reinterpret_cast<const std::uint8_t*>(&v);
+		buffer.insert(buffer.end(), p, p + sizeof(T));
+	}
+	void Write(const std::string& s) {
+		Write<std::uint32_t>(s.size());
+		buffer.insert(buffer.end(), s.begin(), s.end());
+	}
+
+	std::vector<std::uint8_t> buffer;
+};
+
+
+static std::string GetCacheFileName()
+{
+	const std::string& cacheDir = dataDirsAccess.LocateDir(FileSystem::GetCacheDir() + "/defs/", FileQueryFlags::WRITE | FileQueryFlags::CREATE_DIRS);
+
+	if (cacheDir.empty())
+		return "";
+
+	sha512::hex_digest mapCheckSumHex;
+	sha512::hex_digest modCheckSumHex;
+	sha512::dump_digest(archiveScanner->GetArchiveCompleteChecksumBytes(gameSetup->mapName), mapCheckSumHex);
+	sha512::dump_digest(archiveScanner->GetArchiveCompleteChecksumBytes(gameSetup->modName), modCheckSumHex);
+
+	// one entry per map and game, other key changes just replace it
+	return (FileSystem::EnsurePathSepAtEnd(cacheDir) + std::string(mapCheckSumHex.data()).substr(0, 16) + "-" + std::string(modCheckSumHex.data()).substr(0, 16) + ".bin");
+}
+
+static bool GetCacheKey(LuaParser* defsParser, sha512::raw_digest& cacheKey)
+{
+	DefsCacheWriter writer;
+
+	const auto WriteOptions = [&](const spring::unordered_map<std::string, std::string>& options) {
+		std::vector< std::pair<std::string, std::string> > sortedOptions(options.begin(), options.end());
+		std::sort(sortedOptions.begin(), sortedOptions.end());
+
+		writer.Write<std::uint32_t>(sortedOptions.size());
+
+		for (const auto& pair: sortedOptions) {
+			writer.Write(pair.first);
+			writer.Write(pair.second);
+		}
+	};
+
+	writer.Write(SpringVersion::GetFull());
+	writer.Write(defsParser->fileName);
+	writer.Write(defsParser->fileModes);
+	writer.Write(defsParser->accessModes);
+
+	for (const std::string& archiveName: {gameSetup->mapName, gameSetup->modName}) {
+		const sha512::raw_digest& checkSum = archiveScanner->GetArchiveCompleteChecksumBytes(archiveName);
+		writer.buffer.insert(writer.buffer.end(), checkSum.begin(), checkSum.end());
+	}
+
+	WriteOptions(CGameSetup::GetModOptions());
+	WriteOptions(CGameSetup::GetMapOptions());
+
+	// constants defs.lua can see, e.g. Game.mapSizeX
+	if (!defsParser->SerializeGlobal("Game", writer.buffer))
+		return false;
+	if (!defsParser->SerializeGlobal("Engine", writer.buffer))
+		return false;
+
+	sha512::calc_digest(writer.buffer, cacheKey);
+	return true;
+}
+
+
+static bool ReadCache(LuaParser* defsParser, const std::string& fileName, const sha512::raw_digest& cacheKey)
+{
+	if (!FileSystem::FileExists(fileName))
+		return false;
+
+	const CMappedFile file(fileName);
+
+	if (!file.IsOpen()) {
+		LOG_L(L_WARNING, "[DefsCache::%s] failed to map \"%s\"", __func__, fileName.c_str());
+		return false;
+	}
+
+	DefsCacheReader reader = {file.GetData(), file.GetData() + file.GetSize(), true};
+
+	if (reader.Read<std::uint32_t>() != DEFS_CACHE_MAGIC)
+		return false;
+	if (reader.Read<std::uint32_t>() != DEFS_CACHE_VER)
+		return false;
+	if (reader.Read<sha512::raw_digest>() != cacheKey) {
+		LOG("[DefsCache::%s] \"%s\" is outdated", __func__, fileName.c_str());
+		return false;
+	}
+
+	const std::uint32_t executionTime = reader.Read<std::uint32_t>();
+	const std::uint32_t rootSize = reader.Read<std::uint32_t>();
+
+	const sha512::raw_digest rootHash = reader.Read<sha512::raw_digest>();
+	const std::uint8_t* rootData = reader.Skip(rootSize);
+
+	if (reader.Read<std::uint32_t>() != DEFS_CACHE_MAGIC || !reader.valid || reader.pos != reader.end) {
+		LOG_L(L_WARNING, "[DefsCache::%s] \"%s\" is truncated or corrupt", __func__, fileName.c_str());
+		return false;
+	}
+
+	ScopedOnceTimer timer("DefsCache::Load (cached)");
+	sha512::raw_digest hash;
+	sha512::calc_digest(rootData, rootSize, hash.data());
+
+	if (hash != rootHash) {
+		LOG_L(L_WARNING, "[DefsCache::%s] \"%s\" failed validation", __func__, fileName.c_str());
+		return false;
+	}
+
+	if (!defsParser->DeserializeRoot(rootData, rootSize)) {
+		LOG_L(L_WARNING, "[DefsCache::%s] \"%s\" could not be restored (%s)", __func__, fileName.c_str(), defsParser->GetErrorLog().c_str());
+		return false;
+	}
+
+	LOG("[DefsCache::%s] restored %u bytes of definitions in %ims, executing %s took %ums", __func__, rootSize, int(timer.GetDuration().toMilliSecsi()), defsParser->fileName.c_str(), executionTime);
+	return true;
+}
+
+static void WriteCache(LuaParser* defsParser, const std::string& fileName, const sha512::raw_digest& cacheKey, std::uint32_t executionTime)
+{
+	// results would differ from the draws made by clients that load them
+	if (defsParser->UsedSyncedRandom()) {
+		LOG("[DefsCache::%s] %s uses math.random, not caching it", __func__, defsParser->fileName.c_str());
+		return;
+	}
+
+	DefsCacheWriter rootWriter;
+
+	if (!defsParser->SerializeRoot(rootWriter.buffer)) {
+		LOG("[DefsCache::%s] %s returned functions or metatables, not caching it", __func__, defsParser->fileName.c_str());
+		return;
+	}
+
+	sha512::raw_digest rootHash;
+	sha512::calc_digest(rootWriter.buffer, rootHash);
+
+	DefsCacheWriter writer;
+	writer.Write<std::uint32_t>(DEFS_CACHE_MAGIC);
+	writer.Write<std::uint32_t>(DEFS_CACHE_VER);
+	writer.Write<sha512::raw_digest>(cacheKey);
+	writer.Write<std::uint32_t>(executionTime);
+	writer.Write<std::uint32_t>(rootWriter.buffer.size());
+	writer.Write<sha512::raw_digest>(rootHash);
+
+	// another client may have the old cache mapped, never truncate it in-place
+	const std::string tmpFileName = FileSystem::GetTemporaryPath(fileName);
+
+	FILE* out = fopen(tmpFileName.c_str(), "wb");
+
+	if (out == nullptr) {
+		LOG_L(L_ERROR, "[DefsCache::%s] failed to write to \"%s\"", __func__, tmpFileName.c_str());
+		return;
+	}
+
+	bool written = true;
+	written &= (fwrite(writer.buffer.data(), writer.buffer.size(), 1, out) == 1);
+	written &= (fwrite(rootWriter.buffer.data(), rootWriter.buffer.size(), 1, out) == 1);
+	written &= (fwrite(&DEFS_CACHE_MAGIC, sizeof(DEFS_CACHE_MAGIC), 1, out) == 1);
+
+	if ((fclose(out) == EOF) || !written) {
+		LOG_L(L_ERROR, "[DefsCache::%s] failed to write to \"%s\"", __func__, tmpFileName.c_str());
+		// never leave a partial cache behind
+		FileSystem::Remove(tmpFileName);
+		return;
+	}
+
+	if (!FileSystem::RenameFile(tmpFileName, fileName))
+		FileSystem::Remove(tmpFileName);
+}
+
+
+bool LuaDefsCache::Execute(LuaParser* defsParser)
+{
+	if (!configHandler->GetBool("UseDefsCache"))
+		return (defsParser->Execute());
+
+	sha512::raw_digest cacheKey;
+
+	const std::string& cacheFile = GetCacheFileName();
+	const bool haveCacheKey = !cacheFile.empty() && GetCacheKey(defsParser, cacheKey);
+
+	if (haveCacheKey && ReadCache(defsParser, cacheFile, cacheKey))
+		return true;
+
+	std::uint32_t executionTime = 0;
+
+	{
+		ScopedOnceTimer timer("DefsCache::Load (uncached)");
+
+		if (!defsParser->Execute())
+			return false;
+
+		executionTime = timer.GetDuration().toMilliSecsi();
+	}
+
+	if (haveCacheKey)
+		WriteCache(defsParser, cacheFile, cacheKey, executionTime);
+
+	return true;
+}
@@ -0,0 +1,19 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef LUA_DEFS_CACHE_H
+#define LUA_DEFS_CACHE_H
+
+class LuaParser;
+
+/**
+ * Keeps the table returned by gamedata/defs.lua on disk, so the def
+ * post-processing scripts only have to run once per game, map, engine
+ * and set of options; see CGame::LoadDefs.
+ */
+class LuaDefsCache {
+	public:
+		// drop-in replacement for defsParser->Execute()
+		static bool Execute(LuaParser* defsParser);
+};
+
+#endif
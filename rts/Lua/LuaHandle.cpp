@@ -549,9 +549,29 @@ bool CLuaHandle::HasCallIn(lua_State* L, const string& name) const
 }
 
 
+bool CLuaHandle::WantsEvent(const string& name)
+{
+	// UnitDamagedBatch is not an event of its own, it is
+	// fed by UnitDamaged and flushed through GameFramePost
+	if (name == "UnitDamaged" || name == "GameFramePost")
+		return (HasCallIn(L, name) || HasCallIn(L, "UnitDamagedBatch"));
+
+	return (HasCallIn(L, name));
+}
+
+
 bool CLuaHandle::UpdateCallIn(lua_State* L, const string& name)
 {
-	if (HasCallIn(L, name)) {
+	if (name == "UnitDamagedBatch") {
+		if (!HasCallIn(L, name))
+			unitDamagedBatch.clear();
+
+		UpdateCallIn(L, "UnitDamaged");
+		UpdateCallIn(L, "GameFramePost");
+		return true;
+	}
+
+	if (WantsEvent(name)) {
 		eventHandler.InsertEvent(this, name);
 	} else {
 		eventHandler.RemoveEvent(this, name);
@@ -658,6 +678,27 @@ void CLuaHandle::GameFrame(int frameNum)
 }
 
 
+void CLuaHandle::GameFramePost(int frameNum)
+{
+	FlushUnitDamagedBatch();
+
+	LUA_CALL_IN_CHECK(L);
+	luaL_checkstack(L, 4, __func__);
+
+	const LuaUtils::ScopedDebugTraceBack traceBack(L);
+
+	static const LuaHashString cmdStr(__func__);
+
+	if (!cmdStr.GetGlobalFunc(L))
+		return;
+
+	lua_pushnumber(L, frameNum);
+
+	// call the routine
+	RunCallInTraceback(L, cmdStr, 1, 0, traceBack.GetErrFuncIdx(), false);
+}
+
+
 void CLuaHandle::GameID(const unsigned char* gameID, unsigned int numBytes)
 {
 	LUA_CALL_IN_CHECK(L);
@@ -862,6 +903,15 @@ void CLuaHandle::UnitDestroyed(const CUnit* unit, const CUnit* attacker)
 	if (!cmdStr.GetGlobalFunc(L))
 		return;
 
+	// damage dealt before the unit died is reported before its death
+	if (!unitDamagedBatch.empty()) {
+		lua_pop(L, 1);
+		FlushUnitDamagedBatch();
+
+		if (!cmdStr.GetGlobalFunc(L))
+			return;
+	}
+
 	const int argCount = 3 + 3;
 
 	lua_pushnumber(L, unit->id);
@@ -982,8 +1032,29 @@ void CLuaHandle::UnitDamaged(
 	luaL_checkstack(L, 11, __func__);
 
 	static const LuaHashString cmdStr(__func__);
+	static const LuaHashString batchStr("UnitDamagedBatch");
 	const LuaUtils::ScopedDebugTraceBack traceBack(L);
 
+	if (batchStr.GetGlobalFunc(L)) {
+		lua_pop(L, 1);
+
+		// attacker data is captured now, the attacker might be gone by the time the batch is flushed
+		const bool pushAttacker = (attacker != nullptr && GetHandleFullRead(L));
+
+		unitDamagedBatch.push_back({
+			unit->id,
+			unit->unitDef->id,
+			unit->team,
+			weaponDefID,
+			projectileID,
+			pushAttacker? attacker->id: -1,
+			pushAttacker? attacker->unitDef->id: -1,
+			pushAttacker? attacker->team: -1,
+			damage,
+			paralyzer,
+		});
+	}
+
 	if (!cmdStr.GetGlobalFunc(L))
 		return;
 
@@ -1005,8 +1076,85 @@ void CLuaHandle::UnitDamaged(
 		argCount += 3;
 	}
 
+	const spring_time startTime = spring_gettime();
+
 	// call the routine
 	RunCallInTraceback(L, cmdStr, argCount, 0, traceBack.GetErrFuncIdx(), false);
+
+	CallInStats& stats = callInStats[CALLIN_STATS_UNIT_DAMAGED];
+	stats.numCalls += 1;
+	stats.numEvents += 1;
+	stats.time += (spring_gettime() - startTime);
+}
+
+
+void CLuaHandle::FlushUnitDamagedBatch()
+{
+	if (unitDamagedBatch.empty())
+		return;
+
+	LUA_CALL_IN_CHECK(L);
+	luaL_checkstack(L, 14, __func__);
+
+	static const LuaHashString cmdStr("UnitDamagedBatch");
+	const LuaUtils::ScopedDebugTraceBack traceBack(L);
+
+	if (!cmdStr.GetGlobalFunc(L)) {
+		unitDamagedBatch.clear();
+		return;
+	}
+
+	// damage dealt from within the callin goes into the next batch
+	unitDamagedFlush.clear();
+	unitDamagedFlush.swap(unitDamagedBatch);
+
+	const int numEvents = unitDamagedFlush.size();
+
+	// one array per argument of UnitDamaged; attacker entries are nil where the
+	// per-event callin would not have passed them
+	const auto PushColumn = [&](const auto& getValue) {
+		lua_createtable(L, numEvents, 0);
+
+		for (int i = 0; i < numEvents; i++) {
+			getValue(unitDamagedFlush[i]);
+			lua_rawseti(L, -2, i + 1);
+		}
+	};
+	const auto PushAttackerColumn = [&](int UnitDamagedEvent::*member) {
+		lua_createtable(L, numEvents, 0);
+
+		for (int i = 0; i < numEvents; i++) {
+			if (unitDamagedFlush[i].attackerID == -1)
+				continue;
+
+			lua_pushnumber(L, unitDamagedFlush[i].*member);
+			lua_rawseti(L, -2, i + 1);
+		}
+	};
+
+	lua_pushnumber(L, numEvents);
+	PushColumn([&](const UnitDamagedEvent& e) { lua_pushnumber(L, e.unitID); });
+	PushColumn([&](const UnitDamagedEvent& e) { lua_pushnumber(L, e.unitDefID); });
+	PushColumn([&](const UnitDamagedEvent& e) { lua_pushnumber(L, e.unitTeam); });
+	PushColumn([&](const UnitDamagedEvent& e) { lua_pushnumber(L, e.damage); });
+	PushColumn([&](const UnitDamagedEvent& e) { lua_pushboolean(L, e.paralyzer); });
+	PushColumn([&](const UnitDamagedEvent& e) { lua_pushnumber(L, e.weaponDefID); });
+	PushColumn([&](const UnitDamagedEvent& e) { lua_pushnumber(L, e.projectileID); });
+	PushAttackerColumn(&UnitDamagedEvent::attackerID);
+	PushAttackerColumn(&UnitDamagedEvent::attackerDefID);
+	PushAttackerColumn(&UnitDamagedEvent::attackerTeam);
+
+	unitDamagedFlush.clear();
+
+	const spring_time startTime = spring_gettime();
+
+	// call the routine
+	RunCallInTraceback(L, cmdStr, 11, 0, traceBack.GetErrFuncIdx(), false);
+
+	CallInStats& stats = callInStats[CALLIN_STATS_UNIT_DAMAGED_BATCH];
+	stats.numCalls += 1;
+	stats.numEvents += numEvents;
+	stats.time += (spring_gettime() - startTime);
 }
 
 void CLuaHandle::UnitStunned(
@@ -2591,6 +2739,7 @@ bool CLuaHandle::AddBasicCalls(lua_State* L)
 		HSTR_PUSH_CFUNC(L, "GetGlobal",       CallOutGetGlobal);
 		HSTR_PUSH_CFUNC(L, "GetRegistry",     CallOutGetRegistry);
 		HSTR_PUSH_CFUNC(L, "GetCallInList",   CallOutGetCallInList);
+		HSTR_PUSH_CFUNC(L, "GetCallInStats",  CallOutGetCallInStats);
 		HSTR_PUSH_CFUNC(L, "IsEngineMinVersion", CallOutIsEngineMinVersion);
 		// special team constants
 		HSTR_PUSH_NUMBER(L, "NO_ACCESS_TEAM",  CEventClient::NoAccessTeam);
@@ -2711,6 +2860,33 @@ int CLuaHandle::CallOutGetCallInList(lua_State* L)
 }
 
 
+int CLuaHandle::CallOutGetCallInStats(lua_State* L)
+{
+	static const char* names[CALLIN_STATS_COUNT] = {"UnitDamaged", "UnitDamagedBatch"};
+
+	const CLuaHandle* lh = GetHandle(L);
+
+	lua_createtable(L, 0, CALLIN_STATS_COUNT);
+
+	for (int i = 0; i < CALLIN_STATS_COUNT; i++) {
+		const CallInStats& stats = lh->callInStats[i];
+
+		lua_pushstring(L, names[i]);
+		lua_createtable(L, 0, 3); {
+			LuaPushNamedNumber(L, "calls", stats.numCalls);
+			LuaPushNamedNumber(L, "events", stats.numEvents);
+
+			// wall-clock time must not leak into synced code
+			if (!GetHandleSynced(L))
+				LuaPushNamedNumber(L, "time", stats.time.toMilliSecsf());
+		}
+		lua_rawset(L, -3);
+	}
+
+	return 1;
+}
+
+
 int CLuaHandle::CallOutUpdateCallIn(lua_State* L)
 {
 
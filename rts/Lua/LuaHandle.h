@@ -99,7 +99,7 @@ class CLuaHandle : public CEventClient
 #endif
 
 	public: // call-ins
-		bool WantsEvent(const std::string& name) override { return HasCallIn(L, name); }
+		bool WantsEvent(const std::string& name) override;
 		virtual bool HasCallIn(lua_State* L, const std::string& name) const;
 		virtual bool UpdateCallIn(lua_State* L, const std::string& name);
 
@@ -110,6 +110,7 @@ class CLuaHandle : public CEventClient
 		void GameOver(const std::vector<unsigned char>& winningAllyTeams) override;
 		void GamePaused(int playerID, bool paused) override;
 		void GameFrame(int frameNum) override;
+		void GameFramePost(int frameNum) override;
 		void GameID(const unsigned char* gameID, unsigned int numBytes) override;
 
 		void TeamDied(int teamID) override;
@@ -298,6 +299,8 @@ class CLuaHandle : public CEventClient
 
 		void RunDrawCallIn(const LuaHashString& hs);
 
+		void FlushUnitDamagedBatch();
+
 	protected:
 		bool userMode = false;
 		bool killMe = false; // set for handles that fail to RunCallIn
@@ -316,6 +319,42 @@ class CLuaHandle : public CEventClient
 		std::vector<bool> watchExplosionDefs;   // callin masks for Explosion
 		std::vector<bool> watchAllowTargetDefs; // callin masks for AllowWeapon*Target*
 
+		struct UnitDamagedEvent {
+			int unitID;
+			int unitDefID;
+			int unitTeam;
+			int weaponDefID;
+			int projectileID;
+			// -1 if there was no attacker or the handle lacks full read-access
+			int attackerID;
+			int attackerDefID;
+			int attackerTeam;
+
+			float damage;
+			bool paralyzer;
+		};
+
+		// UnitDamaged events waiting for the UnitDamagedBatch callin; flushed
+		// at GameFramePost and before UnitDestroyed; unitDamagedFlush holds the
+		// batch currently being handed to Lua
+		std::vector<UnitDamagedEvent> unitDamagedBatch;
+		std::vector<UnitDamagedEvent> unitDamagedFlush;
+
+		enum {
+			CALLIN_STATS_UNIT_DAMAGED       = 0,
+			CALLIN_STATS_UNIT_DAMAGED_BATCH = 1,
+			CALLIN_STATS_COUNT              = 2,
+		};
+
+		struct CallInStats {
+			std::uint64_t numCalls = 0;
+			std::uint64_t numEvents = 0;
+
+			spring_time time;
+		};
+
+		CallInStats callInStats[CALLIN_STATS_COUNT];
+
 	private: // call-outs
 		static int KillActiveHandle(lua_State* L);
 		static int CallOutGetName(lua_State* L);
@@ -329,6 +368,7 @@ class CLuaHandle : public CEventClient
 		static int CallOutGetGlobal(lua_State* L);
 		static int CallOutGetRegistry(lua_State* L);
 		static int CallOutGetCallInList(lua_State* L);
+		static int CallOutGetCallInStats(lua_State* L);
 		static int CallOutUpdateCallIn(lua_State* L);
 		static int CallOutIsEngineMinVersion(lua_State* L);
 
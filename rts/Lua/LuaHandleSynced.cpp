@@ -43,6 +43,7 @@
 #include "Sim/Units/Scripts/CobInstance.h"
 #include "Sim/Units/Scripts/LuaUnitScript.h"
 #include "Sim/Weapons/Weapon.h"
+#include "Sim/Weapons/WeaponTarget.h"
 #include "Sim/Weapons/WeaponDefHandler.h"
 #include "System/EventHandler.h"
 #include "System/creg/SerializeLuaState.h"
@@ -1327,6 +1328,82 @@ bool CSyncedLuaHandle::AllowWeaponTarget(
 }
 
 
+void CSyncedLuaHandle::AllowWeaponTargets(std::vector<SWeaponTargetCandidate>& candidates)
+{
+	const auto IsWatched = [&](const SWeaponTargetCandidate& c) { return (watchAllowTargetDefs[c.weapon->weaponDef->id]); };
+
+	const size_t numWatched = std::count_if(candidates.begin(), candidates.end(), IsWatched);
+
+	if (numWatched == 0)
+		return;
+
+	LUA_CALL_IN_CHECK(L);
+	luaL_checkstack(L, 2 + 5 + 2, __func__);
+
+	const LuaUtils::ScopedDebugTraceBack dbgTrace(L);
+	static const LuaHashString cmdStr(__func__);
+
+	// created first so it survives the call; callin can modify it in-place
+	lua_createtable(L, numWatched, 0);
+
+	const int priosTableIdx = lua_gettop(L);
+
+	if (!cmdStr.GetGlobalFunc(L)) {
+		lua_pop(L, 1);
+		return;
+	}
+
+	lua_createtable(L, numWatched, 0); // attackerIDs
+	lua_createtable(L, numWatched, 0); // targetIDs
+	lua_createtable(L, numWatched, 0); // attackerWeaponNums
+	lua_createtable(L, numWatched, 0); // attackerWeaponDefIDs
+
+	for (size_t i = 0, n = 0; i < candidates.size(); i++) {
+		const SWeaponTargetCandidate& c = candidates[i];
+
+		if (!IsWatched(c))
+			continue;
+
+		n += 1;
+
+		lua_pushnumber(L, c.weapon->owner->id);
+		lua_rawseti(L, -5, n);
+		lua_pushnumber(L, c.unit->id);
+		lua_rawseti(L, -4, n);
+		lua_pushnumber(L, c.weapon->weaponNum + LUA_WEAPON_BASE_INDEX);
+		lua_rawseti(L, -3, n);
+		lua_pushnumber(L, c.weapon->weaponDef->id);
+		lua_rawseti(L, -2, n);
+		lua_pushnumber(L, c.priority);
+		lua_rawseti(L, priosTableIdx, n);
+	}
+
+	lua_pushvalue(L, priosTableIdx);
+
+	if (RunCallInTraceback(L, cmdStr, 5, 0, dbgTrace.GetErrFuncIdx(), false)) {
+		// non-numbers (e.g. false) reject a candidate, numbers replace its priority
+		for (size_t i = 0, n = 0; i < candidates.size(); i++) {
+			SWeaponTargetCandidate& c = candidates[i];
+
+			if (!IsWatched(c))
+				continue;
+
+			lua_rawgeti(L, priosTableIdx, ++n);
+
+			if (lua_isnumber(L, -1)) {
+				c.priority = lua_tofloat(L, -1);
+			} else {
+				c.allowed = false;
+			}
+
+			lua_pop(L, 1);
+		}
+	}
+
+	lua_pop(L, 1);
+}
+
+
 bool CSyncedLuaHandle::AllowWeaponInterceptTarget(
 	const CUnit* interceptorUnit,
 	const CWeapon* interceptorWeapon,
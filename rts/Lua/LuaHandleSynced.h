@@ -82,6 +82,7 @@ class CSyncedLuaHandle : public CLuaHandle
 			unsigned int attackerWeaponDefID,
 			float* targetPriority
 		) override;
+		void AllowWeaponTargets(std::vector<SWeaponTargetCandidate>& candidates) override;
 		bool AllowWeaponInterceptTarget(const CUnit* interceptorUnit, const CWeapon* interceptorWeapon, const CProjectile* interceptorTarget) override;
 
 		bool UnitPreDamaged(
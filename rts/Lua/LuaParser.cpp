@@ -5,6 +5,7 @@
 
 #include <algorithm>
 #include <climits>
+#include <cstring>
 
 #include "lib/streflop/streflop_cond.h"
 
@@ -298,6 +299,265 @@ LuaTable LuaParser::GetRoot()
 }
 
 
+/******************************************************************************/
+//
+//  Root table (de)serialization
+//
+//  Values are written depth-first as a type byte followed by their payload
+//  (native byte-order). Each table is written once and referred to by index
+//  afterwards, so shared and cyclic subtables survive a round-trip; its '#'
+//  length is stored as well since that depends on how the table was built.
+//  Anything LuaTable can not read back the same way (functions, userdata,
+//  tables with metatables) makes serialization fail.
+//
+
+enum {
+	SERIAL_TYPE_FALSE  = 0,
+	SERIAL_TYPE_TRUE   = 1,
+	SERIAL_TYPE_NUMBER = 2,
+	SERIAL_TYPE_STRING = 3,
+	SERIAL_TYPE_TABLE  = 4,
+	SERIAL_TYPE_TABREF = 5,
+};
+
+static constexpr int MAX_SERIAL_DEPTH = 256;
+
+struct LuaValueWriter {
+	template<typename T> void Write(T v) {
+		const std::uint8_t* p = reinterpret_cast<const std::uint8_t*>(&v);
+		buffer.insert(buffer.end(), p, p + sizeof(T));
+	}
+
+	bool WriteValue(lua_State* L, int index, int depth) {
+		switch (lua_type(L, index)) {
+			case LUA_TBOOLEAN: {
+				Write<std::uint8_t>(lua_toboolean(L, index)? SERIAL_TYPE_TRUE: SERIAL_TYPE_FALSE);
+				return true;
+			} break;
+			case LUA_TNUMBER: {
+				Write<std::uint8_t>(SERIAL_TYPE_NUMBER);
+				Write<lua_Number>(lua_tonumber(L, index));
+				return true;
+			} break;
+			case LUA_TSTRING: {
+				size_t len = 0;
+				const char* str = lua_tolstring(L, index, &len);
+
+				Write<std::uint8_t>(SERIAL_TYPE_STRING);
+				Write<std::uint32_t>(len);
+				buffer.insert(buffer.end(), str, str + len);
+				return true;
+			} break;
+			case LUA_TTABLE: {
+			} break;
+			default: {
+				return false;
+			} break;
+		}
+
+		if (depth >= MAX_SERIAL_DEPTH || !lua_checkstack(L, 3))
+			return false;
+
+		if (lua_getmetatable(L, index)) {
+			lua_pop(L, 1);
+			return false;
+		}
+
+		const int table = (index > 0)? index: (lua_gettop(L) + index + 1);
+		const auto iter = tableIndices.find(lua_topointer(L, table));
+
+		if (iter != tableIndices.end()) {
+			Write<std::uint8_t>(SERIAL_TYPE_TABREF);
+			Write<std::uint32_t>(iter->second);
+			return true;
+		}
+
+		tableIndices.emplace(lua_topointer(L, table), std::uint32_t(tableIndices.size()));
+
+		Write<std::uint8_t>(SERIAL_TYPE_TABLE);
+		Write<std::uint32_t>(lua_objlen(L, table));
+
+		// number of pairs, patched below
+		const size_t countPos = buffer.size();
+		std::uint32_t count = 0;
+
+		Write<std::uint32_t>(count);
+
+		for (lua_pushnil(L); lua_next(L, table) != 0; lua_pop(L, 1), count++) {
+			if (WriteValue(L, -2, depth + 1) && WriteValue(L, -1, depth + 1))
+				continue;
+
+			lua_pop(L, 2);
+			return false;
+		}
+
+		std::memcpy(&buffer[countPos], &count, sizeof(count));
+		return true;
+	}
+
+	std::vector<std::uint8_t>& buffer;
+	spring::unordered_map<const void*, std::uint32_t> tableIndices;
+};
+
+struct LuaValueReader {
+	template<typename T> bool Read(T& v) {
+		if (size_t(end - pos) < sizeof(T))
+			return false;
+
+		std::memcpy(&v, pos, sizeof(T));
+		pos += sizeof(T);
+		return true;
+	}
+
+	// pushes one value, or leaves garbage on the stack and returns false
+	bool ReadValue(lua_State* L, int depth) {
+		std::uint8_t type = 0;
+
+		if (!Read(type))
+			return false;
+
+		switch (type) {
+			case SERIAL_TYPE_FALSE:
+			case SERIAL_TYPE_TRUE: {
+				lua_pushboolean(L, type == SERIAL_TYPE_TRUE);
+				return true;
+			} break;
+			case SERIAL_TYPE_NUMBER: {
+				lua_Number num = 0;
+
+				if (!Read(num))
+					return false;
+
+				lua_pushnumber(L, num);
+				return true;
+			} break;
+			case SERIAL_TYPE_STRING: {
+				std::uint32_t len = 0;
+
+				if (!Read(len) || size_t(end - pos) < len)
+					return false;
+
+				lua_pushlstring(L, reinterpret_cast<const char*>(pos), len);
+				pos += len;
+				return true;
+			} break;
+			case SERIAL_TYPE_TABREF: {
+				std::uint32_t idx = 0;
+
+				if (!Read(idx) || idx >= numTables)
+					return false;
+
+				lua_rawgeti(L, tablesIndex, idx + 1);
+				return true;
+			} break;
+			case SERIAL_TYPE_TABLE: {
+			} break;
+			default: {
+				return false;
+			} break;
+		}
+
+		std::uint32_t length = 0;
+		std::uint32_t count = 0;
+
+		if (!Read(length) || !Read(count))
+			return false;
+		if (depth >= MAX_SERIAL_DEPTH || !lua_checkstack(L, 4))
+			return false;
+
+		// every pair takes at least four bytes, do not trust the sizes blindly
+		const std::uint32_t maxCount = std::uint32_t(end - pos) / 4;
+		const std::uint32_t arrCount = std::min(length, maxCount);
+		const std::uint32_t recCount = std::min(count, maxCount) - std::min(count, arrCount);
+
+		// sizing the array part like the original makes '#' agree with it in
+		// most cases where the array has holes; the check below catches the rest
+		lua_createtable(L, arrCount, recCount);
+		lua_pushvalue(L, -1);
+		lua_rawseti(L, tablesIndex, ++numTables);
+
+		for (std::uint32_t n = 0; n < count; n++) {
+			if (!ReadValue(L, depth + 1) || !ReadValue(L, depth + 1))
+				return false;
+
+			// NaN keys would raise an error outside of any pcall
+			if (lua_israwnumber(L, -2) && math::isnan(lua_tonumber(L, -2)))
+				return false;
+
+			lua_rawset(L, -3);
+		}
+
+		return (lua_objlen(L, -1) == length);
+	}
+
+	const std::uint8_t* pos;
+	const std::uint8_t* end;
+
+	int tablesIndex;
+	std::uint32_t numTables;
+};
+
+
+bool LuaParser::SerializeRoot(std::vector<std::uint8_t>& buffer)
+{
+	if (!IsValid() || rootRef == LUA_NOREF)
+		return false;
+
+	LuaValueWriter writer = {buffer, {}};
+
+	lua_rawgeti(L, LUA_REGISTRYINDEX, rootRef);
+	const bool ret = writer.WriteValue(L, -1, 0);
+	lua_settop(L, 0);
+
+	return ret;
+}
+
+bool LuaParser::SerializeGlobal(const std::string& name, std::vector<std::uint8_t>& buffer)
+{
+	if (!IsValid())
+		return false;
+
+	LuaValueWriter writer = {buffer, {}};
+
+	lua_getglobal(L, name.c_str());
+	const bool ret = writer.WriteValue(L, -1, 0);
+	lua_pop(L, 1);
+
+	return ret;
+}
+
+bool LuaParser::DeserializeRoot(const std::uint8_t* data, size_t size)
+{
+	if (!IsValid()) {
+		errorLog = "could not initialize Lua library";
+		return false;
+	}
+
+	assert(rootRef == LUA_NOREF);
+	assert(initDepth == 0);
+
+	lua_settop(L, 0);
+	lua_newtable(L);
+
+	LuaValueReader reader = {data, data + size, lua_gettop(L), 0};
+
+	if (!reader.ReadValue(L, 0) || !lua_istable(L, -1) || reader.pos != reader.end) {
+		lua_settop(L, 0);
+
+		// leave the parser as it was, caller can still Execute
+		errorLog = "invalid serialized root table";
+		return false;
+	}
+
+	// same state as after Execute
+	initDepth = -1;
+	rootRef = luaL_ref(L, LUA_REGISTRYINDEX);
+	lua_settop(L, 0);
+
+	return (valid = true);
+}
+
+
 /******************************************************************************/
 
 void LuaParser::PushParam()
@@ -522,6 +782,7 @@ int LuaParser::Random(lua_State* L)
 {
 	// both US and DS depend on LuaParser via MapParser, etc
 	#if (!defined(UNITSYNC) && !defined(DEDICATED))
+	GetLuaParser(L)->usedSyncedRandom = true;
 	lua_pushnumber(L, gsRNG.NextFloat());
 	return 1;
 	#else
@@ -3,6 +3,7 @@
 #ifndef LUA_PARSER_H
 #define LUA_PARSER_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -157,6 +158,15 @@ public:
 	void AddFloat(const std::string& key, float value);
 	void AddString(const std::string& key, const std::string& value);
 
+	// (de)serializes the table returned by Execute, e.g. to skip running it
+	// next time; DeserializeRoot is an alternative to calling Execute
+	bool SerializeRoot(std::vector<std::uint8_t>& buffer);
+	bool DeserializeRoot(const std::uint8_t* data, size_t size);
+	bool SerializeGlobal(const std::string& name, std::vector<std::uint8_t>& buffer);
+
+	// true if Execute drew from the synced RNG, its result is then not reproducible
+	bool UsedSyncedRandom() const { return usedSyncedRandom; }
+
 	void SetLowerKeys(bool state) { lowerKeys = state; }
 	void SetLowerCppKeys(bool state) { lowerCppKeys = state; }
 
@@ -191,6 +201,7 @@ private:
 	bool valid = false;
 	bool lowerKeys = false; // convert all returned keys to lower case
 	bool lowerCppKeys = false; // convert strings in arguments keys to lower case
+	bool usedSyncedRandom = false;
 
 private:
 	// Weird call-outs
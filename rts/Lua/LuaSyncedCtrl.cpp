@@ -484,6 +484,8 @@ static int SetSolidObjectCollisionVolumeData(lua_State* L, CSolidObject* o)
 	if (o == nullptr)
 		return 0;
 
+	// projectile collision candidates are culled by the old volume
+	quadField.ChangedObjectVolume(o);
 	return LuaUtils::ParseColVolData(L, 2, &o->collisionVolume);
 }
 
@@ -528,6 +530,7 @@ static int SetSolidObjectRotation(lua_State* L, CSolidObject* o, bool isFeature)
 		return 0;
 
 	o->SetDirVectorsEuler(float3(luaL_checkfloat(L, 2), luaL_checkfloat(L, 3), luaL_checkfloat(L, 4)));
+	quadField.ChangedObjectVolume(o);
 
 	// not a hack: ForcedSpin() and CalculateTransform() calculate a
 	// transform based only on frontdir and assume the helper y-axis
@@ -544,6 +547,7 @@ static int SetSolidObjectDirection(lua_State* L, CSolidObject* o)
 		return 0;
 
 	o->ForcedSpin((float3(luaL_checkfloat(L, 2), luaL_checkfloat(L, 3), luaL_checkfloat(L, 4))).SafeNormalize());
+	quadField.ChangedObjectVolume(o);
 	return 0;
 }
 
@@ -602,6 +606,7 @@ static int SetSolidObjectPhysicalState(lua_State* L, CSolidObject* o)
 	// do not need ForcedSpin, above three calls cover it
 	o->ForcedMove(pos);
 	o->SetVelocityAndSpeed(speed);
+	quadField.ChangedObjectVolume(o);
 	return 0;
 }
 
@@ -626,6 +631,7 @@ static int SetSolidObjectPieceCollisionVolumeData(lua_State* L, CSolidObject* ob
 	// piece volumes are not allowed to use discrete hit-testing
 	vol->InitShape(scales, offset, vType, CollisionVolume::COLVOL_HITTEST_CONT, pAxis);
 	vol->SetIgnoreHits(!luaL_checkboolean(L, 3));
+	quadField.ChangedObjectVolume(obj);
 	return 0;
 }
 
@@ -2382,6 +2388,9 @@ int LuaSyncedCtrl::SetUnitMidAndAimPos(lua_State* L)
 
 	if (updateQuads) {
 		quadField.MovedUnit(unit);
+	} else {
+		// relative mid-position can change without moving the unit
+		quadField.ChangedObjectVolume(unit);
 	}
 
 	lua_pushboolean(L, true);
@@ -3184,6 +3193,9 @@ int LuaSyncedCtrl::SetFeatureMidAndAimPos(lua_State* L)
 
 	if (updateQuads) {
 		quadField.AddFeature(feature);
+	} else {
+		// relative mid-position can change without moving the feature
+		quadField.ChangedObjectVolume(feature);
 	}
 
 	lua_pushboolean(L, true);
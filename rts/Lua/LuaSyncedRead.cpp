@@ -74,7 +74,9 @@
 #include "System/FileSystem/FileSystem.h"
 #include "System/StringUtil.h"
 
+#include <algorithm>
 #include <cctype>
+#include <cstring>
 
 
 using std::min;
@@ -214,6 +216,7 @@ bool LuaSyncedRead::PushEntries(lua_State* L)
 	REGISTER_LUA_CFUNC(GetUnitDirection);
 	REGISTER_LUA_CFUNC(GetUnitHeading);
 	REGISTER_LUA_CFUNC(GetUnitVelocity);
+	REGISTER_LUA_CFUNC(GetUnitsData);
 	REGISTER_LUA_CFUNC(GetUnitBuildFacing);
 	REGISTER_LUA_CFUNC(GetUnitIsBuilding);
 	REGISTER_LUA_CFUNC(GetUnitCurrentBuildPower);
@@ -3165,6 +3168,207 @@ int LuaSyncedRead::GetUnitVelocity(lua_State* L)
 }
 
 
+// columns understood by GetUnitsData, grouped by the getter they mirror
+enum UnitDataField {
+	UNIT_DATA_POS_X = 0,
+	UNIT_DATA_POS_Y,
+	UNIT_DATA_POS_Z,
+	UNIT_DATA_MID_X,
+	UNIT_DATA_MID_Y,
+	UNIT_DATA_MID_Z,
+	UNIT_DATA_AIM_X,
+	UNIT_DATA_AIM_Y,
+	UNIT_DATA_AIM_Z,
+
+	UNIT_DATA_VEL_X,
+	UNIT_DATA_VEL_Y,
+	UNIT_DATA_VEL_Z,
+	UNIT_DATA_SPEED,
+
+	UNIT_DATA_HEALTH,
+	UNIT_DATA_MAX_HEALTH,
+	UNIT_DATA_PARALYZE_DAMAGE,
+	UNIT_DATA_CAPTURE_PROGRESS,
+	UNIT_DATA_BUILD_PROGRESS,
+
+	UNIT_DATA_COUNT,
+};
+
+static const char* UNIT_DATA_FIELD_NAMES[UNIT_DATA_COUNT] = {
+	"x",      "y",      "z",
+	"midX",   "midY",   "midZ",
+	"aimX",   "aimY",   "aimZ",
+	"velX",   "velY",   "velZ",   "speed",
+	"health", "maxHealth", "paralyzeDamage", "captureProgress", "buildProgress",
+};
+
+// bulk variant of GetUnitPosition, GetUnitVelocity and GetUnitHealth
+//
+//   result, numUnits = Spring.GetUnitsData(unitIDs, fields [, result])
+//
+// for each name in <fields> result[name] becomes a flat array with one entry
+// per element of <unitIDs>; entries are nil for units that do not exist or
+// which the per-unit getter would not return either (iterate over 1..numUnits
+// instead of using ipairs). the result of a previous call can be passed back
+// in to reuse its arrays, result.n holds the number of entries last written
+int LuaSyncedRead::GetUnitsData(lua_State* L)
+{
+	luaL_checktype(L, 1, LUA_TTABLE);
+	luaL_checktype(L, 2, LUA_TTABLE);
+
+	const int numUnits = lua_objlen(L, 1);
+	const int numFields = lua_objlen(L, 2);
+
+	if (numFields > UNIT_DATA_COUNT)
+		luaL_error(L, "[%s] too many fields (%d, max %d)", __func__, numFields, UNIT_DATA_COUNT);
+
+	if (lua_istable(L, 3)) {
+		lua_settop(L, 3);
+	} else {
+		lua_settop(L, 2);
+		lua_createtable(L, 0, numFields + 1);
+	}
+
+	constexpr int resultIdx = 3;
+	constexpr int columnIdx = resultIdx + 1;
+
+	// one column-table per field, plus scratch space
+	luaL_checkstack(L, numFields + 2, __func__);
+
+	// number of entries written into reused columns by the previous call
+	lua_getfield(L, resultIdx, "n");
+	const int prevNumUnits = lua_isnumber(L, -1)? lua_toint(L, -1): 0;
+	lua_pop(L, 1);
+
+	int fields[UNIT_DATA_COUNT];
+
+	bool needPos = false;
+	bool needVel = false;
+	bool needHealth = false;
+
+	for (int f = 0; f < numFields; f++) {
+		lua_rawgeti(L, 2, f + 1);
+
+		if (!lua_isstring(L, -1))
+			luaL_error(L, "[%s] field #%d is not a string", __func__, f + 1);
+
+		const char* name = lua_tostring(L, -1);
+		const char** iter = std::find_if(std::begin(UNIT_DATA_FIELD_NAMES), std::end(UNIT_DATA_FIELD_NAMES), [&](const char* n) { return (strcmp(n, name) == 0); });
+
+		if (iter == std::end(UNIT_DATA_FIELD_NAMES))
+			luaL_error(L, "[%s] unknown field \"%s\"", __func__, name);
+
+		lua_pop(L, 1);
+
+		fields[f] = iter - std::begin(UNIT_DATA_FIELD_NAMES);
+
+		needPos    |= (fields[f] <= UNIT_DATA_AIM_Z);
+		needVel    |= (fields[f] >= UNIT_DATA_VEL_X && fields[f] <= UNIT_DATA_SPEED);
+		needHealth |= (fields[f] >= UNIT_DATA_HEALTH);
+
+		// leave the column on the stack at <columnIdx + f>
+		lua_getfield(L, resultIdx, *iter);
+
+		if (lua_istable(L, -1))
+			continue;
+
+		lua_pop(L, 1);
+		lua_createtable(L, numUnits, 0);
+		lua_pushvalue(L, -1);
+		lua_setfield(L, resultIdx, *iter);
+	}
+
+	float values[UNIT_DATA_COUNT];
+	bool  valids[UNIT_DATA_COUNT];
+
+	for (int i = 1; i <= numUnits; i++) {
+		lua_rawgeti(L, 1, i);
+		const CUnit* unit = lua_isnumber(L, -1)? unitHandler.GetUnit(lua_toint(L, -1)): nullptr;
+		lua_pop(L, 1);
+
+		std::fill(std::begin(valids), std::end(valids), false);
+
+		if (unit != nullptr) {
+			// same visibility rules as the per-unit getters
+			if (needPos && ::IsUnitVisible(L, unit)) {
+				float3 errorVec;
+
+				if (!::IsAllyUnit(L, unit))
+					errorVec = unit->GetLuaErrorVector(CLuaHandle::GetHandleReadAllyTeam(L), CLuaHandle::GetHandleFullRead(L));
+
+				const float3 pos = unit->pos + errorVec;
+				const float3 mid = unit->midPos + errorVec;
+				const float3 aim = unit->aimPos + errorVec;
+
+				for (int k = 0; k < 3; k++) {
+					values[UNIT_DATA_POS_X + k] = pos[k];
+					values[UNIT_DATA_MID_X + k] = mid[k];
+					values[UNIT_DATA_AIM_X + k] = aim[k];
+				}
+
+				std::fill(&valids[UNIT_DATA_POS_X], &valids[UNIT_DATA_AIM_Z] + 1, true);
+			}
+
+			if ((needVel || needHealth) && ::IsUnitInLos(L, unit)) {
+				if (needVel) {
+					values[UNIT_DATA_VEL_X] = unit->speed.x;
+					values[UNIT_DATA_VEL_Y] = unit->speed.y;
+					values[UNIT_DATA_VEL_Z] = unit->speed.z;
+					values[UNIT_DATA_SPEED] = unit->speed.w;
+
+					std::fill(&valids[UNIT_DATA_VEL_X], &valids[UNIT_DATA_SPEED] + 1, true);
+				}
+
+				if (needHealth) {
+					const UnitDef* ud = unit->unitDef;
+					const bool enemyUnit = ::IsEnemyUnit(L, unit);
+
+					if (!ud->hideDamage || !enemyUnit) {
+						const float scale = (!enemyUnit || (ud->decoyDef == nullptr))? 1.0f: (ud->decoyDef->health / ud->health);
+
+						values[UNIT_DATA_HEALTH         ] = scale * unit->health;
+						values[UNIT_DATA_MAX_HEALTH     ] = scale * unit->maxHealth;
+						values[UNIT_DATA_PARALYZE_DAMAGE] = scale * unit->paralyzeDamage;
+
+						std::fill(&valids[UNIT_DATA_HEALTH], &valids[UNIT_DATA_PARALYZE_DAMAGE] + 1, true);
+					}
+
+					values[UNIT_DATA_CAPTURE_PROGRESS] = unit->captureProgress;
+					values[UNIT_DATA_BUILD_PROGRESS  ] = unit->buildProgress;
+
+					valids[UNIT_DATA_CAPTURE_PROGRESS] = true;
+					valids[UNIT_DATA_BUILD_PROGRESS  ] = true;
+				}
+			}
+		}
+
+		for (int f = 0; f < numFields; f++) {
+			if (valids[fields[f]]) {
+				lua_pushnumber(L, values[fields[f]]);
+			} else {
+				lua_pushnil(L);
+			}
+
+			lua_rawseti(L, columnIdx + f, i);
+		}
+	}
+
+	// clear the tails of reused columns
+	for (int f = 0; f < numFields; f++) {
+		for (int i = numUnits + 1; i <= prevNumUnits; i++) {
+			lua_pushnil(L);
+			lua_rawseti(L, columnIdx + f, i);
+		}
+	}
+
+	lua_settop(L, resultIdx);
+	lua_pushnumber(L, numUnits);
+	lua_setfield(L, resultIdx, "n");
+	lua_pushnumber(L, numUnits);
+	return 2;
+}
+
+
 int LuaSyncedRead::GetUnitBuildFacing(lua_State* L)
 {
 	const CUnit* unit = ParseInLosUnit(L, __func__, 1);
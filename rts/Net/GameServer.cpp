@@ -76,6 +76,7 @@ CONFIG(bool, ServerRecordDemos).defaultValue(false).dedicatedValue(true);
 CONFIG(bool, ServerLogInfoMessages).defaultValue(false);
 CONFIG(bool, ServerLogDebugMessages).defaultValue(false);
 CONFIG(std::string, AutohostIP).defaultValue("127.0.0.1");
+CONFIG(int, JoinSnapshotInterval).defaultValue(0).minimumValue(0).description("Game-seconds between savestates a client uploads to the server, players joining a running game start from the latest one instead of simulating every frame since the start. Saving stalls the uploading client's simulation, 0 disables. Ignored by builds without sync checking.");
 
 
 // use the specific section for all LOG*() calls in this source file
@@ -255,6 +256,15 @@ void CGameServer::Initialize()
 	}
 
 	loopSleepTime = configHandler->GetInt("ServerSleepTime");
+	joinSnapshotInterval = configHandler->GetInt("JoinSnapshotInterval") * GAME_SPEED;
+
+	#ifndef SYNCCHECK
+	// snapshots are only accepted once sync-responses of their frame confirm them
+	if (joinSnapshotInterval > 0)
+		LOG_L(L_WARNING, "[GameServer] JoinSnapshotInterval is ignored, this build does not check sync");
+
+	joinSnapshotInterval = 0;
+	#endif
 	linkMinPacketSize = globalConfig.linkIncomingMaxPacketRate > 0 ? (globalConfig.linkIncomingSustainedBandwidth / globalConfig.linkIncomingMaxPacketRate) : 1;
 
 	lastNewFrameTick = spring_gettime();
@@ -285,6 +295,35 @@ void CGameServer::PostLoad(int newServerFrameNum)
 	for (GameParticipant& p: players) {
 		p.lastFrameResponse = newServerFrameNum;
 	}
+
+	if (demoReader == nullptr)
+		return;
+
+	// state came from a demo keyframe, continue the stream right after its frame
+	if (demoReader->SeekToFrame(newServerFrameNum) != newServerFrameNum) {
+		Message(spring::format("Warning: demo has no index entry for keyframe %d", newServerFrameNum));
+		return;
+	}
+
+	modGameTime = demoReader->GetNextDemoReadTime();
+
+	if (myGameSetup->demoStartFrame > newServerFrameNum)
+		SkipTo(myGameSetup->demoStartFrame);
+}
+
+int CGameServer::GetDemoKeyFrame(int frameNum) const
+{
+	std::lock_guard<spring::recursive_mutex> scoped_lock(gameServerMutex);
+
+	if (demoReader == nullptr)
+		return -1;
+
+	const int keyFrameIdx = demoReader->FindKeyFrame(frameNum);
+
+	if (keyFrameIdx < 0)
+		return -1;
+
+	return ((demoReader->GetKeyFrames())[keyFrameIdx].frameNum);
 }
 
 
@@ -748,6 +787,9 @@ void CGameServer::CheckSync()
 			}
 		}
 
+		if (completeResponseSet && haveCorrectChecksum)
+			VerifyJoinSnapshot(outstandingSyncFrame, correctChecksum);
+
 		// Remove complete sets (for which all player's checksums have been received).
 		if (completeResponseSet) {
 			for (GameParticipant& p: players) {
@@ -773,6 +815,146 @@ void CGameServer::CheckSync()
 }
 
 
+void CGameServer::RequestJoinSnapshot()
+{
+	pendingJoinSnapshot = {};
+
+	// joiners need the packets following the snapshot, and AI changes
+	// can not be replayed against it (see allowJoinSnapshots)
+	if (!allowJoinSnapshots || demoReader != nullptr)
+		return;
+	if (!canReconnect && !allowSpecJoin)
+		return;
+
+	int uploaderNum = -1;
+	int uploaderRank = -1;
+
+	for (const GameParticipant& p: players) {
+		if (p.clientLink == nullptr || p.myState != GameParticipant::INGAME)
+			continue;
+		if (p.desynced || (serverFrameNum - p.lastFrameResponse) > GAME_SPEED)
+			continue;
+
+		// stalling a spectator matters least, and among equals
+		// the local client has no upload cost
+		const int rank = p.spectator * 2 + p.isLocal;
+
+		if (rank <= uploaderRank)
+			continue;
+
+		uploaderNum = p.id;
+		uploaderRank = rank;
+	}
+
+	if (uploaderNum < 0)
+		return;
+
+	pendingJoinSnapshot.playerNum = uploaderNum;
+	pendingJoinSnapshot.frameNum = serverFrameNum;
+
+	players[uploaderNum].SendData(CBaseNetProtocol::Get().SendJoinSnapshotRequest(serverFrameNum));
+}
+
+void CGameServer::JoinSnapshotReceived(int playerNum, std::shared_ptr<const netcode::RawPacket> packet)
+{
+	JoinSnapshot& snapshot = pendingJoinSnapshot;
+
+	try {
+		netcode::UnpackPacket pckt(packet, sizeof(uint8_t));
+
+		uint16_t packetSize;
+		uint8_t  senderNum;
+		int32_t  frameNum;
+		uint32_t syncChecksum;
+		uint32_t dataChecksum;
+		uint32_t dataSize;
+		uint32_t dataOffset;
+
+		pckt >> packetSize;
+		pckt >> senderNum;
+		pckt >> frameNum;
+		pckt >> syncChecksum;
+		pckt >> dataChecksum;
+		pckt >> dataSize;
+		pckt >> dataOffset;
+
+		if (packetSize != packet->length)
+			throw netcode::UnpackPacketException("invalid packet-size");
+
+		if (senderNum != playerNum) {
+			Message(spring::format(WrongPlayer, NETMSG_JOIN_SNAPSHOT, playerNum, (unsigned)senderNum));
+			return;
+		}
+
+		// stale upload, or a non-droppable packet being processed again
+		if (playerNum != snapshot.playerNum || frameNum != snapshot.frameNum || dataOffset != snapshot.recvSize)
+			return;
+
+		const uint32_t headerSize = sizeof(uint8_t) + sizeof(packetSize) + sizeof(senderNum) + sizeof(frameNum) + sizeof(syncChecksum) + sizeof(dataChecksum) + sizeof(dataSize) + sizeof(dataOffset);
+		const uint32_t chunkSize = packetSize - headerSize;
+
+		if (snapshot.chunks.empty()) {
+			snapshot.syncChecksum = syncChecksum;
+			snapshot.dataChecksum = dataChecksum;
+			snapshot.dataSize = dataSize;
+		}
+
+		if (dataSize != snapshot.dataSize || (snapshot.recvSize + chunkSize) > snapshot.dataSize)
+			throw netcode::UnpackPacketException("inconsistent chunk");
+
+		snapshot.chunks.push_back(packet);
+		snapshot.recvChecksum.Update(packet->data + headerSize, chunkSize);
+		snapshot.recvSize += chunkSize;
+	} catch (const netcode::UnpackPacketException& ex) {
+		Message(spring::format("[GameServer::%s] exception \"%s\" parsing savestate from player %s", __func__, ex.what(), players[playerNum].name.c_str()));
+		pendingJoinSnapshot = {};
+		return;
+	}
+
+	if (snapshot.recvSize < snapshot.dataSize)
+		return;
+
+	if (snapshot.recvChecksum.GetDigest() != snapshot.dataChecksum) {
+		Message(spring::format("[GameServer::%s] savestate of frame %d from player %s is corrupt", __func__, snapshot.frameNum, players[playerNum].name.c_str()));
+		pendingJoinSnapshot = {};
+		return;
+	}
+
+	PromoteJoinSnapshot();
+}
+
+void CGameServer::VerifyJoinSnapshot(int frameNum, unsigned int syncChecksum)
+{
+	if (frameNum != pendingJoinSnapshot.frameNum)
+		return;
+
+	pendingJoinSnapshot.syncConsensus = syncChecksum;
+	pendingJoinSnapshot.haveConsensus = true;
+
+	PromoteJoinSnapshot();
+}
+
+void CGameServer::PromoteJoinSnapshot()
+{
+	JoinSnapshot& snapshot = pendingJoinSnapshot;
+
+	// wait for both the upload and the sync-responses of its frame
+	if (snapshot.chunks.empty() || snapshot.recvSize < snapshot.dataSize || !snapshot.haveConsensus)
+		return;
+
+	if (snapshot.syncChecksum != snapshot.syncConsensus) {
+		Message(spring::format("[GameServer::%s] discarding savestate of frame %d, checksum %x of player %s does not match %x", __func__, snapshot.frameNum, snapshot.syncChecksum, players[snapshot.playerNum].name.c_str(), snapshot.syncConsensus), false);
+		pendingJoinSnapshot = {};
+		return;
+	}
+
+	joinSnapshot = std::move(snapshot);
+	pendingJoinSnapshot = {};
+
+	Message(spring::format("Savestate of frame %d (%u bytes) available for joining players", joinSnapshot.frameNum, joinSnapshot.dataSize), false);
+}
+
+
 float CGameServer::GetDemoTime() const {
 	if (!gameHasStarted) return gameTime;
 	return (startTime + serverFrameNum / float(GAME_SPEED));
@@ -1348,6 +1530,10 @@ void CGameServer::ProcessPacket(const unsigned playerNum, std::shared_ptr<const
 #endif
 		} break;
 
+		case NETMSG_JOIN_SNAPSHOT: {
+			JoinSnapshotReceived(a, packet);
+		} break;
+
 		case NETMSG_SHARE:
 			if (inbuf[1] != a) {
 				Message(spring::format(WrongPlayer, msgCode, a, (unsigned)inbuf[1]));
@@ -1655,6 +1841,8 @@ void CGameServer::ProcessPacket(const unsigned playerNum, std::shared_ptr<const
 				// bounce back, sender will do local creation
 				Broadcast(CBaseNetProtocol::Get().SendAICreated(playerId, skirmishAIId, aiTeamId, aiName));
 
+				allowJoinSnapshots &= !gameHasStarted;
+
 				if (!tai->HasLeader()) {
 					tai->SetLeader(playerId);
 					tai->SetActive(true);
@@ -1701,6 +1889,8 @@ void CGameServer::ProcessPacket(const unsigned playerNum, std::shared_ptr<const
 			}
 			Broadcast(packet); // forward data
 
+			allowJoinSnapshots &= (!gameHasStarted || (newState != SKIRMAISTATE_RELOADING && newState < SKIRMAISTATE_DIEING));
+
 			// skip resetting management state for reloading AI's; will be reinitialized instantly
 			if ((skirmishAIs[skirmishAIId].second.status = newState) == SKIRMAISTATE_DEAD && oldState != SKIRMAISTATE_RELOADING) {
 				skirmishAIs[skirmishAIId] = std::make_pair(false, GameSkirmishAI{});
@@ -2003,7 +2193,7 @@ void CGameServer::ServerReadNet()
 				if (aiPacket == nullptr)
 					break;
 
-				const bool droppablePacket = (aiPacket->length <= 0 || (aiPacket->data[0] != NETMSG_SYNCRESPONSE && aiPacket->data[0] != NETMSG_KEYFRAME));
+				const bool droppablePacket = (aiPacket->length <= 0 || (aiPacket->data[0] != NETMSG_SYNCRESPONSE && aiPacket->data[0] != NETMSG_KEYFRAME && aiPacket->data[0] != NETMSG_JOIN_SNAPSHOT));
 
 				if (forcedDropPacket && droppablePacket) {
 					++numPktsDropped;
@@ -2623,6 +2813,10 @@ void CGameServer::CreateNewFrame(bool fromServerThread, bool fixedFrameTime)
 		for (unsigned int i = 0; i < numNewFrames; ++i) {
 			++serverFrameNum;
 
+			// must precede the frame, clients save their state right after simulating it
+			if (joinSnapshotInterval > 0 && (serverFrameNum % joinSnapshotInterval) == 0)
+				RequestJoinSnapshot();
+
 			// Send out new frame messages.
 			if ((serverFrameNum % serverKeyframeInterval) == 0) {
 				Broadcast(CBaseNetProtocol::Get().SendKeyFrame(serverFrameNum));
@@ -2630,6 +2824,9 @@ void CGameServer::CreateNewFrame(bool fromServerThread, bool fixedFrameTime)
 				Broadcast(CBaseNetProtocol::Get().SendNewFrame());
 			}
 
+			if (serverFrameNum == pendingJoinSnapshot.frameNum)
+				pendingJoinSnapshot.cacheIndex = packetCache.size();
+
 			// every gameProgressFrameInterval, we broadcast current frame in a
 			// special message (that doesn't get cached and skips normal queue)
 			// to let players know their loading %
@@ -2976,6 +3173,17 @@ unsigned CGameServer::BindConnection(
 	}
 
 	newPlayer.Connected(clientLink, isLocal);
+
+	// a savestate lets the player skip simulating all frames preceding it
+	const bool sendJoinSnapshot = (gameHasStarted && !isLocal && !joinSnapshot.chunks.empty());
+
+	if (sendJoinSnapshot) {
+		Message(spring::format(" -> Sending savestate of frame %d", joinSnapshot.frameNum), false);
+
+		for (const std::shared_ptr<const netcode::RawPacket>& p: joinSnapshot.chunks)
+			newPlayer.SendData(p);
+	}
+
 	newPlayer.SendData(std::shared_ptr<const RawPacket>(myGameData->Pack()));
 	newPlayer.SendData(CBaseNetProtocol::Get().SendSetPlayerNum((unsigned char)newPlayerNumber));
 
@@ -2996,8 +3204,19 @@ unsigned CGameServer::BindConnection(
 	}
 
 	// finally send player all packets he missed until now
-	for (const std::shared_ptr<const netcode::RawPacket>& p: packetCache)
+	for (size_t i = 0, n = packetCache.size(); i < n; i++) {
+		const std::shared_ptr<const netcode::RawPacket>& p = packetCache[i];
+
+		// the savestate already contains the effects of all other packets preceding it
+		if (sendJoinSnapshot && i < joinSnapshot.cacheIndex) {
+			const uint8_t msgCode = p->data[0];
+
+			if (msgCode != NETMSG_GAMEID && msgCode != NETMSG_STARTPLAYING && msgCode != NETMSG_AI_CREATED && msgCode != NETMSG_AI_STATE_CHANGED)
+				continue;
+		}
+
 		newPlayer.SendData(p);
+	}
 
 	// new connection established
 	Message(spring::format(" -> Connection established (given id %i)", newPlayerNumber));
@@ -17,6 +17,7 @@
 #include "Game/GameData.h"
 #include "Sim/Misc/GlobalConstants.h"
 #include "Sim/Misc/TeamBase.h"
+#include "System/CRC.h"
 #include "System/float3.h"
 #include "System/GlobalRNG.h"
 #include "System/Misc/SpringTime.h"
@@ -115,6 +116,8 @@ public:
 	const std::shared_ptr<const  CGameSetup> GetGameSetup() const { return myGameSetup; }
 
 	const std::unique_ptr<CDemoReader>& GetDemoReader() const { return demoReader; }
+	/// frame of the last demo keyframe at or before frameNum, -1 if there is none
+	int GetDemoKeyFrame(int frameNum) const;
 	const std::unique_ptr<CDemoRecorder>& GetDemoRecorder() const { return demoRecorder; }
 
 private:
@@ -166,6 +169,12 @@ private:
 
 	void LagProtection();
 
+	/// asks a client to upload its savestate of the current frame for late joiners
+	void RequestJoinSnapshot();
+	void JoinSnapshotReceived(int playerNum, std::shared_ptr<const netcode::RawPacket> packet);
+	void VerifyJoinSnapshot(int frameNum, unsigned int syncChecksum);
+	void PromoteJoinSnapshot();
+
 	/** @brief Generate a unique game identifier and send it to all clients. */
 	void GenerateAndSendGameID();
 
@@ -223,6 +232,35 @@ private:
 
 	std::deque< std::shared_ptr<const netcode::RawPacket> > packetCache;
 
+	/**
+	 * @brief savestate of the running game, uploaded by one of the clients
+	 *
+	 * Clients joining after it was taken receive it instead of having to
+	 * simulate every frame in packetCache since the start of the game.
+	 */
+	struct JoinSnapshot {
+		std::vector< std::shared_ptr<const netcode::RawPacket> > chunks;
+
+		int playerNum = -1;
+		int frameNum = -1;
+
+		/// index of the first packet in packetCache following the NEWFRAME of frameNum
+		size_t cacheIndex = 0;
+
+		unsigned int syncChecksum = 0;
+		unsigned int syncConsensus = 0;
+		unsigned int dataChecksum = 0;
+		unsigned int dataSize = 0;
+		unsigned int recvSize = 0;
+
+		CRC recvChecksum;
+
+		bool haveConsensus = false;
+	};
+
+	JoinSnapshot joinSnapshot;
+	JoinSnapshot pendingJoinSnapshot;
+
 	/////////////////// sync stuff ///////////////////
 #ifdef SYNCCHECK
 	std::set<int> outstandingSyncFrames;
@@ -258,6 +296,9 @@ private:
 
 	int linkMinPacketSize = 1;
 
+	/// frames between savestates for late joiners, 0 disables them
+	int joinSnapshotInterval = 0;
+
 	unsigned localClientNumber = -1u;
 
 
@@ -276,6 +317,8 @@ private:
 	bool allowSpecDraw = true;
 	bool allowSpecJoin = false;
 	bool whiteListAdditionalPlayers = false;
+	/// cleared when AIs are created or removed mid-game, joiners can not replay that against a savestate
+	bool allowJoinSnapshots = true;
 
 	bool logInfoMessages = false;
 	bool logDebugMessages = false;
@@ -491,6 +491,11 @@ void CGame::ClientReadNet()
 				AddTraffic(-1, packetCode, dataLength);
 			} break;
 
+			case NETMSG_JOIN_SNAPSHOT_REQUEST: {
+				joinSnapshotFrame = *reinterpret_cast<const int32_t*>(inbuf + 1);
+				AddTraffic(-1, packetCode, dataLength);
+			} break;
+
 			case NETMSG_GAMEID: {
 				const uint8_t* p = &inbuf[1];
 				CDemoRecorder* record = clientNet->GetDemoRecorder();
@@ -560,6 +565,8 @@ void CGame::ClientReadNet()
 				lastSimFrameNetPacketTime = spring_gettime();
 
 				SimFrame();
+				SaveDemoKeyFrame();
+				SaveJoinSnapshot();
 
 #ifdef SYNCCHECK
 				// both NETMSG_SYNCRESPONSE and NETMSG_NEWFRAME are used for ping calculation by server
@@ -543,6 +543,36 @@ PacketType CBaseNetProtocol::SendPing(uint8_t playerNum, uint8_t pingTag, float
 	return PacketType(packet);
 }
 
+PacketType CBaseNetProtocol::SendJoinSnapshotRequest(int32_t frameNum)
+{
+	PackPacket* packet = new PackPacket(sizeof(uint8_t) + sizeof(frameNum), NETMSG_JOIN_SNAPSHOT_REQUEST);
+	*packet << frameNum;
+	return PacketType(packet);
+}
+
+PacketType CBaseNetProtocol::SendJoinSnapshot(
+	uint8_t playerNum,
+	int32_t frameNum,
+	uint32_t syncChecksum,
+	uint32_t dataChecksum,
+	uint32_t dataSize,
+	uint32_t dataOffset,
+	const uint8_t* data,
+	uint32_t chunkSize
+) {
+	const uint32_t payloadSize = sizeof(playerNum) + sizeof(frameNum) + sizeof(syncChecksum) + sizeof(dataChecksum) + sizeof(dataSize) + sizeof(dataOffset) + chunkSize;
+	const uint32_t headerSize = sizeof(uint8_t) + sizeof(uint16_t);
+	const uint32_t packetSize = headerSize + payloadSize;
+
+	if (packetSize >= (1 << (sizeof(uint16_t) * 8)))
+		throw netcode::PackPacketException("[BaseNetProto::SendJoinSnapshot] maximum packet-size exceeded");
+
+	PackPacket* packet = new PackPacket(packetSize, NETMSG_JOIN_SNAPSHOT);
+	*packet << static_cast<uint16_t>(packetSize) << playerNum << frameNum << syncChecksum << dataChecksum << dataSize << dataOffset;
+	memcpy(packet->GetWritingPos(), data, chunkSize);
+	return PacketType(packet);
+}
+
 
 PacketType CBaseNetProtocol::SendClientData(uint8_t playerNum, const std::vector<uint8_t>& data)
 {
@@ -666,6 +696,8 @@ CBaseNetProtocol::CBaseNetProtocol()
 	proto->AddType(NETMSG_AI_STATE_CHANGED, 4);
 	proto->AddType(NETMSG_GAME_FRAME_PROGRESS, 5);
 	proto->AddType(NETMSG_PING, 1 + (1 + 1 + 4));
+	proto->AddType(NETMSG_JOIN_SNAPSHOT_REQUEST, 5);
+	proto->AddType(NETMSG_JOIN_SNAPSHOT, -2);
 
 #ifdef SYNCDEBUG
 	proto->AddType(NETMSG_SD_CHKREQUEST, 5);
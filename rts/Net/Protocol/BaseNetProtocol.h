@@ -82,6 +82,8 @@ public:
 	PacketType SendLuaMsg(uint8_t playerNum, uint16_t script, uint8_t mode, const std::vector<uint8_t>& rawData);
 	PacketType SendCurrentFrameProgress(int32_t frameNum);
 	PacketType SendPing(uint8_t playerNum, uint8_t pingTag, float localTime);
+	PacketType SendJoinSnapshotRequest(int32_t frameNum);
+	PacketType SendJoinSnapshot(uint8_t playerNum, int32_t frameNum, uint32_t syncChecksum, uint32_t dataChecksum, uint32_t dataSize, uint32_t dataOffset, const uint8_t* data, uint32_t chunkSize);
 
 	PacketType SendPlayerStat(uint8_t playerNum, const PlayerStatistics& currentStats);
 	PacketType SendTeamStat(uint8_t teamNum, const TeamStatistics& currentStats);
@@ -93,6 +93,9 @@ enum NETMSG {
 
 	NETMSG_PING = 78, // uint8_t playerNum, uint8_t pingTag, float localTime
 
+	NETMSG_JOIN_SNAPSHOT_REQUEST = 79, // int32_t frameNum # server asks a client to upload its savestate of <frameNum> for late joiners #
+	NETMSG_JOIN_SNAPSHOT = 80, // uint16_t messageSize, uint8_t playerNum, int32_t frameNum, uint32_t syncChecksum, uint32_t dataChecksum, uint32_t dataSize, uint32_t dataOffset, std::vector<uint8_t> data
+
 	NETMSG_LAST //max types of netmessages, internal only
 };
 
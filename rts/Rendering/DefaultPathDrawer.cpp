@@ -90,9 +90,9 @@ void DefaultPathDrawer::DrawInMiniMap()
 	glDisable(GL_TEXTURE_2D);
 	glColor4f(1.0f, 1.0f, 0.0f, 0.7f);
 
-	for (const int2& sb: pe->GetUpdatedBlocks()) {
-		const int blockIdxX = sb.x * pe->GetBlockSize();
-		const int blockIdxY = sb.y * pe->GetBlockSize();
+	for (const CPathEstimator::QueuedBlock& qb: pe->GetUpdatedBlocks()) {
+		const int blockIdxX = qb.blockPos.x * pe->GetBlockSize();
+		const int blockIdxY = qb.blockPos.y * pe->GetBlockSize();
 		glRectf(blockIdxX, blockIdxY, blockIdxX + pe->GetBlockSize(), blockIdxY + pe->GetBlockSize());
 	}
 
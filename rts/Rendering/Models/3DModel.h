@@ -237,6 +237,9 @@ struct S3DModel
 		, mins(DEF_MIN_SIZE)
 		, maxs(DEF_MAX_SIZE)
 		, relMidPos(ZeroVector)
+
+		, invertTexYAxis(false)
+		, invertTexAlpha(false)
 	{
 	}
 
@@ -262,6 +265,9 @@ struct S3DModel
 		maxs = m.maxs;
 		relMidPos = m.relMidPos;
 
+		invertTexYAxis = m.invertTexYAxis;
+		invertTexAlpha = m.invertTexAlpha;
+
 		pieces = std::move(m.pieces);
 		return *this;
 	}
@@ -333,6 +339,10 @@ public:
 	float3 mins;
 	float3 maxs;
 	float3 relMidPos;
+
+	// texture-loading flags from the model's metadata (Assimp only)
+	bool invertTexYAxis;
+	bool invertTexAlpha;
 };
 
 
@@ -189,18 +189,24 @@ S3DModel CAssParser::Load(const std::string& modelFilePath)
 	importer.SetPropertyInteger(AI_CONFIG_PP_SLM_VERTEX_LIMIT,   maxVertices);
 	importer.SetPropertyInteger(AI_CONFIG_PP_SLM_TRIANGLE_LIMIT, maxIndices / 3);
 
+	// only the preprocessing pass needs a private copy, Assimp reads from a const buffer
+	const bool preProcess = modelTable.GetBool("nodenamesfromids", false);
+
 	if (!file.IsBuffered()) {
 		fileBuf.resize(file.FileSize(), 0);
 		file.Read(fileBuf.data(), fileBuf.size());
-	} else {
+	} else if (!file.IsMapped() || preProcess) {
 		fileBuf = std::move(file.GetBuffer());
 	}
 
-	if (modelTable.GetBool("nodenamesfromids", false)) {
+	if (preProcess) {
 		assert(FileSystem::GetExtension(modelFilePath) == "dae");
 		PreProcessFileBuffer(fileBuf);
 	}
 
+	const std::uint8_t* fileData = file.IsMapped()? file.GetBufferData(): fileBuf.data();
+	const size_t fileSize = file.IsMapped()? file.FileSize(): fileBuf.size();
+
 
 	// Read the model file to build a scene object
 	LOG_SL(LOG_SECTION_MODEL, L_INFO, "Importing model file: %s", modelFilePath.c_str());
@@ -210,7 +216,7 @@ S3DModel CAssParser::Load(const std::string& modelFilePath)
 	{
 		// ASSIMP spams many SIGFPEs atm in normal & tangent generation
 		ScopedDisableFpuExceptions fe;
-		scene = importer.ReadFileFromMemory(fileBuf.data(), fileBuf.size(), ASS_POSTPROCESS_OPTIONS);
+		scene = importer.ReadFileFromMemory(fileData, fileSize, ASS_POSTPROCESS_OPTIONS);
 	}
 
 	if (scene == nullptr)
@@ -233,7 +239,11 @@ S3DModel CAssParser::Load(const std::string& modelFilePath)
 	FindTextures(&model, scene, modelTable, modelPath, modelName);
 	LOG_SL(LOG_SECTION_MODEL, L_INFO, "Loading textures. Tex1: '%s' Tex2: '%s'", model.texs[0].c_str(), model.texs[1].c_str());
 
-	textureHandlerS3O.PreloadTexture(&model, modelTable.GetBool("fliptextures", true), modelTable.GetBool("invertteamcolor", true));
+	// remembered for models loaded from the cache, which skip the metadata
+	model.invertTexYAxis = modelTable.GetBool("fliptextures", true);
+	model.invertTexAlpha = modelTable.GetBool("invertteamcolor", true);
+
+	textureHandlerS3O.PreloadTexture(&model, model.invertTexYAxis, model.invertTexAlpha);
 
 	// Load all pieces in the model
 	LOG_SL(LOG_SECTION_MODEL, L_INFO, "Loading pieces from root node '%s'", scene->mRootNode->mName.data);
@@ -607,6 +617,32 @@ SAssPiece* CAssParser::AllocPiece()
 	return &piecePool[numPoolPieces++];
 }
 
+
+bool CAssParser::WriteCachedPiece(const S3DModelPiece* piece, ModelCacheWriter& writer) const
+{
+	const SAssPiece* assPiece = static_cast<const SAssPiece*>(piece);
+
+	writer.Write<std::uint32_t>(assPiece->numTexCoorChannels);
+	writer.WriteVector(assPiece->vertices);
+	writer.WriteVector(assPiece->indices);
+	return true;
+}
+
+S3DModelPiece* CAssParser::ReadCachedPiece(ModelCacheReader& reader)
+{
+	SAssPiece* piece = AllocPiece();
+
+	piece->numTexCoorChannels = reader.Read<std::uint32_t>();
+	reader.ReadVector(piece->vertices);
+	reader.ReadVector(piece->indices);
+
+	for (const unsigned int idx: piece->indices) {
+		reader.valid &= (idx < piece->vertices.size());
+	}
+
+	return piece;
+}
+
 SAssPiece* CAssParser::LoadPiece(
 	S3DModel* model,
 	const aiNode* pieceNode,
@@ -78,6 +78,9 @@ public:
 
 	S3DModel Load(const std::string& modelFileName) override;
 
+	bool WriteCachedPiece(const S3DModelPiece* piece, ModelCacheWriter& writer) const override;
+	S3DModelPiece* ReadCachedPiece(ModelCacheReader& reader) override;
+
 private:
 	static void PreProcessFileBuffer(std::vector<unsigned char>& fileBuffer);
 
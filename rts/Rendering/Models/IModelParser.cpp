@@ -16,6 +16,7 @@
 #include "System/MainDefines.h" // SNPRINTF
 #include "System/SafeUtil.h"
 #include "System/Threading/ThreadPool.h"
+#include "System/TimeProfiler.h"
 #include "lib/assimp/include/assimp/Importer.hpp"
 
 
@@ -126,6 +127,8 @@ void CModelLoader::Init()
 	RegisterModelFormats(formats);
 	InitParsers();
 
+	modelCache.Init();
+
 	models.clear();
 	models.resize(MAX_MODEL_OBJECTS);
 
@@ -150,6 +153,8 @@ void CModelLoader::Kill()
 	KillModels();
 	KillParsers();
 
+	modelCache.Kill();
+
 	cache.clear();
 	formats.clear();
 }
@@ -222,6 +227,18 @@ void CModelLoader::PreloadModel(const std::string& modelName)
 	});
 }
 
+void CModelLoader::PreloadModels(const std::vector<std::string>& modelNames)
+{
+	ScopedOnceTimer timer("ModelLoader::PreloadModels");
+
+	// parse (or read from the model-cache) in parallel; lists are
+	// still created by the first non-preload LoadModel call
+	// this thread takes part, so nothing here may wait on others
+	for_mt(0, modelNames.size(), [&](const int i) {
+		LoadModel(modelNames[i], true);
+	});
+}
+
 void CModelLoader::LogErrors()
 {
 	assert(Threading::IsMainThread());
@@ -251,39 +268,67 @@ S3DModel* CModelLoader::LoadModel(std::string name, bool preload)
 	if (name.empty())
 		return nullptr;
 
-	std::string  path;
-	std::string* refs[2] = {&name, &path};
-
 	StringToLowerInPlace(name);
 
 	{
-		std::lock_guard<spring::mutex> lock(mutex);
+		std::unique_lock<spring::mutex> lock(mutex);
 
 		// search in cache first
-		for (const auto& ref: refs) {
-			S3DModel* cachedModel = LoadCachedModel(*ref, preload);
+		const auto ci = cache.find(name);
+
+		if (ci != cache.end())
+			return (LoadCachedModel(ci->second, preload, lock));
+	}
+
+	// expensive, done unlocked so preload workers can search in parallel
+	const std::string& path = FindModelPath(name);
+
+	const std::string* refs[2] = {&name, &path};
+
+	unsigned int id = 0;
+
+	{
+		std::unique_lock<spring::mutex> lock(mutex);
+
+		// another thread may have claimed either key in the meantime
+		for (const std::string* ref: refs) {
+			const auto ci = cache.find(*ref);
 
-			if (cachedModel != nullptr)
-				return cachedModel;
+			if (ci == cache.end())
+				continue;
 
-			// expensive, delay until needed
-			path = FindModelPath(name);
+			cache[name] = (id = ci->second);
+			return (LoadCachedModel(id, preload, lock));
+		}
+
+		// return dummy if at limit
+		if ((numModels + 1) >= MAX_MODEL_OBJECTS) {
+			errors.emplace_back(name, "numModels >= MAX_MODEL_OBJECTS");
+			return &models[0];
 		}
+
+		// claim a slot before parsing so no other thread parses the same model
+		// NB: id depends on thread order, can not be used in synced code
+		cache[name] = (id = ++numModels);
+		cache[path] = id;
 	}
 
-	// not found in cache, create the model and cache it
-	return (CreateModel(name, path, preload));
+	// not found in cache, create the model
+	return (CreateModel(name, path, id, preload));
 }
 
-S3DModel* CModelLoader::LoadCachedModel(const std::string& name, bool preload)
+S3DModel* CModelLoader::LoadCachedModel(unsigned int id, bool preload, std::unique_lock<spring::mutex>& lock)
 {
 	// caller has lock
-	const auto ci = cache.find(name);
+	S3DModel* cachedModel = &models[id];
 
-	if (ci == cache.end())
-		return nullptr;
+	if (!IsModelLoaded(id)) {
+		// still being parsed by another thread, nothing to preload
+		if (preload)
+			return nullptr;
 
-	S3DModel* cachedModel = &models[ci->second];
+		loadCond.wait(lock, [&]() { return (IsModelLoaded(id)); });
+	}
 
 	if (!preload)
 		CreateLists(cachedModel);
@@ -296,12 +341,15 @@ S3DModel* CModelLoader::LoadCachedModel(const std::string& name, bool preload)
 S3DModel* CModelLoader::CreateModel(
 	const std::string& name,
 	const std::string& path,
+	unsigned int id,
 	bool preload
 ) {
-	S3DModel model = std::move(ParseModel(name, path));
-	S3DModel* pmodel = &models[0];
+	S3DModel model;
+	S3DModel* pmodel = &models[id];
+
+	try {
+		model = std::move(ParseModel(name, path));
 
-	{
 		assert(model.numPieces != 0);
 		assert(model.GetRootPiece() != nullptr);
 
@@ -309,26 +357,29 @@ S3DModel* CModelLoader::CreateModel(
 
 		if (!preload)
 			CreateLists(&model);
-	}
-	{
-		std::lock_guard<spring::mutex> lock(mutex);
+	} catch (...) {
+		// threads waiting for this id in LoadCachedModel would block forever,
+		// publish a dummy before passing the error on
+		S3DModel dummy = std::move(CreateDummyModel(id));
+		dummy.SetPieceMatrices();
 
-		// discard loaded model and return dummy if at limit
-		if (numModels >= MAX_MODEL_OBJECTS) {
-			errors.emplace_back(name, "numModels >= MAX_MODEL_OBJECTS");
-			return pmodel;
+		{
+			std::lock_guard<spring::mutex> lock(mutex);
+			*pmodel = std::move(dummy);
 		}
 
-		// NB: id depends on thread order, can not be used in synced code
-		pmodel = &models[model.id = ++numModels];
-
-		// add (parsed or dummy) model to cache
-		cache[name] = model.id;
-		cache[path] = model.id;
+		loadCond.notify_all();
+		throw;
+	}
+	{
+		std::lock_guard<spring::mutex> lock(mutex);
 
+		// publish (parsed or dummy) model to threads waiting for it
+		model.id = id;
 		*pmodel = std::move(model);
 	}
 
+	loadCond.notify_all();
 	return pmodel;
 }
 
@@ -355,7 +406,10 @@ S3DModel CModelLoader::ParseModel(const std::string& name, const std::string& pa
 	}
 
 	try {
-		model = std::move(parser->Load(path));
+		if (!modelCache.Load(parser, path, model)) {
+			model = std::move(parser->Load(path));
+			modelCache.Save(parser, path, model);
+		}
 	} catch (const content_error& ex) {
 		{
 			std::lock_guard<spring::mutex> lock(mutex);
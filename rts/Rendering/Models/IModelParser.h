@@ -7,6 +7,7 @@
 #include <string>
 
 #include "3DModel.h"
+#include "ModelCache.h"
 #include "System/UnorderedMap.hpp"
 #include "System/Threading/SpringThreading.h"
 
@@ -18,6 +19,10 @@ public:
 	virtual void Init() {}
 	virtual void Kill() {}
 	virtual S3DModel Load(const std::string& name) = 0;
+
+	// format-specific piece data for CModelCache; formats that can not be cached keep these
+	virtual bool WriteCachedPiece(const S3DModelPiece* piece, ModelCacheWriter& writer) const { return false; }
+	virtual S3DModelPiece* ReadCachedPiece(ModelCacheReader& reader) { return nullptr; }
 };
 
 
@@ -32,6 +37,7 @@ public:
 
 	bool IsValid() const { return (!formats.empty()); }
 	void PreloadModel(const std::string& name);
+	void PreloadModels(const std::vector<std::string>& names);
 	void LogErrors();
 
 public:
@@ -41,8 +47,8 @@ public:
 
 private:
 	S3DModel ParseModel(const std::string& name, const std::string& path);
-	S3DModel* CreateModel(const std::string& name, const std::string& path, bool preload);
-	S3DModel* LoadCachedModel(const std::string& name, bool preload);
+	S3DModel* CreateModel(const std::string& name, const std::string& path, unsigned int id, bool preload);
+	S3DModel* LoadCachedModel(unsigned int id, bool preload, std::unique_lock<spring::mutex>& lock);
 
 	IModelParser* GetFormatParser(const std::string& pathExt);
 
@@ -52,12 +58,18 @@ private:
 
 	void CreateLists(S3DModel* o);
 
+	bool IsModelLoaded(unsigned int id) const { return (models[id].id == int(id)); }
+
 private:
 	ModelMap cache;
 	FormatMap formats;
 	ParserMap parsers;
 
+	CModelCache modelCache;
+
 	spring::mutex mutex;
+	// signalled whenever a model claimed by some thread finishes loading
+	spring::condition_variable_any loadCond;
 
 	std::vector<S3DModel> models;
 	std::vector< std::pair<std::string, std::string> > errors;
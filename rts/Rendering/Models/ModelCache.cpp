@@ -0,0 +1,314 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include <cstdio>
+
+#include "ModelCache.h"
+#include "3DModel.h"
+#include "IModelParser.h"
+#include "Game/GameSetup.h"
+#include "Game/GameVersion.h"
+#include "Rendering/Textures/S3OTextureHandler.h"
+#include "System/Config/ConfigHandler.h"
+#include "System/CRC.h"
+#include "System/FileSystem/ArchiveScanner.h"
+#include "System/FileSystem/DataDirsAccess.h"
+#include "System/FileSystem/FileHandler.h"
+#include "System/FileSystem/FileQueryFlags.h"
+#include "System/FileSystem/FileSystem.h"
+#include "System/FileSystem/MappedFile.h"
+#include "System/Log/ILog.h"
+
+CONFIG(bool, UseModelCache).defaultValue(true).description("If parsed S3O and Assimp models should be cached on disk, making subsequent loads of the same archive a memory-mapped read.");
+
+
+/*
+ * Layout (native byte-order, strings are prefixed by their uint32 length):
+ *
+ *   uint32 magic, uint32 MODEL_CACHE_VER, raw_digest key
+ *   uint32 dataSize, uint32 dataCRC
+ *   {model}, uint32 numPieces, {{parser piece data}, {piece}}
+ *   uint32 magic
+ *
+ * Pieces are stored in S3DModel::pieces order, so every parent
+ * precedes its children.
+ */
+constexpr static std::uint32_t MODEL_CACHE_MAGIC = 0x434C444D; // "MDLC"
+constexpr static std::uint32_t MODEL_CACHE_VER = 1;
+
+
+void CModelCache::Init()
+{
+	numHits = 0;
+	numMisses = 0;
+
+	if (!configHandler->GetBool("UseModelCache"))
+		return;
+
+	cacheDir = dataDirsAccess.LocateDir(FileSystem::GetCacheDir() + "/models/", FileQueryFlags::WRITE | FileQueryFlags::CREATE_DIRS);
+}
+
+void CModelCache::Kill()
+{
+	if (!cacheDir.empty())
+		LOG_L(L_INFO, "[ModelCache::%s] %u models loaded from cache, %u parsed", __func__, numHits.load(), numMisses.load());
+
+	archiveChecksums.clear();
+	cacheDir.clear();
+}
+
+
+bool CModelCache::GetCacheKey(const std::string& modelPath, sha512::raw_digest& cacheKey)
+{
+	// loose files shadow archived ones and have no checksum
+	if (!CFileHandler::GetFileAbsolutePath(modelPath, SPRING_VFS_RAW).empty())
+		return false;
+
+	const std::string& archiveName = CFileHandler::GetArchiveContainingFile(modelPath, SPRING_VFS_ZIP);
+
+	if (archiveName.empty())
+		return false;
+	if (gameSetup == nullptr)
+		return false;
+
+	ModelCacheWriter writer;
+
+	writer.Write(SpringVersion::GetFull());
+	writer.Write(modelPath);
+
+	{
+		std::lock_guard<spring::mutex> lock(mutex);
+
+		// complete checksums also cover dependencies; metadata (e.g. a
+		// model's .lua) and textures can come from the game or the map
+		// rather than from the model's own archive
+		for (const std::string& name: {archiveName, gameSetup->modName, gameSetup->mapName}) {
+			auto iter = archiveChecksums.find(name);
+
+			if (iter == archiveChecksums.end())
+				iter = archiveChecksums.emplace(name, archiveScanner->GetArchiveCompleteChecksumBytes(name)).first;
+
+			writer.Write(iter->second);
+		}
+	}
+
+	sha512::calc_digest(writer.buffer, cacheKey);
+	return true;
+}
+
+std::string CModelCache::GetCacheFileName(const std::string& modelPath) const
+{
+	sha512::raw_digest pathHash;
+	sha512::hex_digest pathHashHex;
+	sha512::calc_digest(reinterpret_cast<const std::uint8_t*>(modelPath.data()), modelPath.size(), pathHash.data());
+	sha512::dump_digest(pathHash, pathHashHex);
+
+	// one file per model path, newer archive versions replace it
+	return (FileSystem::EnsurePathSepAtEnd(cacheDir) + std::string(pathHashHex.data()).substr(0, 16) + ".bin");
+}
+
+
+bool CModelCache::Load(IModelParser* parser, const std::string& modelPath, S3DModel& model)
+{
+	if (cacheDir.empty())
+		return false;
+
+	const std::string& fileName = GetCacheFileName(modelPath);
+	sha512::raw_digest cacheKey;
+
+	if (!FileSystem::FileExists(fileName) || !GetCacheKey(modelPath, cacheKey)) {
+		numMisses += 1;
+		return false;
+	}
+
+	const CMappedFile file(fileName);
+
+	if (!file.IsOpen()) {
+		LOG_L(L_WARNING, "[ModelCache::%s] failed to map \"%s\"", __func__, fileName.c_str());
+		numMisses += 1;
+		return false;
+	}
+
+	ModelCacheReader reader = {file.GetData(), file.GetData() + file.GetSize(), true};
+
+	const std::uint32_t magic = reader.Read<std::uint32_t>();
+	const std::uint32_t version = reader.Read<std::uint32_t>();
+	const sha512::raw_digest fileKey = reader.Read<sha512::raw_digest>();
+	const std::uint32_t dataSize = reader.Read<std::uint32_t>();
+	const std::uint32_t dataCRC = reader.Read<std::uint32_t>();
+
+	// do not load caches from other versions or archives
+	if (magic != MODEL_CACHE_MAGIC || version != MODEL_CACHE_VER || fileKey != cacheKey) {
+		numMisses += 1;
+		return false;
+	}
+
+	const std::uint8_t* data = reader.pos;
+
+	if (!reader.valid || size_t(reader.end - reader.pos) != (dataSize + sizeof(magic)) || CRC::CalcDigest(data, dataSize) != dataCRC) {
+		LOG_L(L_WARNING, "[ModelCache::%s] \"%s\" is truncated or corrupt", __func__, fileName.c_str());
+		numMisses += 1;
+		return false;
+	}
+
+	ModelCacheReader dataReader = {data, data + dataSize, true};
+	S3DModel cachedModel;
+
+	cachedModel.name    = dataReader.ReadString();
+	cachedModel.texs[0] = dataReader.ReadString();
+	cachedModel.texs[1] = dataReader.ReadString();
+
+	cachedModel.type = static_cast<ModelType>(dataReader.Read<std::int32_t>());
+	cachedModel.numPieces = dataReader.Read<std::int32_t>();
+
+	cachedModel.radius = dataReader.Read<float>();
+	cachedModel.height = dataReader.Read<float>();
+
+	cachedModel.mins = dataReader.Read<float3>();
+	cachedModel.maxs = dataReader.Read<float3>();
+	cachedModel.relMidPos = dataReader.Read<float3>();
+
+	cachedModel.invertTexYAxis = dataReader.Read<std::uint8_t>();
+	cachedModel.invertTexAlpha = dataReader.Read<std::uint8_t>();
+
+	const std::uint32_t numPieces = dataReader.Read<std::uint32_t>();
+
+	cachedModel.pieces.reserve(std::min(numPieces, std::uint32_t(dataSize)));
+
+	for (std::uint32_t i = 0; i < numPieces && dataReader.valid; i++) {
+		S3DModelPiece* piece = parser->ReadCachedPiece(dataReader);
+
+		if (piece == nullptr)
+			break;
+
+		piece->name = dataReader.ReadString();
+
+		const std::int32_t parentIndex = dataReader.Read<std::int32_t>();
+
+		piece->offset = dataReader.Read<float3>();
+		piece->goffset = dataReader.Read<float3>();
+		piece->scales = dataReader.Read<float3>();
+		piece->mins = dataReader.Read<float3>();
+		piece->maxs = dataReader.Read<float3>();
+
+		piece->SetBakedMatrix(dataReader.Read<CMatrix44f>());
+		dataReader.ReadBytes(static_cast<void*>(piece->GetCollisionVolume()), sizeof(CollisionVolume));
+
+		// only the root has no parent, and parents come first
+		if (!(dataReader.valid &= ((i == 0) == (parentIndex < 0) && parentIndex < std::int32_t(i))))
+			break;
+
+		if (parentIndex >= 0) {
+			piece->parent = cachedModel.pieces[parentIndex];
+			piece->parent->children.push_back(piece);
+		}
+
+		cachedModel.pieces.push_back(piece);
+	}
+
+	if (cachedModel.pieces.size() != numPieces || numPieces == 0 || !dataReader.valid || dataReader.pos != dataReader.end || cachedModel.name != modelPath) {
+		// pieces already taken from the parser's pool are not reclaimed, same as for parse errors
+		LOG_L(L_WARNING, "[ModelCache::%s] \"%s\" does not match model \"%s\"", __func__, fileName.c_str(), modelPath.c_str());
+		numMisses += 1;
+		return false;
+	}
+
+	textureHandlerS3O.PreloadTexture(&cachedModel, cachedModel.invertTexYAxis, cachedModel.invertTexAlpha);
+
+	model = std::move(cachedModel);
+	numHits += 1;
+	return true;
+}
+
+void CModelCache::Save(IModelParser* parser, const std::string& modelPath, const S3DModel& model)
+{
+	if (cacheDir.empty())
+		return;
+	// dummy replacing a model that failed to load
+	if (model.pieces.empty() || model.name != modelPath)
+		return;
+
+	ModelCacheWriter dataWriter;
+	spring::unordered_map<const S3DModelPiece*, std::int32_t> pieceIndices;
+
+	dataWriter.Write(model.name);
+	dataWriter.Write(model.texs[0]);
+	dataWriter.Write(model.texs[1]);
+
+	dataWriter.Write<std::int32_t>(model.type);
+	dataWriter.Write<std::int32_t>(model.numPieces);
+
+	dataWriter.Write<float>(model.radius);
+	dataWriter.Write<float>(model.height);
+
+	dataWriter.Write<float3>(model.mins);
+	dataWriter.Write<float3>(model.maxs);
+	dataWriter.Write<float3>(model.relMidPos);
+
+	dataWriter.Write<std::uint8_t>(model.invertTexYAxis);
+	dataWriter.Write<std::uint8_t>(model.invertTexAlpha);
+
+	dataWriter.Write<std::uint32_t>(model.pieces.size());
+
+	for (const S3DModelPiece* piece: model.pieces) {
+		// format does not support caching
+		if (!parser->WriteCachedPiece(piece, dataWriter))
+			return;
+
+		const auto parentIter = pieceIndices.find(piece->parent);
+
+		if (piece->parent != nullptr && parentIter == pieceIndices.end())
+			return;
+
+		pieceIndices.emplace(piece, std::int32_t(pieceIndices.size()));
+
+		dataWriter.Write(piece->name);
+		dataWriter.Write<std::int32_t>((piece->parent != nullptr)? parentIter->second: -1);
+
+		dataWriter.Write<float3>(piece->offset);
+		dataWriter.Write<float3>(piece->goffset);
+		dataWriter.Write<float3>(piece->scales);
+		dataWriter.Write<float3>(piece->mins);
+		dataWriter.Write<float3>(piece->maxs);
+
+		dataWriter.Write<CMatrix44f>(piece->bakedMatrix);
+		dataWriter.Write<CollisionVolume>(*piece->GetCollisionVolume());
+	}
+
+	sha512::raw_digest cacheKey;
+
+	if (!GetCacheKey(modelPath, cacheKey))
+		return;
+
+	ModelCacheWriter writer;
+	writer.Write<std::uint32_t>(MODEL_CACHE_MAGIC);
+	writer.Write<std::uint32_t>(MODEL_CACHE_VER);
+	writer.Write<sha512::raw_digest>(cacheKey);
+	writer.Write<std::uint32_t>(dataWriter.buffer.size());
+	writer.Write<std::uint32_t>(CRC::CalcDigest(dataWriter.buffer.data(), dataWriter.buffer.size()));
+
+	const std::string& fileName = GetCacheFileName(modelPath);
+	// another client may have the old cache mapped, never truncate it in-place
+	const std::string tmpFileName = FileSystem::GetTemporaryPath(fileName);
+
+	FILE* out = fopen(tmpFileName.c_str(), "wb");
+
+	if (out == nullptr) {
+		LOG_L(L_ERROR, "[ModelCache::%s] failed to write to \"%s\"", __func__, tmpFileName.c_str());
+		return;
+	}
+
+	bool written = true;
+	written &= (fwrite(writer.buffer.data(), writer.buffer.size(), 1, out) == 1);
+	written &= (fwrite(dataWriter.buffer.data(), dataWriter.buffer.size(), 1, out) == 1);
+	written &= (fwrite(&MODEL_CACHE_MAGIC, sizeof(MODEL_CACHE_MAGIC), 1, out) == 1);
+
+	if ((fclose(out) == EOF) || !written) {
+		LOG_L(L_ERROR, "[ModelCache::%s] failed to write to \"%s\"", __func__, tmpFileName.c_str());
+		// never leave a partial cache behind
+		FileSystem::Remove(tmpFileName);
+		return;
+	}
+
+	if (!FileSystem::RenameFile(tmpFileName, fileName))
+		FileSystem::Remove(tmpFileName);
+}
@@ -0,0 +1,109 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef MODEL_CACHE_H
+#define MODEL_CACHE_H
+
+#include <atomic>
+#include <cinttypes>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "System/UnorderedMap.hpp"
+#include "System/Sync/SHA512.hpp"
+#include "System/Threading/SpringThreading.h"
+
+class IModelParser;
+struct S3DModel;
+
+
+// trivially copyable data only; native byte-order
+struct ModelCacheWriter {
+	template<typename T> void Write(const T& v) {
+		const std::uint8_t* p = reinterpret_cast<const std::uint8_t*>(&v);
+		buffer.insert(buffer.end(), p, p + sizeof(T));
+	}
+	template<typename T> void WriteVector(const std::vector<T>& v) {
+		const std::uint8_t* p = reinterpret_cast<const std::uint8_t*>(v.data());
+		Write<std::uint32_t>(v.size());
+		buffer.insert(buffer.end(), p, p + v.size() * sizeof(T));
+	}
+	void Write(const std::string& s) {
+		Write<std::uint32_t>(s.size());
+		buffer.insert(buffer.end(), s.begin(), s.end());
+	}
+
+	std::vector<std::uint8_t> buffer;
+};
+
+struct ModelCacheReader {
+	template<typename T> T Read() {
+		T v = {};
+		ReadBytes(&v, sizeof(T));
+		return v;
+	}
+	template<typename T> void ReadVector(std::vector<T>& v) {
+		const std::uint32_t size = Read<std::uint32_t>();
+
+		if (!(valid &= (size_t(end - pos) / sizeof(T) >= size)))
+			return;
+
+		v.resize(size);
+		ReadBytes(static_cast<void*>(v.data()), size * sizeof(T));
+	}
+	std::string ReadString() {
+		const std::uint32_t size = Read<std::uint32_t>();
+
+		if (!(valid &= (size_t(end - pos) >= size)))
+			return "";
+
+		pos += size;
+		return std::string(reinterpret_cast<const char*>(pos - size), size);
+	}
+	void ReadBytes(void* dst, size_t size) {
+		if ((valid &= (size_t(end - pos) >= size)))
+			std::memcpy(dst, pos, size);
+
+		pos += (size * valid);
+	}
+
+	const std::uint8_t* pos;
+	const std::uint8_t* end;
+
+	bool valid;
+};
+
+
+/**
+ * Per-model files holding S3DModel's exactly as the format parsers
+ * returned them (pieces, vertices, indices, volumes), keyed by the
+ * engine version and the checksums of the archive the model is in and
+ * of the loaded game and map.
+ * Parsers opt in through IModelParser::{Read,Write}CachedPiece.
+ * Load and Save are safe to call from multiple threads.
+ */
+class CModelCache
+{
+public:
+	void Init();
+	void Kill();
+
+	bool Load(IModelParser* parser, const std::string& modelPath, S3DModel& model);
+	void Save(IModelParser* parser, const std::string& modelPath, const S3DModel& model);
+
+private:
+	bool GetCacheKey(const std::string& modelPath, sha512::raw_digest& cacheKey);
+	std::string GetCacheFileName(const std::string& modelPath) const;
+
+private:
+	// complete checksums of the game, the map and the archives models were found in
+	spring::unordered_map<std::string, sha512::raw_digest> archiveChecksums;
+	spring::mutex mutex;
+
+	std::string cacheDir;
+
+	std::atomic<unsigned int> numHits = {0};
+	std::atomic<unsigned int> numMisses = {0};
+};
+
+#endif // MODEL_CACHE_H
@@ -93,6 +93,33 @@ SS3OPiece* CS3OParser::AllocPiece()
 	return &piecePool[numPoolPieces++];
 }
 
+
+bool CS3OParser::WriteCachedPiece(const S3DModelPiece* piece, ModelCacheWriter& writer) const
+{
+	const SS3OPiece* s3oPiece = static_cast<const SS3OPiece*>(piece);
+
+	writer.Write<std::int32_t>(s3oPiece->primType);
+	writer.WriteVector(s3oPiece->vertices);
+	writer.WriteVector(s3oPiece->indices);
+	return true;
+}
+
+S3DModelPiece* CS3OParser::ReadCachedPiece(ModelCacheReader& reader)
+{
+	SS3OPiece* piece = AllocPiece();
+
+	piece->primType = reader.Read<std::int32_t>();
+	reader.ReadVector(piece->vertices);
+	reader.ReadVector(piece->indices);
+
+	// indices are trusted by the VBO upload and shatter code
+	for (const unsigned int idx: piece->indices) {
+		reader.valid &= (idx < piece->vertices.size());
+	}
+
+	return piece;
+}
+
 SS3OPiece* CS3OParser::LoadPiece(S3DModel* model, SS3OPiece* parent, std::vector<uint8_t>& buf, int offset)
 {
 	if ((offset + sizeof(Piece)) > buf.size())
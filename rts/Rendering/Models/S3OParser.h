@@ -84,6 +84,9 @@ public:
 
 	S3DModel Load(const std::string& name) override;
 
+	bool WriteCachedPiece(const S3DModelPiece* piece, ModelCacheWriter& writer) const override;
+	S3DModelPiece* ReadCachedPiece(ModelCacheReader& reader) override;
+
 private:
 	SS3OPiece* AllocPiece();
 	SS3OPiece* LoadPiece(S3DModel*, SS3OPiece*, std::vector<uint8_t>& buf, int offset);
@@ -1,5 +1,7 @@
 /* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
 
+#include <algorithm>
+
 #include "FeatureHandler.h"
 #include "Feature.h"
 #include "FeatureDef.h"
@@ -7,6 +9,7 @@
 #include "FeatureMemPool.h"
 #include "Map/Ground.h"
 #include "Map/ReadMap.h"
+#include "Rendering/Models/IModelParser.h"
 #include "Sim/Misc/QuadField.h"
 #include "Sim/Units/CommandAI/BuilderCAI.h"
 #include "System/creg/STL_Set.h"
@@ -67,6 +70,27 @@ void CFeatureHandler::LoadFeaturesFromMap()
 	mfi.resize(numFeatures);
 	readMap->GetFeatureInfo(&mfi[0]);
 
+	{
+		std::vector<std::string> modelNames;
+
+		// parse every distinct model up-front in parallel, instead
+		// of one by one as the features below are initialized
+		for (int a = 0; a < numFeatures; ++a) {
+			// unknown types are reported by the loop below
+			const FeatureDef* def = featureDefHandler->GetFeatureDef(readMap->GetFeatureTypeName(mfi[a].featureType), false);
+
+			if (def == nullptr || def->modelName.empty())
+				continue;
+
+			modelNames.push_back(def->modelName);
+		}
+
+		std::sort(modelNames.begin(), modelNames.end());
+		modelNames.erase(std::unique(modelNames.begin(), modelNames.end()), modelNames.end());
+
+		modelLoader.PreloadModels(modelNames);
+	}
+
 	for (int a = 0; a < numFeatures; ++a) {
 		const FeatureDef* def = featureDefHandler->GetFeatureDef(readMap->GetFeatureTypeName(mfi[a].featureType), true);
 
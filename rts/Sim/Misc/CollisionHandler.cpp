@@ -9,6 +9,11 @@
 #include "Sim/Objects/SolidObject.h"
 #include "System/Matrix44f.h"
 #include "System/Log/ILog.h"
+#include "System/SpringMath.h"
+
+#ifndef DEDICATED_NOSSE
+#include <xmmintrin.h>
+#endif
 
 unsigned int CCollisionHandler::numDiscTests = 0;
 unsigned int CCollisionHandler::numContTests = 0;
@@ -394,6 +399,67 @@ bool CCollisionHandler::Intersect(const CollisionVolume* v, const CMatrix44f& m,
 	return intersect;
 }
 
+void CCollisionHandler::IntersectBoundingSpheres(
+	const CollisionSphereBatch& batch,
+	const float3& p0,
+	const float3& p1,
+	std::vector<unsigned int>& hitMasks
+) {
+	constexpr unsigned int B = CollisionSphereBatch::BLOCK_SIZE;
+
+	// closest point on the segment to center c is p0 + d * t, with
+	// t = clamp(dot(c - p0, d) / dot(d, d), 0, 1); zero-length rays
+	// degenerate into a point test at p0
+	const float3 d = p1 - p0;
+	const float segLenSq = d.SqLength();
+	const float segLenSqInv = (segLenSq > 0.0f)? (1.0f / segLenSq): 0.0f;
+
+	hitMasks.resize(batch.GetNumBlocks());
+
+	#ifndef DEDICATED_NOSSE
+	static_assert(B == 4, "");
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 inv = _mm_set1_ps(segLenSqInv);
+
+	const __m128 px = _mm_set1_ps(p0.x);
+	const __m128 py = _mm_set1_ps(p0.y);
+	const __m128 pz = _mm_set1_ps(p0.z);
+	const __m128 dx = _mm_set1_ps(d.x);
+	const __m128 dy = _mm_set1_ps(d.y);
+	const __m128 dz = _mm_set1_ps(d.z);
+
+	for (unsigned int b = 0, n = batch.GetNumBlocks(); b < n; b++) {
+		const __m128 wx = _mm_sub_ps(_mm_loadu_ps(&batch.xs[b * B]), px);
+		const __m128 wy = _mm_sub_ps(_mm_loadu_ps(&batch.ys[b * B]), py);
+		const __m128 wz = _mm_sub_ps(_mm_loadu_ps(&batch.zs[b * B]), pz);
+
+		const __m128 wd = _mm_add_ps(_mm_add_ps(_mm_mul_ps(wx, dx), _mm_mul_ps(wy, dy)), _mm_mul_ps(wz, dz));
+		const __m128 t = _mm_min_ps(_mm_max_ps(_mm_mul_ps(wd, inv), zero), one);
+
+		const __m128 ex = _mm_sub_ps(wx, _mm_mul_ps(dx, t));
+		const __m128 ey = _mm_sub_ps(wy, _mm_mul_ps(dy, t));
+		const __m128 ez = _mm_sub_ps(wz, _mm_mul_ps(dz, t));
+
+		const __m128 distSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, ex), _mm_mul_ps(ey, ey)), _mm_mul_ps(ez, ez));
+
+		hitMasks[b] = _mm_movemask_ps(_mm_cmple_ps(distSq, _mm_loadu_ps(&batch.rSqs[b * B])));
+	}
+	#else
+	for (unsigned int b = 0, n = batch.GetNumBlocks(); b < n; b++) {
+		hitMasks[b] = 0;
+
+		for (unsigned int i = b * B; i < (b + 1) * B; i++) {
+			const float3 w = float3(batch.xs[i], batch.ys[i], batch.zs[i]) - p0;
+			const float3 e = w - d * Clamp(w.dot(d) * segLenSqInv, 0.0f, 1.0f);
+
+			hitMasks[b] |= ((e.SqLength() <= batch.rSqs[i]) << (i - b * B));
+		}
+	}
+	#endif
+}
+
 bool CCollisionHandler::IntersectEllipsoid(const CollisionVolume* v, const float3& pi0, const float3& pi1, CollisionQuery* q)
 {
 	// transform the volume-space points into (unit) sphere-space; requires fewer
@@ -8,6 +8,7 @@
 #include "System/Matrix44f.h"
 
 #include <algorithm>
+#include <vector>
 
 class CSolidObject;
 struct LocalModelPiece;
@@ -86,6 +87,59 @@ private:
 	const LocalModelPiece* lmp = nullptr;
 };
 
+/**
+ * Bounding spheres of collision volumes in structure-of-arrays layout,
+ * padded to whole blocks so CCollisionHandler::IntersectBoundingSpheres
+ * can test a ray segment against BLOCK_SIZE of them per SIMD step.
+ */
+struct CollisionSphereBatch {
+public:
+	static constexpr unsigned int BLOCK_SIZE = 4;
+
+	// absorbs rounding differences between the sphere test and the
+	// exact volume tests, culling must never reject a real hit
+	static constexpr float RADIUS_SLACK = 1.0f;
+
+	void Clear() {
+		xs.clear();
+		ys.clear();
+		zs.clear();
+		rSqs.clear();
+
+		numSpheres = 0;
+	}
+
+	void Add(const float3& center, float radius) {
+		if ((numSpheres % BLOCK_SIZE) == 0) {
+			// padding spheres have a negative squared radius and are never hit
+			xs.resize(xs.size() + BLOCK_SIZE, 0.0f);
+			ys.resize(ys.size() + BLOCK_SIZE, 0.0f);
+			zs.resize(zs.size() + BLOCK_SIZE, 0.0f);
+			rSqs.resize(rSqs.size() + BLOCK_SIZE, -1.0f);
+		}
+
+		xs[numSpheres] = center.x;
+		ys[numSpheres] = center.y;
+		zs[numSpheres] = center.z;
+		rSqs[numSpheres] = (radius + RADIUS_SLACK) * (radius + RADIUS_SLACK);
+
+		numSpheres += 1;
+	}
+
+	unsigned int GetNumSpheres() const { return numSpheres; }
+	unsigned int GetNumBlocks() const { return (xs.size() / BLOCK_SIZE); }
+
+public:
+	std::vector<float> xs;
+	std::vector<float> ys;
+	std::vector<float> zs;
+	std::vector<float> rSqs;
+
+private:
+	unsigned int numSpheres = 0;
+};
+
+
 /**
  * Responsible for detecting hits between projectiles
  * and solid objects (units, features), each SO has a
@@ -163,6 +217,19 @@ class CCollisionHandler {
 		static bool IntersectPiecesHelper(const CSolidObject* o, const CMatrix44f& m, const float3& p0, const float3& p1, CollisionQuery* cqp);
 
 	public:
+		/**
+		 * Conservative early-out test of one ray segment against a batch of
+		 * bounding spheres. Bit (i % BLOCK_SIZE) of hitMasks[i / BLOCK_SIZE]
+		 * is set if the segment might touch sphere i; a cleared bit means
+		 * DetectHit can not report a continuous hit on the volume inside.
+		 */
+		static void IntersectBoundingSpheres(
+			const CollisionSphereBatch& batch,
+			const float3& p0,
+			const float3& p1,
+			std::vector<unsigned int>& hitMasks
+		);
+
 		static bool IntersectEllipsoid(const CollisionVolume* v, const float3& pi0, const float3& pi1, CollisionQuery* cq);
 		static bool IntersectCylinder(const CollisionVolume* v, const float3& pi0, const float3& pi1, CollisionQuery* cq);
 		static bool IntersectBox(const CollisionVolume* v, const float3& pi0, const float3& pi1, CollisionQuery* cq);
@@ -41,7 +41,13 @@ CR_REG_METADATA(CLosHandler,(
 	CR_MEMBER(baseRadarErrorSize),
 	CR_MEMBER(baseRadarErrorMult),
 	CR_MEMBER(radarErrorSizes),
-	CR_IGNORED(losTypes)
+	CR_IGNORED(losTypes),
+
+	CR_IGNORED(unitLosSquares),
+	CR_IGNORED(unitAirLosSquares),
+	CR_IGNORED(unitRadarSquares),
+	CR_IGNORED(unitSonarSquares),
+	CR_IGNORED(unitLosMasks)
 ))
 
 
@@ -818,7 +824,7 @@ void CLosHandler::UpdateHeightMapSynced(SRectangle rect)
 }
 
 
-bool CLosHandler::InLos(const CUnit* unit, int allyTeam) const
+bool CLosHandler::InLos(const UnitHotState::Entry& unit, int allyTeam) const
 {
 	// NOTE: units are treated differently than world objects in two ways:
 	//   1. they can be cloaked (has to be checked BEFORE all other cases)
@@ -827,34 +833,34 @@ bool CLosHandler::InLos(const CUnit* unit, int allyTeam) const
 	//      is enabled --> underwater units can NOT BE SEEN AT ALL without
 	//      active radar!
 	if (modInfo.alwaysVisibleOverridesCloaked) {
-		if (unit->alwaysVisible)
+		if (unit.HasFlag(UnitHotState::FLAG_ALWAYS_VISIBLE))
 			return true;
-		if (unit->isCloaked && unit->allyteam != allyTeam)
+		if (unit.HasFlag(UnitHotState::FLAG_CLOAKED) && unit.allyTeam != allyTeam)
 			return false;
 	} else {
-		if (unit->isCloaked && unit->allyteam != allyTeam)
+		if (unit.HasFlag(UnitHotState::FLAG_CLOAKED) && unit.allyTeam != allyTeam)
 			return false;
-		if (unit->alwaysVisible)
+		if (unit.HasFlag(UnitHotState::FLAG_ALWAYS_VISIBLE))
 			return true;
 	}
 
 	// isCloaked always overrides globalLOS
 	if (globalLOS[allyTeam])
 		return true;
-	if (unit->useAirLos)
-		return (InAirLos(unit->pos, allyTeam) || InAirLos(unit->pos + unit->speed, allyTeam));
+	if (unit.HasFlag(UnitHotState::FLAG_AIR_LOS))
+		return (InAirLos(unit.pos, allyTeam) || InAirLos(unit.pos + unit.speed, allyTeam));
 
 	if (modInfo.requireSonarUnderWater) {
-		if (unit->IsUnderWater() && !InRadar(unit, allyTeam)) {
+		if (unit.HasFlag(UnitHotState::FLAG_UNDER_WATER) && !InRadar(unit, allyTeam)) {
 			return false;
 		}
 	}
 
-	return (InLos(unit->pos, allyTeam) || InLos(unit->pos + unit->speed, allyTeam));
+	return (InLos(unit.pos, allyTeam) || InLos(unit.pos + unit.speed, allyTeam));
 }
 
 
-bool CLosHandler::InAirLos(const CUnit* unit, int allyTeam) const
+bool CLosHandler::InAirLos(const UnitHotState::Entry& unit, int allyTeam) const
 {
 	// NOTE: units are treated differently than world objects in two ways:
 	//   1. they can be cloaked (has to be checked BEFORE all other cases)
@@ -863,14 +869,14 @@ bool CLosHandler::InAirLos(const CUnit* unit, int allyTeam) const
 	//      is enabled --> underwater units can NOT BE SEEN AT ALL without
 	//      active radar!
 	if (modInfo.alwaysVisibleOverridesCloaked) {
-		if (unit->alwaysVisible)
+		if (unit.HasFlag(UnitHotState::FLAG_ALWAYS_VISIBLE))
 			return true;
-		if (unit->isCloaked && unit->allyteam != allyTeam)
+		if (unit.HasFlag(UnitHotState::FLAG_CLOAKED) && unit.allyTeam != allyTeam)
 			return false;
 	} else {
-		if (unit->isCloaked && unit->allyteam != allyTeam)
+		if (unit.HasFlag(UnitHotState::FLAG_CLOAKED) && unit.allyTeam != allyTeam)
 			return false;
-		if (unit->alwaysVisible)
+		if (unit.HasFlag(UnitHotState::FLAG_ALWAYS_VISIBLE))
 			return true;
 	}
 
@@ -879,11 +885,11 @@ bool CLosHandler::InAirLos(const CUnit* unit, int allyTeam) const
 		return true;
 
 	if (modInfo.requireSonarUnderWater) {
-		if (unit->IsUnderWater() && !InRadar(unit, allyTeam))
+		if (unit.HasFlag(UnitHotState::FLAG_UNDER_WATER) && !InRadar(unit, allyTeam))
 			return false;
 	}
 
-	return airLos.InSight(unit->pos, allyTeam);
+	return airLos.InSight(unit.pos, allyTeam);
 }
 
 
@@ -898,25 +904,25 @@ bool CLosHandler::InRadar(const float3 pos, int allyTeam) const
 }
 
 
-bool CLosHandler::InRadar(const CUnit* unit, int allyTeam) const
+bool CLosHandler::InRadar(const UnitHotState::Entry& unit, int allyTeam) const
 {
 	// unit is discoverable by sonar
-	if (unit->IsInWater()) {
-		if ((!unit->sonarStealth || unit->beingBuilt) &&
-		    sonar.InSight(unit->pos, allyTeam) &&
+	if (unit.HasFlag(UnitHotState::FLAG_IN_WATER)) {
+		if ((!unit.HasFlag(UnitHotState::FLAG_SONAR_STEALTH) || unit.HasFlag(UnitHotState::FLAG_BEING_BUILT)) &&
+		    sonar.InSight(unit.pos, allyTeam) &&
 		    !InJammer(unit, allyTeam))
 			return true;
 	}
 
 	// unit is completely submerged, only sonar can see it
-	if (unit->IsUnderWater())
+	if (unit.HasFlag(UnitHotState::FLAG_UNDER_WATER))
 		return false;
 
 	// radar stealth
-	if (unit->stealth && !unit->beingBuilt)
+	if (unit.HasFlag(UnitHotState::FLAG_STEALTH) && !unit.HasFlag(UnitHotState::FLAG_BEING_BUILT))
 		return false;
 
-	return (radar.InSight(unit->pos, allyTeam) && !InJammer(unit, allyTeam));
+	return (radar.InSight(unit.pos, allyTeam) && !InJammer(unit, allyTeam));
 }
 
 
@@ -931,17 +937,103 @@ bool CLosHandler::InJammer(const float3 pos, int allyTeam) const
 }
 
 
-bool CLosHandler::InJammer(const CUnit* unit, int allyTeam) const
+bool CLosHandler::InJammer(const UnitHotState::Entry& unit, int allyTeam) const
 {
-	if (allyTeam == unit->allyteam)
+	if (allyTeam == unit.allyTeam)
 		return false;
 
 	//TODO handle ingame alliances
 
-	const int jammerAlly = modInfo.separateJammers ? unit->allyteam : 0;
+	const int jammerAlly = modInfo.separateJammers ? unit.allyTeam : 0;
 
-	if (unit->IsUnderWater()) {
-		return sonarJammer.InSight(unit->pos, jammerAlly);
+	if (unit.HasFlag(UnitHotState::FLAG_UNDER_WATER)) {
+		return sonarJammer.InSight(unit.pos, jammerAlly);
 	}
-	return jammer.InSight(unit->pos, jammerAlly);
+	return jammer.InSight(unit.pos, jammerAlly);
+}
+
+
+void CLosHandler::CalcUnitLosBits(UnitHotState& hotState)
+{
+	enum {
+		MASK_HIDDEN         = (1 << 0), // cloaked, only visible to own allyteam
+		MASK_ALWAYS_VISIBLE = (1 << 1),
+		MASK_AIR_LOS        = (1 << 2),
+		MASK_SONAR_ONLY     = (1 << 3), // requireSonarUnderWater applies
+		MASK_SONAR_VISIBLE  = (1 << 4),
+		MASK_RADAR_VISIBLE  = (1 << 5),
+		MASK_JAMMED         = (1 << 6), // by its own allyteam's jammers
+	};
+
+	const std::vector<int>& unitIDs = hotState.activeIDs;
+	const size_t numUnits = unitIDs.size();
+
+	for (auto* v: {&unitLosSquares[0], &unitLosSquares[1], &unitAirLosSquares[0], &unitAirLosSquares[1], &unitRadarSquares, &unitSonarSquares}) {
+		v->resize(numUnits);
+	}
+
+	unitLosMasks.resize(numUnits);
+
+	// pass 1: per-unit state that does not depend on the observing allyteam
+	// (map squares are allyteam-independent, jamming only depends on the
+	// unit's own allyteam)
+	for_mt(0, numUnits, [&](const int i) {
+		const UnitHotState::Entry e = hotState.GetEntry(unitIDs[i]);
+
+		const bool underWater = e.HasFlag(UnitHotState::FLAG_UNDER_WATER);
+		const bool beingBuilt = e.HasFlag(UnitHotState::FLAG_BEING_BUILT);
+		const bool jammed = (underWater? sonarJammer: jammer).InSight(e.pos, modInfo.separateJammers? e.allyTeam: 0);
+
+		unsigned char mask = 0;
+
+		mask |= (MASK_HIDDEN         * e.HasFlag(UnitHotState::FLAG_CLOAKED));
+		mask |= (MASK_ALWAYS_VISIBLE * e.HasFlag(UnitHotState::FLAG_ALWAYS_VISIBLE));
+		mask |= (MASK_AIR_LOS        * e.HasFlag(UnitHotState::FLAG_AIR_LOS));
+		mask |= (MASK_SONAR_ONLY     * (modInfo.requireSonarUnderWater && underWater));
+		mask |= (MASK_SONAR_VISIBLE  * (e.HasFlag(UnitHotState::FLAG_IN_WATER) && (!e.HasFlag(UnitHotState::FLAG_SONAR_STEALTH) || beingBuilt)));
+		mask |= (MASK_RADAR_VISIBLE  * (!underWater && !(e.HasFlag(UnitHotState::FLAG_STEALTH) && !beingBuilt)));
+		mask |= (MASK_JAMMED         * jammed);
+
+		unitLosSquares[0][i] = los.PosToIndex(e.pos);
+		unitLosSquares[1][i] = los.PosToIndex(e.pos + e.speed);
+		unitAirLosSquares[0][i] = airLos.PosToIndex(e.pos);
+		unitAirLosSquares[1][i] = airLos.PosToIndex(e.pos + e.speed);
+		unitRadarSquares[i] = radar.PosToIndex(e.pos);
+		unitSonarSquares[i] = sonar.PosToIndex(e.pos);
+		unitLosMasks[i] = mask;
+	});
+
+	// pass 2: one branch-free sweep per allyteam over the arrays above, same
+	// logic as InLos(Entry) and InRadar(Entry); planes are written disjointly
+	for_mt(0, teamHandler.ActiveAllyTeams(), [&](const int at) {
+		const unsigned short* losMap    = &los.losMaps[at].front();
+		const unsigned short* airLosMap = &airLos.losMaps[at].front();
+		const unsigned short* radarMap  = &radar.losMaps[at].front();
+		const unsigned short* sonarMap  = &sonar.losMaps[at].front();
+
+		const bool globalVis = globalLOS[at];
+		const bool avOverridesCloak = modInfo.alwaysVisibleOverridesCloaked;
+
+		for (size_t i = 0; i < numUnits; i++) {
+			const unsigned char mask = unitLosMasks[i];
+			const unsigned int unitID = unitIDs[i];
+
+			const bool ownAllyTeam = (hotState.allyTeams[unitID] == at);
+			const bool hidden = (mask & MASK_HIDDEN) && !ownAllyTeam;
+			const bool jammed = (mask & MASK_JAMMED) && !ownAllyTeam;
+			const bool alwaysVisible = (mask & MASK_ALWAYS_VISIBLE);
+
+			const bool sonarHit = (mask & MASK_SONAR_VISIBLE) && (sonarMap[unitSonarSquares[i]] != 0);
+			const bool radarHit = (mask & MASK_RADAR_VISIBLE) && (radarMap[unitRadarSquares[i]] != 0);
+			const bool inRadar = (sonarHit || radarHit) && !jammed;
+
+			const bool losHit = (losMap[unitLosSquares[0][i]] != 0) || (losMap[unitLosSquares[1][i]] != 0);
+			const bool airLosHit = (airLosMap[unitAirLosSquares[0][i]] != 0) || (airLosMap[unitAirLosSquares[1][i]] != 0);
+
+			const bool seen = globalVis || ((mask & MASK_AIR_LOS)? airLosHit: (losHit && (inRadar || !(mask & MASK_SONAR_ONLY))));
+			const bool inLos = (avOverridesCloak)? (alwaysVisible || (!hidden && seen)): (!hidden && (alwaysVisible || seen));
+
+			hotState.GetLosBits(at, unitID) = (UnitHotState::LOS_BIT_INLOS * inLos) | (UnitHotState::LOS_BIT_INRADAR * (!inLos && inRadar));
+		}
+	});
 }
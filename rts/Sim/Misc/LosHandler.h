@@ -10,6 +10,7 @@
 #include "Sim/Misc/LosMap.h"
 #include "Sim/Objects/WorldObject.h"
 #include "Sim/Units/Unit.h"
+#include "Sim/Units/UnitHotState.h"
 #include "System/type2.h"
 #include "System/Rectangle.h"
 #include "System/EventClient.h"
@@ -105,6 +106,10 @@ class ILosType
 public:
 	// the Interface
 	int2 PosToSquare(const float3 pos) const { return int2(pos.x * invDiv, pos.z * invDiv); }
+	int PosToIndex(const float3 pos) const {
+		const int2 sq = PosToSquare(pos);
+		return (Clamp(sq.y, 0, size.y - 1) * size.x + Clamp(sq.x, 0, size.x - 1));
+	}
 
 	inline bool InSight(const float3 pos, int allyTeam) const {
 		assert(allyTeam < losMaps.size());
@@ -216,7 +221,8 @@ public:
 	void Kill();
 
 	// the Interface
-	bool InLos(const CUnit* unit, int allyTeam) const;
+	bool InLos(const CUnit* unit, int allyTeam) const { return (InLos(UnitHotState::MakeEntry(unit), allyTeam)); }
+	bool InLos(const UnitHotState::Entry& unit, int allyTeam) const;
 	bool InLos(const CWorldObject* obj, int allyTeam) const {
 		if (obj->alwaysVisible || globalLOS[allyTeam])
 			return true;
@@ -235,7 +241,8 @@ public:
 	}
 
 
-	bool InAirLos(const CUnit* unit, int allyTeam) const;
+	bool InAirLos(const CUnit* unit, int allyTeam) const { return (InAirLos(UnitHotState::MakeEntry(unit), allyTeam)); }
+	bool InAirLos(const UnitHotState::Entry& unit, int allyTeam) const;
 	bool InAirLos(const CWorldObject* obj, int allyTeam) const {
 		if (obj->alwaysVisible || globalLOS[allyTeam])
 			return true;
@@ -250,19 +257,26 @@ public:
 
 
 	bool InRadar(const float3 pos, int allyTeam) const;
-	bool InRadar(const CUnit* unit, int allyTeam) const;
+	bool InRadar(const CUnit* unit, int allyTeam) const { return (InRadar(UnitHotState::MakeEntry(unit), allyTeam)); }
+	bool InRadar(const UnitHotState::Entry& unit, int allyTeam) const;
 
 
 	// returns whether a square is being radar- or sonar-jammed
 	// (even when the square is not in radar- or sonar-coverage)
 	bool InJammer(const float3 pos, int allyTeam) const;
-	bool InJammer(const CUnit* unit, int allyTeam) const;
+	bool InJammer(const CUnit* unit, int allyTeam) const { return (InJammer(UnitHotState::MakeEntry(unit), allyTeam)); }
+	bool InJammer(const UnitHotState::Entry& unit, int allyTeam) const;
 
 
 	bool InSeismicDistance(const CUnit* unit, int allyTeam) const {
 		return seismic.InSight(unit->pos, allyTeam);
 	}
 
+
+	// batched InLos and InRadar for all units in hotState.activeIDs; writes
+	// the UnitHotState::LOS_BIT_* results into the per-allyteam planes
+	void CalcUnitLosBits(UnitHotState& hotState);
+
 public:
 	// default operations for targeting-facilities
 	void IncreaseAllyTeamRadarErrorSize(int allyTeam) { radarErrorSizes[allyTeam] *= baseRadarErrorMult; }
@@ -320,6 +334,13 @@ private:
 
 	std::vector<float> radarErrorSizes;
 	std::array<ILosType*, 7> losTypes;
+
+	// CalcUnitLosBits scratch, per unit (indexed like hotState.activeIDs)
+	std::vector<int> unitLosSquares[2];
+	std::vector<int> unitAirLosSquares[2];
+	std::vector<int> unitRadarSquares;
+	std::vector<int> unitSonarSquares;
+	std::vector<unsigned char> unitLosMasks;
 };
 
 
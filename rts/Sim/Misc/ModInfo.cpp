@@ -95,6 +95,9 @@ void CModInfo::ResetState()
 		pathFinderSystem = NOPFS_TYPE;
 		pfRawDistMult    = 1.25f;
 		pfUpdateRate     = 0.007f;
+		pfUpdateBudget   = 0;
+		pfAsyncRequests  = false;
+		pfFlowFields     = false;
 
 		allowTake = true;
 	}
@@ -134,6 +137,9 @@ void CModInfo::Init(const std::string& modFileName)
 		pathFinderSystem = Clamp(system.GetInt("pathFinderSystem", HAPFS_TYPE), int(NOPFS_TYPE), int(QTPFS_TYPE));
 		pfRawDistMult = system.GetFloat("pathFinderRawDistMult", pfRawDistMult);
 		pfUpdateRate = system.GetFloat("pathFinderUpdateRate", pfUpdateRate);
+		pfUpdateBudget = std::max(0, system.GetInt("pathFinderUpdateBudget", pfUpdateBudget));
+		pfAsyncRequests = system.GetBool("pathFinderAsyncRequests", pfAsyncRequests);
+		pfFlowFields = system.GetBool("pathFinderFlowFields", pfFlowFields);
 
 		allowTake = system.GetBool("allowTake", allowTake);
 	}
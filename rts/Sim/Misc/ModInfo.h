@@ -161,6 +161,13 @@ public:
 
 	float pfRawDistMult;
 	float pfUpdateRate;
+	/// maximum number of estimator blocks (times path-types) updated per frame after map changes, 0 derives it from pfUpdateRate
+	int pfUpdateBudget;
+
+	/// if true, the default PFS queues unit path-requests and solves them in parallel at the start of the next frame
+	bool pfAsyncRequests;
+	/// if true, large groups of units moving to the same goal share a flow-field instead of per-unit paths
+	bool pfFlowFields;
 
 	bool allowTake;
 };
@@ -5,10 +5,10 @@
 #include "QuadField.h"
 #include "Map/ReadMap.h"
 #include "Sim/Misc/CollisionVolume.h"
-#include "Sim/Misc/GlobalSynced.h"
 #include "Sim/Misc/GlobalConstants.h"
 #include "Sim/Misc/TeamHandler.h"
 #include "System/ContainerUtil.h"
+#include "System/Threading/ThreadPool.h"
 
 #ifndef UNIT_TEST
 	#include "Sim/Features/Feature.h"
@@ -26,11 +26,8 @@ CR_REG_METADATA(CQuadField, (
 	CR_MEMBER(quadSizeZ),
 	CR_MEMBER(invQuadSize),
 
-	CR_IGNORED(tempUnits),
-	CR_IGNORED(tempFeatures),
-	CR_IGNORED(tempProjectiles),
-	CR_IGNORED(tempSolids),
-	CR_IGNORED(tempQuads)
+	CR_IGNORED(queryArenas),
+	CR_IGNORED(changeStamp)
 ))
 
 CR_BIND(CQuadField::Quad, )
@@ -40,6 +37,7 @@ CR_REG_METADATA_SUB(CQuadField, Quad, (
 	CR_MEMBER(features),
 	CR_MEMBER(projectiles),
 	CR_MEMBER(repulsers),
+	CR_IGNORED(changeStamp),
 
 	CR_POSTLOAD(PostLoad)
 ))
@@ -121,8 +119,12 @@ void CQuadField::Init(int2 mapDims, int quadSize)
 	invQuadSize = {1.0f / quadSizeX, 1.0f / quadSizeZ};
 
 	baseQuads.resize(numQuadsX * numQuadsZ);
-	tempQuads.ReserveAll(numQuadsX * numQuadsZ);
-	tempQuads.ReleaseAll();
+	queryArenas.resize(ThreadPool::MAX_THREADS);
+
+	for (QueryArena& arena: queryArenas) {
+		arena.tempQuads.ReserveAll(numQuadsX * numQuadsZ);
+		arena.tempQuads.ReleaseAll();
+	}
 
 #ifndef UNIT_TEST
 	for (Quad& quad: baseQuads) {
@@ -139,11 +141,13 @@ void CQuadField::Kill()
 		quad.Clear();
 	}
 
-	tempUnits.ReleaseAll();
-	tempFeatures.ReleaseAll();
-	tempProjectiles.ReleaseAll();
-	tempSolids.ReleaseAll();
-	tempQuads.ReleaseAll();
+	for (QueryArena& arena: queryArenas) {
+		arena.tempUnits.ReleaseAll();
+		arena.tempFeatures.ReleaseAll();
+		arena.tempProjectiles.ReleaseAll();
+		arena.tempSolids.ReleaseAll();
+		arena.tempQuads.ReleaseAll();
+	}
 }
 
 
@@ -162,12 +166,64 @@ int CQuadField::WorldPosToQuadFieldIdx(const float3 p) const
 }
 
 
-#ifndef UNIT_TEST
+CQuadField::QueryArena& CQuadField::GetQueryArena()
+{
+	assert(static_cast<size_t>(ThreadPool::GetThreadNum()) < queryArenas.size());
+	return queryArenas[ThreadPool::GetThreadNum()];
+}
+
+void QueryMarks::Begin()
+{
+	if ((++curMark) != 0)
+		return;
+
+	// wrapped around, older marks could collide
+	std::fill(unitMarks.begin(), unitMarks.end(), 0);
+	std::fill(featureMarks.begin(), featureMarks.end(), 0);
+	std::fill(projectileMarks.begin(), projectileMarks.end(), 0);
+	curMark = 1;
+}
+
+bool QueryMarks::Mark(std::vector<unsigned int>& marks, int id)
+{
+	assert(id >= 0);
+
+	if (static_cast<size_t>(id) >= marks.size())
+		marks.resize(std::max(static_cast<size_t>(id) + 1, marks.size() * 2), 0);
+
+	if (marks[id] == curMark)
+		return false;
+
+	marks[id] = curMark;
+	return true;
+}
+
+
+void CQuadField::NewChangePeriod()
+{
+	if ((++changeStamp) != 0)
+		return;
+
+	// wrapped around, older stamps could collide
+	for (Quad& quad: baseQuads) {
+		quad.changeStamp = 0;
+	}
+
+	changeStamp = 1;
+}
+
+bool CQuadField::AnyQuadChanged(const std::vector<int>& quads) const
+{
+	const auto pred = [&](int qi) { return (baseQuads[qi].changeStamp == changeStamp); };
+	return (std::find_if(quads.begin(), quads.end(), pred) != quads.end());
+}
+
+
 void CQuadField::GetQuads(QuadFieldQuery& qfq, float3 pos, float radius)
 {
 	pos.AssertNaNs();
 	pos.ClampInBounds();
-	qfq.quads = tempQuads.ReserveVector();
+	qfq.quads = GetQueryArena().tempQuads.ReserveVector();
 
 	const int2 min = WorldPosToQuadField(pos - radius);
 	const int2 max = WorldPosToQuadField(pos + radius);
@@ -197,7 +253,7 @@ void CQuadField::GetQuadsRectangle(QuadFieldQuery& qfq, const float3& mins, cons
 {
 	mins.AssertNaNs();
 	maxs.AssertNaNs();
-	qfq.quads = tempQuads.ReserveVector();
+	qfq.quads = GetQueryArena().tempQuads.ReserveVector();
 
 	const int2 min = WorldPosToQuadField(mins);
 	const int2 max = WorldPosToQuadField(maxs);
@@ -215,7 +271,6 @@ void CQuadField::GetQuadsRectangle(QuadFieldQuery& qfq, const float3& mins, cons
 
 	return;
 }
-#endif // UNIT_TEST
 
 
 /// note: this function got an UnitTest, check the tests/ folder!
@@ -224,7 +279,7 @@ void CQuadField::GetQuadsOnRay(QuadFieldQuery& qfq, const float3& start, const f
 	dir.AssertNaNs();
 	start.AssertNaNs();
 
-	auto& queryQuads = *(qfq.quads = tempQuads.ReserveVector());
+	auto& queryQuads = *(qfq.quads = GetQueryArena().tempQuads.ReserveVector());
 
 	const float3 to = start + (dir * length);
 
@@ -322,8 +377,7 @@ bool CQuadField::InsertUnitIf(CUnit* unit, const float3& wpos)
 	if (!spring::VectorInsertUnique(unit->quads, wposQuadIdx, true))
 		return false;
 
-	spring::VectorInsertUnique(baseQuads[wposQuadIdx].units, unit, false);
-	spring::VectorInsertUnique(baseQuads[wposQuadIdx].teamUnits[unit->allyteam], unit, false);
+	InsertQuadUnit(wposQuadIdx, unit);
 	return true;
 }
 
@@ -352,8 +406,7 @@ bool CQuadField::RemoveUnitIf(CUnit* unit, const float3& wpos)
 	if (!spring::VectorErase(unit->quads, wposQuadIdx))
 		return false;
 
-	spring::VectorErase(baseQuads[wposQuadIdx].units, unit);
-	spring::VectorErase(baseQuads[wposQuadIdx].teamUnits[unit->allyteam], unit);
+	EraseQuadUnit(wposQuadIdx, unit);
 	return true;
 }
 #endif
@@ -368,18 +421,21 @@ void CQuadField::MovedUnit(CUnit* unit)
 
 	// compare if the quads have changed, if not stop here
 	if (qfQuery.quads->size() == unit->quads.size()) {
-		if (std::equal(qfQuery.quads->begin(), qfQuery.quads->end(), unit->quads.begin()))
+		if (std::equal(qfQuery.quads->begin(), qfQuery.quads->end(), unit->quads.begin())) {
+			for (const int qi: unit->quads) {
+				MarkQuadChanged(qi);
+			}
+
 			return;
+		}
 	}
 
 	for (const int qi: unit->quads) {
-		spring::VectorErase(baseQuads[qi].units, unit);
-		spring::VectorErase(baseQuads[qi].teamUnits[unit->allyteam], unit);
+		EraseQuadUnit(qi, unit);
 	}
 
 	for (const int qi: *qfQuery.quads) {
-		spring::VectorInsertUnique(baseQuads[qi].units, unit, false);
-		spring::VectorInsertUnique(baseQuads[qi].teamUnits[unit->allyteam], unit, false);
+		InsertQuadUnit(qi, unit);
 	}
 
 	unit->quads = std::move(*qfQuery.quads);
@@ -388,8 +444,7 @@ void CQuadField::MovedUnit(CUnit* unit)
 void CQuadField::RemoveUnit(CUnit* unit)
 {
 	for (const int qi: unit->quads) {
-		spring::VectorErase(baseQuads[qi].units, unit);
-		spring::VectorErase(baseQuads[qi].teamUnits[unit->allyteam], unit);
+		EraseQuadUnit(qi, unit);
 	}
 
 	unit->quads.clear();
@@ -406,6 +461,23 @@ void CQuadField::RemoveUnit(CUnit* unit)
 }
 
 
+void CQuadField::InsertQuadUnit(int quadIdx, CUnit* unit)
+{
+	MarkQuadChanged(quadIdx);
+
+	spring::VectorInsertUnique(baseQuads[quadIdx].units, unit, false);
+	spring::VectorInsertUnique(baseQuads[quadIdx].teamUnits[unit->allyteam], unit, false);
+}
+
+void CQuadField::EraseQuadUnit(int quadIdx, CUnit* unit)
+{
+	MarkQuadChanged(quadIdx);
+
+	spring::VectorErase(baseQuads[quadIdx].units, unit);
+	spring::VectorErase(baseQuads[quadIdx].teamUnits[unit->allyteam], unit);
+}
+
+
 void CQuadField::MovedRepulser(CPlasmaRepulser* repulser)
 {
 	QuadFieldQuery qfQuery;
@@ -413,6 +485,11 @@ void CQuadField::MovedRepulser(CPlasmaRepulser* repulser)
 
 	const auto& repulserQuads = repulser->GetQuads();
 
+	// queries cull repulsers by position, so their quads change either way
+	for (const int qi: repulserQuads) {
+		MarkQuadChanged(qi);
+	}
+
 	// compare if the quads have changed, if not stop here
 	if (qfQuery.quads->size() == repulserQuads.size()) {
 		if (std::equal(qfQuery.quads->begin(), qfQuery.quads->end(), repulserQuads.begin()))
@@ -424,6 +501,7 @@ void CQuadField::MovedRepulser(CPlasmaRepulser* repulser)
 	}
 
 	for (const int qi: *qfQuery.quads) {
+		MarkQuadChanged(qi);
 		spring::VectorInsertUnique(baseQuads[qi].repulsers, repulser, false);
 	}
 
@@ -433,6 +511,7 @@ void CQuadField::MovedRepulser(CPlasmaRepulser* repulser)
 void CQuadField::RemoveRepulser(CPlasmaRepulser* repulser)
 {
 	for (const int qi: repulser->GetQuads()) {
+		MarkQuadChanged(qi);
 		spring::VectorErase(baseQuads[qi].repulsers, repulser);
 	}
 
@@ -454,6 +533,7 @@ void CQuadField::AddFeature(CFeature* feature)
 	GetQuads(qfQuery, feature->pos, feature->radius);
 
 	for (const int qi: *qfQuery.quads) {
+		MarkQuadChanged(qi);
 		spring::VectorInsertUnique(baseQuads[qi].features, feature, false);
 	}
 }
@@ -464,6 +544,7 @@ void CQuadField::RemoveFeature(CFeature* feature)
 	GetQuads(qfQuery, feature->pos, feature->radius);
 
 	for (const int qi: *qfQuery.quads) {
+		MarkQuadChanged(qi);
 		spring::VectorErase(baseQuads[qi].features, feature);
 	}
 
@@ -476,6 +557,27 @@ void CQuadField::RemoveFeature(CFeature* feature)
 	#endif
 }
 
+void CQuadField::ChangedObjectVolume(const CSolidObject* object)
+{
+	const CUnit* unit = dynamic_cast<const CUnit*>(object);
+
+	if (unit != nullptr) {
+		for (const int qi: unit->quads) {
+			MarkQuadChanged(qi);
+		}
+
+		return;
+	}
+
+	// features stay in the quads AddFeature put them in
+	QuadFieldQuery qfQuery;
+	GetQuads(qfQuery, object->pos, object->radius);
+
+	for (const int qi: *qfQuery.quads) {
+		MarkQuadChanged(qi);
+	}
+}
+
 
 
 void CQuadField::MovedProjectile(CProjectile* p)
@@ -533,15 +635,15 @@ void CQuadField::GetUnits(QuadFieldQuery& qfq, const float3& pos, float radius)
 {
 	QuadFieldQuery qfQuery;
 	GetQuads(qfQuery, pos, radius);
-	const int tempNum = gs->GetTempNum();
-	qfq.units = tempUnits.ReserveVector();
+	QueryArena& arena = GetQueryArena();
+	arena.marks.Begin();
+	qfq.units = arena.tempUnits.ReserveVector();
 
 	for (const int qi: *qfQuery.quads) {
 		for (CUnit* u: baseQuads[qi].units) {
-			if (u->tempNum == tempNum)
+			if (!arena.marks.MarkUnit(u->id))
 				continue;
 
-			u->tempNum = tempNum;
 			qfq.units->push_back(u);
 		}
 	}
@@ -553,16 +655,15 @@ void CQuadField::GetUnitsExact(QuadFieldQuery& qfq, const float3& pos, float rad
 {
 	QuadFieldQuery qfQuery;
 	GetQuads(qfQuery, pos, radius);
-	const int tempNum = gs->GetTempNum();
-	qfq.units = tempUnits.ReserveVector();
+	QueryArena& arena = GetQueryArena();
+	arena.marks.Begin();
+	qfq.units = arena.tempUnits.ReserveVector();
 
 	for (const int qi: *qfQuery.quads) {
 		for (CUnit* u: baseQuads[qi].units) {
-			if (u->tempNum == tempNum)
+			if (!arena.marks.MarkUnit(u->id))
 				continue;
 
-			u->tempNum = tempNum;
-
 			const float totRad       = radius + u->radius;
 			const float totRadSq     = totRad * totRad;
 			const float posUnitDstSq = spherical?
@@ -583,17 +684,16 @@ void CQuadField::GetUnitsExact(QuadFieldQuery& qfq, const float3& mins, const fl
 {
 	QuadFieldQuery qfQuery;
 	GetQuadsRectangle(qfQuery, mins, maxs);
-	const int tempNum = gs->GetTempNum();
-	qfq.units = tempUnits.ReserveVector();
+	QueryArena& arena = GetQueryArena();
+	arena.marks.Begin();
+	qfq.units = arena.tempUnits.ReserveVector();
 
 	for (const int qi: *qfQuery.quads) {
 		for (CUnit* unit: baseQuads[qi].units) {
 
-			if (unit->tempNum == tempNum)
+			if (!arena.marks.MarkUnit(unit->id))
 				continue;
 
-			unit->tempNum = tempNum;
-
 			const float3& pos = unit->pos;
 			if (pos.x < mins.x || pos.x > maxs.x)
 				continue;
@@ -612,16 +712,15 @@ void CQuadField::GetFeaturesExact(QuadFieldQuery& qfq, const float3& pos, float
 {
 	QuadFieldQuery qfQuery;
 	GetQuads(qfQuery, pos, radius);
-	const int tempNum = gs->GetTempNum();
-	qfq.features = tempFeatures.ReserveVector();
+	QueryArena& arena = GetQueryArena();
+	arena.marks.Begin();
+	qfq.features = arena.tempFeatures.ReserveVector();
 
 	for (const int qi: *qfQuery.quads) {
 		for (CFeature* f: baseQuads[qi].features) {
-			if (f->tempNum == tempNum)
+			if (!arena.marks.MarkFeature(f->id))
 				continue;
 
-			f->tempNum = tempNum;
-
 			const float totRad       = radius + f->radius;
 			const float totRadSq     = totRad * totRad;
 			const float posDstSq = spherical?
@@ -642,16 +741,15 @@ void CQuadField::GetFeaturesExact(QuadFieldQuery& qfq, const float3& mins, const
 {
 	QuadFieldQuery qfQuery;
 	GetQuadsRectangle(qfQuery, mins, maxs);
-	const int tempNum = gs->GetTempNum();
-	qfq.features = tempFeatures.ReserveVector();
+	QueryArena& arena = GetQueryArena();
+	arena.marks.Begin();
+	qfq.features = arena.tempFeatures.ReserveVector();
 
 	for (const int qi: *qfQuery.quads) {
 		for (CFeature* feature: baseQuads[qi].features) {
-			if (feature->tempNum == tempNum)
+			if (!arena.marks.MarkFeature(feature->id))
 				continue;
 
-			feature->tempNum = tempNum;
-
 			const float3& pos = feature->pos;
 			if (pos.x < mins.x || pos.x > maxs.x)
 				continue;
@@ -671,16 +769,15 @@ void CQuadField::GetProjectilesExact(QuadFieldQuery& qfq, const float3& pos, flo
 {
 	QuadFieldQuery qfQuery;
 	GetQuads(qfQuery, pos, radius);
-	const int tempNum = gs->GetTempNum();
-	qfq.projectiles = tempProjectiles.ReserveVector();
+	QueryArena& arena = GetQueryArena();
+	arena.marks.Begin();
+	qfq.projectiles = arena.tempProjectiles.ReserveVector();
 
 	for (const int qi: *qfQuery.quads) {
 		for (CProjectile* p: baseQuads[qi].projectiles) {
-			if (p->tempNum == tempNum)
+			if (!arena.marks.MarkProjectile(p->id))
 				continue;
 
-			p->tempNum = tempNum;
-
 			if (pos.SqDistance(p->pos) >= Square(radius + p->radius))
 				continue;
 
@@ -695,16 +792,15 @@ void CQuadField::GetProjectilesExact(QuadFieldQuery& qfq, const float3& mins, co
 {
 	QuadFieldQuery qfQuery;
 	GetQuadsRectangle(qfQuery, mins, maxs);
-	const int tempNum = gs->GetTempNum();
-	qfq.projectiles = tempProjectiles.ReserveVector();
+	QueryArena& arena = GetQueryArena();
+	arena.marks.Begin();
+	qfq.projectiles = arena.tempProjectiles.ReserveVector();
 
 	for (const int qi: *qfQuery.quads) {
 		for (CProjectile* p: baseQuads[qi].projectiles) {
-			if (p->tempNum == tempNum)
+			if (!arena.marks.MarkProjectile(p->id))
 				continue;
 
-			p->tempNum = tempNum;
-
 			const float3& pos = p->pos;
 			if (pos.x < mins.x || pos.x > maxs.x)
 				continue;
@@ -729,16 +825,15 @@ void CQuadField::GetSolidsExact(
 ) {
 	QuadFieldQuery qfQuery;
 	GetQuads(qfQuery, pos, radius);
-	const int tempNum = gs->GetTempNum();
-	qfq.solids = tempSolids.ReserveVector();
+	QueryArena& arena = GetQueryArena();
+	arena.marks.Begin();
+	qfq.solids = arena.tempSolids.ReserveVector();
 
 	for (const int qi: *qfQuery.quads) {
 		for (CUnit* u: baseQuads[qi].units) {
-			if (u->tempNum == tempNum)
+			if (!arena.marks.MarkUnit(u->id))
 				continue;
 
-			u->tempNum = tempNum;
-
 			if (!u->HasPhysicalStateBit(physicalStateBits))
 				continue;
 			if (!u->HasCollidableStateBit(collisionStateBits))
@@ -750,11 +845,9 @@ void CQuadField::GetSolidsExact(
 		}
 
 		for (CFeature* f: baseQuads[qi].features) {
-			if (f->tempNum == tempNum)
+			if (!arena.marks.MarkFeature(f->id))
 				continue;
 
-			f->tempNum = tempNum;
-
 			if (!f->HasPhysicalStateBit(physicalStateBits))
 				continue;
 			if (!f->HasCollidableStateBit(collisionStateBits))
@@ -778,15 +871,14 @@ bool CQuadField::NoSolidsExact(
 ) {
 	QuadFieldQuery qfQuery;
 	GetQuads(qfQuery, pos, radius);
-	const int tempNum = gs->GetTempNum();
+	QueryArena& arena = GetQueryArena();
+	arena.marks.Begin();
 
 	for (const int qi: *qfQuery.quads) {
 		for (CUnit* u: baseQuads[qi].units) {
-			if (u->tempNum == tempNum)
+			if (!arena.marks.MarkUnit(u->id))
 				continue;
 
-			u->tempNum = tempNum;
-
 			if (!u->HasPhysicalStateBit(physicalStateBits))
 				continue;
 			if (!u->HasCollidableStateBit(collisionStateBits))
@@ -798,11 +890,9 @@ bool CQuadField::NoSolidsExact(
 		}
 
 		for (CFeature* f: baseQuads[qi].features) {
-			if (f->tempNum == tempNum)
+			if (!arena.marks.MarkFeature(f->id))
 				continue;
 
-			f->tempNum = tempNum;
-
 			if (!f->HasPhysicalStateBit(physicalStateBits))
 				continue;
 			if (!f->HasCollidableStateBit(collisionStateBits))
@@ -826,22 +916,22 @@ void CQuadField::GetUnitsAndFeaturesColVol(
 	std::vector<CFeature*>& features,
 	std::vector<CPlasmaRepulser*>* repulsers
 ) {
-	const int tempNum = gs->GetTempNum();
+	QueryArena& arena = GetQueryArena();
+	arena.marks.Begin();
 
 	QuadFieldQuery qfQuery;
 	GetQuads(qfQuery, pos, radius);
 	// start counting from the previous object-cache sizes
+	const size_t numRepulsers = (repulsers != nullptr)? repulsers->size(): 0;
 
 	for (const int qi: *qfQuery.quads) {
 		const Quad& quad = baseQuads[qi];
 
 		for (CUnit* u: quad.units) {
 			// prevent double adding
-			if (u->tempNum == tempNum)
+			if (!arena.marks.MarkUnit(u->id))
 				continue;
 
-			u->tempNum = tempNum;
-
 			const auto* colvol = &u->collisionVolume;
 			const float totRad = radius + colvol->GetBoundingRadius();
 
@@ -853,11 +943,9 @@ void CQuadField::GetUnitsAndFeaturesColVol(
 
 		for (CFeature* f: quad.features) {
 			// prevent double adding
-			if (f->tempNum == tempNum)
+			if (!arena.marks.MarkFeature(f->id))
 				continue;
 
-			f->tempNum = tempNum;
-
 			const auto* colvol = &f->collisionVolume;
 			const float totRad = radius + colvol->GetBoundingRadius();
 
@@ -868,12 +956,11 @@ void CQuadField::GetUnitsAndFeaturesColVol(
 		}
 		if (repulsers != nullptr) {
 			for (CPlasmaRepulser* r: quad.repulsers) {
-				// prevent double adding
-				if (r->tempNum == tempNum)
+				// prevent double adding; repulsers have no id to mark
+				// but are few, so just search the ones added so far
+				if (std::find(repulsers->begin() + numRepulsers, repulsers->end(), r) != repulsers->end())
 					continue;
 
-				r->tempNum = tempNum;
-
 				const auto* colvol = &r->collisionVolume;
 				const float totRad = radius + colvol->GetBoundingRadius();
 
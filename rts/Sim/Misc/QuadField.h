@@ -66,13 +66,43 @@ public:
 	}
 private:
 	// There should at most be 2 concurrent users of each vector type
-	// using 3 to be safe, increase this number if the assertions below
-	// fail
+	// (per thread) using 3 to be safe, increase this number if the
+	// assertions below fail
 	std::array<PairType, 3> vectors = {{{false, {}}, {false, {}}, {false, {}}}};
 };
 
 
+/**
+ * Replaces CWorldObject::tempNum (which threads can not share) for removing
+ * duplicates from query results; marks are indexed by object id. Begin starts
+ * a new query, Mark* return false if the object was already marked during it.
+ */
+class QueryMarks {
+public:
+	void Begin();
+
+	bool MarkUnit(int id) { return Mark(unitMarks, id); }
+	bool MarkFeature(int id) { return Mark(featureMarks, id); }
+	bool MarkProjectile(int id) { return Mark(projectileMarks, id); }
+
+private:
+	bool Mark(std::vector<unsigned int>& marks, int id);
+
+public:
+	std::vector<unsigned int> unitMarks;
+	std::vector<unsigned int> featureMarks;
+	std::vector<unsigned int> projectileMarks;
 
+	unsigned int curMark = 0;
+};
+
+
+
+/**
+ * Queries only read the quads and use scratch storage of the calling
+ * ThreadPool thread, so they can run concurrently (e.g. from for_mt)
+ * as long as no thread adds, moves or removes objects meanwhile.
+ */
 class CQuadField : spring::noncopyable
 {
 	CR_DECLARE_STRUCT(CQuadField)
@@ -167,11 +197,27 @@ public:
 	void MovedRepulser(CPlasmaRepulser* repulser);
 	void RemoveRepulser(CPlasmaRepulser* repulser);
 
-	void ReleaseVector(std::vector<CUnit*>* v       ) { tempUnits.ReleaseVector(v); }
-	void ReleaseVector(std::vector<CFeature*>* v    ) { tempFeatures.ReleaseVector(v); }
-	void ReleaseVector(std::vector<CProjectile*>* v ) { tempProjectiles.ReleaseVector(v); }
-	void ReleaseVector(std::vector<CSolidObject*>* v) { tempSolids.ReleaseVector(v); }
-	void ReleaseVector(std::vector<int>* v          ) { tempQuads.ReleaseVector(v); }
+	/// for changes that keep an object in its quads but move or reshape its collision volume
+	void ChangedObjectVolume(const CSolidObject* object);
+
+	/// quads changed before this count as unchanged for AnyQuadChanged
+	void NewChangePeriod();
+	/**
+	 * True if a unit, feature or repulser was added to, moved within or
+	 * removed from one of <quads>, or had its volume changed, since the
+	 * last call to NewChangePeriod.
+	 */
+	bool AnyQuadChanged(const std::vector<int>& quads) const;
+
+	/// duplicate removal scratch of the calling thread
+	QueryMarks& GetQueryMarks() { return GetQueryArena().marks; }
+
+	// must be called from the thread that ran the query
+	void ReleaseVector(std::vector<CUnit*>* v       ) { GetQueryArena().tempUnits.ReleaseVector(v); }
+	void ReleaseVector(std::vector<CFeature*>* v    ) { GetQueryArena().tempFeatures.ReleaseVector(v); }
+	void ReleaseVector(std::vector<CProjectile*>* v ) { GetQueryArena().tempProjectiles.ReleaseVector(v); }
+	void ReleaseVector(std::vector<CSolidObject*>* v) { GetQueryArena().tempSolids.ReleaseVector(v); }
+	void ReleaseVector(std::vector<int>* v          ) { GetQueryArena().tempQuads.ReleaseVector(v); }
 
 	struct Quad {
 	public:
@@ -188,6 +234,7 @@ public:
 			features = std::move(q.features);
 			projectiles = std::move(q.projectiles);
 			repulsers = std::move(q.repulsers);
+			changeStamp = q.changeStamp;
 			return *this;
 		}
 
@@ -211,6 +258,9 @@ public:
 		std::vector<CFeature*> features;
 		std::vector<CProjectile*> projectiles;
 		std::vector<CPlasmaRepulser*> repulsers;
+
+		// value of CQuadField::changeStamp when the quad last changed
+		unsigned int changeStamp = 0;
 	};
 
 	const Quad& GetQuad(unsigned i) const {
@@ -232,21 +282,39 @@ public:
 	constexpr static unsigned int BASE_QUAD_SIZE = 128;
 
 private:
+	/// scratch storage of one ThreadPool thread
+	struct QueryArena {
+		// preallocated vectors for Get*Exact functions
+		QueryVectorCache<CUnit*> tempUnits;
+		QueryVectorCache<CFeature*> tempFeatures;
+		QueryVectorCache<CProjectile*> tempProjectiles;
+		QueryVectorCache<CSolidObject*> tempSolids;
+		QueryVectorCache<int> tempQuads;
+
+		QueryMarks marks;
+	};
+
 	int2 WorldPosToQuadField(const float3 p) const;
 	int WorldPosToQuadFieldIdx(const float3 p) const;
 
+	QueryArena& GetQueryArena();
+
+	void MarkQuadChanged(int quadIdx) { baseQuads[quadIdx].changeStamp = changeStamp; }
+
+	void InsertQuadUnit(int quadIdx, CUnit* unit);
+	void EraseQuadUnit(int quadIdx, CUnit* unit);
+
 private:
 	std::vector<Quad> baseQuads;
 
-	// preallocated vectors for Get*Exact functions
-	QueryVectorCache<CUnit*> tempUnits;
-	QueryVectorCache<CFeature*> tempFeatures;
-	QueryVectorCache<CProjectile*> tempProjectiles;
-	QueryVectorCache<CSolidObject*> tempSolids;
-	QueryVectorCache<int> tempQuads;
+	// one per ThreadPool::MAX_THREADS, indexed by ThreadPool::GetThreadNum
+	std::vector<QueryArena> queryArenas;
 
 	float2 invQuadSize;
 
+	// current change period, see NewChangePeriod
+	unsigned int changeStamp = 1;
+
 	int numQuadsX;
 	int numQuadsZ;
 
@@ -31,6 +31,9 @@ public:
 
 	PathNodeStateBuffer& GetNodeStateBuffer() { return blockStates; }
 
+	/// makes searches read estimator offsets and extra costs from <source> instead of our own buffer
+	void ShareNodeStates(const IPathFinder* source) { sharedStates = &source->blockStates; }
+
 	unsigned int GetBlockSize() const { return BLOCK_SIZE; }
 	int2 GetNumBlocks() const { return nbrOfBlocks; }
 	int2 BlockIdxToPos(const unsigned idx) const { return int2(idx % nbrOfBlocks.x, idx / nbrOfBlocks.x); }
@@ -145,6 +148,11 @@ public:
 	PathNodeStateBuffer blockStates;
 	PathPriorityQueue openBlocks;
 
+	// search-independent part of the node states (peNodeOffsets, extra
+	// costs); differs from &blockStates only for search workers, whose
+	// blockStates just hold the per-search costs and masks
+	const PathNodeStateBuffer* sharedStates = &blockStates;
+
 	// list of blocks changed in last search
 	std::vector<unsigned int> dirtyBlocks;
 };
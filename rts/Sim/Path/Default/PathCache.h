@@ -40,6 +40,13 @@ public:
 		float goalRadius,
 		int pathType
 	);
+	/// same as GetCachedPath but does not count hits, safe to call from multiple threads
+	const CacheItem& FindCachedPath(
+		const int2 strtBlock,
+		const int2 goalBlock,
+		float goalRadius,
+		int pathType
+	) const;
 
 private:
 	void RemoveFrontQueItem();
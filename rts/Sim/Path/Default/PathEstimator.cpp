@@ -2,7 +2,10 @@
 
 #include "System/Platform/Win/win32.h"
 
-#include "minizip/zip.h"
+#include <cstdio>
+#include <algorithm>
+#include <cstring>
+#include <numeric>
 
 #include "PathEstimator.h"
 #include "PathFinder.h"
@@ -12,6 +15,8 @@
 #include "PathMemPool.h"
 #include "Game/GlobalUnsynced.h"
 #include "Game/LoadScreen.h"
+#include "Map/MapInfo.h"
+#include "Map/ReadMap.h"
 #include "Sim/Misc/GroundBlockingObjectMap.h"
 #include "Sim/Misc/ModInfo.h"
 #include "Sim/MoveTypes/MoveDefHandler.h"
@@ -20,20 +25,20 @@
 #include "System/Threading/ThreadPool.h" // for_mt
 #include "System/TimeProfiler.h"
 #include "System/Config/ConfigHandler.h"
-#include "System/FileSystem/Archives/IArchive.h"
-#include "System/FileSystem/ArchiveLoader.h"
 #include "System/FileSystem/DataDirsAccess.h"
 #include "System/FileSystem/FileSystem.h"
 #include "System/FileSystem/FileQueryFlags.h"
 #include "System/Platform/Threading.h"
 #include "System/SafeUtil.h"
 #include "System/StringUtil.h"
+#include "System/Sync/HsiehHash.h"
 #include "System/Sync/SHA512.hpp"
 
 #define ENABLE_NETLOG_CHECKSUM 1
 
 CONFIG(int, PathingThreadCount).defaultValue(0).safemodeValue(1).minimumValue(0);
 CONFIG(int, MaxPathCostsMemoryFootPrint).defaultValue(512).minimumValue(64).description("Maximum memusage (in MByte) of multithreaded pathcache generator at loading time.");
+CONFIG(int, MaxPathUpdateMemoryFootPrint).defaultValue(256).minimumValue(0).description("Maximum memusage (in MByte) of the pathfinders used to update path-costs of changed map areas in parallel. One is always created.");
 
 PCMemPool pcMemPool;
 PEMemPool peMemPool;
@@ -43,11 +48,38 @@ static const std::string GetPathCacheDir() {
 	return (FileSystem::GetCacheDir() + "/paths/");
 }
 
-static const std::string GetCacheFileName(const std::string& fileHashCode, const std::string& peFileName, const std::string& mapFileName) {
-	return (GetPathCacheDir() + mapFileName + "." + peFileName + "-" + fileHashCode + ".zip");
+static const std::string GetCacheFileName(const std::string& peFileName, const std::string& mapFileName) {
+	return (GetPathCacheDir() + mapFileName + "." + peFileName + ".blocks");
 }
 
 
+// squares around a block whose data also goes into its hash; slopes
+// and types are stored at half resolution and depend on neighbours
+static constexpr int BLOCK_HASH_MARGIN = 2;
+
+struct BlockCacheHeader {
+	char magic[8];
+
+	std::uint32_t version;
+	// zero until the file has been written completely
+	std::uint32_t hashCode;
+
+	std::uint32_t blockSize;
+	std::uint32_t numBlocksX;
+	std::uint32_t numBlocksZ;
+	std::uint32_t numMoveDefs;
+};
+
+static constexpr char BLOCK_CACHE_MAGIC[8] = {'s', 'p', 'r', 'i', 'n', 'g', 'p', 'e'};
+
+
+// block usage is halved every this many updates, and saturates at MAX_BLOCK_USAGE;
+// a queued block gains one unit of priority per frame it waits, so even unused
+// blocks are updated within MAX_BLOCK_USAGE frames under a permanent backlog
+static constexpr unsigned int BLOCK_USAGE_DECAY_RATE = 64;
+static constexpr unsigned int MAX_BLOCK_USAGE = 1024;
+
+
 static size_t GetNumThreads() {
 	const size_t numThreads = std::max(0, configHandler->GetInt("PathingThreadCount"));
 	const size_t numCores = Threading::GetLogicalCpuCores();
@@ -70,8 +102,8 @@ void CPathEstimator::Init(IPathFinder* pf, unsigned int BLOCK_SIZE, const std::s
 		pathChecksum = 0;
 		fileHashCode = CalcHash(__func__);
 
-		offsetBlockNum = {nbrOfBlocks.x * nbrOfBlocks.y};
-		costBlockNum = {nbrOfBlocks.x * nbrOfBlocks.y};
+		offsetBlockNum = {0};
+		costBlockNum = {0};
 
 		parentPathFinder = pf;
 		nextPathEstimator = nullptr;
@@ -82,9 +114,24 @@ void CPathEstimator::Init(IPathFinder* pf, unsigned int BLOCK_SIZE, const std::s
 		maxSpeedMods.clear();
 		maxSpeedMods.resize(moveDefHandler.GetNumMoveDefs(), 0.001f);
 
+		dirtyRects.clear();
 		updatedBlocks.clear();
 		consumedBlocks.clear();
 		offsetBlocksSortedByCost.clear();
+
+		blockUsage.clear();
+		blockUsage.resize(blockStates.GetSize(), 0);
+
+		updateFrame = 0;
+		nextBlockSeqNum = 0;
+
+		updateStats = {};
+		prevPeakQueuedBlocks = 0;
+		currPeakQueuedBlocks = 0;
+
+		blockHashes.clear();
+		offsetBlockIndices.clear();
+		costBlockIndices.clear();
 	}
 
 	CPathEstimator*  childPE = this;
@@ -136,8 +183,37 @@ void CPathEstimator::Init(IPathFinder* pf, unsigned int BLOCK_SIZE, const std::s
 }
 
 
+void CPathEstimator::InitSearchWorker(const CPathEstimator* source, IPathFinder* parent)
+{
+	IPathFinder::Init(source->BLOCK_SIZE);
+	ShareNodeStates(source);
+
+	parentPathFinder = parent;
+	nextPathEstimator = nullptr;
+
+	pathCache[0] = source->pathCache[0];
+	pathCache[1] = source->pathCache[1];
+
+	maxSpeedMods = source->maxSpeedMods;
+	sharedVertexCosts = &source->vertexCosts;
+
+	deferredCacheItems.clear();
+	deferredCacheItems.reserve(16);
+
+	searchWorker = true;
+}
+
+
 void CPathEstimator::Kill()
 {
+	// workers only borrow the caches of their source
+	if (searchWorker) {
+		IPathFinder::Kill();
+		return;
+	}
+
+	KillUpdateHelpers();
+
 	pcMemPool.free(pathCache[0]);
 	pcMemPool.free(pathCache[1]);
 }
@@ -160,8 +236,13 @@ void CPathEstimator::InitEstimator(const std::string& peFileName, const std::str
 
 	// Not much point in multithreading these...
 	InitBlocks();
+	CalcBlockHashes();
+
+	// fills {offset,cost}BlockIndices with every block whose cached data can not be reused
+	ReadFile(peFileName, mapFileName);
 
-	if (!ReadFile(peFileName, mapFileName)) {
+	// a changed block always invalidates its own costs
+	if (!costBlockIndices.empty()) {
 		// start extra threads if applicable, but always keep the total
 		// memory-footprint made by CPathFinder instances within bounds
 		const unsigned int minMemFootPrint = sizeof(CPathFinder) + parentPathFinder->GetMemFootPrint();
@@ -171,17 +252,19 @@ void CPathEstimator::InitEstimator(const std::string& peFileName, const std::str
 
 		char calcMsg[512];
 		const char* fmtStrs[4] = {
-			"[%s] creating PE%u cache with %u PF threads (%u MB)",
-			"[%s] creating PE%u cache with %u PF thread (%u MB)",
+			"[%s] creating PE%u cache with %u PF threads (%u MB, %u of %u blocks)",
+			"[%s] creating PE%u cache with %u PF thread (%u MB, %u of %u blocks)",
 			"[%s] writing PE%u cache-file %s-%x",
 			"[%s] written PE%u cache-file %s-%x",
 		};
 
 		{
-			sprintf(calcMsg, fmtStrs[numExtraThreads == 0], __func__, BLOCK_SIZE, numExtraThreads + 1, reqMemFootPrint / (1024 * 1024));
+			sprintf(calcMsg, fmtStrs[numExtraThreads == 0], __func__, BLOCK_SIZE, numExtraThreads + 1, reqMemFootPrint / (1024 * 1024), unsigned(costBlockIndices.size()), blockStates.GetSize());
 			loadscreen->SetLoadMessage(calcMsg);
 		}
 
+		offsetBlockNum = {static_cast<std::int64_t>(offsetBlockIndices.size())};
+		costBlockNum = {static_cast<std::int64_t>(costBlockIndices.size())};
 
 		// note: only really needed if numExtraThreads > 0
 		spring::barrier pathBarrier(numExtraThreads + 1);
@@ -209,15 +292,71 @@ void CPathEstimator::InitEstimator(const std::string& peFileName, const std::str
 		loadscreen->SetLoadMessage(calcMsg, true);
 	}
 
+	offsetBlockIndices.clear();
+	costBlockIndices.clear();
+
 	// calculate checksum over block-offsets and vertex-costs
 	pathChecksum = CalcChecksum();
 
-	// switch to runtime wanted IPathFinder (maybe PF or PE)
+	// switch to the runtime helpers (PF or PE, depending on our parent)
 	pfMemPool.free(pathFinders[0]);
-	pathFinders[0] = parentPathFinder;
 
 	pathCache[0] = pcMemPool.alloc<CPathCache>(nbrOfBlocks.x, nbrOfBlocks.y);
 	pathCache[1] = pcMemPool.alloc<CPathCache>(nbrOfBlocks.x, nbrOfBlocks.y);
+
+	InitUpdateHelpers();
+}
+
+
+void CPathEstimator::InitUpdateHelpers()
+{
+	CPathEstimator* parentPE = dynamic_cast<CPathEstimator*>(parentPathFinder);
+
+	pathFinders.clear();
+
+	if (parentPE == nullptr) {
+		// vertex-costs are found by max-res searches; helpers share the extra
+		// costs of our parent, so their results equal those of the parent
+		const unsigned int memFootPrint = sizeof(CPathFinder) + parentPathFinder->GetMemFootPrint();
+		const unsigned int maxMemFootPrint = configHandler->GetInt("MaxPathUpdateMemoryFootPrint") * 1024 * 1024;
+		const unsigned int numHelpers = Clamp(int(maxMemFootPrint / memFootPrint), 1, ThreadPool::GetNumThreads());
+
+		for (unsigned int i = 0; i < numHelpers; i++) {
+			CPathFinder* pf = pfMemPool.alloc<CPathFinder>(true);
+
+			pf->ShareNodeStates(parentPathFinder);
+			pathFinders.push_back(pf);
+		}
+	} else {
+		// vertex-costs are found by med-res searches; every helper is a search
+		// worker of our parent which runs on top of one of the parent's helpers
+		// (never both at the same time, estimators are updated one by one)
+		for (IPathFinder* parentHelper: parentPE->pathFinders) {
+			CPathEstimator* pe = peMemPool.alloc<CPathEstimator>();
+
+			pe->InitSearchWorker(parentPE, parentHelper);
+			pathFinders.push_back(pe);
+		}
+	}
+}
+
+void CPathEstimator::KillUpdateHelpers()
+{
+	const bool parentIsPE = (dynamic_cast<CPathEstimator*>(parentPathFinder) != nullptr);
+
+	for (IPathFinder* helper: pathFinders) {
+		helper->Kill();
+
+		if (parentIsPE) {
+			CPathEstimator* pe = static_cast<CPathEstimator*>(helper);
+			peMemPool.free(pe);
+		} else {
+			CPathFinder* pf = static_cast<CPathFinder*>(helper);
+			pfMemPool.free(pf);
+		}
+	}
+
+	pathFinders.clear();
 }
 
 
@@ -245,16 +384,18 @@ void CPathEstimator::CalcOffsetsAndPathCosts(unsigned int threadNum, spring::bar
 	// A must be completely finished before B_i can be safely called. This means we cannot
 	// let thread i execute (A_i, B_i), but instead have to split the work such that every
 	// thread finishes its part of A before any starts B_i.
-	const unsigned int maxBlockIdx = blockStates.GetSize() - 1;
+	// Both only cover the blocks whose cached data was unusable.
+	const int maxOffsetIdx = offsetBlockIndices.size() - 1;
+	const int maxCostIdx = costBlockIndices.size() - 1;
 	int i;
 
 	while ((i = --offsetBlockNum) >= 0)
-		CalculateBlockOffsets(maxBlockIdx - i, threadNum);
+		CalculateBlockOffsets(offsetBlockIndices[maxOffsetIdx - i], threadNum);
 
 	pathBarrier->wait();
 
 	while ((i = --costBlockNum) >= 0)
-		EstimatePathCosts(maxBlockIdx - i, threadNum);
+		EstimatePathCosts(costBlockIndices[maxCostIdx - i], threadNum);
 }
 
 
@@ -442,7 +583,7 @@ void CPathEstimator::CalcVertexPathCost(
 
 
 /**
- * Mark affected blocks as obsolete
+ * Remember the affected blocks, they are marked as obsolete by the next Update
  */
 void CPathEstimator::MapChanged(unsigned int x1, unsigned int z1, unsigned int x2, unsigned z2)
 {
@@ -455,31 +596,133 @@ void CPathEstimator::MapChanged(unsigned int x1, unsigned int z1, unsigned int x
 	const int lowerZ = Clamp(int(z1 / BLOCK_SIZE) - 1, 0, int(nbrOfBlocks.y - 1));
 	const int upperZ = Clamp(int(z2 / BLOCK_SIZE) + 1, 0, int(nbrOfBlocks.y - 1));
 
-	// mark the blocks inside the rectangle, enqueue them
+	dirtyRects.push_back({lowerX, lowerZ, upperX, upperZ});
+}
+
+
+/**
+ * Merge the areas changed since the last call and mark their blocks as obsolete
+ */
+void CPathEstimator::QueueDirtyBlocks()
+{
+	const auto GetArea = [](const DirtyRect& r) { return ((r.x2 - r.x1 + 1) * (r.z2 - r.z1 + 1)); };
+
+	// changes tend to come in clusters (explosions, rows of buildings, and the
+	// blocks consumed by our parent which are each expanded by their neighbors)
+	// so merge rectangles that touch if their bounding box adds no more blocks
+	// than their overlap saves; this keeps rectangles from being queued twice
+	for (size_t i = 0; i < dirtyRects.size(); i++) {
+		for (size_t j = i + 1; j < dirtyRects.size(); ) {
+			const DirtyRect& a = dirtyRects[i];
+			const DirtyRect& b = dirtyRects[j];
+
+			if (a.x1 > (b.x2 + 1) || b.x1 > (a.x2 + 1) || a.z1 > (b.z2 + 1) || b.z1 > (a.z2 + 1)) {
+				j++;
+				continue;
+			}
+
+			const DirtyRect m = {std::min(a.x1, b.x1), std::min(a.z1, b.z1), std::max(a.x2, b.x2), std::max(a.z2, b.z2)};
+
+			if (GetArea(m) > (GetArea(a) + GetArea(b))) {
+				j++;
+				continue;
+			}
+
+			// the grown rectangle may now touch earlier ones
+			dirtyRects[i] = m;
+			dirtyRects[j] = dirtyRects.back();
+			dirtyRects.pop_back();
+			j = i + 1;
+		}
+	}
+
+	// mark the blocks inside the rectangles, enqueue them
 	// from upper to lower because of the placement of the
 	// bi-directional vertices
-	for (int z = upperZ; z >= lowerZ; z--) {
-		for (int x = upperX; x >= lowerX; x--) {
-			const int idx = BlockPosToIdx(int2(x, z));
+	for (const DirtyRect& r: dirtyRects) {
+		for (int z = r.z2; z >= r.z1; z--) {
+			for (int x = r.x2; x >= r.x1; x--) {
+				const int idx = BlockPosToIdx(int2(x, z));
 
-			if ((blockStates.nodeMask[idx] & PATHOPT_OBSOLETE) != 0)
-				continue;
+				if ((blockStates.nodeMask[idx] & PATHOPT_OBSOLETE) != 0)
+					continue;
 
-			updatedBlocks.emplace_back(x, z);
-			blockStates.nodeMask[idx] |= PATHOPT_OBSOLETE;
+				updatedBlocks.push_back({int2(x, z), updateFrame, nextBlockSeqNum++});
+				blockStates.nodeMask[idx] |= PATHOPT_OBSOLETE;
+			}
 		}
 	}
+
+	dirtyRects.clear();
 }
 
 
 /**
- * Update some obsolete blocks using the FIFO-principle
+ * Move the <numBlocks> queued blocks with the highest priority to the front
+ */
+void CPathEstimator::SelectUpdateBlocks(unsigned int numBlocks)
+{
+	if (numBlocks >= updatedBlocks.size())
+		return;
+
+	// priority is the usage of a block plus the number of frames it has been
+	// waiting, ties are broken by queueing order; this is a strict ordering
+	// so the selection does not depend on the order of the queue itself
+	const auto GetPriority = [&](const QueuedBlock& qb) {
+		return (blockUsage[BlockPosToIdx(qb.blockPos)] + (updateFrame - qb.frame));
+	};
+	const auto HasPriority = [&](const QueuedBlock& a, const QueuedBlock& b) {
+		const std::uint32_t pa = GetPriority(a);
+		const std::uint32_t pb = GetPriority(b);
+		return ((pa > pb) || (pa == pb && a.seqNum < b.seqNum));
+	};
+
+	std::partial_sort(updatedBlocks.begin(), updatedBlocks.begin() + numBlocks, updatedBlocks.end(), HasPriority);
+}
+
+
+void CPathEstimator::AddBlockUsage(const IPath::Path& path) const
+{
+	for (const float3& pos: path.path) {
+		const int2 blockPos = {int(pos.x / BLOCK_PIXEL_SIZE), int(pos.z / BLOCK_PIXEL_SIZE)};
+
+		if ((unsigned)blockPos.x >= nbrOfBlocks.x || (unsigned)blockPos.y >= nbrOfBlocks.y)
+			continue;
+
+		std::uint16_t& usage = blockUsage[BlockPosToIdx(blockPos)];
+		usage = std::min(usage + 1u, MAX_BLOCK_USAGE);
+	}
+}
+
+
+/**
+ * Update some obsolete blocks, most used (or longest waiting) first
  */
 void CPathEstimator::Update()
 {
 	pathCache[0]->Update();
 	pathCache[1]->Update();
 
+	// measured for the stats only, must not affect which blocks are updated
+	const spring_time updateStartTime = spring_gettime();
+
+	if (((++updateFrame) % BLOCK_USAGE_DECAY_RATE) == 0) {
+		for (std::uint16_t& usage: blockUsage)
+			usage >>= 1;
+
+		prevPeakQueuedBlocks = currPeakQueuedBlocks;
+		currPeakQueuedBlocks = 0;
+	}
+
+	QueueDirtyBlocks();
+
+	currPeakQueuedBlocks = std::max(currPeakQueuedBlocks, unsigned(updatedBlocks.size()));
+
+	updateStats.numQueuedBlocks = updatedBlocks.size();
+	updateStats.peakQueuedBlocks = std::max(prevPeakQueuedBlocks, currPeakQueuedBlocks);
+	updateStats.numUpdatedBlocks = 0;
+	updateStats.updateTime = 0.0f;
+
 	const unsigned int numMoveDefs = moveDefHandler.GetNumMoveDefs();
 
 	if (numMoveDefs == 0)
@@ -491,7 +734,7 @@ void CPathEstimator::Update()
 	{
 		const int progressiveUpdates = updatedBlocks.size() * numMoveDefs * modInfo.pfUpdateRate;
 		const int MIN_BLOCKS_TO_UPDATE = std::max<int>(BLOCKS_TO_UPDATE >> 1, 4U);
-		const int MAX_BLOCKS_TO_UPDATE = std::max<int>(BLOCKS_TO_UPDATE << 1, MIN_BLOCKS_TO_UPDATE);
+		const int MAX_BLOCKS_TO_UPDATE = std::max<int>((modInfo.pfUpdateBudget > 0)? modInfo.pfUpdateBudget: (BLOCKS_TO_UPDATE << 1), MIN_BLOCKS_TO_UPDATE);
 
 		blocksToUpdate = Clamp(progressiveUpdates, MIN_BLOCKS_TO_UPDATE, MAX_BLOCKS_TO_UPDATE);
 		blockUpdatePenalty = std::max(0, blockUpdatePenalty - blocksToUpdate);
@@ -510,22 +753,18 @@ void CPathEstimator::Update()
 	if (updatedBlocks.empty())
 		return;
 
+	const unsigned int numConsumedBlocks = std::min(size_t((blocksToUpdate + numMoveDefs - 1) / numMoveDefs), updatedBlocks.size());
+
+	SelectUpdateBlocks(numConsumedBlocks);
+
 	consumedBlocks.clear();
-	consumedBlocks.reserve(consumeBlocks);
+	consumedBlocks.reserve(numConsumedBlocks * numMoveDefs);
 
 	// get blocks to update
-	while (!updatedBlocks.empty()) {
-		const int2& pos = updatedBlocks.front();
+	for (unsigned int n = 0; n < numConsumedBlocks; n++) {
+		const int2 pos = updatedBlocks[n].blockPos;
 		const int idx = BlockPosToIdx(pos);
 
-		if ((blockStates.nodeMask[idx] & PATHOPT_OBSOLETE) == 0) {
-			updatedBlocks.pop_front();
-			continue;
-		}
-
-		if (consumedBlocks.size() >= blocksToUpdate)
-			break;
-
 		// issue repathing for all active movedefs
 		for (unsigned int i = 0; i < numMoveDefs; i++) {
 			const MoveDef* md = moveDefHandler.GetMoveDefByPathType(i);
@@ -534,17 +773,15 @@ void CPathEstimator::Update()
 		}
 
 		// inform dependent estimator that costs were updated and it should do the same
-		// FIXME?
-		//   adjacent med-res PE blocks will cause a low-res block to be updated twice
-		//   (in addition to the overlap that already exists because MapChanged() adds
-		//   boundary blocks)
-		if (true && nextPathEstimator != nullptr)
+		// (adjacent blocks are merged into one area by its QueueDirtyBlocks)
+		if (nextPathEstimator != nullptr)
 			nextPathEstimator->MapChanged(pos.x * BLOCK_SIZE, pos.y * BLOCK_SIZE, pos.x * BLOCK_SIZE, pos.y * BLOCK_SIZE);
 
-		updatedBlocks.pop_front(); // must happen _after_ last usage of the `pos` reference!
 		blockStates.nodeMask[idx] &= ~PATHOPT_OBSOLETE;
 	}
 
+	updatedBlocks.erase(updatedBlocks.begin(), updatedBlocks.begin() + numConsumedBlocks);
+
 	// FindOffset (threadsafe)
 	{
 		SCOPED_TIMER("Sim::Path::Estimator::FindOffset");
@@ -557,26 +794,76 @@ void CPathEstimator::Update()
 		});
 	}
 
-	// CalcVertexPathCosts (not threadsafe)
+	// CalcVertexPathCosts (threadsafe with one helper per thread)
 	{
 		SCOPED_TIMER("Sim::Path::Estimator::CalcVertexPathCosts");
-		for (unsigned int n = 0; n < consumedBlocks.size(); ++n) {
-			CalcVertexPathCosts(*consumedBlocks[n].moveDef, consumedBlocks[n].blockPos);
-		}
+
+		std::atomic<unsigned int> nextBlockIdx = {0};
+
+		// every vertex-cost only depends on the (already updated) offsets
+		// and is written by exactly one search, so it does not matter which
+		// helper calculates it; blocks are handed out dynamically instead
+		for_mt(0, pathFinders.size(), [&](const int helperIdx) {
+			for (unsigned int n = nextBlockIdx.fetch_add(1); n < consumedBlocks.size(); n = nextBlockIdx.fetch_add(1)) {
+				CalcVertexPathCosts(*consumedBlocks[n].moveDef, consumedBlocks[n].blockPos, helperIdx);
+			}
+
+			// helpers of a low-res estimator are med-res search workers; the
+			// rectangle-constrained paths they found are of no use to regular
+			// requests, so drop them rather than adding them to the cache
+			if (parentPathFinder->GetBlockSize() != 1)
+				static_cast<CPathEstimator*>(pathFinders[helperIdx])->deferredCacheItems.clear();
+		});
 	}
+
+	updateStats.numQueuedBlocks = updatedBlocks.size();
+	updateStats.numUpdatedBlocks = numConsumedBlocks;
+	updateStats.updateTime = (spring_gettime() - updateStartTime).toMilliSecsf();
 }
 
 
 const CPathCache::CacheItem& CPathEstimator::GetCache(const int2 strtBlock, const int2 goalBlock, float goalRadius, int pathType, const bool synced) const
 {
-	return pathCache[synced]->GetCachedPath(strtBlock, goalBlock, goalRadius, pathType);
+	// workers must not touch the (shared) hit-counters, and only see entries
+	// present before the current batch so results do not depend on the order
+	// in which requests get picked up by threads
+	if (searchWorker)
+		return pathCache[synced]->FindCachedPath(strtBlock, goalBlock, goalRadius, pathType);
+
+	const CPathCache::CacheItem& ci = pathCache[synced]->GetCachedPath(strtBlock, goalBlock, goalRadius, pathType);
+
+	// only synced requests may influence the (synced) update order
+	if (synced && ci.pathType != -1)
+		AddBlockUsage(ci.path);
+
+	return ci;
 }
 
 void CPathEstimator::AddCache(const IPath::Path* path, const IPath::SearchResult result, const int2 strtBlock, const int2 goalBlock, float goalRadius, int pathType, const bool synced)
 {
+	if (searchWorker) {
+		deferredCacheItems.push_back({{result, *path, strtBlock, goalBlock, goalRadius, pathType}, synced});
+		return;
+	}
+
+	if (synced)
+		AddBlockUsage(*path);
+
 	pathCache[synced]->AddPath(path, result, strtBlock, goalBlock, goalRadius, pathType);
 }
 
+void CPathEstimator::AddDeferredCacheItems(const std::vector<DeferredCacheItem>& items)
+{
+	for (const DeferredCacheItem& dci: items) {
+		const CPathCache::CacheItem& ci = dci.item;
+
+		if (dci.synced)
+			AddBlockUsage(ci.path);
+
+		pathCache[dci.synced]->AddPath(&ci.path, ci.result, ci.strtBlock, ci.goalBlock, ci.goalRadius, ci.pathType);
+	}
+}
+
 
 
 IPath::SearchResult CPathEstimator::DoBlockSearch(
@@ -634,7 +921,7 @@ IPath::SearchResult CPathEstimator::DoSearch(const MoveDef& moveDef, const CPath
 			continue;
 
 		// no, check if the goal is already reached
-		const int2 bSquare = blockStates.peNodeOffsets[moveDef.pathType][ob->nodeNum];
+		const int2 bSquare = sharedStates->peNodeOffsets[moveDef.pathType][ob->nodeNum];
 		const int2 gSquare = ob->nodePos * BLOCK_SIZE + goalSqrOffset;
 
 		bool runBlkSearch = false;
@@ -732,15 +1019,15 @@ bool CPathEstimator::TestBlock(
 		openBlockIdx * PATH_DIRECTION_VERTICES +
 		GetBlockVertexOffset(pathDir, nbrOfBlocks.x);
 
-	assert(testBlockIdx < blockStates.peNodeOffsets[moveDef.pathType].size());
-	assert(vertexCostIdx < vertexCosts.size());
+	assert(testBlockIdx < sharedStates->peNodeOffsets[moveDef.pathType].size());
+	assert(vertexCostIdx < sharedVertexCosts->size());
 
 	// best accessible heightmap-coordinate within tested block
-	// [DBG] const int2 openBlockSquare = blockStates.peNodeOffsets[moveDef.pathType][openBlockIdx];
-	const int2 testBlockSquare = blockStates.peNodeOffsets[moveDef.pathType][testBlockIdx];
+	// [DBG] const int2 openBlockSquare = sharedStates->peNodeOffsets[moveDef.pathType][openBlockIdx];
+	const int2 testBlockSquare = sharedStates->peNodeOffsets[moveDef.pathType][testBlockIdx];
 
 	// transition-cost from parent to tested child
-	float testVertexCost = vertexCosts[vertexCostIdx];
+	float testVertexCost = (*sharedVertexCosts)[vertexCostIdx];
 
 
 	// inf-cost means we can not get from the parent VERTEX to the child
@@ -824,7 +1111,7 @@ bool CPathEstimator::TestBlock(
 	// maximum modifier value
 	//
 	// const float  flowCost = (peDef.testMobile) ? (PathFlowMap::GetInstance())->GetFlowCost(testBlockSquare.x, testBlockSquare.y, moveDef, PathDir2PathOpt(pathDir)) : 0.0f;
-	const float extraCost = blockStates.GetNodeExtraCost(testBlockSquare.x, testBlockSquare.y, peDef.synced);
+	const float extraCost = sharedStates->GetNodeExtraCost(testBlockSquare.x, testBlockSquare.y, peDef.synced);
 	const float  nodeCost = testVertexCost + extraCost;
 
 	const float gCost = parentOpenBlock->gCost + nodeCost;
@@ -907,7 +1194,7 @@ void CPathEstimator::FinishSearch(const MoveDef& moveDef, const CPathFinderDef&
 
 		while (true) {
 			// use offset defined by the block
-			const int2 square = blockStates.peNodeOffsets[moveDef.pathType][blockIdx];
+			const int2 square = sharedStates->peNodeOffsets[moveDef.pathType][blockIdx];
 
 			// foundPath.squares.push_back(square);
 			foundPath.path.emplace_back(square.x * SQUARE_SIZE, CMoveMath::yLevel(moveDef, square.x, square.y), square.y * SQUARE_SIZE);
@@ -932,73 +1219,75 @@ void CPathEstimator::FinishSearch(const MoveDef& moveDef, const CPathFinderDef&
 
 bool CPathEstimator::RemoveCacheFile(const std::string& peFileName, const std::string& mapFileName)
 {
-	return (FileSystem::Remove(GetCacheFileName(IntToString(fileHashCode, "%x"), peFileName, mapFileName)));
+	return (FileSystem::Remove(GetCacheFileName(peFileName, mapFileName)));
 }
 
 /**
- * Try to read offset and vertices data from file, return false on failure
+ * Try to read offset and vertex data from file; blocks whose stored hash
+ * no longer matches (or all, on failure) are queued for recalculation
  */
 bool CPathEstimator::ReadFile(const std::string& peFileName, const std::string& mapFileName)
 {
+	const std::string cacheFileName = GetCacheFileName(peFileName, mapFileName);
 	const std::string hashHexString = IntToString(fileHashCode, "%x");
-	const std::string cacheFileName = GetCacheFileName(hashHexString, peFileName, mapFileName);
+
+	const unsigned int numBlocks = blockStates.GetSize();
+	const unsigned int numMoveDefs = moveDefHandler.GetNumMoveDefs();
+
+	offsetBlockIndices.clear();
+	offsetBlockIndices.resize(numBlocks);
+	costBlockIndices.clear();
+	costBlockIndices.resize(numBlocks);
+
+	std::iota(offsetBlockIndices.begin(), offsetBlockIndices.end(), 0);
+	std::iota(costBlockIndices.begin(), costBlockIndices.end(), 0);
 
 	LOG("[PathEstimator::%s] hash=%s file=\"%s\" (exists=%d)", __func__, hashHexString.c_str(), cacheFileName.c_str(), FileSystem::FileExists(cacheFileName));
 
 	if (!FileSystem::FileExists(cacheFileName))
 		return false;
 
-	std::unique_ptr<IArchive> upfile(archiveLoader.OpenArchive(dataDirsAccess.LocateFile(cacheFileName), "sdz"));
+	FILE* file = fopen(dataDirsAccess.LocateFile(cacheFileName).c_str(), "rb");
 
-	if (upfile == nullptr || !upfile->IsOpen()) {
-		FileSystem::Remove(cacheFileName);
+	if (file == nullptr)
 		return false;
-	}
 
 	char calcMsg[512];
 	sprintf(calcMsg, "Reading Estimate PathCosts [%d]", BLOCK_SIZE);
 	loadscreen->SetLoadMessage(calcMsg);
 
-	const unsigned fid = upfile->FindFile("pathinfo");
-	if (fid >= upfile->NumFiles()) {
-		FileSystem::Remove(cacheFileName);
-		return false;
-	}
+	BlockCacheHeader header;
+	std::vector<std::uint32_t> fileBlockHashes(numBlocks, 0);
 
-	std::vector<std::uint8_t> buffer;
+	bool ret = true;
 
-	if (!upfile->GetFile(fid, buffer) || buffer.size() < 4) {
-		FileSystem::Remove(cacheFileName);
-		return false;
-	}
+	ret = ret && (fread(&header, sizeof(header), 1, file) == 1);
+	ret = ret && (std::memcmp(header.magic, BLOCK_CACHE_MAGIC, sizeof(header.magic)) == 0);
+	ret = ret && (header.version == PATHESTIMATOR_VERSION);
+	ret = ret && (header.hashCode == fileHashCode);
+	ret = ret && (header.blockSize == BLOCK_SIZE);
+	ret = ret && (header.numBlocksX == nbrOfBlocks.x && header.numBlocksZ == nbrOfBlocks.y);
+	ret = ret && (header.numMoveDefs == numMoveDefs);
 
-	const unsigned int filehash = *(reinterpret_cast<unsigned int*>(&buffer[0]));
-	const unsigned int blockSize = blockStates.GetSize() * sizeof(short2);
-	unsigned int pos = sizeof(unsigned);
+	// read everything straight into place, stale blocks are overwritten later
+	ret = ret && (fread(fileBlockHashes.data(), sizeof(std::uint32_t), numBlocks, file) == numBlocks);
 
-	if (filehash != fileHashCode) {
-		FileSystem::Remove(cacheFileName);
-		return false;
+	for (unsigned int pathType = 0; pathType < numMoveDefs && ret; ++pathType) {
+		ret = ret && (fread(blockStates.peNodeOffsets[pathType].data(), sizeof(short2), numBlocks, file) == numBlocks);
 	}
 
-	if (buffer.size() < (pos + blockSize * moveDefHandler.GetNumMoveDefs())) {
-		FileSystem::Remove(cacheFileName);
-		return false;
-	}
+	ret = ret && (fread(vertexCosts.data(), sizeof(float), vertexCosts.size(), file) == vertexCosts.size());
 
-	// read center-offset data
-	for (int pathType = 0; pathType < moveDefHandler.GetNumMoveDefs(); ++pathType) {
-		std::memcpy(&blockStates.peNodeOffsets[pathType][0], &buffer[pos], blockSize);
-		pos += blockSize;
-	}
+	fclose(file);
 
-	// read vertex-cost data
-	if (buffer.size() < (pos + vertexCosts.size() * sizeof(float))) {
+	if (!ret) {
 		FileSystem::Remove(cacheFileName);
 		return false;
 	}
 
-	std::memcpy(&vertexCosts[0], &buffer[pos], vertexCosts.size() * sizeof(float));
+	MarkDirtyBlocks(fileBlockHashes);
+
+	LOG("[PathEstimator::%s] reusing %u of %u blocks (%u offsets and %u cost-sets stale)", __func__, numBlocks - unsigned(costBlockIndices.size()), numBlocks, unsigned(offsetBlockIndices.size()), unsigned(costBlockIndices.size()));
 	return true;
 }
 
@@ -1012,44 +1301,101 @@ bool CPathEstimator::WriteFile(const std::string& peFileName, const std::string&
 	if (!FileSystem::CreateDirectory(GetPathCacheDir()))
 		return false;
 
+	const std::string cacheFileName = GetCacheFileName(peFileName, mapFileName);
 	const std::string hashHexString = IntToString(fileHashCode, "%x");
-	const std::string cacheFileName = GetCacheFileName(hashHexString, peFileName, mapFileName);
 
 	LOG("[PathEstimator::%s] hash=%s file=\"%s\" (exists=%d)", __func__, hashHexString.c_str(), cacheFileName.c_str(), FileSystem::FileExists(cacheFileName));
 
 	// open file for writing in a suitable location
-	zipFile file = zipOpen(dataDirsAccess.LocateFile(cacheFileName, FileQueryFlags::WRITE).c_str(), APPEND_STATUS_CREATE);
+	FILE* file = fopen(dataDirsAccess.LocateFile(cacheFileName, FileQueryFlags::WRITE).c_str(), "wb");
 
 	if (file == nullptr)
 		return false;
 
-	zipOpenNewFileInZip(file, "pathinfo", nullptr, nullptr, 0, nullptr, 0, nullptr, Z_DEFLATED, Z_BEST_COMPRESSION);
+	const unsigned int numBlocks = blockStates.GetSize();
+	const unsigned int numMoveDefs = moveDefHandler.GetNumMoveDefs();
 
-	// write hash-code (NOTE: this also affects the CRC!)
-	zipWriteInFileInZip(file, (const void*) &fileHashCode, 4);
+	BlockCacheHeader header;
+	std::memcpy(header.magic, BLOCK_CACHE_MAGIC, sizeof(header.magic));
 
-	// write center-offsets
-	for (int pathType = 0; pathType < moveDefHandler.GetNumMoveDefs(); ++pathType) {
-		zipWriteInFileInZip(file, (const void*) &blockStates.peNodeOffsets[pathType][0], blockStates.peNodeOffsets[pathType].size() * sizeof(short2));
-	}
+	header.version = PATHESTIMATOR_VERSION;
+	header.hashCode = 0;
+	header.blockSize = BLOCK_SIZE;
+	header.numBlocksX = nbrOfBlocks.x;
+	header.numBlocksZ = nbrOfBlocks.y;
+	header.numMoveDefs = numMoveDefs;
+
+	// raw and uncompressed, the costs are floats and hardly compress anyway
+	bool ret = true;
 
-	// write vertex-costs
-	zipWriteInFileInZip(file, vertexCosts.data(), vertexCosts.size() * sizeof(float));
+	ret = ret && (fwrite(&header, sizeof(header), 1, file) == 1);
+	ret = ret && (fwrite(blockHashes.data(), sizeof(std::uint32_t), numBlocks, file) == numBlocks);
 
-	zipCloseFileInZip(file);
-	zipClose(file, nullptr);
+	for (unsigned int pathType = 0; pathType < numMoveDefs && ret; ++pathType) {
+		ret = ret && (fwrite(blockStates.peNodeOffsets[pathType].data(), sizeof(short2), numBlocks, file) == numBlocks);
+	}
+
+	ret = ret && (fwrite(vertexCosts.data(), sizeof(float), vertexCosts.size(), file) == vertexCosts.size());
+	ret = ret && (fflush(file) == 0);
 
+	// only now mark the file as complete, an interrupted write stays invalid
+	header.hashCode = fileHashCode;
 
-	// get the CRC over the written path data
-	std::unique_ptr<IArchive> upfile(archiveLoader.OpenArchive(dataDirsAccess.LocateFile(cacheFileName), "sdz"));
+	ret = ret && (fseek(file, 0, SEEK_SET) == 0);
+	ret = ret && (fwrite(&header, sizeof(header), 1, file) == 1);
+	ret = (fclose(file) == 0) && ret;
 
-	if (upfile == nullptr || !upfile->IsOpen()) {
+	if (!ret) {
 		FileSystem::Remove(cacheFileName);
 		return false;
 	}
 
-	assert(upfile->FindFile("pathinfo") < upfile->NumFiles());
-  return true;
+	return true;
+}
+
+
+void CPathEstimator::CalcBlockHashes()
+{
+	blockHashes.clear();
+	blockHashes.resize(blockStates.GetSize(), 0);
+
+	for_mt(0, blockStates.GetSize(), [&](const int blockIdx) {
+		blockHashes[blockIdx] = CalcBlockHash(blockIdx);
+	});
+}
+
+void CPathEstimator::MarkDirtyBlocks(const std::vector<std::uint32_t>& fileBlockHashes)
+{
+	offsetBlockIndices.clear();
+	costBlockIndices.clear();
+
+	const auto BlockChanged = [&](const int2 blockPos) {
+		if ((unsigned)blockPos.x >= nbrOfBlocks.x || (unsigned)blockPos.y >= nbrOfBlocks.y)
+			return false;
+
+		const unsigned int blockIdx = BlockPosToIdx(blockPos);
+		return (fileBlockHashes[blockIdx] != blockHashes[blockIdx]);
+	};
+
+	for (unsigned int blockIdx = 0; blockIdx < blockStates.GetSize(); blockIdx++) {
+		const int2 blockPos = BlockIdxToPos(blockIdx);
+
+		// offsets only depend on the block itself
+		if (BlockChanged(blockPos)) {
+			offsetBlockIndices.push_back(blockIdx);
+			costBlockIndices.push_back(blockIdx);
+			continue;
+		}
+
+		// costs also on the neighbours searched into, see CalcVertexPathCosts
+		for (const unsigned int pathDir: {PATHDIR_LEFT, PATHDIR_LEFT_UP, PATHDIR_UP, PATHDIR_RIGHT_UP}) {
+			if (!BlockChanged(blockPos + PE_DIRECTION_VECTORS[pathDir]))
+				continue;
+
+			costBlockIndices.push_back(blockIdx);
+			break;
+		}
+	}
 }
 
 
@@ -1115,23 +1461,67 @@ std::uint32_t CPathEstimator::CalcChecksum() const
 
 
 /**
- * Returns a hash-code identifying the dataset of this estimator.
+ * Returns a hash-code identifying the inputs shared by all blocks of this
+ * estimator; the map data itself is covered per block by CalcBlockHash.
  */
 std::uint32_t CPathEstimator::CalcHash(const char* caller) const
 {
-	const unsigned int hmChecksum = readMap->CalcHeightmapChecksum();
-	const unsigned int tmChecksum = readMap->CalcTypemapChecksum();
+	unsigned int ttChecksum = 0;
+
+	for (const CMapInfo::TerrainType& tt: mapInfo->terrainTypes) {
+		ttChecksum = HsiehHash(tt.name.c_str(), tt.name.size(), ttChecksum);
+		ttChecksum = HsiehHash(&tt.hardness, offsetof(CMapInfo::TerrainType, receiveTracks) - offsetof(CMapInfo::TerrainType, hardness), ttChecksum);
+	}
+
 	const unsigned int mdChecksum = moveDefHandler.GetCheckSum();
-	const unsigned int bmChecksum = groundBlockingObjectMap.CalcChecksum();
-	const unsigned int peHashCode = (hmChecksum + tmChecksum + mdChecksum + bmChecksum + BLOCK_SIZE + PATHESTIMATOR_VERSION);
+	const unsigned int peHashCode = (ttChecksum + mdChecksum + BLOCK_SIZE + PATHESTIMATOR_VERSION);
 
 	LOG("[PathEstimator::%s][%s] BLOCK_SIZE=%u", __func__, caller, BLOCK_SIZE);
 	LOG("[PathEstimator::%s][%s] PATHESTIMATOR_VERSION=%u", __func__, caller, PATHESTIMATOR_VERSION);
-	LOG("[PathEstimator::%s][%s] heightMapChecksum=%x", __func__, caller, hmChecksum);
-	LOG("[PathEstimator::%s][%s] typeMapChecksum=%x", __func__, caller, tmChecksum);
+	LOG("[PathEstimator::%s][%s] terrainTypesChecksum=%x", __func__, caller, ttChecksum);
 	LOG("[PathEstimator::%s][%s] moveDefChecksum=%x", __func__, caller, mdChecksum);
-	LOG("[PathEstimator::%s][%s] blockMapChecksum=%x", __func__, caller, bmChecksum);
 	LOG("[PathEstimator::%s][%s] estimatorHashCode=%x", __func__, caller, peHashCode);
 
 	return peHashCode;
 }
+
+/**
+ * Returns a hash over the heightmap, typemap and blocking-map data a
+ * block's offsets and costs are derived from (with a small margin).
+ */
+std::uint32_t CPathEstimator::CalcBlockHash(unsigned int blockIdx) const
+{
+	const int2 blockPos = BlockIdxToPos(blockIdx);
+
+	const int x1 = std::max(int(blockPos.x * BLOCK_SIZE) - BLOCK_HASH_MARGIN, 0);
+	const int z1 = std::max(int(blockPos.y * BLOCK_SIZE) - BLOCK_HASH_MARGIN, 0);
+	const int x2 = std::min(int((blockPos.x + 1) * BLOCK_SIZE) + BLOCK_HASH_MARGIN, mapDims.mapx);
+	const int z2 = std::min(int((blockPos.y + 1) * BLOCK_SIZE) + BLOCK_HASH_MARGIN, mapDims.mapy);
+
+	const float* cornerHeightMap = readMap->GetCornerHeightMapSynced();
+	const uint8_t* typeMap = readMap->GetTypeMapSynced();
+
+	std::uint32_t hash = 0;
+
+	// corners, so includes the row and column past (x2, z2)
+	for (int z = z1; z <= z2; z++) {
+		hash = HsiehHash(&cornerHeightMap[z * mapDims.mapxp1 + x1], (x2 - x1 + 1) * sizeof(float), hash);
+	}
+
+	for (int hz = z1 >> 1, hx1 = x1 >> 1, hx2 = (x2 - 1) >> 1; hz <= ((z2 - 1) >> 1); hz++) {
+		hash = HsiehHash(&typeMap[hz * mapDims.hmapx + hx1], (hx2 - hx1 + 1) * sizeof(uint8_t), hash);
+	}
+
+	for (int z = z1; z < z2; z++) {
+		for (int x = x1; x < x2; x++) {
+			const unsigned int sqr = z * mapDims.mapx + x;
+
+			if (groundBlockingObjectMap.GroundBlockedUnsafe(sqr) == nullptr)
+				continue;
+
+			hash = HsiehHash(&sqr, sizeof(sqr), hash);
+		}
+	}
+
+	return hash;
+}
@@ -5,7 +5,6 @@
 
 #include <atomic>
 #include <cinttypes>
-#include <deque>
 #include <string>
 #include <vector>
 
@@ -38,11 +37,27 @@ public:
 	 *   Name of the file on disk where pre-calculated data is stored.
 	 *   The name given are added to the end of the filename, after the
 	 *   name of the corresponding map.
-	 *   Ex. PE-name "pe" + Mapname "Desert" => "Desert.pe"
+	 *   Ex. PE-name "pe" + Mapname "Desert" => "Desert.pe.blocks"
+	 *
+	 * The file holds the data of every block along with a hash of the
+	 * map area it was calculated from, so only blocks whose inputs have
+	 * changed since it was written need to be recalculated.
 	 */
 	void Init(IPathFinder*, unsigned int BSIZE, const std::string& peFileName, const std::string& mapFileName);
 	void Kill();
 
+	/**
+	 * Turns this instance into a search-only view of <source> that can run
+	 * concurrently with other such views. The block offsets, vertex-costs
+	 * and path-caches of <source> are shared (and must not change while a
+	 * worker is searching); new cache entries are collected locally until
+	 * they are handed back via SwapDeferredCacheItems.
+	 *
+	 * @param parent
+	 *   The (worker) pathfinder to be used for block-searches.
+	 */
+	void InitSearchWorker(const CPathEstimator* source, IPathFinder* parent);
+
 	bool RemoveCacheFile(const std::string& peFileName, const std::string& mapFileName);
 
 
@@ -55,7 +70,8 @@ public:
 	void MapChanged(unsigned int x1, unsigned int z1, unsigned int x2, unsigned int z2);
 
 	/**
-	 * called every frame
+	 * called every frame; recalculates a bounded number of obsolete blocks,
+	 * those on frequently used paths (and those waiting longest) first
 	 */
 	void Update();
 
@@ -68,8 +84,39 @@ public:
 	std::uint32_t GetPathChecksum() const { return pathChecksum; }
 
 
+	struct QueuedBlock {
+		int2 blockPos;
+		// frame and order in which the block became obsolete, see Update
+		std::uint32_t frame;
+		std::uint32_t seqNum;
+	};
+
+	struct UpdateStats {
+		unsigned int numQueuedBlocks = 0;
+		// largest backlog over (roughly) the last BLOCK_USAGE_DECAY_RATE frames
+		unsigned int peakQueuedBlocks = 0;
+		unsigned int numUpdatedBlocks = 0;
+		// wall-clock time of the last update in milliseconds; informational only
+		float updateTime = 0.0f;
+	};
+
 	const std::vector<float>& GetVertexCosts() const { return vertexCosts; }
-	const std::deque<int2>& GetUpdatedBlocks() const { return updatedBlocks; }
+	const std::vector<QueuedBlock>& GetUpdatedBlocks() const { return updatedBlocks; }
+	const UpdateStats& GetUpdateStats() const { return updateStats; }
+
+
+	struct DeferredCacheItem {
+		CPathCache::CacheItem item;
+		bool synced;
+	};
+
+	/// moves the cache entries a search worker collected so far into <items>
+	void SwapDeferredCacheItems(std::vector<DeferredCacheItem>& items) {
+		items.clear();
+		items.swap(deferredCacheItems);
+	}
+	/// adds entries collected by a search worker to our own caches
+	void AddDeferredCacheItems(const std::vector<DeferredCacheItem>& items);
 
 
 protected: // IPathFinder impl
@@ -109,6 +156,12 @@ protected: // IPathFinder impl
 private:
 	void InitEstimator(const std::string& peFileName, const std::string& mapFileName);
 	void InitBlocks();
+	void InitUpdateHelpers();
+	void KillUpdateHelpers();
+
+	void QueueDirtyBlocks();
+	void SelectUpdateBlocks(unsigned int numBlocks);
+	void AddBlockUsage(const IPath::Path& path) const;
 
 	void CalcOffsetsAndPathCosts(unsigned int threadNum, spring::barrier* pathBarrier);
 	void CalculateBlockOffsets(unsigned int, unsigned int);
@@ -121,8 +174,12 @@ private:
 	bool ReadFile(const std::string& peFileName, const std::string& mapFileName);
 	bool WriteFile(const std::string& peFileName, const std::string& mapFileName);
 
+	void CalcBlockHashes();
+	void MarkDirtyBlocks(const std::vector<std::uint32_t>& fileBlockHashes);
+
 	std::uint32_t CalcChecksum() const;
 	std::uint32_t CalcHash(const char* caller) const;
+	std::uint32_t CalcBlockHash(unsigned int blockIdx) const;
 
 private:
 	friend class CPathManager;
@@ -145,13 +202,46 @@ private:
 	CPathEstimator* nextPathEstimator; // next lower-resolution estimator
 	CPathCache* pathCache[2]; // [0] = !synced, [1] = synced
 
-	std::vector<IPathFinder*> pathFinders; // InitEstimator helpers
+	// InitEstimator helpers, replaced by one instance per Update thread (see InitUpdateHelpers)
+	std::vector<IPathFinder*> pathFinders;
 	std::vector<spring::thread> threads;
 
 	std::vector<float> maxSpeedMods;
 	std::vector<float> vertexCosts;
+
+	// search workers read the costs of their source estimator
+	const std::vector<float>* sharedVertexCosts = &vertexCosts;
+	// cache entries added by a search worker, see SwapDeferredCacheItems
+	std::vector<DeferredCacheItem> deferredCacheItems;
+
+	bool searchWorker = false;
+
+	/// per-block hashes of the map data their offsets and costs depend on
+	std::vector<std::uint32_t> blockHashes;
+	/// blocks whose offsets resp. vertex-costs have to be (re)calculated by InitEstimator
+	std::vector<unsigned int> offsetBlockIndices;
+	std::vector<unsigned int> costBlockIndices;
+	struct DirtyRect {
+		// inclusive block coordinates
+		int x1, z1;
+		int x2, z2;
+	};
+
+	/// areas changed since the last Update, merged before being queued
+	std::vector<DirtyRect> dirtyRects;
 	/// blocks that may need an update due to map changes
-	std::deque<int2> updatedBlocks;
+	std::vector<QueuedBlock> updatedBlocks;
+
+	/// decaying number of synced cached paths (and cache-hits) through each block
+	mutable std::vector<std::uint16_t> blockUsage;
+
+	std::uint32_t updateFrame = 0;
+	std::uint32_t nextBlockSeqNum = 0;
+
+	UpdateStats updateStats;
+
+	unsigned int prevPeakQueuedBlocks = 0;
+	unsigned int currPeakQueuedBlocks = 0;
 
 	struct SOffsetBlock {
 		float cost;
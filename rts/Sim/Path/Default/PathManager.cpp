@@ -14,12 +14,39 @@
 #include "Sim/MoveTypes/MoveDefHandler.h"
 #include "System/Log/ILog.h"
 #include "System/TimeProfiler.h"
+#include "System/Threading/ThreadPool.h"
 
+#include <atomic>
+#include <deque>
+
+
+struct SearchWorker {
+	CPathFinder    maxResPF;
+	CPathEstimator medResPE;
+	CPathEstimator lowResPE;
+};
+
+struct QueuedRequest {
+	unsigned int pathID;
+
+	CPathManager::MultiPath* multiPath;
+
+	IPath::SearchResult result;
+
+	// cache entries produced while solving this request, applied in request order
+	std::vector<CPathEstimator::DeferredCacheItem> medResCacheItems;
+	std::vector<CPathEstimator::DeferredCacheItem> lowResCacheItems;
+};
 
 static CPathFinder    gMaxResPF;
 static CPathEstimator gMedResPE;
 static CPathEstimator gLowResPE;
 
+// one set of search-instances per thread for queued requests, only
+// created if modInfo.pfAsyncRequests is enabled
+static std::deque<SearchWorker> gSearchWorkers;
+static std::vector<QueuedRequest> gQueuedRequests;
+
 
 CPathManager::CPathManager()
 : maxResPF(nullptr)
@@ -36,6 +63,7 @@ CPathManager::CPathManager()
 	pathHeatMap = PathHeatMap::GetInstance();
 
 	pathMap.reserve(1024);
+	queuedRequests.reserve(256);
 
 	// PathNode::nodePos is an ushort2, PathNode::nodeNum is an int
 	// therefore the maximum map size is limited to 64k*64k squares
@@ -46,6 +74,12 @@ CPathManager::~CPathManager()
 {
 	// Finalize is not called in case of forced exit
 	if (maxResPF != nullptr) {
+		for (SearchWorker& sw: gSearchWorkers) {
+			sw.lowResPE.Kill();
+			sw.medResPE.Kill();
+			sw.maxResPF.Kill();
+		}
+
 		lowResPE->Kill();
 		medResPE->Kill();
 		maxResPF->Kill();
@@ -55,6 +89,11 @@ CPathManager::~CPathManager()
 		lowResPE = nullptr;
 	}
 
+	gSearchWorkers.clear();
+	gQueuedRequests.clear();
+
+	flowFields.Kill();
+
 	PathHeatMap::FreeInstance(pathHeatMap);
 	PathFlowMap::FreeInstance(pathFlowMap);
 	IPathFinder::KillStatic();
@@ -87,10 +126,37 @@ std::int64_t CPathManager::Finalize() {
 		lowResPE->Init(medResPE, LOWRES_PE_BLOCKSIZE, "pe2", mapInfo->map.name);
 	}
 
+	if (modInfo.pfAsyncRequests)
+		InitSearchWorkers();
+	if (modInfo.pfFlowFields)
+		flowFields.Init(this);
+
 	const spring_time dt = spring_gettime() - t0;
 	return (dt.toMilliSecsi());
 }
 
+void CPathManager::InitSearchWorkers()
+{
+	for (int i = 0, n = ThreadPool::GetNumThreads(); i < n; i++) {
+		gSearchWorkers.emplace_back();
+
+		SearchWorker& sw = gSearchWorkers.back();
+
+		// workers share all per-block data with the main instances, and
+		// only own the search state (costs, masks, open-lists) themselves
+		sw.maxResPF.Init(true);
+		sw.maxResPF.ShareNodeStates(maxResPF);
+		sw.medResPE.InitSearchWorker(medResPE, &sw.maxResPF);
+		sw.lowResPE.InitSearchWorker(lowResPE, &sw.medResPE);
+	}
+
+	LOG("[PathManager::%s] created %u search-workers for queued path-requests", __func__, unsigned(gSearchWorkers.size()));
+}
+
+CPathManager::PathFinderSet CPathManager::GetPathFinders() const {
+	return {{lowResPE, medResPE, maxResPF}};
+}
+
 
 void CPathManager::FinalizePath(MultiPath* path, const float3 startPos, const float3 goalPos, const bool cantGetCloser)
 {
@@ -130,6 +196,7 @@ void CPathManager::FinalizePath(MultiPath* path, const float3 startPos, const fl
 
 
 IPath::SearchResult CPathManager::ArrangePath(
+	const PathFinderSet& pathFinders,
 	MultiPath* newPath,
 	const MoveDef* moveDef,
 	const float3& startPos,
@@ -158,7 +225,6 @@ IPath::SearchResult CPathManager::ArrangePath(
 	constexpr bool useConstraints[] = {false, false, false};
 	constexpr bool allowRawSearch[] = {false, false, false};
 
-	IPathFinder* pathFinders[] = {lowResPE, medResPE, maxResPF};
 	IPath::Path* pathObjects[] = {&newPath->lowResPath, &newPath->medResPath, &newPath->maxResPath};
 
 	IPath::SearchResult bestResult = IPath::Error;
@@ -372,23 +438,61 @@ unsigned int CPathManager::RequestPath(
 	goalRadius = std::max<float>(goalRadius, PATH_NODE_SPACING * SQUARE_SIZE); //FIXME do on a per PE & PF level?
 	assert(moveDef == moveDefHandler.GetMoveDefByPathType(moveDef->pathType));
 
+	// units ordered to the same goal in large numbers share a flow-field
+	if (synced && caller != nullptr) {
+		const unsigned int fieldPathID = flowFields.RequestPath(caller, moveDef, startPos, goalPos, goalRadius);
+
+		if (fieldPathID != 0)
+			return fieldPathID;
+	}
+
 	MultiPath newPath = MultiPath(moveDef, startPos, goalPos, goalRadius);
 	newPath.finalGoal = goalPos;
 	newPath.caller = caller;
 	newPath.peDef.synced = synced;
 
+	// synced unit requests can be deferred to the start of the next frame
+	// (Lua and AI callers expect an immediate answer); until then the ID
+	// maps to a placeholder for which NextWayPoint returns temporary points
+	if (synced && caller != nullptr && !gSearchWorkers.empty()) {
+		newPath.queued = true;
+
+		queuedRequests.push_back(Store(newPath));
+		return queuedRequests.back();
+	}
+
 	if (caller != nullptr)
 		caller->UnBlock();
 
-	const IPath::SearchResult result = ArrangePath(&newPath, moveDef, startPos, goalPos, caller);
+	const IPath::SearchResult result = SolvePath(GetPathFinders(), newPath);
 
 	unsigned int pathID = 0;
 
+	if (result != IPath::Error)
+		pathID = Store(newPath);
+
+	if (caller != nullptr)
+		caller->Block();
+
+	return pathID;
+}
+
+
+IPath::SearchResult CPathManager::SolvePath(const PathFinderSet& pathFinders, MultiPath& newPath) const
+{
+	const float3& startPos = newPath.start;
+	const float3& goalPos = newPath.finalGoal;
+
+	CSolidObject* caller = newPath.caller;
+
+	const bool synced = newPath.peDef.synced;
+	const IPath::SearchResult result = ArrangePath(pathFinders, &newPath, newPath.moveDef, startPos, goalPos, caller);
+
 	if (result != IPath::Error) {
 		if (newPath.maxResPath.path.empty()) {
 			if (result != IPath::CantGetCloser) {
-				LowRes2MedRes(newPath, startPos, caller, synced);
-				MedRes2MaxRes(newPath, startPos, caller, synced);
+				LowRes2MedRes(pathFinders, newPath, startPos, caller, synced);
+				MedRes2MaxRes(pathFinders, newPath, startPos, caller, synced);
 			} else {
 				// add one dummy waypoint so that the calling MoveType
 				// does not consider this request a failure, which can
@@ -404,18 +508,14 @@ unsigned int CPathManager::RequestPath(
 
 		FinalizePath(&newPath, startPos, goalPos, result == IPath::CantGetCloser);
 		newPath.searchResult = result;
-		pathID = Store(newPath);
 	}
 
-	if (caller != nullptr)
-		caller->Block();
-
-	return pathID;
+	return result;
 }
 
 
 // converts part of a med-res path into a max-res path
-void CPathManager::MedRes2MaxRes(MultiPath& multiPath, const float3& startPos, const CSolidObject* owner, bool synced) const
+void CPathManager::MedRes2MaxRes(const PathFinderSet& pathFinders, MultiPath& multiPath, const float3& startPos, const CSolidObject* owner, bool synced) const
 {
 	assert(IsFinalized());
 
@@ -448,7 +548,7 @@ void CPathManager::MedRes2MaxRes(MultiPath& multiPath, const float3& startPos, c
 	// Perform the search.
 	// If this is the final improvement of the path, then use the original goal.
 	const auto& pfd = (medResPath.path.empty() && lowResPath.path.empty()) ? multiPath.peDef : rangedGoalDef;
-	const IPath::SearchResult result = maxResPF->GetPath(*multiPath.moveDef, pfd, owner, startPos, maxResPath, MAX_SEARCHED_NODES_ON_REFINE);
+	const IPath::SearchResult result = pathFinders[2]->GetPath(*multiPath.moveDef, pfd, owner, startPos, maxResPath, MAX_SEARCHED_NODES_ON_REFINE);
 
 	// If no refined path could be found, set goal as desired goal.
 	if (result == IPath::CantGetCloser || result == IPath::Error) {
@@ -457,7 +557,7 @@ void CPathManager::MedRes2MaxRes(MultiPath& multiPath, const float3& startPos, c
 }
 
 // converts part of a low-res path into a med-res path
-void CPathManager::LowRes2MedRes(MultiPath& multiPath, const float3& startPos, const CSolidObject* owner, bool synced) const
+void CPathManager::LowRes2MedRes(const PathFinderSet& pathFinders, MultiPath& multiPath, const float3& startPos, const CSolidObject* owner, bool synced) const
 {
 	assert(IsFinalized());
 
@@ -487,7 +587,7 @@ void CPathManager::LowRes2MedRes(MultiPath& multiPath, const float3& startPos, c
 	// Perform the search.
 	// If there is no low-res path left, use original goal.
 	const auto& pfd = (lowResPath.path.empty()) ? multiPath.peDef : rangedGoalDef;
-	const IPath::SearchResult result = medResPE->GetPath(*multiPath.moveDef, pfd, owner, startPos, medResPath, MAX_SEARCHED_NODES_ON_REFINE);
+	const IPath::SearchResult result = pathFinders[1]->GetPath(*multiPath.moveDef, pfd, owner, startPos, medResPath, MAX_SEARCHED_NODES_ON_REFINE);
 
 	// If no refined path could be found, set goal as desired goal.
 	if (result == IPath::CantGetCloser || result == IPath::Error) {
@@ -519,12 +619,23 @@ float3 CPathManager::NextWayPoint(
 	if (pathID == 0)
 		return noPathPoint;
 
+	if (CFlowFieldCache::IsFieldPathID(pathID))
+		return (flowFields.NextWayPoint(owner, pathID, numRetries, callerPos, radius, synced));
+
 	// find corresponding multipath entry
 	MultiPath* multiPath = GetMultiPath(pathID);
 
 	if (multiPath == nullptr)
 		return noPathPoint;
 
+	if (multiPath->queued) {
+		// request is solved at the start of the next frame; set the unit off
+		// toward its goal in the meantime (y=-1 marks this as a temporary
+		// waypoint which GMT does not follow religiously, as for QTPFS)
+		const float3 goalDir = (multiPath->finalGoal - callerPos).SafeNormalize() * SQUARE_SIZE;
+		return float3(callerPos.x + goalDir.x, -1.0f, callerPos.z + goalDir.z);
+	}
+
 	if (numRetries > MAX_PATH_REFINEMENT_DEPTH)
 		return (multiPath->finalGoal);
 
@@ -550,9 +661,9 @@ float3 CPathManager::NextWayPoint(
 			multiPath->caller->UnBlock();
 
 		if (extendMedResPath)
-			LowRes2MedRes(*multiPath, callerPos, owner, synced);
+			LowRes2MedRes(GetPathFinders(), *multiPath, callerPos, owner, synced);
 
-		MedRes2MaxRes(*multiPath, callerPos, owner, synced);
+		MedRes2MaxRes(GetPathFinders(), *multiPath, callerPos, owner, synced);
 
 		if (multiPath->caller != nullptr)
 			multiPath->caller->Block();
@@ -594,7 +705,6 @@ float3 CPathManager::NextWayPoint(
 	} while ((callerPos.SqDistance2D(waypoint) < Square(radius)) && (waypoint != maxResPath.pathGoal));
 
 	// y=0 indicates this is not a temporary waypoint
-	// (the default PFS does not queue path-requests)
 	return (waypoint * XZVector);
 }
 
@@ -604,6 +714,7 @@ void CPathManager::TerrainChange(unsigned int x1, unsigned int z1, unsigned int
 	if (!IsFinalized())
 		return;
 
+	flowFields.TerrainChange(x1, z1, x2, z2);
 	medResPE->MapChanged(x1, z1, x2, z2);
 
 	// low-res PE will be informed via (medRes)PE::Update
@@ -625,6 +736,75 @@ void CPathManager::Update()
 
 	medResPE->Update();
 	lowResPE->Update();
+
+	// must run after the estimator updates, workers read their data
+	ProcessQueuedRequests();
+
+	flowFields.Update();
+}
+
+void CPathManager::ProcessQueuedRequests()
+{
+	if (queuedRequests.empty())
+		return;
+
+	SCOPED_TIMER("Sim::Path::QueuedRequests");
+
+	gQueuedRequests.clear();
+	gQueuedRequests.reserve(queuedRequests.size());
+
+	for (const unsigned int pathID: queuedRequests) {
+		MultiPath* multiPath = GetMultiPath(pathID);
+
+		// path was deleted (e.g. its owner died) before being solved
+		if (multiPath == nullptr)
+			continue;
+
+		gQueuedRequests.push_back({pathID, multiPath, IPath::Error, {}, {}});
+	}
+
+	queuedRequests.clear();
+
+	{
+		std::atomic<unsigned int> nextRequestIdx = {0};
+
+		// no path is added to or removed from pathMap while workers run, so
+		// the MultiPath pointers stay valid; each worker is used by exactly
+		// one thread and requests are handed out dynamically for balancing
+		for_mt(0, gSearchWorkers.size(), [&](const int workerIdx) {
+			SearchWorker& sw = gSearchWorkers[workerIdx];
+
+			const PathFinderSet pathFinders = {{&sw.lowResPE, &sw.medResPE, &sw.maxResPF}};
+
+			for (unsigned int n = nextRequestIdx.fetch_add(1); n < gQueuedRequests.size(); n = nextRequestIdx.fetch_add(1)) {
+				QueuedRequest& qr = gQueuedRequests[n];
+
+				// the owner is not unblocked here (not thread-safe), instead
+				// searches ignore it since they pass it along as collider
+				qr.result = SolvePath(pathFinders, *qr.multiPath);
+
+				sw.medResPE.SwapDeferredCacheItems(qr.medResCacheItems);
+				sw.lowResPE.SwapDeferredCacheItems(qr.lowResCacheItems);
+			}
+		});
+	}
+
+	// deliver results in request order, independent of thread scheduling
+	for (QueuedRequest& qr: gQueuedRequests) {
+		medResPE->AddDeferredCacheItems(qr.medResCacheItems);
+		lowResPE->AddDeferredCacheItems(qr.lowResCacheItems);
+
+		qr.multiPath->queued = false;
+	}
+
+	// failed requests behave like an immediate RequestPath returning 0 would
+	// (erasing can move other entries, so this is done in a separate pass)
+	for (const QueuedRequest& qr: gQueuedRequests) {
+		if (qr.result != IPath::Error)
+			continue;
+
+		DeletePath(qr.pathID);
+	}
 }
 
 // used to deposit heat on the heat-map as a unit moves along its path
@@ -633,7 +813,7 @@ void CPathManager::UpdatePath(const CSolidObject* owner, unsigned int pathID)
 	assert(IsFinalized());
 
 	pathFlowMap->AddFlow(owner);
-	pathHeatMap->AddHeat(owner, this, pathID);
+	pathHeatMap->AddHeat(owner, this, flowFields.GetBackingPathID(pathID));
 }
 
 
@@ -689,6 +869,11 @@ void CPathManager::GetPathWayPoints(
 	points.clear();
 	starts.clear();
 
+	if (CFlowFieldCache::IsFieldPathID(pathID)) {
+		flowFields.GetPathWayPoints(pathID, points, starts);
+		return;
+	}
+
 	const MultiPath* multiPath = GetMultiPathConst(pathID);
 
 	if (multiPath == nullptr)
@@ -781,10 +966,61 @@ int2 CPathManager::GetNumQueuedUpdates() const {
 	int2 data;
 
 	if (IsFinalized()) {
-		data.x = medResPE->updatedBlocks.size();
-		data.y = lowResPE->updatedBlocks.size();
+		data.x = medResPE->GetUpdateStats().numQueuedBlocks;
+		data.y = lowResPE->GetUpdateStats().numQueuedBlocks;
 	}
 
 	return data;
 }
 
+int2 CPathManager::GetPeakQueuedUpdates() const {
+	int2 data;
+
+	if (IsFinalized()) {
+		data.x = medResPE->GetUpdateStats().peakQueuedBlocks;
+		data.y = lowResPE->GetUpdateStats().peakQueuedBlocks;
+	}
+
+	return data;
+}
+
+float CPathManager::GetQueuedUpdateTime() const {
+	if (!IsFinalized())
+		return 0.0f;
+
+	return (medResPE->GetUpdateStats().updateTime + lowResPE->GetUpdateStats().updateTime);
+}
+
+
+
+
+unsigned int CPathManager::GetFlowFieldBlockSize() const {
+	return MEDRES_PE_BLOCKSIZE;
+}
+
+float CPathManager::GetFlowFieldEdgeCost(const MoveDef& moveDef, int2 blockPos, int2 blockDir) const {
+	const int2 numBlocks = medResPE->GetNumBlocks();
+	const int2 ngbBlockPos = blockPos + blockDir;
+
+	if (static_cast<unsigned int>(ngbBlockPos.x) >= numBlocks.x || static_cast<unsigned int>(ngbBlockPos.y) >= numBlocks.y)
+		return PATHCOST_INFINITY;
+
+	unsigned int pathDir = 0;
+
+	while (pathDir < PATH_DIRECTIONS && PE_DIRECTION_VECTORS[pathDir] != blockDir)
+		pathDir++;
+
+	assert(pathDir < PATH_DIRECTIONS);
+
+	// same lookup as CPathEstimator::TestBlock; costs are bi-directional
+	const unsigned int vertexCostIdx =
+		moveDef.pathType * numBlocks.x * numBlocks.y * PATH_DIRECTION_VERTICES +
+		medResPE->BlockPosToIdx(blockPos) * PATH_DIRECTION_VERTICES +
+		GetBlockVertexOffset(pathDir, numBlocks.x);
+
+	return (medResPE->GetVertexCosts()[vertexCostIdx]);
+}
+
+int2 CPathManager::GetFlowFieldBlockNode(const MoveDef& moveDef, int2 blockPos) const {
+	return (medResPE->GetNodeStateBuffer().peNodeOffsets[moveDef.pathType][medResPE->BlockPosToIdx(blockPos)]);
+}
@@ -3,7 +3,9 @@
 #ifndef PATHMANAGER_H
 #define PATHMANAGER_H
 
+#include <array>
 #include <cinttypes>
+#include <vector>
 
 #include "Sim/Path/IPathManager.h"
 #include "IPath.h"
@@ -16,6 +18,7 @@ class CPathEstimator;
 class PathFlowMap;
 class PathHeatMap;
 class CPathFinderDef;
+class IPathFinder;
 struct MoveDef;
 
 class CPathManager: public IPathManager {
@@ -47,6 +50,7 @@ public:
 			peDef   = mp.peDef;
 			moveDef = mp.moveDef;
 			caller  = mp.caller;
+			queued  = mp.queued;
 
 			mp.moveDef = nullptr;
 			mp.caller  = nullptr;
@@ -70,8 +74,14 @@ public:
 
 		// additional information
 		CSolidObject* caller;
+
+		// true until the request is solved by ProcessQueuedRequests
+		bool queued = false;
 	};
 
+	// {lowResPE, medResPE, maxResPF}, either the main instances or those of a search-worker
+	typedef std::array<IPathFinder*, 3> PathFinderSet;
+
 public:
 	CPathManager();
 	~CPathManager();
@@ -81,6 +91,10 @@ public:
 
 	std::int64_t Finalize() override;
 
+	bool PathUpdated(unsigned int pathID) override {
+		return (CFlowFieldCache::IsFieldPathID(pathID) && flowFields.PathUpdated(pathID));
+	}
+
 	void RemoveCacheFiles() override;
 	void Update() override;
 	void UpdatePath(const CSolidObject*, unsigned int) override;
@@ -88,6 +102,11 @@ public:
 		if (pathID == 0)
 			return;
 
+		if (CFlowFieldCache::IsFieldPathID(pathID)) {
+			flowFields.DeletePath(pathID);
+			return;
+		}
+
 		const auto pi = pathMap.find(pathID);
 
 		if (pi == pathMap.end())
@@ -144,6 +163,13 @@ public:
 	const float* GetNodeExtraCosts(bool) const override;
 
 	int2 GetNumQueuedUpdates() const override;
+	int2 GetPeakQueuedUpdates() const override;
+	float GetQueuedUpdateTime() const override;
+
+	// the coarse flow-field parts use the med-res estimator's blocks
+	unsigned int GetFlowFieldBlockSize() const override;
+	float GetFlowFieldEdgeCost(const MoveDef& moveDef, int2 blockPos, int2 blockDir) const override;
+	int2 GetFlowFieldBlockNode(const MoveDef& moveDef, int2 blockPos) const override;
 
 
 	const CPathFinder* GetMaxResPF() const { return maxResPF; }
@@ -157,12 +183,19 @@ public:
 
 private:
 	IPath::SearchResult ArrangePath(
+		const PathFinderSet& pathFinders,
 		MultiPath* newPath,
 		const MoveDef* moveDef,
 		const float3& startPos,
 		const float3& goalPos,
 		CSolidObject* caller
 	) const;
+	IPath::SearchResult SolvePath(const PathFinderSet& pathFinders, MultiPath& newPath) const;
+
+	void InitSearchWorkers();
+	void ProcessQueuedRequests();
+
+	PathFinderSet GetPathFinders() const;
 
 	MultiPath* GetMultiPath(int pathID) { return (const_cast<MultiPath*>(GetMultiPathConst(pathID))); }
 
@@ -181,8 +214,8 @@ private:
 
 	static void FinalizePath(MultiPath* path, const float3 startPos, const float3 goalPos, const bool cantGetCloser);
 
-	void LowRes2MedRes(MultiPath& path, const float3& startPos, const CSolidObject* owner, bool synced) const;
-	void MedRes2MaxRes(MultiPath& path, const float3& startPos, const CSolidObject* owner, bool synced) const;
+	void LowRes2MedRes(const PathFinderSet& pathFinders, MultiPath& path, const float3& startPos, const CSolidObject* owner, bool synced) const;
+	void MedRes2MaxRes(const PathFinderSet& pathFinders, MultiPath& path, const float3& startPos, const CSolidObject* owner, bool synced) const;
 
 	bool IsFinalized() const { return (maxResPF != nullptr); }
 
@@ -196,6 +229,9 @@ private:
 
 	spring::unordered_map<unsigned int, MultiPath> pathMap;
 
+	// IDs of synced unit requests to be solved at the start of the next frame
+	std::vector<unsigned int> queuedRequests;
+
 	unsigned int nextPathID;
 };
 
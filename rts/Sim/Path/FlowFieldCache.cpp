@@ -0,0 +1,652 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+
+#include "FlowFieldCache.h"
+#include "IPathManager.h"
+#include "Map/ReadMap.h"
+#include "Sim/Misc/GlobalConstants.h"
+#include "Sim/Misc/GlobalSynced.h"
+#include "Sim/MoveTypes/MoveDefHandler.h"
+#include "Sim/MoveTypes/MoveMath/MoveMath.h"
+#include "System/SpringMath.h"
+
+
+// minimum number of same-frame requests toward one goal before they share a field
+static constexpr unsigned int MIN_GROUP_SIZE = 8;
+static constexpr unsigned int MAX_FLOW_FIELDS = 16;
+
+// half-size (in squares) of the per-square window around the goal
+static constexpr int FIELD_WINDOW_RADIUS = 32;
+// number of squares NextWayPoint can look ahead in the per-square window
+static constexpr int FIELD_LOOKAHEAD_SQUARES = 8;
+static constexpr float FIELD_MIN_WAYPOINT_DIST = SQUARE_SIZE * 4.0f;
+
+// dirty fields are recalculated at most this often
+static constexpr int FIELD_UPDATE_RATE = GAME_SPEED;
+// fields without users are kept around this long for reuse
+static constexpr int FIELD_IDLE_FRAMES = GAME_SPEED * 10;
+
+static constexpr float FIELD_COST_INFINITY = std::numeric_limits<float>::infinity();
+
+// opposite directions are 4 apart, BLOCK_DIRS[(d + 4) % 8] == -BLOCK_DIRS[d]
+static constexpr int2 BLOCK_DIRS[] = {
+	{+1,  0},
+	{+1, +1},
+	{ 0, +1},
+	{-1, +1},
+	{-1,  0},
+	{-1, -1},
+	{ 0, -1},
+	{+1, -1},
+};
+static constexpr std::uint8_t NO_BLOCK_DIR = 8;
+
+
+typedef std::pair<float, unsigned int> OpenNode;
+typedef std::priority_queue<OpenNode, std::vector<OpenNode>, std::greater<OpenNode>> OpenQueue;
+
+
+static std::uint64_t GetGroupKey(const MoveDef* moveDef, const float3& goalPos, float goalRadius)
+{
+	const std::uint64_t goalX = goalPos.x / SQUARE_SIZE;
+	const std::uint64_t goalZ = goalPos.z / SQUARE_SIZE;
+	const std::uint64_t radius = std::min(goalRadius / SQUARE_SIZE, 65535.0f);
+
+	return ((std::uint64_t(moveDef->pathType) << 48) | (goalX << 32) | (goalZ << 16) | radius);
+}
+
+static float3 SquareToPos(const int2 square) {
+	return {square.x * SQUARE_SIZE * 1.0f, 0.0f, square.y * SQUARE_SIZE * 1.0f};
+}
+
+
+
+void CFlowFieldCache::Init(IPathManager* pm)
+{
+	manager = pm;
+
+	blockSize = pm->GetFlowFieldBlockSize();
+	numBlocks = {int(mapDims.mapx / blockSize), int(mapDims.mapy / blockSize)};
+
+	fields.clear();
+	fields.resize(MAX_FLOW_FIELDS);
+	fieldPaths.clear();
+	fieldPaths.reserve(1024);
+	groupRequests.clear();
+
+	nextPathID = 0;
+
+	lastRequestFrame = -1;
+	lastUpdateFrame = 0;
+}
+
+void CFlowFieldCache::Kill()
+{
+	manager = nullptr;
+
+	fields.clear();
+	fieldPaths.clear();
+	groupRequests.clear();
+}
+
+
+void CFlowFieldCache::Update()
+{
+	if (manager == nullptr)
+		return;
+
+	if ((gs->frameNum - lastUpdateFrame) >= FIELD_UPDATE_RATE) {
+		lastUpdateFrame = gs->frameNum;
+
+		for (unsigned int n = 0; n < fields.size(); n++) {
+			FlowField& ff = fields[n];
+
+			if (!ff.dirty)
+				continue;
+
+			if (ff.numUsers == 0) {
+				EvictField(n);
+				continue;
+			}
+
+			CalcField(ff);
+		}
+	}
+
+	for (unsigned int n = 0; n < fields.size(); n++) {
+		const FlowField& ff = fields[n];
+
+		if (ff.moveDef == nullptr || ff.numUsers != 0)
+			continue;
+		if ((gs->frameNum - ff.lastRequestFrame) <= FIELD_IDLE_FRAMES)
+			continue;
+
+		EvictField(n);
+	}
+}
+
+void CFlowFieldCache::TerrainChange(unsigned int x1, unsigned int z1, unsigned int x2, unsigned int z2)
+{
+	// the coarse part spans the whole map, so any change can affect a field
+	for (FlowField& ff: fields) {
+		ff.dirty |= (ff.moveDef != nullptr);
+	}
+}
+
+
+
+unsigned int CFlowFieldCache::RequestPath(
+	CSolidObject* caller,
+	const MoveDef* moveDef,
+	float3 startPos,
+	float3 goalPos,
+	float goalRadius
+) {
+	if (manager == nullptr || requestingFallback)
+		return 0;
+
+	startPos.ClampInBounds();
+	goalPos.ClampInBounds();
+
+	// short paths are cheap and more precise when searched per unit
+	if (startPos.SqDistance2D(goalPos) < Square(blockSize * SQUARE_SIZE * 2.0f))
+		return 0;
+
+	if (lastRequestFrame != gs->frameNum) {
+		groupRequests.clear();
+		lastRequestFrame = gs->frameNum;
+	}
+
+	const std::uint64_t groupKey = GetGroupKey(moveDef, goalPos, goalRadius);
+	const unsigned int numRequests = ++groupRequests[groupKey];
+
+	unsigned int fieldSlot = 0;
+
+	// join an existing field for this group, or create one if enough units want it
+	for (; fieldSlot < fields.size(); fieldSlot++) {
+		if (fields[fieldSlot].moveDef != nullptr && fields[fieldSlot].key == groupKey)
+			break;
+	}
+
+	if (fieldSlot == fields.size()) {
+		if (numRequests < MIN_GROUP_SIZE)
+			return 0;
+
+		CalcField(fields[fieldSlot = AllocField(groupKey, moveDef, goalPos, goalRadius)]);
+	}
+
+	FlowField& ff = fields[fieldSlot];
+
+	ff.numUsers += 1;
+	ff.lastRequestFrame = gs->frameNum;
+
+	const unsigned int pathID = (++nextPathID & ~FIELD_PATH_ID_BIT) | FIELD_PATH_ID_BIT;
+
+	fieldPaths[pathID] = {fieldSlot, ff.fieldID, ff.version, 0, caller, moveDef, startPos, goalPos, goalRadius, false};
+	return pathID;
+}
+
+float3 CFlowFieldCache::NextWayPoint(
+	const CSolidObject* owner,
+	unsigned int pathID,
+	unsigned int numRetries,
+	float3 callerPos,
+	float radius,
+	bool synced
+) {
+	const float3 noPathPoint = -XZVector;
+	const auto iter = fieldPaths.find(pathID);
+
+	if (iter == fieldPaths.end())
+		return noPathPoint;
+
+	FieldPath& fp = iter->second;
+
+	if (fp.fallbackPathID != 0)
+		return (manager->NextWayPoint(owner, fp.fallbackPathID, numRetries, callerPos, radius, synced));
+
+	if (callerPos == ZeroVector)
+		callerPos = fp.startPos;
+
+	const FlowField* ff = GetField(fp);
+
+	if (ff != nullptr) {
+		float3 wayPoint;
+
+		if (callerPos.SqDistance2D(ff->goalPos) <= Square(ff->goalRadius))
+			return (ff->goalPos * XZVector);
+
+		if (SampleSquares(*ff, callerPos, radius, wayPoint))
+			return wayPoint;
+		if (SampleBlocks(*ff, callerPos, radius, wayPoint))
+			return wayPoint;
+	}
+
+	// field was evicted or does not reach callerPos; requesting
+	// a path changes state that affects later requests so this
+	// is not possible when unsynced
+	if (!synced)
+		return noPathPoint;
+	if (RequestFallbackPath(fp, callerPos) == 0)
+		return noPathPoint;
+
+	return (manager->NextWayPoint(owner, fp.fallbackPathID, numRetries, callerPos, radius, synced));
+}
+
+
+void CFlowFieldCache::DeletePath(unsigned int pathID)
+{
+	const auto iter = fieldPaths.find(pathID);
+
+	if (iter == fieldPaths.end())
+		return;
+
+	FieldPath& fp = iter->second;
+	FlowField* ff = GetField(fp);
+
+	if (fp.fallbackPathID != 0)
+		manager->DeletePath(fp.fallbackPathID);
+
+	if (ff != nullptr)
+		ff->numUsers -= 1;
+
+	fieldPaths.erase(iter);
+}
+
+bool CFlowFieldCache::PathUpdated(unsigned int pathID)
+{
+	const auto iter = fieldPaths.find(pathID);
+
+	if (iter == fieldPaths.end())
+		return false;
+
+	FieldPath& fp = iter->second;
+
+	if (fp.fallbackPathID != 0)
+		return (manager->PathUpdated(fp.fallbackPathID));
+
+	const FlowField* ff = GetField(fp);
+
+	// report eviction once, so the owner asks for new waypoints (and gets a fallback path)
+	if (ff == nullptr) {
+		const bool ret = !fp.evicted;
+		fp.evicted = true;
+		return ret;
+	}
+
+	if (fp.fieldVersion == ff->version)
+		return false;
+
+	fp.fieldVersion = ff->version;
+	return true;
+}
+
+void CFlowFieldCache::GetPathWayPoints(unsigned int pathID, std::vector<float3>& points, std::vector<int>& starts) const
+{
+	points.clear();
+	starts.clear();
+
+	const auto iter = fieldPaths.find(pathID);
+
+	if (iter == fieldPaths.end())
+		return;
+
+	const FieldPath& fp = iter->second;
+
+	if (fp.fallbackPathID != 0) {
+		manager->GetPathWayPoints(fp.fallbackPathID, points, starts);
+		return;
+	}
+
+	const FlowField* ff = GetField(fp);
+
+	if (ff == nullptr)
+		return;
+
+	// trace the field from the original start, all points count as max-res
+	float3 pos = fp.startPos;
+	float3 wayPoint;
+
+	for (unsigned int n = 0; n < 1024; n++) {
+		if (pos.SqDistance2D(ff->goalPos) <= Square(ff->goalRadius))
+			break;
+		if (!SampleSquares(*ff, pos, 0.0f, wayPoint) && !SampleBlocks(*ff, pos, 0.0f, wayPoint))
+			break;
+		if (wayPoint == pos)
+			break;
+
+		points.push_back(pos = wayPoint);
+	}
+
+	starts.resize(3, points.size());
+	starts[0] = 0;
+}
+
+unsigned int CFlowFieldCache::GetBackingPathID(unsigned int pathID) const
+{
+	if (!IsFieldPathID(pathID))
+		return pathID;
+
+	const auto iter = fieldPaths.find(pathID);
+
+	if (iter == fieldPaths.end())
+		return 0;
+
+	return ((iter->second).fallbackPathID);
+}
+
+unsigned int CFlowFieldCache::GetNumFields() const
+{
+	return (std::count_if(fields.begin(), fields.end(), [](const FlowField& ff) { return (ff.moveDef != nullptr); }));
+}
+
+
+
+CFlowFieldCache::FlowField* CFlowFieldCache::GetField(const FieldPath& fp)
+{
+	return (const_cast<FlowField*>(static_cast<const CFlowFieldCache*>(this)->GetField(fp)));
+}
+
+const CFlowFieldCache::FlowField* CFlowFieldCache::GetField(const FieldPath& fp) const
+{
+	if (fp.fieldSlot >= fields.size())
+		return nullptr;
+	if (fields[fp.fieldSlot].fieldID != fp.fieldID)
+		return nullptr;
+
+	return &fields[fp.fieldSlot];
+}
+
+
+unsigned int CFlowFieldCache::AllocField(std::uint64_t key, const MoveDef* moveDef, const float3& goalPos, float goalRadius)
+{
+	unsigned int fieldSlot = 0;
+
+	// prefer an unused slot, otherwise evict the least recently requested field
+	for (unsigned int n = 0; n < fields.size(); n++) {
+		if (fields[n].numUsers == 0) {
+			fieldSlot = n;
+			break;
+		}
+
+		if (fields[n].lastRequestFrame < fields[fieldSlot].lastRequestFrame)
+			fieldSlot = n;
+	}
+
+	EvictField(fieldSlot);
+
+	FlowField& ff = fields[fieldSlot];
+
+	ff.key = key;
+	ff.moveDef = moveDef;
+	ff.goalPos = goalPos;
+	ff.goalRadius = goalRadius;
+	ff.lastRequestFrame = gs->frameNum;
+
+	return fieldSlot;
+}
+
+void CFlowFieldCache::EvictField(unsigned int fieldSlot)
+{
+	FlowField& ff = fields[fieldSlot];
+
+	// invalidates all FieldPath's referring to this field
+	ff.fieldID += 1;
+	ff.version = 0;
+
+	ff.key = 0;
+	ff.moveDef = nullptr;
+	ff.numUsers = 0;
+	ff.dirty = false;
+}
+
+
+void CFlowFieldCache::CalcField(FlowField& ff)
+{
+	CalcBlockCosts(ff);
+	CalcSquareCosts(ff);
+
+	ff.version += 1;
+	ff.dirty = false;
+}
+
+void CFlowFieldCache::CalcBlockCosts(FlowField& ff)
+{
+	const MoveDef& moveDef = *ff.moveDef;
+
+	const int2 goalBlock = {
+		Clamp(int(ff.goalPos.x / (blockSize * SQUARE_SIZE)), 0, numBlocks.x - 1),
+		Clamp(int(ff.goalPos.z / (blockSize * SQUARE_SIZE)), 0, numBlocks.y - 1),
+	};
+
+	ff.blockCosts.clear();
+	ff.blockCosts.resize(numBlocks.x * numBlocks.y, FIELD_COST_INFINITY);
+	ff.blockDirs.clear();
+	ff.blockDirs.resize(numBlocks.x * numBlocks.y, NO_BLOCK_DIR);
+
+	OpenQueue openBlocks;
+	openBlocks.emplace(ff.blockCosts[goalBlock.y * numBlocks.x + goalBlock.x] = 0.0f, goalBlock.y * numBlocks.x + goalBlock.x);
+
+	// Dijkstra outward from the goal; each block remembers which neighbour leads back
+	while (!openBlocks.empty()) {
+		const OpenNode node = openBlocks.top();
+		openBlocks.pop();
+
+		if (node.first > ff.blockCosts[node.second])
+			continue;
+
+		const int2 blockPos = {int(node.second % numBlocks.x), int(node.second / numBlocks.x)};
+
+		for (unsigned int dir = 0; dir < 8; dir++) {
+			const int2 ngbPos = blockPos + BLOCK_DIRS[dir];
+
+			if (static_cast<unsigned int>(ngbPos.x) >= numBlocks.x || static_cast<unsigned int>(ngbPos.y) >= numBlocks.y)
+				continue;
+
+			// cost of moving from the neighbour toward blockPos
+			const unsigned int ngbIdx = ngbPos.y * numBlocks.x + ngbPos.x;
+			const float ngbCost = node.first + manager->GetFlowFieldEdgeCost(moveDef, ngbPos, -BLOCK_DIRS[dir]);
+
+			if (ngbCost >= ff.blockCosts[ngbIdx])
+				continue;
+
+			ff.blockCosts[ngbIdx] = ngbCost;
+			ff.blockDirs[ngbIdx] = (dir + 4) % 8;
+
+			openBlocks.emplace(ngbCost, ngbIdx);
+		}
+	}
+}
+
+void CFlowFieldCache::CalcSquareCosts(FlowField& ff)
+{
+	const MoveDef& moveDef = *ff.moveDef;
+
+	const int2 goalSquare = {int(ff.goalPos.x / SQUARE_SIZE), int(ff.goalPos.z / SQUARE_SIZE)};
+
+	ff.windowMin = {std::max(goalSquare.x - FIELD_WINDOW_RADIUS, 0), std::max(goalSquare.y - FIELD_WINDOW_RADIUS, 0)};
+	ff.windowMax = {std::min(goalSquare.x + FIELD_WINDOW_RADIUS, mapDims.mapx - 1), std::min(goalSquare.y + FIELD_WINDOW_RADIUS, mapDims.mapy - 1)};
+
+	const int2 windowSize = ff.windowMax - ff.windowMin + int2(1, 1);
+
+	// speed-modifiers of all window squares, 0 if impassable
+	std::vector<float> speedMods(windowSize.x * windowSize.y, 0.0f);
+
+	ff.squareCosts.clear();
+	ff.squareCosts.resize(windowSize.x * windowSize.y, FIELD_COST_INFINITY);
+
+	OpenQueue openSquares;
+
+	for (int z = ff.windowMin.y; z <= ff.windowMax.y; z++) {
+		for (int x = ff.windowMin.x; x <= ff.windowMax.x; x++) {
+			const unsigned int idx = (z - ff.windowMin.y) * windowSize.x + (x - ff.windowMin.x);
+
+			if (CMoveMath::IsBlockedStructure(moveDef, x, z, nullptr) == 0)
+				speedMods[idx] = CMoveMath::GetPosSpeedMod(moveDef, x, z);
+
+			// all squares within the goal-radius are goals, also impassable ones
+			// (units then get as close as they can, like with GoalOutOfRange paths)
+			if ((x != goalSquare.x || z != goalSquare.y) && SquareToPos({x, z}).SqDistance2D(ff.goalPos) > Square(ff.goalRadius))
+				continue;
+
+			openSquares.emplace(ff.squareCosts[idx] = 0.0f, idx);
+		}
+	}
+
+	while (!openSquares.empty()) {
+		const OpenNode node = openSquares.top();
+		openSquares.pop();
+
+		if (node.first > ff.squareCosts[node.second])
+			continue;
+
+		const int2 squarePos = {int(node.second % windowSize.x), int(node.second / windowSize.x)};
+
+		// cost of entering this square from a neighbour; impassable squares
+		// are only ever opened as goal-squares (reachable, never crossed)
+		const float moveCost = (speedMods[node.second] > 0.0f)? (1.0f / speedMods[node.second]): 1.0f;
+		const float extraCost = manager->GetNodeExtraCost(squarePos.x + ff.windowMin.x, squarePos.y + ff.windowMin.y, true);
+
+		for (unsigned int dir = 0; dir < 8; dir++) {
+			const int2 ngbPos = squarePos + BLOCK_DIRS[dir];
+
+			if (static_cast<unsigned int>(ngbPos.x) >= windowSize.x || static_cast<unsigned int>(ngbPos.y) >= windowSize.y)
+				continue;
+
+			const unsigned int ngbIdx = ngbPos.y * windowSize.x + ngbPos.x;
+
+			if (speedMods[ngbIdx] <= 0.0f)
+				continue;
+
+			// diagonal moves can not cut corners of impassable squares
+			if ((dir & 1) != 0) {
+				if (speedMods[squarePos.y * windowSize.x + ngbPos.x] <= 0.0f)
+					continue;
+				if (speedMods[ngbPos.y * windowSize.x + squarePos.x] <= 0.0f)
+					continue;
+			}
+
+			const float ngbCost = node.first + moveCost * (((dir & 1) != 0)? math::SQRT2: 1.0f) + extraCost;
+
+			if (ngbCost >= ff.squareCosts[ngbIdx])
+				continue;
+
+			ff.squareCosts[ngbIdx] = ngbCost;
+
+			openSquares.emplace(ngbCost, ngbIdx);
+		}
+	}
+}
+
+
+
+bool CFlowFieldCache::SampleSquares(const FlowField& ff, const float3& pos, float radius, float3& wayPoint) const
+{
+	const int2 windowSize = ff.windowMax - ff.windowMin + int2(1, 1);
+	const int2 startPos = {int(pos.x / SQUARE_SIZE) - ff.windowMin.x, int(pos.z / SQUARE_SIZE) - ff.windowMin.y};
+
+	if (static_cast<unsigned int>(startPos.x) >= windowSize.x || static_cast<unsigned int>(startPos.y) >= windowSize.y)
+		return false;
+	if (ff.squareCosts[startPos.y * windowSize.x + startPos.x] == FIELD_COST_INFINITY)
+		return false;
+
+	const float minDist = std::max(radius, FIELD_MIN_WAYPOINT_DIST);
+
+	int2 currPos = startPos;
+
+	// descend the field until far enough from pos (or at a goal-square)
+	for (int n = 0; n < FIELD_LOOKAHEAD_SQUARES; n++) {
+		const float currCost = ff.squareCosts[currPos.y * windowSize.x + currPos.x];
+
+		if (currCost == 0.0f)
+			break;
+
+		int2 nextPos = currPos;
+		float nextCost = currCost;
+
+		for (const int2& dir: BLOCK_DIRS) {
+			const int2 ngbPos = currPos + dir;
+
+			if (static_cast<unsigned int>(ngbPos.x) >= windowSize.x || static_cast<unsigned int>(ngbPos.y) >= windowSize.y)
+				continue;
+			if (ff.squareCosts[ngbPos.y * windowSize.x + ngbPos.x] >= nextCost)
+				continue;
+
+			nextPos = ngbPos;
+			nextCost = ff.squareCosts[ngbPos.y * windowSize.x + ngbPos.x];
+		}
+
+		if (nextPos == currPos)
+			break;
+
+		currPos = nextPos;
+
+		if (pos.SqDistance2D(SquareToPos(currPos + ff.windowMin)) >= Square(minDist))
+			break;
+	}
+
+	if (ff.squareCosts[currPos.y * windowSize.x + currPos.x] == 0.0f || currPos == startPos) {
+		wayPoint = ff.goalPos * XZVector;
+	} else {
+		wayPoint = SquareToPos(currPos + ff.windowMin);
+	}
+
+	return true;
+}
+
+bool CFlowFieldCache::SampleBlocks(const FlowField& ff, const float3& pos, float radius, float3& wayPoint) const
+{
+	const int2 startBlock = {
+		Clamp(int(pos.x / (blockSize * SQUARE_SIZE)), 0, numBlocks.x - 1),
+		Clamp(int(pos.z / (blockSize * SQUARE_SIZE)), 0, numBlocks.y - 1),
+	};
+
+	if (ff.blockCosts[startBlock.y * numBlocks.x + startBlock.x] == FIELD_COST_INFINITY)
+		return false;
+
+	int2 currBlock = startBlock;
+
+	// head for the node of the next block (or the one after if that is too close)
+	for (int n = 0; n < 2; n++) {
+		const std::uint8_t dir = ff.blockDirs[currBlock.y * numBlocks.x + currBlock.x];
+
+		if (dir == NO_BLOCK_DIR)
+			break;
+
+		currBlock += BLOCK_DIRS[dir];
+		wayPoint = SquareToPos(manager->GetFlowFieldBlockNode(*ff.moveDef, currBlock));
+
+		if (pos.SqDistance2D(wayPoint) >= Square(radius))
+			break;
+	}
+
+	// in the goal-block but outside the reach of the window; go straight for the goal
+	if (currBlock == startBlock)
+		wayPoint = ff.goalPos * XZVector;
+
+	return true;
+}
+
+
+
+unsigned int CFlowFieldCache::RequestFallbackPath(FieldPath& fp, const float3& startPos)
+{
+	FlowField* ff = GetField(fp);
+
+	// leave the field for good, it can be evicted once all users are gone
+	if (ff != nullptr)
+		ff->numUsers -= 1;
+
+	fp.fieldSlot = -1u;
+	fp.evicted = true;
+
+	requestingFallback = true;
+	fp.fallbackPathID = manager->RequestPath(fp.caller, fp.moveDef, startPos, fp.goalPos, fp.goalRadius, true);
+	requestingFallback = false;
+
+	return fp.fallbackPathID;
+}
@@ -0,0 +1,146 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef FLOW_FIELD_CACHE_H
+#define FLOW_FIELD_CACHE_H
+
+#include <cinttypes>
+#include <vector>
+
+#include "System/float3.h"
+#include "System/type2.h"
+#include "System/UnorderedMap.hpp"
+
+struct MoveDef;
+class CSolidObject;
+class IPathManager;
+
+// shares one integration-field per (pathType, goal, radius) between all
+// units that are ordered to the same goal in the same frame, instead of
+// running one search per unit; fields consist of a coarse part over the
+// blocks of the owning path-manager (see IPathManager::GetFlowFieldEdgeCost)
+// and a per-square part in a window around the goal
+//
+// units hold a regular pathID which is sampled by NextWayPoint, so they do
+// not need to know whether they follow a field or a path; if their field is
+// evicted (or does not reach them) a per-unit path is requested on demand
+class CFlowFieldCache {
+public:
+	// IDs of field-paths have this bit set, managers never hand out such IDs
+	static constexpr unsigned int FIELD_PATH_ID_BIT = 1u << 31;
+
+	static bool IsFieldPathID(unsigned int pathID) { return ((pathID & FIELD_PATH_ID_BIT) != 0); }
+
+	void Init(IPathManager* pm);
+	void Kill();
+
+	bool IsEnabled() const { return (manager != nullptr); }
+
+	void Update();
+	void TerrainChange(unsigned int x1, unsigned int z1, unsigned int x2, unsigned int z2);
+
+	/**
+	 * Counts the request toward its (pathType, goal, radius) group and, once
+	 * the group is large enough, returns a field-pathID for it. Returns 0 if
+	 * the caller should run a regular search instead.
+	 */
+	unsigned int RequestPath(CSolidObject* caller, const MoveDef* moveDef, float3 startPos, float3 goalPos, float goalRadius);
+	float3 NextWayPoint(const CSolidObject* owner, unsigned int pathID, unsigned int numRetries, float3 callerPos, float radius, bool synced);
+
+	void DeletePath(unsigned int pathID);
+	bool PathUpdated(unsigned int pathID);
+
+	void GetPathWayPoints(unsigned int pathID, std::vector<float3>& points, std::vector<int>& starts) const;
+
+	/// returns the manager-path backing <pathID>: the ID itself if it is not a
+	/// field-path, otherwise its fallback path (0 if it still follows its field)
+	unsigned int GetBackingPathID(unsigned int pathID) const;
+
+	unsigned int GetNumFields() const;
+	unsigned int GetNumFieldPaths() const { return fieldPaths.size(); }
+
+private:
+	struct FlowField {
+		// incremented on every reuse of the slot, see FieldPath::fieldID
+		std::uint32_t fieldID = 0;
+		// incremented whenever the field is recalculated
+		std::uint32_t version = 0;
+
+		std::uint64_t key = 0;
+
+		const MoveDef* moveDef = nullptr;
+
+		float3 goalPos;
+		float goalRadius = 0.0f;
+
+		// coarse integrated cost-to-goal and direction (index into BLOCK_DIRS) per block
+		std::vector<float> blockCosts;
+		std::vector<std::uint8_t> blockDirs;
+
+		// fine integrated cost-to-goal per square within [windowMin, windowMax]
+		std::vector<float> squareCosts;
+		int2 windowMin;
+		int2 windowMax;
+
+		unsigned int numUsers = 0;
+
+		int lastRequestFrame = 0;
+
+		bool dirty = false;
+	};
+
+	struct FieldPath {
+		unsigned int fieldSlot;
+		std::uint32_t fieldID;
+		std::uint32_t fieldVersion;
+
+		unsigned int fallbackPathID;
+
+		CSolidObject* caller;
+		const MoveDef* moveDef;
+
+		float3 startPos;
+		float3 goalPos;
+		float goalRadius;
+
+		bool evicted;
+	};
+
+	FlowField* GetField(const FieldPath& fp);
+	const FlowField* GetField(const FieldPath& fp) const;
+
+	unsigned int AllocField(std::uint64_t key, const MoveDef* moveDef, const float3& goalPos, float goalRadius);
+	void EvictField(unsigned int fieldSlot);
+
+	void CalcField(FlowField& ff);
+	void CalcBlockCosts(FlowField& ff);
+	void CalcSquareCosts(FlowField& ff);
+
+	// both return false if <pos> is not covered by the respective part of the field
+	bool SampleSquares(const FlowField& ff, const float3& pos, float radius, float3& wayPoint) const;
+	bool SampleBlocks(const FlowField& ff, const float3& pos, float radius, float3& wayPoint) const;
+
+	unsigned int RequestFallbackPath(FieldPath& fp, const float3& startPos);
+
+private:
+	IPathManager* manager = nullptr;
+
+	std::vector<FlowField> fields;
+	spring::unordered_map<unsigned int, FieldPath> fieldPaths;
+
+	// number of requests per group in the current frame
+	spring::unordered_map<std::uint64_t, unsigned int> groupRequests;
+
+	unsigned int blockSize = 0;
+	int2 numBlocks;
+
+	unsigned int nextPathID = 0;
+
+	int lastRequestFrame = -1;
+	int lastUpdateFrame = 0;
+
+	// set while a fallback path is being requested, so the
+	// manager's RequestPath does not route it back to us
+	bool requestingFallback = false;
+};
+
+#endif
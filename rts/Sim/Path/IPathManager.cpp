@@ -3,7 +3,13 @@
 #include "IPathManager.h"
 #include "Default/PathManager.h"
 #include "QTPFS/PathManager.hpp"
+#include "Map/ReadMap.h"
+#include "Sim/MoveTypes/MoveDefHandler.h"
+#include "Sim/MoveTypes/MoveMath/MoveMath.h"
 #include "System/Log/ILog.h"
+#include "System/SpringMath.h"
+
+#include <limits>
 
 IPathManager nullPathManager;
 IPathManager* pathManager = &nullPathManager;
@@ -34,3 +40,39 @@ void IPathManager::FreeInstance(IPathManager* pm) {
 	pathManager = &nullPathManager;
 }
 
+
+
+float IPathManager::GetFlowFieldEdgeCost(const MoveDef& moveDef, int2 blockPos, int2 blockDir) const
+{
+	const int2 numBlocks = {int(mapDims.mapx / GetFlowFieldBlockSize()), int(mapDims.mapy / GetFlowFieldBlockSize())};
+	const int2 ngbBlockPos = blockPos + blockDir;
+
+	if (static_cast<unsigned int>(ngbBlockPos.x) >= numBlocks.x || static_cast<unsigned int>(ngbBlockPos.y) >= numBlocks.y)
+		return std::numeric_limits<float>::infinity();
+
+	const int2 srcSquare = GetFlowFieldBlockNode(moveDef, blockPos);
+	const int2 dstSquare = GetFlowFieldBlockNode(moveDef, ngbBlockPos);
+	const int2 midSquare = (srcSquare + dstSquare) / 2;
+	const int2 squares[] = {srcSquare, midSquare, dstSquare};
+
+	float sumMoveCosts = 0.0f;
+
+	// cheap estimate; assumes the nodes are connected along a straight line
+	for (const int2& sq: squares) {
+		const float speedMod = CMoveMath::GetPosSpeedMod(moveDef, sq.x, sq.y);
+
+		if (speedMod <= 0.0f || CMoveMath::IsBlockedStructure(moveDef, sq.x, sq.y, nullptr) != 0)
+			return std::numeric_limits<float>::infinity();
+
+		sumMoveCosts += (1.0f / speedMod);
+	}
+
+	const int2 delta = dstSquare - srcSquare;
+	return (math::sqrt(float(delta.x * delta.x + delta.y * delta.y)) * sumMoveCosts / 3.0f);
+}
+
+int2 IPathManager::GetFlowFieldBlockNode(const MoveDef& moveDef, int2 blockPos) const
+{
+	const int blockSize = GetFlowFieldBlockSize();
+	return {blockPos.x * blockSize + blockSize / 2, blockPos.y * blockSize + blockSize / 2};
+}
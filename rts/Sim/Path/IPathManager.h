@@ -6,6 +6,7 @@
 #include <vector>
 #include <cinttypes>
 
+#include "FlowFieldCache.h"
 #include "PFSTypes.h"
 #include "System/type2.h"
 #include "System/float3.h"
@@ -170,6 +171,29 @@ public:
 	virtual const float* GetNodeExtraCosts(bool synced) const { return nullptr; }
 
 	virtual int2 GetNumQueuedUpdates() const { return (int2(0, 0)); }
+	/// largest number of queued updates over the last few seconds
+	virtual int2 GetPeakQueuedUpdates() const { return (GetNumQueuedUpdates()); }
+	/// time (in milliseconds) spent processing queued updates in the last frame
+	virtual float GetQueuedUpdateTime() const { return 0.0f; }
+
+
+	/**
+	 * Block-data for the coarse part of shared flow-fields (see FlowFieldCache.h):
+	 * the block-size in squares, the cost for <moveDef> to move from block
+	 * <blockPos> to the adjacent block at <blockPos + blockDir> (infinite if
+	 * there is no connection), and the square units should head for within
+	 * a block. The defaults derive these from speed-modifiers and structure
+	 * blocking, managers with precomputed block-data should override them.
+	 */
+	virtual unsigned int GetFlowFieldBlockSize() const { return 16; }
+	virtual float GetFlowFieldEdgeCost(const MoveDef& moveDef, int2 blockPos, int2 blockDir) const;
+	virtual int2 GetFlowFieldBlockNode(const MoveDef& moveDef, int2 blockPos) const;
+
+	const CFlowFieldCache& GetFlowFieldCache() const { return flowFields; }
+
+protected:
+	// only enabled (by Finalize) if modInfo.pfFlowFields is set
+	CFlowFieldCache flowFields;
 };
 
 extern IPathManager* pathManager;
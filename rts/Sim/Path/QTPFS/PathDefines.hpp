@@ -12,12 +12,10 @@
 // #define QTPFS_DEBUG_NODE_HEAP
 #define QTPFS_CORNER_CONNECTED_NODES
 // #define QTPFS_SLOW_ACCURATE_TESSELATION
-// #define QTPFS_OPENMP_ENABLED
 // #define QTPFS_ORTHOPROJECTED_EDGE_TRANSITIONS
 #define QTPFS_STAGGERED_LAYER_UPDATES
 //
 // #define QTPFS_VIRTUAL_NODE_FUNCTIONS
-// #define QTPFS_ENABLE_THREADED_UPDATE
 // #define QTPFS_AMORTIZED_NODE_NEIGHBOR_CACHE_UPDATES
 #define QTPFS_ENABLE_MICRO_OPTIMIZATION_HACKS
 // #define QTPFS_CONSERVATIVE_NEIGHBOR_CACHE_UPDATES
@@ -14,6 +14,7 @@
 #include "Game/LoadScreen.h"
 #include "Map/MapInfo.h"
 #include "Sim/Misc/GlobalSynced.h"
+#include "Sim/Misc/ModInfo.h"
 #include "Sim/Misc/TeamHandler.h"
 #include "Sim/MoveTypes/MoveDefHandler.h"
 #include "Sim/MoveTypes/MoveMath/MoveMath.h"
@@ -99,12 +100,6 @@ namespace QTPFS {
 
 	static PMLoadScreen pmLoadScreen;
 
-	static size_t GetNumThreads() {
-		const size_t numThreads = std::max(0, configHandler->GetInt("PathingThreadCount"));
-		const size_t numCores = Threading::GetLogicalCpuCores();
-		return ((numThreads == 0)? numCores: numThreads);
-	}
-
 	unsigned int PathManager::LAYERS_PER_UPDATE;
 	unsigned int PathManager::MAX_TEAM_SEARCHES;
 
@@ -142,21 +137,17 @@ QTPFS::PathManager::~PathManager() {
 	// nodeLayers.clear();
 	pathCaches.clear();
 	pathSearches.clear();
+	searchStates.clear();
+	sharedPaths.clear();
 	pathTypes.clear();
 	pathTraces.clear();
 
 	numCurrExecutedSearches.clear();
 	numPrevExecutedSearches.clear();
 
-	PathSearch::FreeGlobalQueue();
+	flowFields.Kill();
 
-	#ifdef QTPFS_ENABLE_THREADED_UPDATE
-	// at this point the thread is waiting, so notify it
-	// (nodeTrees has been cleared already, guaranteeing
-	// that no "final" iteration shall execute)
-	condThreadUpdate.notify_one();
-	updateThread.join();
-	#endif
+	PathSearch::FreeGlobalQueue();
 }
 
 std::int64_t QTPFS::PathManager::Finalize() {
@@ -165,12 +156,8 @@ std::int64_t QTPFS::PathManager::Finalize() {
 	{
 		pmLoadScreen.Show(&PathManager::Load, this);
 
-		#ifdef QTPFS_ENABLE_THREADED_UPDATE
-		mutexThreadUpdate = spring::mutex();
-		condThreadUpdate = spring::condition_variable();
-		condThreadUpdated = spring::condition_variable();
-		updateThread = spring::thread(std::bind(&PathManager::ThreadUpdate, this));
-		#endif
+		if (modInfo.pfFlowFields)
+			flowFields.Init(this);
 	}
 
 	const spring_time t1 = spring_gettime();
@@ -185,8 +172,6 @@ void QTPFS::PathManager::InitStatic() {
 }
 
 void QTPFS::PathManager::Load() {
-	// NOTE: offset *must* start at a non-zero value
-	searchStateOffset = NODE_STATE_OFFSET;
 	numTerrainChanges = 0;
 	numPathRequests   = 0;
 	maxNumLeafNodes   = 0;
@@ -195,6 +180,12 @@ void QTPFS::PathManager::Load() {
 	nodeLayers.resize(moveDefHandler.GetNumMoveDefs());
 	pathCaches.resize(moveDefHandler.GetNumMoveDefs());
 	pathSearches.resize(moveDefHandler.GetNumMoveDefs());
+	searchStates.resize(moveDefHandler.GetNumMoveDefs());
+	sharedPaths.resize(moveDefHandler.GetNumMoveDefs());
+
+	// NOTE: offsets *must* start at a non-zero value
+	searchStateOffsets.clear();
+	searchStateOffsets.resize(moveDefHandler.GetNumMoveDefs(), NODE_STATE_OFFSET);
 
 	// add one extra element for object-less requests
 	numCurrExecutedSearches.resize(teamHandler.ActiveTeams() + 1, 0);
@@ -273,27 +264,12 @@ std::uint64_t QTPFS::PathManager::GetMemFootPrint() const {
 
 
 
-void QTPFS::PathManager::SpawnSpringThreads(MemberFunc f, const SRectangle& r) {
-	static std::vector<spring::thread*> threads(std::min(GetNumThreads(), nodeLayers.size()), nullptr);
-
-	for (unsigned int threadNum = 0; threadNum < threads.size(); threadNum++) {
-		threads[threadNum] = new spring::thread(std::bind(f, this, threadNum, threads.size(), r));
-	}
-
-	for (unsigned int threadNum = 0; threadNum < threads.size(); threadNum++) {
-		threads[threadNum]->join(); delete threads[threadNum];
-	}
-}
-
-
-
 void QTPFS::PathManager::InitNodeLayersThreaded(const SRectangle& rect) {
 	streflop::streflop_init<streflop::Simple>();
 
 	char loadMsg[512] = {'\0'};
 	const char* fmtString = "[PathManager::%s] using %u threads for %u node-layers (%s)";
 
-	#ifdef QTPFS_OPENMP_ENABLED
 	{
 		sprintf(loadMsg, fmtString, __func__, ThreadPool::GetNumThreads(), nodeLayers.size(), (haveCacheDir? "cached": "uncached"));
 		pmLoadScreen.AddMessage(loadMsg);
@@ -303,10 +279,12 @@ void QTPFS::PathManager::InitNodeLayersThreaded(const SRectangle& rect) {
 		const char* pstFmtStr = "  initialized node-layer %u (%u MB, %u leafs, ratio %f)";
 		#endif
 
-		for_mt(0, nodeLayers.size(), [&,loadMsg](const int layerNum){
+		for_mt(0, nodeLayers.size(), [&](const int layerNum){
 			#ifndef NDEBUG
-			sprintf(loadMsg, preFmtStr, layerNum, ThreadPool::GetThreadNum());
-			pmLoadScreen.AddMessage(loadMsg);
+			char layerMsg[512] = {'\0'};
+
+			sprintf(layerMsg, preFmtStr, layerNum, ThreadPool::GetThreadNum());
+			pmLoadScreen.AddMessage(layerMsg);
 			#endif
 
 			// construct each tree from scratch IFF no cache-dir exists
@@ -323,62 +301,15 @@ void QTPFS::PathManager::InitNodeLayersThreaded(const SRectangle& rect) {
 			const unsigned int mem = (tree->GetMemFootPrint(layer) + layer.GetMemFootPrint()) / (1024 * 1024);
 
 			#ifndef NDEBUG
-			sprintf(loadMsg, pstFmtStr, layerNum, mem, layer.GetNumLeafNodes(), layer.GetNodeRatio());
-			pmLoadScreen.AddMessage(loadMsg);
+			sprintf(layerMsg, pstFmtStr, layerNum, mem, layer.GetNumLeafNodes(), layer.GetNodeRatio());
+			pmLoadScreen.AddMessage(layerMsg);
 			#endif
 		});
 	}
-	#else
-	{
-		sprintf(loadMsg, fmtString, __func__, GetNumThreads(), nodeLayers.size(), (haveCacheDir? "cached": "uncached"));
-		pmLoadScreen.AddMessage(loadMsg);
-
-		SpawnSpringThreads(&PathManager::InitNodeLayersThread, rect);
-	}
-	#endif
 
 	streflop::streflop_init<streflop::Simple>();
 }
 
-__FORCE_ALIGN_STACK__
-void QTPFS::PathManager::InitNodeLayersThread(
-	unsigned int threadNum,
-	unsigned int numThreads,
-	const SRectangle& rect
-) {
-	const unsigned int layersPerThread = (nodeLayers.size() / numThreads);
-	const unsigned int numExcessLayers = (threadNum == (numThreads - 1))?
-		(nodeLayers.size() % numThreads): 0;
-
-	const unsigned int minLayer = threadNum * layersPerThread;
-	const unsigned int maxLayer = minLayer + layersPerThread + numExcessLayers;
-
-	#ifndef NDEBUG
-	char loadMsg[512] = {'\0'};
-	const char* preFmtStr = "  initializing node-layer %u (thread %u)";
-	const char* pstFmtStr = "  initialized node-layer %u (%u MB, %u leafs, ratio %f)";
-	#endif
-
-	for (unsigned int layerNum = minLayer; layerNum < maxLayer; layerNum++) {
-		#ifndef NDEBUG
-		sprintf(loadMsg, preFmtStr, layerNum, threadNum);
-		pmLoadScreen.AddMessage(loadMsg);
-		#endif
-
-		InitNodeLayer(layerNum, rect);
-		UpdateNodeLayer(layerNum, rect);
-
-		const QTNode* tree = nodeTrees[layerNum];
-		const NodeLayer& layer = nodeLayers[layerNum];
-		const unsigned int mem = (tree->GetMemFootPrint(layer) + layer.GetMemFootPrint()) / (1024 * 1024);
-
-		#ifndef NDEBUG
-		sprintf(loadMsg, pstFmtStr, layerNum, mem, layer.GetNumLeafNodes(), layer.GetNodeRatio());
-		pmLoadScreen.AddMessage(loadMsg);
-		#endif
-	}
-}
-
 void QTPFS::PathManager::InitNodeLayer(unsigned int layerNum, const SRectangle& r) {
 	NodeLayer& nl = nodeLayers[layerNum];
 
@@ -391,39 +322,13 @@ void QTPFS::PathManager::InitNodeLayer(unsigned int layerNum, const SRectangle&
 void QTPFS::PathManager::UpdateNodeLayersThreaded(const SRectangle& rect) {
 	streflop::streflop_init<streflop::Simple>();
 
-	#ifdef QTPFS_OPENMP_ENABLED
-	{
-		for_mt(0, nodeLayers.size(), [&,rect](const int layerNum) {
-			UpdateNodeLayer(layerNum, rect);
-		});
-	}
-	#else
-	{
-		SpawnSpringThreads(&PathManager::UpdateNodeLayersThread, rect);
-	}
-	#endif
+	for_mt(0, nodeLayers.size(), [&,rect](const int layerNum) {
+		UpdateNodeLayer(layerNum, rect);
+	});
 
 	streflop::streflop_init<streflop::Simple>();
 }
 
-__FORCE_ALIGN_STACK__
-void QTPFS::PathManager::UpdateNodeLayersThread(
-	unsigned int threadNum,
-	unsigned int numThreads,
-	const SRectangle& rect
-) {
-	const unsigned int layersPerThread = (nodeLayers.size() / numThreads);
-	const unsigned int numExcessLayers = (threadNum == (numThreads - 1))?
-		(nodeLayers.size() % numThreads): 0;
-
-	const unsigned int minLayer = threadNum * layersPerThread;
-	const unsigned int maxLayer = minLayer + layersPerThread + numExcessLayers;
-
-	for (unsigned int layerNum = minLayer; layerNum < maxLayer; layerNum++) {
-		UpdateNodeLayer(layerNum, rect);
-	}
-}
-
 // called in the non-staggered (#ifndef QTPFS_STAGGERED_LAYER_UPDATES)
 // layer update scheme and during initialization; see ::TerrainChange
 void QTPFS::PathManager::UpdateNodeLayer(unsigned int layerNum, const SRectangle& r) {
@@ -647,6 +552,8 @@ void QTPFS::PathManager::TerrainChange(unsigned int x1, unsigned int z1,  unsign
 	// maximum depth automatically
 	numTerrainChanges += 1;
 
+	flowFields.TerrainChange(x1, z1, x2, z2);
+
 	#ifdef QTPFS_STAGGERED_LAYER_UPDATES
 	// defer layer-updates to ::Update so we can stagger them
 	// this may or may not be more efficient than updating all
@@ -666,147 +573,170 @@ void QTPFS::PathManager::TerrainChange(unsigned int x1, unsigned int z1,  unsign
 void QTPFS::PathManager::Update() {
 	SCOPED_TIMER("Sim::Path");
 
-	#ifdef QTPFS_ENABLE_THREADED_UPDATE
-	streflop::streflop_init<streflop::Simple>();
+	// NOTE:
+	//     for a mod with N move-types, any unit will be waiting
+	//     (N / LAYERS_PER_UPDATE) sim-frames before its request
+	//     executes at a minimum
+	const unsigned int layersPerUpdateTmp = LAYERS_PER_UPDATE;
+	const unsigned int numPathTypeUpdates = std::min(static_cast<unsigned int>(nodeLayers.size()), layersPerUpdateTmp);
 
-	std::lock_guard<spring::mutex> lock(mutexThreadUpdate);
+	// NOTE: thread-safe (only ONE thread ever accesses these)
+	static unsigned int minPathTypeUpdate = 0;
+	static unsigned int maxPathTypeUpdate = numPathTypeUpdates;
 
-	// allow ThreadUpdate to run one iteration
-	condThreadUpdate.notify_one();
+	updateLayers.clear();
 
-	// wait for the ThreadUpdate iteration to finish
-	condThreadUpdated.wait(lock);
+	for (unsigned int pathTypeUpdate = minPathTypeUpdate; pathTypeUpdate < maxPathTypeUpdate; pathTypeUpdate++) {
+		updateLayers.push_back(pathTypeUpdate);
+	}
 
-	streflop::streflop_init<streflop::Simple>();
-	#else
-	ThreadUpdate();
-	#endif
-}
+	// layers are independent of each other (nodes, trees, caches and search
+	// state are all per-layer), so each phase that only touches one layer is
+	// run for all layers of this update in parallel; phases touching shared
+	// data run serially in layer-order, s.t. results never depend on timing
+	{
+		#ifndef QTPFS_IGNORE_DEAD_PATHS
+		for (const unsigned int pathType: updateLayers) {
+			QueueDeadPathSearches(pathType);
+		}
+		#endif
 
-__FORCE_ALIGN_STACK__
-void QTPFS::PathManager::ThreadUpdate() {
-	#ifdef QTPFS_ENABLE_THREADED_UPDATE
-	while (!nodeLayers.empty()) {
-		std::lock_guard<spring::mutex> lock(mutexThreadUpdate);
+		{
+			SCOPED_TIMER("Sim::Path::QTPFS::LayerUpdates");
+			ForEachUpdateLayer(&PathManager::InitQueuedSearches);
+		}
 
-		// wait for green light from Update
-		condThreadUpdate.wait(lock);
+		for (const unsigned int pathType: updateLayers) {
+			AdmitQueuedSearches(pathType);
+		}
 
-		// if we were notified from the destructor, then structures
-		// are no longer valid and there is no point to finish this
-		// iteration --> break early to avoid crashing
-		if (nodeTrees.empty())
-			break;
-	#endif
+		{
+			SCOPED_TIMER("Sim::Path::QTPFS::Searches");
+			ForEachUpdateLayer(&PathManager::ExecuteQueuedSearches);
+		}
 
-		// NOTE:
-		//     for a mod with N move-types, any unit will be waiting
-		//     (N / LAYERS_PER_UPDATE) sim-frames before its request
-		//     executes at a minimum
-		const unsigned int layersPerUpdateTmp = LAYERS_PER_UPDATE;
-		const unsigned int numPathTypeUpdates = std::min(static_cast<unsigned int>(nodeLayers.size()), layersPerUpdateTmp);
+		for (const unsigned int pathType: updateLayers) {
+			FinishQueuedSearches(pathType);
+		}
+	}
 
-		// NOTE: thread-safe (only ONE thread ever accesses these)
-		static unsigned int minPathTypeUpdate = 0;
-		static unsigned int maxPathTypeUpdate = numPathTypeUpdates;
+	std::copy(numCurrExecutedSearches.begin(), numCurrExecutedSearches.end(), numPrevExecutedSearches.begin());
 
-		sharedPaths.clear();
+	minPathTypeUpdate = (minPathTypeUpdate + numPathTypeUpdates);
+	maxPathTypeUpdate = (minPathTypeUpdate + numPathTypeUpdates);
 
-		for (unsigned int pathTypeUpdate = minPathTypeUpdate; pathTypeUpdate < maxPathTypeUpdate; pathTypeUpdate++) {
-			#ifndef QTPFS_IGNORE_DEAD_PATHS
-			QueueDeadPathSearches(pathTypeUpdate);
-			#endif
+	if (minPathTypeUpdate >= nodeLayers.size()) {
+		minPathTypeUpdate = 0;
+		maxPathTypeUpdate = numPathTypeUpdates;
+	}
+	if (maxPathTypeUpdate >= nodeLayers.size()) {
+		maxPathTypeUpdate = nodeLayers.size();
+	}
 
-			#ifdef QTPFS_STAGGERED_LAYER_UPDATES
-			// NOTE: *must* be called between QueueDeadPathSearches and ExecuteQueuedSearches
-			ExecQueuedNodeLayerUpdates(pathTypeUpdate, !pathSearches[pathTypeUpdate].empty());
-			#endif
+	flowFields.Update();
+}
 
-			ExecuteQueuedSearches(pathTypeUpdate);
-		}
+void QTPFS::PathManager::ForEachUpdateLayer(LayerFunc f) {
+	if (updateLayers.empty())
+		return;
 
-		std::copy(numCurrExecutedSearches.begin(), numCurrExecutedSearches.end(), numPrevExecutedSearches.begin());
+	// start with the layers that have the most work, the others are picked
+	// up by whichever thread becomes idle first (the order of the layers is
+	// only a scheduling hint and has no influence on the results)
+	std::stable_sort(updateLayers.begin(), updateLayers.end(), [&](unsigned int a, unsigned int b) {
+		return (GetLayerWorkLoad(a) > GetLayerWorkLoad(b));
+	});
 
-		minPathTypeUpdate = (minPathTypeUpdate + numPathTypeUpdates);
-		maxPathTypeUpdate = (minPathTypeUpdate + numPathTypeUpdates);
+	std::atomic<unsigned int> nextLayerIdx = {0};
 
-		if (minPathTypeUpdate >= nodeLayers.size()) {
-			minPathTypeUpdate = 0;
-			maxPathTypeUpdate = numPathTypeUpdates;
-		}
-		if (maxPathTypeUpdate >= nodeLayers.size()) {
-			maxPathTypeUpdate = nodeLayers.size();
+	streflop::streflop_init<streflop::Simple>();
+
+	for_mt(0, std::min(int(updateLayers.size()), ThreadPool::GetNumThreads()), [&](const int) {
+		for (unsigned int n = nextLayerIdx.fetch_add(1); n < updateLayers.size(); n = nextLayerIdx.fetch_add(1)) {
+			(this->*f)(updateLayers[n]);
 		}
+	});
 
-	#ifdef QTPFS_ENABLE_THREADED_UPDATE
-		// tell Update we are finished with this iteration
-		condThreadUpdated.notify_one();
-	}
+	streflop::streflop_init<streflop::Simple>();
+
+	// restore layer-order for the serial phases
+	std::sort(updateLayers.begin(), updateLayers.end());
+}
+
+unsigned int QTPFS::PathManager::GetLayerWorkLoad(unsigned int pathType) const {
+	unsigned int workLoad = pathSearches[pathType].size();
+
+	#ifdef QTPFS_STAGGERED_LAYER_UPDATES
+	workLoad += nodeLayers[pathType].NumQueuedUpdates();
 	#endif
+
+	return workLoad;
 }
 
 
 
-void QTPFS::PathManager::ExecuteQueuedSearches(unsigned int pathType) {
+// runs in parallel for different layers
+void QTPFS::PathManager::InitQueuedSearches(unsigned int pathType) {
+	#ifdef QTPFS_STAGGERED_LAYER_UPDATES
+	// NOTE: *must* be called between QueueDeadPathSearches and ExecuteQueuedSearches
+	ExecQueuedNodeLayerUpdates(pathType, !pathSearches[pathType].empty());
+	#endif
+
 	NodeLayer& nodeLayer = nodeLayers[pathType];
 	PathCache& pathCache = pathCaches[pathType];
 
-	std::vector<IPathSearch*>& searches = pathSearches[pathType];
-	std::vector<IPathSearch*>::iterator searchesIt = searches.begin();
-
-	if (!searches.empty()) {
-		// execute pending searches collected via
-		// RequestPath and QueueDeadPathSearches
-		while (searchesIt != searches.end()) {
-			if (ExecuteSearch(searches, searchesIt, nodeLayer, pathCache, pathType)) {
-				searchStateOffset += NODE_STATE_OFFSET;
-			}
+	const std::vector<IPathSearch*>& searches = pathSearches[pathType];
+	std::vector<SearchState>& states = searchStates[pathType];
+
+	states.clear();
+	states.resize(searches.size(), SEARCH_STATE_QUEUED);
+
+	// searches can only be initialized after the layer is up to date
+	for (unsigned int i = 0; i < searches.size(); i++) {
+		IPathSearch* search = searches[i];
+		IPath* path = pathCache.GetTempPath(search->GetID());
+
+		assert(search != nullptr);
+		assert(path != nullptr);
+
+		// temp-path might have been removed already via
+		// DeletePath before we got a chance to process it
+		if (path->GetID() == 0) {
+			states[i] = SEARCH_STATE_DELETED;
+			continue;
 		}
+
+		assert(search->GetID() != 0);
+		assert(path->GetID() == search->GetID());
+
+		search->Initialize(&nodeLayer, &pathCache, path->GetSourcePoint(), path->GetTargetPoint(), MAP_RECTANGLE);
+		path->SetHash(search->GetHash(mapDims.mapx * mapDims.mapy, pathType));
 	}
 }
 
-bool QTPFS::PathManager::ExecuteSearch(
-	PathSearchVect& searches,
-	PathSearchVectIt& searchesIt,
-	NodeLayer& nodeLayer,
-	PathCache& pathCache,
-	unsigned int pathType
-) {
-	IPathSearch* search = *searchesIt;
-	IPath* path = pathCache.GetTempPath(search->GetID());
+// runs serially in layer-order, the team limits are shared by all layers
+void QTPFS::PathManager::AdmitQueuedSearches(unsigned int pathType) {
+	const PathCache& pathCache = pathCaches[pathType];
+	const std::vector<IPathSearch*>& searches = pathSearches[pathType];
 
-	assert(search != nullptr);
-	assert(path != nullptr);
+	std::vector<SearchState>& states = searchStates[pathType];
 
-	const auto DeleteSearch = [](IPathSearch* s, PathSearchVect& v, PathSearchVectIt& it) {
-		// ordering of still-queued searches is not relevant
-		*it = v.back();
-		v.pop_back();
-		delete s;
-	};
+	admittedHashes.clear();
 
-	// temp-path might have been removed already via
-	// DeletePath before we got a chance to process it
-	if (path->GetID() == 0) {
-		DeleteSearch(search, searches, searchesIt);
-		return false;
-	}
+	for (unsigned int i = 0; i < searches.size(); i++) {
+		if (states[i] != SEARCH_STATE_QUEUED)
+			continue;
 
-	assert(search->GetID() != 0);
-	assert(path->GetID() == search->GetID());
+		const IPathSearch* search = searches[i];
 
-	search->Initialize(&nodeLayer, &pathCache, path->GetSourcePoint(), path->GetTargetPoint(), MAP_RECTANGLE);
-	path->SetHash(search->GetHash(mapDims.mapx * mapDims.mapy, pathType));
-
-	{
 		#ifdef QTPFS_SEARCH_SHARED_PATHS
-		SharedPathMap::const_iterator sharedPathsIt = sharedPaths.find(path->GetHash());
+		const std::uint64_t hash = (pathCache.GetTempPath(search->GetID()))->GetHash();
 
-		if (sharedPathsIt != sharedPaths.end()) {
-			if (search->SharedFinalize(sharedPathsIt->second, path)) {
-				DeleteSearch(search, searches, searchesIt);
-				return false;
-			}
+		// an earlier search with the same hash will execute, try to share its
+		// path; if that fails this one is simply admitted in the next update
+		if (admittedHashes.find(hash) != admittedHashes.end()) {
+			states[i] = SEARCH_STATE_SHARED;
+			continue;
 		}
 		#endif
 
@@ -814,31 +744,111 @@ bool QTPFS::PathManager::ExecuteSearch(
 		const unsigned int numCurrSearches = numCurrExecutedSearches[search->GetTeam()];
 		const unsigned int numPrevSearches = numPrevExecutedSearches[search->GetTeam()];
 
-		if ((numCurrSearches - numPrevSearches) >= MAX_TEAM_SEARCHES) {
-			++searchesIt; return false;
-		}
+		if ((numCurrSearches - numPrevSearches) >= MAX_TEAM_SEARCHES)
+			continue;
 
 		numCurrExecutedSearches[search->GetTeam()] += 1;
 		#endif
-	}
-
-	// removes path from temp-paths, adds it to live-paths
-	if (search->Execute(searchStateOffset, numTerrainChanges)) {
-		search->Finalize(path);
 
 		#ifdef QTPFS_SEARCH_SHARED_PATHS
-		sharedPaths[path->GetHash()] = path;
+		admittedHashes.insert(hash);
 		#endif
 
-		#ifdef QTPFS_TRACE_PATH_SEARCHES
-		pathTraces[path->GetID()] = search->GetExecutionTrace();
-		#endif
-	} else {
-		DeletePath(path->GetID());
+		states[i] = SEARCH_STATE_ADMITTED;
 	}
+}
 
-	DeleteSearch(search, searches, searchesIt);
-	return true;
+// runs in parallel for different layers
+void QTPFS::PathManager::ExecuteQueuedSearches(unsigned int pathType) {
+	PathCache& pathCache = pathCaches[pathType];
+	SharedPathMap& layerSharedPaths = sharedPaths[pathType];
+
+	const std::vector<IPathSearch*>& searches = pathSearches[pathType];
+	std::vector<SearchState>& states = searchStates[pathType];
+
+	layerSharedPaths.clear();
+
+	for (unsigned int i = 0; i < searches.size(); i++) {
+		IPathSearch* search = searches[i];
+		IPath* path = nullptr;
+
+		switch (states[i]) {
+			#ifdef QTPFS_SEARCH_SHARED_PATHS
+			case SEARCH_STATE_SHARED: {
+				path = pathCache.GetTempPath(search->GetID());
+
+				const SharedPathMapIt sharedPathsIt = layerSharedPaths.find(path->GetHash());
+
+				if (sharedPathsIt != layerSharedPaths.end() && search->SharedFinalize(sharedPathsIt->second, path)) {
+					states[i] = SEARCH_STATE_FINISHED;
+				} else {
+					states[i] = SEARCH_STATE_QUEUED;
+				}
+			} break;
+			#endif
+
+			case SEARCH_STATE_ADMITTED: {
+				path = pathCache.GetTempPath(search->GetID());
+
+				// removes path from temp-paths, adds it to live-paths
+				if (search->Execute(searchStateOffsets[pathType], numTerrainChanges)) {
+					search->Finalize(path);
+
+					#ifdef QTPFS_SEARCH_SHARED_PATHS
+					layerSharedPaths[path->GetHash()] = path;
+					#endif
+
+					states[i] = SEARCH_STATE_FINISHED;
+				} else {
+					states[i] = SEARCH_STATE_FAILED;
+				}
+
+				searchStateOffsets[pathType] += NODE_STATE_OFFSET;
+			} break;
+
+			default: {
+			} break;
+		}
+	}
+}
+
+// runs serially in layer-order, deleting paths touches shared data
+void QTPFS::PathManager::FinishQueuedSearches(unsigned int pathType) {
+	std::vector<IPathSearch*>& searches = pathSearches[pathType];
+	std::vector<SearchState>& states = searchStates[pathType];
+
+	unsigned int numQueuedSearches = 0;
+
+	for (unsigned int i = 0; i < searches.size(); i++) {
+		IPathSearch* search = searches[i];
+
+		switch (states[i]) {
+			case SEARCH_STATE_QUEUED: {
+				// keep for the next update of this layer, in the same order
+				searches[numQueuedSearches++] = search;
+				continue;
+			} break;
+
+			case SEARCH_STATE_FINISHED: {
+				#ifdef QTPFS_TRACE_PATH_SEARCHES
+				if (search->GetExecutionTrace() != nullptr)
+					pathTraces[search->GetID()] = search->GetExecutionTrace();
+				#endif
+			} break;
+
+			case SEARCH_STATE_FAILED: {
+				DeletePath(search->GetID());
+			} break;
+
+			default: {
+			} break;
+		}
+
+		delete search;
+	}
+
+	searches.resize(numQueuedSearches);
+	states.clear();
 }
 
 void QTPFS::PathManager::QueueDeadPathSearches(unsigned int pathType) {
@@ -942,6 +952,8 @@ unsigned int QTPFS::PathManager::QueueSearch(
 
 
 void QTPFS::PathManager::UpdatePath(const CSolidObject* owner, unsigned int pathID) {
+	pathID = flowFields.GetBackingPathID(pathID);
+
 	const PathTypeMapIt pathTypeIt = pathTypes.find(pathID);
 
 	if (pathTypeIt != pathTypes.end()) {
@@ -955,6 +967,11 @@ void QTPFS::PathManager::UpdatePath(const CSolidObject* owner, unsigned int path
 }
 
 void QTPFS::PathManager::DeletePath(unsigned int pathID) {
+	if (CFlowFieldCache::IsFieldPathID(pathID)) {
+		flowFields.DeletePath(pathID);
+		return;
+	}
+
 	const PathTypeMapIt pathTypeIt = pathTypes.find(pathID);
 	const PathTraceMapIt pathTraceIt = pathTraces.find(pathID);
 
@@ -985,12 +1002,23 @@ unsigned int QTPFS::PathManager::RequestPath(
 	if (!IsFinalized())
 		return 0;
 
+	// units ordered to the same goal in large numbers share a flow-field
+	if (synced && object != nullptr) {
+		const unsigned int fieldPathID = flowFields.RequestPath(object, moveDef, sourcePoint, targetPoint, radius);
+
+		if (fieldPathID != 0)
+			return fieldPathID;
+	}
+
 	return (QueueSearch(nullptr, object, moveDef, sourcePoint, targetPoint, radius, synced));
 }
 
 
 
 bool QTPFS::PathManager::PathUpdated(unsigned int pathID) {
+	if (CFlowFieldCache::IsFieldPathID(pathID))
+		return (flowFields.PathUpdated(pathID));
+
 	const PathTypeMapIt pathTypeIt = pathTypes.find(pathID);
 
 	if (pathTypeIt == pathTypes.end())
@@ -1012,11 +1040,11 @@ bool QTPFS::PathManager::PathUpdated(unsigned int pathID) {
 
 
 float3 QTPFS::PathManager::NextWayPoint(
-	const CSolidObject*, // owner
+	const CSolidObject* owner,
 	unsigned int pathID,
-	unsigned int, // numRetries
+	unsigned int numRetries,
 	float3 point,
-	float, // radius,
+	float radius,
 	bool synced
 ) {
 	// in misc since it is called from many points
@@ -1030,6 +1058,9 @@ float3 QTPFS::PathManager::NextWayPoint(
 	if (!synced)
 		return noPathPoint;
 
+	if (CFlowFieldCache::IsFieldPathID(pathID))
+		return (flowFields.NextWayPoint(owner, pathID, numRetries, point, radius, synced));
+
 	// dangling ID after a re-request failure or regular deletion
 	// return an error-vector so GMT knows it should stop the unit
 	if (pathTypeIt == pathTypes.end())
@@ -1127,6 +1158,12 @@ void QTPFS::PathManager::GetPathWayPoints(
 
 	if (!IsFinalized())
 		return;
+
+	if (CFlowFieldCache::IsFieldPathID(pathID)) {
+		flowFields.GetPathWayPoints(pathID, points, starts);
+		return;
+	}
+
 	if (pathTypeIt == pathTypes.end())
 		return;
 
@@ -10,19 +10,12 @@
 #include "PathCache.hpp"
 #include "PathSearch.hpp"
 #include "System/UnorderedMap.hpp"
+#include "System/UnorderedSet.hpp"
 
 struct MoveDef;
 struct SRectangle;
 class CSolidObject;
 
-#ifdef QTPFS_ENABLE_THREADED_UPDATE
-namespace spring {
-	class mutex;
-	class thread;
-	class condition_variable;
-};
-#endif
-
 namespace QTPFS {
 	struct QTNode;
 	class PathManager: public IPathManager {
@@ -79,16 +72,11 @@ namespace QTPFS {
 		const spring::unordered_map<unsigned int, PathSearchTrace::Execution*>& GetPathTraces() const { return pathTraces; }
 
 	private:
-		void ThreadUpdate();
 		void Load();
 
 		std::uint64_t GetMemFootPrint() const;
 
-		typedef void (PathManager::*MemberFunc)(
-			unsigned int threadNum,
-			unsigned int numThreads,
-			const SRectangle& rect
-		);
+		typedef void (PathManager::*LayerFunc)(unsigned int pathType);
 		typedef spring::unordered_map<unsigned int, unsigned int> PathTypeMap;
 		typedef spring::unordered_map<unsigned int, unsigned int>::iterator PathTypeMapIt;
 		typedef spring::unordered_map<unsigned int, PathSearchTrace::Execution*> PathTraceMap;
@@ -96,23 +84,18 @@ namespace QTPFS {
 		typedef spring::unordered_map<std::uint64_t, IPath*> SharedPathMap;
 		typedef spring::unordered_map<std::uint64_t, IPath*>::iterator SharedPathMapIt;
 
-		typedef std::vector<IPathSearch*> PathSearchVect;
-		typedef std::vector<IPathSearch*>::iterator PathSearchVectIt;
-
-		void SpawnSpringThreads(MemberFunc f, const SRectangle& r);
+		// what happens to a queued search during one update of its layer
+		enum SearchState {
+			SEARCH_STATE_QUEUED   = 0, // stays queued until the next update
+			SEARCH_STATE_DELETED  = 1, // its path was deleted before it ran
+			SEARCH_STATE_ADMITTED = 2, // will execute (counted toward team limits)
+			SEARCH_STATE_SHARED   = 3, // will copy the path of an earlier search
+			SEARCH_STATE_FINISHED = 4,
+			SEARCH_STATE_FAILED   = 5,
+		};
 
 		void InitNodeLayersThreaded(const SRectangle& rect);
 		void UpdateNodeLayersThreaded(const SRectangle& rect);
-		void InitNodeLayersThread(
-			unsigned int threadNum,
-			unsigned int numThreads,
-			const SRectangle& rect
-		);
-		void UpdateNodeLayersThread(
-			unsigned int threadNum,
-			unsigned int numThreads,
-			const SRectangle& rect
-		);
 		void InitNodeLayer(unsigned int layerNum, const SRectangle& r);
 		void UpdateNodeLayer(unsigned int layerNum, const SRectangle& r);
 
@@ -121,7 +104,14 @@ namespace QTPFS {
 		void ExecQueuedNodeLayerUpdates(unsigned int layerNum, bool flushQueue);
 		#endif
 
+		// runs <f> for all layers of the current update on the ThreadPool
+		void ForEachUpdateLayer(LayerFunc f);
+		unsigned int GetLayerWorkLoad(unsigned int pathType) const;
+
+		void InitQueuedSearches(unsigned int pathType);
+		void AdmitQueuedSearches(unsigned int pathType);
 		void ExecuteQueuedSearches(unsigned int pathType);
+		void FinishQueuedSearches(unsigned int pathType);
 		void QueueDeadPathSearches(unsigned int pathType);
 
 		unsigned int QueueSearch(
@@ -134,14 +124,6 @@ namespace QTPFS {
 			const bool synced
 		);
 
-		bool ExecuteSearch(
-			PathSearchVect& searches,
-			PathSearchVectIt& searchesIt,
-			NodeLayer& nodeLayer,
-			PathCache& pathCache,
-			unsigned int pathType
-		);
-
 		bool IsFinalized() const { return (!nodeTrees.empty()); }
 
 
@@ -156,8 +138,17 @@ namespace QTPFS {
 		spring::unordered_map<unsigned int, unsigned int> pathTypes;
 		spring::unordered_map<unsigned int, PathSearchTrace::Execution*> pathTraces;
 
-		// maps "hashes" of executed searches to the found paths
-		spring::unordered_map<std::uint64_t, IPath*> sharedPaths;
+		// per layer: maps "hashes" of executed searches to the found paths
+		std::vector<SharedPathMap> sharedPaths;
+		// per layer: state of each queued search during an update, see SearchState
+		std::vector< std::vector<SearchState> > searchStates;
+		// per layer: offsets identifying the nodes visited by a search
+		std::vector<unsigned int> searchStateOffsets;
+
+		// layers (path-types) processed by the current update
+		std::vector<unsigned int> updateLayers;
+		// hashes of the searches admitted for a layer, see AdmitQueuedSearches
+		spring::unordered_set<std::uint64_t> admittedHashes;
 
 		std::vector<unsigned int> numCurrExecutedSearches;
 		std::vector<unsigned int> numPrevExecutedSearches;
@@ -165,7 +156,6 @@ namespace QTPFS {
 		static unsigned int LAYERS_PER_UPDATE;
 		static unsigned int MAX_TEAM_SEARCHES;
 
-		unsigned int searchStateOffset;
 		unsigned int numTerrainChanges;
 		unsigned int numPathRequests;
 		unsigned int maxNumLeafNodes;
@@ -174,13 +164,6 @@ namespace QTPFS {
 
 		bool layersInited;
 		bool haveCacheDir;
-
-		#ifdef QTPFS_ENABLE_THREADED_UPDATE
-		spring::thread updateThread;
-		spring::mutex mutexThreadUpdate;
-		spring::condition_variable condThreadUpdate;
-		spring::condition_variable condThreadUpdated;
-		#endif
 	};
 }
 
@@ -30,6 +30,7 @@
 #include "System/Log/ILog.h"
 #include "System/SpringMath.h"
 #include "System/TimeProfiler.h"
+#include "System/Threading/ThreadPool.h" // for_mt
 
 
 // reserve 5% of maxNanoParticles for important stuff such as capture and reclaim other teams' units
@@ -55,7 +56,10 @@ CR_REG_METADATA(CProjectileHandler, (
 	CR_MEMBER_UN(lastProjectileCounts),
 
 	CR_MEMBER(freeProjectileIDs),
-	CR_MEMBER(projectileMaps)
+	CR_MEMBER(projectileMaps),
+
+	CR_IGNORED(collisionCandidates),
+	CR_IGNORED(candidateBuffers)
 ))
 
 
@@ -115,6 +119,10 @@ void CProjectileHandler::Init()
 		flyingPieces[modelType].reserve(1000);
 	}
 
+	collisionCandidates.clear();
+	candidateBuffers.clear();
+	candidateBuffers.resize(ThreadPool::MAX_THREADS);
+
 	// register ConfigNotify()
 	configHandler->NotifyOnChange(this, {"MaxParticles", "MaxNanoParticles"});
 }
@@ -157,6 +165,9 @@ void CProjectileHandler::Kill()
 	projectileMaps[ true].clear();
 	projectileMaps[false].clear();
 
+	collisionCandidates.clear();
+	candidateBuffers.clear();
+
 	CCollisionHandler::PrintStats();
 }
 
@@ -600,12 +611,111 @@ void CProjectileHandler::CheckShieldCollisions(
 	}
 }
 
+template<typename T>
+static void CullCollisionCandidates(
+	std::vector<T*>& objects,
+	size_t first,
+	const float3 ppos0,
+	const float3 ppos1,
+	CollisionSphereBatch& spheres,
+	std::vector<unsigned int>& hitMasks
+) {
+	constexpr unsigned int B = CollisionSphereBatch::BLOCK_SIZE;
+
+	if (first == objects.size())
+		return;
+
+	spheres.Clear();
+
+	for (size_t i = first; i < objects.size(); i++) {
+		const T* o = objects[i];
+		const CollisionVolume* v = &o->collisionVolume;
+
+		// piece-trees and discrete tests are not bounded by the volume's
+		// sphere around this center, a sphere at ppos0 always keeps them
+		if (v->DefaultToPieceTree() || !v->UseContHitTest()) {
+			spheres.Add(ppos0, 0.0f);
+			continue;
+		}
+
+		// same center as DetectHit derives from the synced transform
+		spheres.Add(o->GetTransformMatrix(true).Mul(o->relMidPos + v->GetOffsets()), v->GetBoundingRadius());
+	}
+
+	CCollisionHandler::IntersectBoundingSpheres(spheres, ppos0, ppos1, hitMasks);
+
+	// compact in place, keeping the quadfield order
+	size_t n = first;
+
+	for (size_t i = first, j = 0; i < objects.size(); i++, j++) {
+		if ((hitMasks[j / B] & (1u << (j % B))) == 0)
+			continue;
+
+		objects[n++] = objects[i];
+	}
+
+	objects.resize(n);
+}
+
+void CProjectileHandler::GatherCollisionCandidates(const ProjectileContainer& pc)
+{
+	collisionCandidates.clear();
+	collisionCandidates.resize(pc.size());
+
+	for (CollisionCandidateBuffers& buffers: candidateBuffers) {
+		buffers.Clear();
+	}
+
+	// phase 1: read-only, every projectile writes its own entry and appends
+	// to the buffers of the running thread; only the ranges in those depend
+	// on scheduling, not the candidates or their order
+	for_mt(0, pc.size(), [&](const int i) {
+		const CProjectile* p = pc[i];
+
+		if (!p->checkCol) return;
+		if ( p->deleteMe) return;
+
+		const int threadNum = ThreadPool::GetThreadNum();
+
+		CollisionCandidateBuffers& buffers = candidateBuffers[threadNum];
+		CollisionCandidates& cc = collisionCandidates[i];
+
+		cc.pos0 = p->pos;
+		cc.pos1 = p->pos + p->speed;
+		cc.radius = p->speed.w + p->radius;
+		cc.threadNum = threadNum;
+
+		cc.units.x = buffers.units.size();
+		cc.features.x = buffers.features.size();
+		cc.repulsers.x = buffers.repulsers.size();
+
+		quadField.GetUnitsAndFeaturesColVol(cc.pos0, cc.radius, buffers.units, buffers.features, &buffers.repulsers);
+
+		// most objects within the query radius are nowhere near the ray,
+		// drop those before DetectHit inverts a matrix for each of them
+		CullCollisionCandidates(buffers.units, cc.units.x, cc.pos0, cc.pos1, buffers.spheres, buffers.hitMasks);
+		CullCollisionCandidates(buffers.features, cc.features.x, cc.pos0, cc.pos1, buffers.spheres, buffers.hitMasks);
+
+		cc.units.y = buffers.units.size();
+		cc.features.y = buffers.features.size();
+		cc.repulsers.y = buffers.repulsers.size();
+	});
+}
+
 void CProjectileHandler::CheckUnitFeatureCollisions(ProjectileContainer& pc)
 {
 	static std::vector<CUnit*> tempUnits;
 	static std::vector<CFeature*> tempFeatures;
 	static std::vector<CPlasmaRepulser*> tempRepulsers;
 
+	GatherCollisionCandidates(pc);
+
+	// a change to an object or its collision volume (e.g. by a callin
+	// reacting to an earlier hit) can make the gathered and culled
+	// candidates stale, query again for projectiles near a changed quad
+	quadField.NewChangePeriod();
+
+	// phase 2: serial, in container order; hits run callins and change state
 	for (size_t i = 0; i < pc.size(); ++i) {
 		CProjectile* p = pc[i];
 
@@ -615,8 +725,29 @@ void CProjectileHandler::CheckUnitFeatureCollisions(ProjectileContainer& pc)
 		const float3 ppos0 = p->pos;
 		const float3 ppos1 = p->pos + p->speed;
 		// const float3 ppos1 = p->pos + p->dir * (p->speed.w + p->radius);
+		const float radius = p->speed.w + p->radius;
+
+		// projectiles added or moved since the gather pass also need a query
+		const bool gathered = (i < collisionCandidates.size() && collisionCandidates[i].Matches(ppos0, ppos1, radius));
 
-		quadField.GetUnitsAndFeaturesColVol(p->pos, p->speed.w + p->radius, tempUnits, tempFeatures, &tempRepulsers);
+		bool unchanged = gathered;
+
+		if (unchanged) {
+			QuadFieldQuery qfQuery;
+			quadField.GetQuads(qfQuery, ppos0, radius);
+			unchanged = !quadField.AnyQuadChanged(*qfQuery.quads);
+		}
+
+		if (unchanged) {
+			const CollisionCandidates& cc = collisionCandidates[i];
+			const CollisionCandidateBuffers& buffers = candidateBuffers[cc.threadNum];
+
+			tempUnits.assign(buffers.units.begin() + cc.units.x, buffers.units.begin() + cc.units.y);
+			tempFeatures.assign(buffers.features.begin() + cc.features.x, buffers.features.begin() + cc.features.y);
+			tempRepulsers.assign(buffers.repulsers.begin() + cc.repulsers.x, buffers.repulsers.begin() + cc.repulsers.y);
+		} else {
+			quadField.GetUnitsAndFeaturesColVol(p->pos, radius, tempUnits, tempFeatures, &tempRepulsers);
+		}
 
 		CheckShieldCollisions(p, tempRepulsers, ppos0, ppos1); tempRepulsers.clear();
 		CheckUnitCollisions(p, tempUnits, ppos0, ppos1); tempUnits.clear();
@@ -7,8 +7,10 @@
 #include <vector>
 
 #include "Rendering/Models/3DModel.h"
+#include "Sim/Misc/CollisionHandler.h"
 #include "Sim/Projectiles/ProjectileFunctors.h"
 #include "System/float3.h"
+#include "System/type2.h"
 
 // bypass id and event handling for unsynced projectiles (faster)
 #define PH_UNSYNCED_PROJECTILE_EVENTS 0
@@ -98,6 +100,44 @@ public:
 	GroundFlashContainer groundFlashes;
 
 private:
+	// objects near one projectile's ray, see GatherCollisionCandidates
+	struct CollisionCandidates {
+		bool Matches(const float3& p0, const float3& p1, float r) const {
+			return (threadNum >= 0 && pos0.same(p0) && pos1.same(p1) && radius == r);
+		}
+
+		// ray and query radius the candidates were gathered for
+		float3 pos0;
+		float3 pos1;
+		float radius = 0.0f;
+
+		// CollisionCandidateBuffers holding the [begin, end) ranges below
+		int threadNum = -1;
+
+		int2 units;
+		int2 features;
+		int2 repulsers;
+	};
+
+	// filled by one ThreadPool thread per frame
+	struct CollisionCandidateBuffers {
+		void Clear() {
+			units.clear();
+			features.clear();
+			repulsers.clear();
+		}
+
+		std::vector<CUnit*> units;
+		std::vector<CFeature*> features;
+		std::vector<CPlasmaRepulser*> repulsers;
+
+		// scratch space for culling
+		CollisionSphereBatch spheres;
+		std::vector<unsigned int> hitMasks;
+	};
+
+	void GatherCollisionCandidates(const ProjectileContainer&);
+
 	// event-notifiers
 	void CreateProjectile(CProjectile*);
 	void DestroyProjectile(CProjectile*);
@@ -116,6 +156,11 @@ private:
 	// [0] := ID ==> projectile* map for living unsynced projectiles
 	// [1] := ID ==> projectile* map for living   synced projectiles
 	std::vector<CProjectile*> projectileMaps[2];
+
+	// indexed like the container being checked, rebuilt per check
+	std::vector<CollisionCandidates> collisionCandidates;
+	// one per ThreadPool::MAX_THREADS, indexed by ThreadPool::GetThreadNum
+	std::vector<CollisionCandidateBuffers> candidateBuffers;
 };
 
 
@@ -4,6 +4,13 @@
 #include "CobEngine.h"
 #include "CobThread.h"
 #include "CobFile.h"
+#include "System/Config/ConfigHandler.h"
+#include "System/Threading/ThreadPool.h"
+
+#include <algorithm>
+
+
+CONFIG(bool, ThreadedCOB).defaultValue(true).description("Run the script-local part of COB threads on all cores; the simulation result is the same either way.");
 
 
 CR_BIND(CCobEngine, )
@@ -16,11 +23,18 @@ CR_REG_METADATA(CCobEngine, (
 	CR_MEMBER(sleepingThreadIDs),
 	// always null/empty when saving
 	CR_IGNORED(waitingThreadIDs),
+	CR_IGNORED(wokenThreadIDs),
+
+	CR_IGNORED(threadTicks),
+	CR_IGNORED(threadTickOrder),
+	CR_IGNORED(ownerBatches),
 
 	CR_IGNORED(curThread),
 
 	CR_MEMBER(currentTime),
-	CR_MEMBER(threadCounter)
+	CR_MEMBER(threadCounter),
+
+	CR_IGNORED(threaded)
 ))
 
 CR_BIND(CCobEngine::SleepingThread, )
@@ -30,6 +44,24 @@ CR_REG_METADATA(CCobEngine::SleepingThread, (
 ))
 
 
+void CCobEngine::Init()
+{
+	threadInstances.reserve(2048);
+	tickAddedThreads.reserve(128);
+
+	runningThreadIDs.reserve(512);
+	waitingThreadIDs.reserve(512);
+	wokenThreadIDs.reserve(512);
+
+	threadTicks.reserve(1024);
+	threadTickOrder.reserve(1024);
+	ownerBatches.reserve(512);
+
+	threadCounter = 0;
+	threaded = configHandler->GetBool("ThreadedCOB");
+}
+
+
 int CCobEngine::AddThread(CCobThread&& thread)
 {
 	if (thread.GetID() == -1)
@@ -88,8 +120,91 @@ void CCobEngine::TickThread(CCobThread* thread)
 	curThread = nullptr;
 }
 
+void CCobEngine::TickThreads(const std::vector<int>& threadIDs)
+{
+	threadTicks.clear();
+	threadTickOrder.clear();
+	ownerBatches.clear();
+
+	for (const int threadID: threadIDs) {
+		const CCobThread* thread = GetThread(threadID);
+		const int ownerID = (thread != nullptr && !thread->IsGarbage())? thread->cobInst->GetUnit()->id: -1;
+
+		threadTickOrder.push_back(threadTicks.size());
+		threadTicks.push_back({threadID, ownerID, ThreadTick::TICK_PENDING, 0, CCobThread::Init});
+	}
+
+	// group by owner; stable so every batch stays in scheduling order
+	std::stable_sort(threadTickOrder.begin(), threadTickOrder.end(), [&](int a, int b) { return (threadTicks[a].ownerID < threadTicks[b].ownerID); });
+
+	for (size_t i = 0, j = 0; i < threadTickOrder.size(); i = j) {
+		for (j = i + 1; j < threadTickOrder.size() && threadTicks[threadTickOrder[j]].ownerID == threadTicks[threadTickOrder[i]].ownerID; j++);
+
+		// missing and garbage threads are left to TickThread
+		if (threadTicks[threadTickOrder[i]].ownerID == -1)
+			continue;
+
+		ownerBatches.emplace_back(i, j);
+	}
+
+	// phase 1: run each batch until its first thread needs global state; a
+	// batch only touches its own instance (and its threads), so the order
+	// in which batches run does not matter
+	const auto TickBatch = [&](const int batchIdx) {
+		for (int i = ownerBatches[batchIdx].first; i < ownerBatches[batchIdx].second; i++) {
+			ThreadTick& tt = threadTicks[threadTickOrder[i]];
+			CCobThread* thread = GetThread(tt.threadID);
+
+			if (!thread->TickLocal()) {
+				tt.status = ThreadTick::TICK_DEAD;
+				continue;
+			}
+
+			// later threads of this instance must not overtake it
+			if (thread->IsYielded())
+				break;
+
+			tt.status = ThreadTick::TICK_ALIVE;
+			tt.state = thread->GetState();
+			tt.wakeTime = thread->GetWakeTime();
+		}
+	};
+
+	if (threaded) {
+		for_mt(0, ownerBatches.size(), TickBatch);
+	} else {
+		for (size_t i = 0; i < ownerBatches.size(); i++) {
+			TickBatch(i);
+		}
+	}
+
+	// phase 2: in scheduling order, commit what phase 1 deferred and run
+	// all remaining threads (from their yield points) as before
+	for (const ThreadTick& tt: threadTicks) {
+		switch (tt.status) {
+			case ThreadTick::TICK_PENDING: {
+				TickThread(GetThread(tt.threadID));
+			} break;
+			case ThreadTick::TICK_ALIVE: {
+				// state at the time of the tick, the thread may since have been killed
+				if (tt.state == CCobThread::Sleep)
+					sleepingThreadIDs.push(SleepingThread{tt.threadID, tt.wakeTime});
+			} break;
+			case ThreadTick::TICK_DEAD: {
+				// runs the death-callback, if any
+				RemoveThread(tt.threadID);
+			} break;
+			default: {
+				assert(false);
+			} break;
+		}
+	}
+}
+
 void CCobEngine::WakeSleepingThreads()
 {
+	wokenThreadIDs.clear();
+
 	// check on the sleeping threads, remove any whose owner died
 	while (!sleepingThreadIDs.empty()) {
 		CCobThread* zzzThread = GetThread((sleepingThreadIDs.top()).id);
@@ -106,22 +221,24 @@ void CCobEngine::WakeSleepingThreads()
 		// remove executing thread from the queue
 		sleepingThreadIDs.pop();
 
-		// wake up the thread and tick it (if not dead)
-		// this can quite possibly re-add the thread to <sleepingThreadIDs>
-		// again, but any thread is guaranteed to sleep for at least 1 tick
+		// wake up the thread and tick it below (dead ones are just removed
+		// there, in order); this can quite possibly re-add the thread to
+		// <sleepingThreadIDs> but not for this tick
 		switch (zzzThread->GetState()) {
 			case CCobThread::Sleep: {
 				zzzThread->SetState(CCobThread::Run);
-				TickThread(zzzThread);
+				wokenThreadIDs.push_back(zzzThread->GetID());
 			} break;
 			case CCobThread::Dead: {
-				RemoveThread(zzzThread->GetID());
+				wokenThreadIDs.push_back(zzzThread->GetID());
 			} break;
 			default: {
 				LOG_L(L_ERROR, "[COBEngine::%s] unknown state %d for thread %d", __func__, zzzThread->GetState(), zzzThread->GetID());
 			} break;
 		}
 	}
+
+	TickThreads(wokenThreadIDs);
 }
 
 void CCobEngine::Tick(int deltaTime)
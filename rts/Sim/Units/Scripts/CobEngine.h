@@ -6,6 +6,12 @@
 /*
  * Simple VM responsible for "scheduling" and running COB threads.
  * It also manages reading and caching of the actual .cob files.
+ *
+ * Threads due in a tick are run in two phases (see TickThreads): first
+ * the threads of each script instance are advanced in parallel as far as
+ * they only touch that instance, then everything with global side-effects
+ * (Lua calls, SFX, unit state changes, scheduling, ...) is run serially in
+ * the original thread order. Results do not depend on the thread count.
  */
 
 #include <vector>
@@ -40,16 +46,24 @@ private:
 		}
 	};
 
-public:
-	void Init() {
-		threadInstances.reserve(2048);
-		tickAddedThreads.reserve(128);
+	// outcome of the parallel phase for one thread
+	struct ThreadTick {
+		enum {
+			TICK_PENDING, // not (fully) run yet, continues in the serial phase
+			TICK_ALIVE,
+			TICK_DEAD,
+		};
 
-		runningThreadIDs.reserve(512);
-		waitingThreadIDs.reserve(512);
+		int threadID;
+		int ownerID;
+		int status;
+		int wakeTime;
 
-		threadCounter = 0;
-	}
+		CCobThread::State state;
+	};
+
+public:
+	void Init();
 	void Kill() {
 		// threadInstances is never explicitly iterated, so
 		// calling clear_unordered_map (between reloads) is
@@ -59,6 +73,11 @@ public:
 
 		runningThreadIDs.clear();
 		waitingThreadIDs.clear();
+		wokenThreadIDs.clear();
+
+		threadTicks.clear();
+		threadTickOrder.clear();
+		ownerBatches.clear();
 
 		while (!sleepingThreadIDs.empty()) {
 			sleepingThreadIDs.pop();
@@ -108,15 +127,17 @@ public:
 	void ScheduleThread(const CCobThread* thread);
 	void SanityCheckThreads(const CCobInstance* owner);
 
+	bool IsThreaded() const { return threaded; }
+	void SetThreaded(bool b) { threaded = b; }
+
 private:
 	void TickThread(CCobThread* thread);
+	void TickThreads(const std::vector<int>& threadIDs);
 
 	void WakeSleepingThreads();
 	void TickRunningThreads() {
 		// advance all currently running threads
-		for (const int threadID: runningThreadIDs) {
-			TickThread(GetThread(threadID));
-		}
+		TickThreads(runningThreadIDs);
 
 		// a thread can never go from running->running, so clear the list
 		// note: if preemption was to be added, this would no longer hold
@@ -136,6 +157,13 @@ private:
 
 	std::vector<int> runningThreadIDs;
 	std::vector<int> waitingThreadIDs;
+	std::vector<int> wokenThreadIDs;
+
+	// TickThreads scratch; batches are [begin, end) ranges of threadTickOrder
+	// (threadTicks indices sorted by owner), each ticked by a single worker
+	std::vector<ThreadTick> threadTicks;
+	std::vector<int> threadTickOrder;
+	std::vector<std::pair<int, int>> ownerBatches;
 
 	// stores <id, waketime> pairs s.t. after waking up the ID can be checked
 	// for validity; thread owner might get removed while a thread is sleeping
@@ -145,6 +173,8 @@ private:
 
 	int currentTime = 0;
 	int threadCounter = 0;
+
+	bool threaded = true;
 };
 
 
@@ -196,6 +196,101 @@ CCobFile::CCobFile(CFileHandler& in, const std::string& scriptName)
 
 		scriptIndex[pair.second] = fn;
 	}
+
+	DecodeCode();
+}
+
+
+void CCobFile::DecodeCode()
+{
+	const int numWords = code.size();
+
+	insts.clear();
+	insts.resize(numWords + 1, {COB_OP_BAD_PC, 1, COB_LOCAL_NEVER, 0, 0});
+
+	for (int i = 0; i < numWords; i++) {
+		CobInstruction& inst = insts[i];
+
+		switch (code[i]) {
+			#define COB_OP_DECODE(name, raw, numOperands, locality) \
+			case raw: { inst = {COB_OP_##name, 1 + numOperands, COB_LOCAL_##locality, 0, 0}; } break;
+			COB_OPCODE_LIST(COB_OP_DECODE)
+			#undef COB_OP_DECODE
+
+			default: {
+				inst = {COB_OP_UNKNOWN, 1, COB_LOCAL_NEVER, 0, 0};
+			} break;
+		}
+
+		// running off the end while fetching operands (mantis #5981)
+		if ((i + inst.size) > numWords) {
+			inst = {COB_OP_BAD_PC, 1, COB_LOCAL_NEVER, 0, 0};
+			continue;
+		}
+
+		inst.a = (inst.size > 1)? code[i + 1]: 0;
+		inst.b = (inst.size > 2)? code[i + 2]: 0;
+
+		switch (inst.op) {
+			case COB_OP_CALL: {
+				if (static_cast<size_t>(inst.a) >= scriptNames.size()) {
+					inst = {COB_OP_UNKNOWN, inst.size, COB_LOCAL_NEVER, 0, 0};
+					break;
+				}
+
+				// used to be rewritten in-place the first time the call was executed
+				if (scriptNames[inst.a].find("lua_") == 0) {
+					inst.op = COB_OP_LUA_CALL;
+					inst.locality = COB_LOCAL_NEVER;
+				} else {
+					inst.op = COB_OP_REAL_CALL;
+					inst.locality = COB_LOCAL_ALWAYS;
+				}
+			} break;
+			case COB_OP_REAL_CALL:
+			case COB_OP_START: {
+				if (static_cast<size_t>(inst.a) >= scriptLengths.size())
+					inst = {COB_OP_UNKNOWN, inst.size, COB_LOCAL_NEVER, 0, 0};
+			} break;
+
+			case COB_OP_JUMP:
+			case COB_OP_JUMP_NOT_EQUAL: {
+				if (static_cast<unsigned int>(inst.a) >= static_cast<unsigned int>(numWords))
+					inst.a = numWords;
+			} break;
+
+			case COB_OP_PUSH_STATIC: {
+				if (inst.a < 0 || inst.a >= numStaticVars)
+					inst.op = COB_OP_NOP;
+			} break;
+			case COB_OP_POP_STATIC: {
+				if (inst.a < 0 || inst.a >= numStaticVars)
+					inst.op = COB_OP_POP_NOP;
+			} break;
+
+			default: {
+			} break;
+		}
+	}
+
+	// fuse PUSH_CONSTANT k + <binary op> into <binary op>_CONST k; the op's own
+	// entry stays intact for jumps landing on it
+	for (int i = 0, n = numWords - COB_SIZE_PUSH_CONSTANT; i < n; i++) {
+		CobInstruction& inst = insts[i];
+
+		if (inst.op != COB_OP_PUSH_CONSTANT)
+			continue;
+
+		switch (insts[i + COB_SIZE_PUSH_CONSTANT].op) {
+			#define COB_OP_FUSE(name) \
+			case COB_OP_##name: { inst = {COB_OP_##name##_CONST, COB_SIZE_##name##_CONST, COB_LOCAL_ALWAYS, inst.a, 0}; } break;
+			COB_BINARY_OPCODE_LIST(COB_OP_FUSE)
+			#undef COB_OP_FUSE
+
+			default: {
+			} break;
+		}
+	}
 }
 
 
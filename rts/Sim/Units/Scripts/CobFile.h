@@ -8,6 +8,7 @@
 #include <string>
 
 #include "Lua/LuaHashString.h"
+#include "CobInstructions.h"
 #include "CobScriptNames.h"
 #include "System/UnorderedMap.hpp"
 
@@ -23,6 +24,7 @@ public:
 		numStaticVars = f.numStaticVars;
 
 		code = std::move(f.code);
+		insts = std::move(f.insts);
 		scriptNames = std::move(f.scriptNames);
 		scriptOffsets = std::move(f.scriptOffsets);
 
@@ -39,10 +41,15 @@ public:
 
 	int GetFunctionId(const std::string& name);
 
+private:
+	void DecodeCode();
+
 public:
 	int numStaticVars = 0;
 
 	std::vector<int> code;
+	/// code.size() + 1 entries, the last is always COB_OP_BAD_PC
+	std::vector<CobInstruction> insts;
 	std::vector<std::string> scriptNames;
 	std::vector<int> scriptOffsets;
 	/// Assumes that the scripts are sorted by offset in the file
@@ -0,0 +1,163 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef COB_INSTRUCTIONS_H
+#define COB_INSTRUCTIONS_H
+
+#include <cstdint>
+
+// Command documentation from http://visualta.tauniverse.com/Downloads/cob-commands.txt
+// And some information from basm0.8 source (basm ops.txt)
+//
+// name, raw opcode, number of operand words, locality (see CCobThread::TickLocal)
+// ALWAYS ops only touch the thread and its own instance, CHECK ops are local
+// depending on their operands or the stack (CCobThread::IsLocalInstruction)
+#define COB_OPCODE_LIST(X)                                  \
+	/* Model interaction */                                 \
+	X(MOVE,                 0x10001000, 2, CHECK )          \
+	X(TURN,                 0x10002000, 2, CHECK )          \
+	X(SPIN,                 0x10003000, 2, CHECK )          \
+	X(STOP_SPIN,            0x10004000, 2, CHECK )          \
+	X(SHOW,                 0x10005000, 1, CHECK )          \
+	X(HIDE,                 0x10006000, 1, CHECK )          \
+	X(CACHE,                0x10007000, 1, ALWAYS)          \
+	X(DONT_CACHE,           0x10008000, 1, ALWAYS)          \
+	X(MOVE_NOW,             0x1000B000, 2, CHECK )          \
+	X(TURN_NOW,             0x1000C000, 2, CHECK )          \
+	X(SHADE,                0x1000D000, 1, ALWAYS)          \
+	X(DONT_SHADE,           0x1000E000, 1, ALWAYS)          \
+	X(EMIT_SFX,             0x1000F000, 1, NEVER )          \
+	/* Blocking operations */                               \
+	X(WAIT_TURN,            0x10011000, 2, ALWAYS)          \
+	X(WAIT_MOVE,            0x10012000, 2, ALWAYS)          \
+	X(SLEEP,                0x10013000, 0, ALWAYS)          \
+	/* Stack manipulation */                                \
+	X(PUSH_CONSTANT,        0x10021001, 1, ALWAYS)          \
+	X(PUSH_LOCAL_VAR,       0x10021002, 1, ALWAYS)          \
+	X(PUSH_STATIC,          0x10021004, 1, ALWAYS)          \
+	X(CREATE_LOCAL_VAR,     0x10022000, 0, ALWAYS)          \
+	X(POP_LOCAL_VAR,        0x10023002, 1, ALWAYS)          \
+	X(POP_STATIC,           0x10023004, 1, ALWAYS)          \
+	X(POP_STACK,            0x10024000, 0, ALWAYS)          \
+	/* Arithmetic operations */                             \
+	X(ADD,                  0x10031000, 0, ALWAYS)          \
+	X(SUB,                  0x10032000, 0, ALWAYS)          \
+	X(MUL,                  0x10033000, 0, ALWAYS)          \
+	X(DIV,                  0x10034000, 0, CHECK )          \
+	X(MOD,                  0x10034001, 0, CHECK )          \
+	X(BITWISE_AND,          0x10035000, 0, ALWAYS)          \
+	X(BITWISE_OR,           0x10036000, 0, ALWAYS)          \
+	X(BITWISE_XOR,          0x10037000, 0, ALWAYS)          \
+	X(BITWISE_NOT,          0x10038000, 0, ALWAYS)          \
+	/* Native function calls */                             \
+	X(RAND,                 0x10041000, 0, NEVER )          \
+	X(GET_UNIT_VALUE,       0x10042000, 0, CHECK )          \
+	X(GET,                  0x10043000, 0, CHECK )          \
+	/* Comparison */                                        \
+	X(SET_LESS,             0x10051000, 0, ALWAYS)          \
+	X(SET_LESS_OR_EQUAL,    0x10052000, 0, ALWAYS)          \
+	X(SET_GREATER,          0x10053000, 0, ALWAYS)          \
+	X(SET_GREATER_OR_EQUAL, 0x10054000, 0, ALWAYS)          \
+	X(SET_EQUAL,            0x10055000, 0, ALWAYS)          \
+	X(SET_NOT_EQUAL,        0x10056000, 0, ALWAYS)          \
+	X(LOGICAL_AND,          0x10057000, 0, ALWAYS)          \
+	X(LOGICAL_OR,           0x10058000, 0, ALWAYS)          \
+	X(LOGICAL_XOR,          0x10059000, 0, ALWAYS)          \
+	X(LOGICAL_NOT,          0x1005A000, 0, ALWAYS)          \
+	/* Flow control */                                      \
+	X(START,                0x10061000, 2, NEVER )          \
+	X(CALL,                 0x10062000, 2, NEVER )          \
+	X(REAL_CALL,            0x10062001, 2, ALWAYS)          \
+	X(LUA_CALL,             0x10062002, 2, NEVER )          \
+	X(JUMP,                 0x10064000, 1, ALWAYS)          \
+	X(RETURN,               0x10065000, 0, ALWAYS)          \
+	X(JUMP_NOT_EQUAL,       0x10066000, 1, ALWAYS)          \
+	X(SIGNAL,               0x10067000, 0, ALWAYS)          \
+	X(SET_SIGNAL_MASK,      0x10068000, 0, ALWAYS)          \
+	/* Piece destruction */                                 \
+	X(EXPLODE,              0x10071000, 1, NEVER )          \
+	X(PLAY_SOUND,           0x10072000, 1, NEVER )          \
+	/* Special functions */                                 \
+	X(SET,                  0x10082000, 0, CHECK )          \
+	X(ATTACH,               0x10083000, 0, NEVER )          \
+	X(DROP,                 0x10084000, 0, NEVER )
+
+
+// binary operators that also have a *_CONST variant taking their right-hand
+// side from an immediately preceding PUSH_CONSTANT (fused by CCobFile), the
+// most common pattern in compiled scripts
+#define COB_BINARY_OPCODE_LIST(X) \
+	X(ADD                 )       \
+	X(SUB                 )       \
+	X(MUL                 )       \
+	X(BITWISE_AND         )       \
+	X(BITWISE_OR          )       \
+	X(BITWISE_XOR         )       \
+	X(SET_LESS            )       \
+	X(SET_LESS_OR_EQUAL   )       \
+	X(SET_GREATER         )       \
+	X(SET_GREATER_OR_EQUAL)       \
+	X(SET_EQUAL           )       \
+	X(SET_NOT_EQUAL       )       \
+	X(LOGICAL_AND         )       \
+	X(LOGICAL_OR          )       \
+	X(LOGICAL_XOR         )
+
+
+enum CobLocality: uint8_t {
+	COB_LOCAL_NEVER  = 0,
+	COB_LOCAL_ALWAYS = 1,
+	COB_LOCAL_CHECK  = 2,
+};
+
+enum CobOpID: uint8_t {
+	#define COB_OP_ENUM(name, raw, numOperands, locality) COB_OP_##name,
+	COB_OPCODE_LIST(COB_OP_ENUM)
+	#undef COB_OP_ENUM
+
+	// not produced by scripts, only by CCobFile's decoder
+	#define COB_OP_ENUM_CONST(name) COB_OP_##name##_CONST,
+	COB_BINARY_OPCODE_LIST(COB_OP_ENUM_CONST)
+	#undef COB_OP_ENUM_CONST
+
+	COB_OP_NOP,     ///< PUSH_STATIC out of range
+	COB_OP_POP_NOP, ///< POP_STATIC out of range
+	COB_OP_BAD_PC,  ///< past the end of the code (or an operand would be)
+	COB_OP_UNKNOWN, ///< unknown raw opcode or invalid call target
+
+	COB_OP_COUNT
+};
+
+// instruction sizes in code words, known statically so the interpreter's
+// program counter does not depend on loading the current instruction
+enum CobOpSize: uint8_t {
+	#define COB_OP_SIZE(name, raw, numOperands, locality) COB_SIZE_##name = 1 + numOperands,
+	COB_OPCODE_LIST(COB_OP_SIZE)
+	#undef COB_OP_SIZE
+
+	#define COB_OP_SIZE_CONST(name) COB_SIZE_##name##_CONST = COB_SIZE_PUSH_CONSTANT + COB_SIZE_##name,
+	COB_BINARY_OPCODE_LIST(COB_OP_SIZE_CONST)
+	#undef COB_OP_SIZE_CONST
+
+	COB_SIZE_NOP     = COB_SIZE_PUSH_STATIC,
+	COB_SIZE_POP_NOP = COB_SIZE_POP_STATIC,
+	COB_SIZE_BAD_PC  = 1,
+};
+
+
+/**
+ * Pre-decoded form of the raw instruction starting at the same index in
+ * CCobFile::code; operands are read once at load-time and call targets
+ * resolved, so the interpreter neither re-fetches nor bounds-checks them.
+ * Every code word gets one (a jump may land on any of them), which keeps
+ * program counters and return addresses identical to raw code offsets.
+ */
+struct CobInstruction {
+	uint8_t op;       ///< CobOpID
+	uint8_t size;     ///< in code words, including the opcode (CobOpSize)
+	uint8_t locality; ///< CobLocality
+
+	int a; ///< first operand (piece, constant, variable index, jump target, script)
+	int b; ///< second operand (axis, argument count)
+};
+
+#endif // COB_INSTRUCTIONS_H
@@ -5,9 +5,12 @@
 #include "CobFile.h"
 #include "CobInstance.h"
 #include "CobEngine.h"
+#include "CobInstructions.h"
 #include "Sim/Misc/GlobalConstants.h"
 #include "Sim/Misc/GlobalSynced.h"
 
+#include <stdexcept>
+
 CR_BIND(CCobThread, )
 
 CR_REG_METADATA(CCobThread, (
@@ -30,6 +33,7 @@ CR_REG_METADATA(CCobThread, (
 	CR_MEMBER(dataStackSize),
 
 	CR_IGNORED(errorCounter),
+	CR_IGNORED(yielded),
 
 	CR_MEMBER(cbType),
 	CR_MEMBER(state),
@@ -198,86 +202,6 @@ void CCobThread::InitStack(unsigned int n, CCobThread* t)
 
 
 
-// Command documentation from http://visualta.tauniverse.com/Downloads/cob-commands.txt
-// And some information from basm0.8 source (basm ops.txt)
-
-// Model interaction
-constexpr int MOVE       = 0x10001000;
-constexpr int TURN       = 0x10002000;
-constexpr int SPIN       = 0x10003000;
-constexpr int STOP_SPIN  = 0x10004000;
-constexpr int SHOW       = 0x10005000;
-constexpr int HIDE       = 0x10006000;
-constexpr int CACHE      = 0x10007000;
-constexpr int DONT_CACHE = 0x10008000;
-constexpr int MOVE_NOW   = 0x1000B000;
-constexpr int TURN_NOW   = 0x1000C000;
-constexpr int SHADE      = 0x1000D000;
-constexpr int DONT_SHADE = 0x1000E000;
-constexpr int EMIT_SFX   = 0x1000F000;
-
-// Blocking operations
-constexpr int WAIT_TURN  = 0x10011000;
-constexpr int WAIT_MOVE  = 0x10012000;
-constexpr int SLEEP      = 0x10013000;
-
-// Stack manipulation
-constexpr int PUSH_CONSTANT    = 0x10021001;
-constexpr int PUSH_LOCAL_VAR   = 0x10021002;
-constexpr int PUSH_STATIC      = 0x10021004;
-constexpr int CREATE_LOCAL_VAR = 0x10022000;
-constexpr int POP_LOCAL_VAR    = 0x10023002;
-constexpr int POP_STATIC       = 0x10023004;
-constexpr int POP_STACK        = 0x10024000; ///< Not sure what this is supposed to do
-
-// Arithmetic operations
-constexpr int ADD         = 0x10031000;
-constexpr int SUB         = 0x10032000;
-constexpr int MUL         = 0x10033000;
-constexpr int DIV         = 0x10034000;
-constexpr int MOD		  = 0x10034001; ///< spring specific
-constexpr int BITWISE_AND = 0x10035000;
-constexpr int BITWISE_OR  = 0x10036000;
-constexpr int BITWISE_XOR = 0x10037000;
-constexpr int BITWISE_NOT = 0x10038000;
-
-// Native function calls
-constexpr int RAND           = 0x10041000;
-constexpr int GET_UNIT_VALUE = 0x10042000;
-constexpr int GET            = 0x10043000;
-
-// Comparison
-constexpr int SET_LESS             = 0x10051000;
-constexpr int SET_LESS_OR_EQUAL    = 0x10052000;
-constexpr int SET_GREATER          = 0x10053000;
-constexpr int SET_GREATER_OR_EQUAL = 0x10054000;
-constexpr int SET_EQUAL            = 0x10055000;
-constexpr int SET_NOT_EQUAL        = 0x10056000;
-constexpr int LOGICAL_AND          = 0x10057000;
-constexpr int LOGICAL_OR           = 0x10058000;
-constexpr int LOGICAL_XOR          = 0x10059000;
-constexpr int LOGICAL_NOT          = 0x1005A000;
-
-// Flow control
-constexpr int START           = 0x10061000;
-constexpr int CALL            = 0x10062000; ///< converted when executed
-constexpr int REAL_CALL       = 0x10062001; ///< spring custom
-constexpr int LUA_CALL        = 0x10062002; ///< spring custom
-constexpr int JUMP            = 0x10064000;
-constexpr int RETURN          = 0x10065000;
-constexpr int JUMP_NOT_EQUAL  = 0x10066000;
-constexpr int SIGNAL          = 0x10067000;
-constexpr int SET_SIGNAL_MASK = 0x10068000;
-
-// Piece destruction
-constexpr int EXPLODE    = 0x10071000;
-constexpr int PLAY_SOUND = 0x10072000;
-
-// Special functions
-constexpr int SET    = 0x10082000;
-constexpr int ATTACH = 0x10083000;
-constexpr int DROP   = 0x10084000;
-
 // Indices for SET, GET, and GET_UNIT_VALUE for LUA return values
 #define LUA0 110 // (LUA0 returns the lua call status, 0 or 1)
 #define LUA1 111
@@ -290,575 +214,501 @@ constexpr int DROP   = 0x10084000;
 #define LUA8 118
 #define LUA9 119
 
-#if 0
-#define GET_LONG_PC() (cobFile->code[pc++])
+// direct-threaded dispatch needs the labels-as-values extension, else use a switch
+#if defined(__GNUC__)
+	#define COB_DIRECT_THREADED 1
 #else
-// mantis #5981
-#define GET_LONG_PC() (cobFile->code.at(pc++))
+	#define COB_DIRECT_THREADED 0
 #endif
 
 
-#if 0
-static const char* GetOpcodeName(int opcode)
+static constexpr bool IsLuaArgIndex(int i) { return (i >= LUA0 && i <= LUA9); }
+
+
+bool CCobThread::InFireScript() const
 {
-	switch (opcode) {
-		case MOVE: return "move";
-		case TURN: return "turn";
-		case SPIN: return "spin";
-		case STOP_SPIN: return "stop-spin";
-		case SHOW: return "show";
-		case HIDE: return "hide";
-		case CACHE: return "cache";
-		case DONT_CACHE: return "dont-cache";
-		case TURN_NOW: return "turn-now";
-		case MOVE_NOW: return "move-now";
-		case SHADE: return "shade";
-		case DONT_SHADE: return "dont-shade";
-		case EMIT_SFX: return "sfx";
-
-		case WAIT_TURN: return "wait-for-turn";
-		case WAIT_MOVE: return "wait-for-move";
-		case SLEEP: return "sleep";
-
-		case PUSH_CONSTANT: return "pushc";
-		case PUSH_LOCAL_VAR: return "pushl";
-		case PUSH_STATIC: return "pushs";
-		case CREATE_LOCAL_VAR: return "clv";
-		case POP_LOCAL_VAR: return "popl";
-		case POP_STATIC: return "pops";
-		case POP_STACK: return "pop-stack";
-
-		case ADD: return "add";
-		case SUB: return "sub";
-		case MUL: return "mul";
-		case DIV: return "div";
-		case MOD: return "mod";
-		case BITWISE_AND: return "and";
-		case BITWISE_OR: return "or";
-		case BITWISE_XOR: return "xor";
-		case BITWISE_NOT: return "not";
-
-		case RAND: return "rand";
-		case GET_UNIT_VALUE: return "getuv";
-		case GET: return "get";
-
-		case SET_LESS: return "setl";
-		case SET_LESS_OR_EQUAL: return "setle";
-		case SET_GREATER: return "setg";
-		case SET_GREATER_OR_EQUAL: return "setge";
-		case SET_EQUAL: return "sete";
-		case SET_NOT_EQUAL: return "setne";
-		case LOGICAL_AND: return "land";
-		case LOGICAL_OR: return "lor";
-		case LOGICAL_XOR: return "lxor";
-		case LOGICAL_NOT: return "neg";
-
-		case START: return "start";
-		case CALL: return "call";
-		case REAL_CALL: return "call";
-		case LUA_CALL: return "lua_call";
-		case JUMP: return "jmp";
-		case RETURN: return "return";
-		case JUMP_NOT_EQUAL: return "jne";
-		case SIGNAL: return "signal";
-		case SET_SIGNAL_MASK: return "mask";
-
-		case EXPLODE: return "explode";
-		case PLAY_SOUND: return "play-sound";
-
-		case SET: return "set";
-		case ATTACH: return "attach";
-		case DROP: return "drop";
+	for (int i = 0; i < MAX_WEAPONS_PER_UNIT; ++i) {
+		if (LocalFunctionID() == cobFile->scriptIndex[COBFN_FirePrimary + COBFN_Weapon_Funcs * i])
+			return true;
 	}
 
-	return "unknown";
+	return false;
 }
-#endif
 
+bool CCobThread::IsLocalInstruction(const CobInstruction& inst) const
+{
+	switch (inst.locality) {
+		case COB_LOCAL_ALWAYS: { return true ; } break;
+		case COB_LOCAL_NEVER : { return false; } break;
+		default: {} break;
+	}
+
+	// NB: nothing was popped yet
+	switch (inst.op) {
+		// division by zero logs an error, leave that to the serial phase
+		case COB_OP_DIV:
+		case COB_OP_MOD: {
+			return (PeekDataStack(0) != 0);
+		} break;
+
+		// only the Lua-argument registers are thread-local
+		case COB_OP_GET_UNIT_VALUE: { return (IsLuaArgIndex(PeekDataStack(0))); } break;
+		case COB_OP_GET: { return (IsLuaArgIndex(PeekDataStack(4))); } break;
+		case COB_OP_SET: { return (IsLuaArgIndex(PeekDataStack(1))); } break;
+
+		// invalid pieces make CUnitScript report errors via cobEngine
+		case COB_OP_MOVE_NOW:
+		case COB_OP_TURN_NOW:
+		case COB_OP_HIDE: {
+			return (cobInst->PieceExists(inst.a));
+		} break;
+		case COB_OP_SHOW: {
+			return (cobInst->PieceExists(inst.a) && !InFireScript());
+		} break;
+
+		case COB_OP_TURN: { return (cobInst->IsLocalAnimChange(CUnitScript::ATurn, inst.a, inst.b)); } break;
+		case COB_OP_SPIN: { return (cobInst->IsLocalAnimChange(CUnitScript::ASpin, inst.a, inst.b)); } break;
+		case COB_OP_MOVE: { return (cobInst->IsLocalAnimChange(CUnitScript::AMove, inst.a, inst.b)); } break;
+
+		case COB_OP_STOP_SPIN: {
+			// an instant stop removes the animation, which can reschedule threads
+			return (PeekDataStack(0) > 0 || !cobInst->IsInAnimation(CUnitScript::ASpin, inst.a, inst.b));
+		} break;
+
+		default: {
+		} break;
+	}
+
+	return false;
+}
+
+
+bool CCobThread::Tick() { return (TickImpl<false>()); }
+bool CCobThread::TickLocal() { return (TickImpl<true>()); }
 
-bool CCobThread::Tick()
+template<bool localOnly>
+bool CCobThread::TickImpl()
 {
 	assert(state != Sleep);
 	assert(cobInst != nullptr);
 
+	yielded = false;
+
 	if (IsDead())
 		return false;
 
 	state = Run;
 
-	int r1, r2, r3, r4, r5, r6;
+	const CobInstruction* insts = cobFile->insts.data();
+	const CobInstruction* inst = nullptr;
+
+	// the last instruction is always COB_OP_BAD_PC
+	const unsigned int maxPC = cobFile->insts.size() - 1;
+	const auto ClampPC = [maxPC](int addr) { return int(std::min(static_cast<unsigned int>(addr), maxPC)); };
 
-	while (state == Run) {
-		const int opcode = GET_LONG_PC();
+	pc = ClampPC(pc);
 
-		switch (opcode) {
-			case PUSH_CONSTANT: {
-				r1 = GET_LONG_PC();
-				PushDataStack(r1);
-			} break;
-			case SLEEP: {
-				r1 = PopDataStack();
-				wakeTime = cobEngine->GetCurrentTime() + r1;
-				state = Sleep;
+	// in local mode, stop in front of the first non-local instruction
+	// so the serial phase resumes there
+	#define COB_FETCH()                                                                        \
+	{                                                                                          \
+		inst = &insts[pc];                                                                     \
+		if (localOnly && inst->locality != COB_LOCAL_ALWAYS && !IsLocalInstruction(*inst)) {   \
+			yielded = true;                                                                    \
+			return true;                                                                       \
+		}                                                                                      \
+	}
 
+	#if (COB_DIRECT_THREADED == 1)
+	static const void* dispatchTable[COB_OP_COUNT] = {
+		#define COB_OP_ADDR(name, raw, numOperands, locality) &&op_##name,
+		COB_OPCODE_LIST(COB_OP_ADDR)
+		#undef COB_OP_ADDR
+		#define COB_OP_ADDR_CONST(name) &&op_##name##_CONST,
+		COB_BINARY_OPCODE_LIST(COB_OP_ADDR_CONST)
+		#undef COB_OP_ADDR_CONST
+		&&op_NOP,
+		&&op_POP_NOP,
+		&&op_BAD_PC,
+		&&op_UNKNOWN,
+	};
+
+	#define COB_LABEL(name) op_##name:
+	#define COB_NEXT() { COB_FETCH(); goto *dispatchTable[inst->op]; }
+	#else
+	#define COB_LABEL(name) case COB_OP_##name:
+	#define COB_NEXT() { continue; }
+	#endif
+
+	// advance past the instruction up-front like the old fetch-as-you-go
+	// interpreter, ShowError (also via CUnitScript) reports pc - 1
+	#define COB_OP(name) COB_LABEL(name) pc += COB_SIZE_##name;
+
+	// for instructions that call out of the interpreter, which can kill this
+	// thread (e.g. through CCobInstance::Signal) or otherwise change its state
+	#define COB_NEXT_CHECKED() { if (state != Run) goto done; COB_NEXT(); }
+
+	// <rhs> of the fused variant is the constant, unless the stack was full
+	// and the (former) PUSH_CONSTANT would have been dropped
+	#define COB_BINARY_OP(name, expr)                                                         \
+		COB_OP(name) {                                                                        \
+			const int rhs = PopDataStack();                                                   \
+			const int lhs = PopDataStack();                                                   \
+			PushDataStack(expr);                                                              \
+		} COB_NEXT();                                                                         \
+		COB_OP(name##_CONST) {                                                                \
+			const int rhs = (dataStackSize < dataStack.size())? inst->a: PopDataStack();      \
+			const int lhs = PopDataStack();                                                   \
+			PushDataStack(expr);                                                              \
+		} COB_NEXT();
+
+
+	#if (COB_DIRECT_THREADED == 1)
+	COB_NEXT();
+	{
+	#else
+	while (true) {
+		COB_FETCH();
+
+		switch (inst->op) {
+	#endif
+		COB_OP(PUSH_CONSTANT) {
+			PushDataStack(inst->a);
+		} COB_NEXT();
+		COB_OP(SLEEP) {
+			wakeTime = cobEngine->GetCurrentTime() + PopDataStack();
+			state = Sleep;
+
+			// CCobEngine::TickThreads schedules locally ticked threads in order
+			if (!localOnly)
 				cobEngine->ScheduleThread(this);
-				return true;
-			} break;
-			case SPIN: {
-				r1 = GET_LONG_PC();
-				r2 = GET_LONG_PC();
-				r3 = PopDataStack();         // speed
-				r4 = PopDataStack();         // accel
-				cobInst->Spin(r1, r2, r3, r4);
-			} break;
-			case STOP_SPIN: {
-				r1 = GET_LONG_PC();
-				r2 = GET_LONG_PC();
-				r3 = PopDataStack();         // decel
-
-				cobInst->StopSpin(r1, r2, r3);
-			} break;
-			case RETURN: {
-				retCode = PopDataStack();
-
-				if (LocalReturnAddr() == -1) {
-					state = Dead;
-
-					// leave values intact on stack in case caller wants to check them
-					// callStackSize -= 1;
-					return false;
-				}
-
-				// return to caller
-				pc = LocalReturnAddr();
-				dataStackSize = std::min(dataStackSize, LocalStackFrame());
-				callStackSize -= 1;
-			} break;
-
-
-			case SHADE: {
-				r1 = GET_LONG_PC();
-			} break;
-			case DONT_SHADE: {
-				r1 = GET_LONG_PC();
-			} break;
-			case CACHE: {
-				r1 = GET_LONG_PC();
-			} break;
-			case DONT_CACHE: {
-				r1 = GET_LONG_PC();
-			} break;
-
-
-			case CALL: {
-				r1 = GET_LONG_PC();
-				pc--;
-
-				if (cobFile->scriptNames[r1].find("lua_") == 0) {
-					cobFile->code[pc - 1] = LUA_CALL;
-					LuaCall();
-					break;
-				}
-
-				cobFile->code[pc - 1] = REAL_CALL;
-
-				// fall-through
-			}
-			case REAL_CALL: {
-				r1 = GET_LONG_PC();
-				r2 = GET_LONG_PC();
-
-				// do not call zero-length functions
-				if (cobFile->scriptLengths[r1] == 0)
-					break;
-
-				CallInfo& ci = PushCallStackRef();
-				ci.functionId = r1;
-				ci.returnAddr = pc;
-				ci.stackTop = dataStackSize - r2;
-
-				paramCount = r2;
-
-				// call cobFile->scriptNames[r1]
-				pc = cobFile->scriptOffsets[r1];
-			} break;
-			case LUA_CALL: {
-				LuaCall();
-			} break;
-
-
-			case POP_STATIC: {
-				r1 = GET_LONG_PC();
-				r2 = PopDataStack();
-
-				if (static_cast<size_t>(r1) < cobInst->staticVars.size())
-					cobInst->staticVars[r1] = r2;
-			} break;
-			case POP_STACK: {
-				PopDataStack();
-			} break;
-
-
-			case START: {
-				r1 = GET_LONG_PC();
-				r2 = GET_LONG_PC();
-
-				if (cobFile->scriptLengths[r1] == 0)
-					break;
-
-
-				CCobThread t(cobInst);
-
-				t.SetID(cobEngine->GenThreadID());
-				t.InitStack(r2, this);
-				t.Start(r1, signalMask, {{0}}, true);
-
-				// calling AddThread directly might move <this>, defer it
-				cobEngine->QueueAddThread(std::move(t));
-			} break;
-
-			case CREATE_LOCAL_VAR: {
-				if (paramCount == 0) {
-					PushDataStack(0);
-				} else {
-					paramCount--;
-				}
-			} break;
-			case GET_UNIT_VALUE: {
-				r1 = PopDataStack();
-				if ((r1 >= LUA0) && (r1 <= LUA9)) {
-					PushDataStack(luaArgs[r1 - LUA0]);
-					break;
-				}
-				r1 = cobInst->GetUnitVal(r1, 0, 0, 0, 0);
-				PushDataStack(r1);
-			} break;
-
-
-			case JUMP_NOT_EQUAL: {
-				r1 = GET_LONG_PC();
-				r2 = PopDataStack();
-
-				if (r2 == 0)
-					pc = r1;
-
-			} break;
-			case JUMP: {
-				r1 = GET_LONG_PC();
-				// this seem to be an error in the docs..
-				//r2 = cobFile->scriptOffsets[LocalFunctionID()] + r1;
-				pc = r1;
-			} break;
-
-
-			case POP_LOCAL_VAR: {
-				r1 = GET_LONG_PC();
-				r2 = PopDataStack();
-				dataStack[LocalStackFrame() + r1] = r2;
-			} break;
-			case PUSH_LOCAL_VAR: {
-				r1 = GET_LONG_PC();
-				r2 = dataStack[LocalStackFrame() + r1];
-				PushDataStack(r2);
-			} break;
-
-
-			case BITWISE_AND: {
-				r1 = PopDataStack();
-				r2 = PopDataStack();
-				PushDataStack(r1 & r2);
-			} break;
-			case BITWISE_OR: {
-				r1 = PopDataStack();
-				r2 = PopDataStack();
-				PushDataStack(r1 | r2);
-			} break;
-			case BITWISE_XOR: {
-				r1 = PopDataStack();
-				r2 = PopDataStack();
-				PushDataStack(r1 ^ r2);
-			} break;
-			case BITWISE_NOT: {
-				r1 = PopDataStack();
-				PushDataStack(~r1);
-			} break;
-
-			case EXPLODE: {
-				r1 = GET_LONG_PC();
-				r2 = PopDataStack();
-				cobInst->Explode(r1, r2);
-			} break;
-
-			case PLAY_SOUND: {
-				r1 = GET_LONG_PC();
-				r2 = PopDataStack();
-				cobInst->PlayUnitSound(r1, r2);
-			} break;
-
-			case PUSH_STATIC: {
-				r1 = GET_LONG_PC();
-
-				if (static_cast<size_t>(r1) < cobInst->staticVars.size())
-					PushDataStack(cobInst->staticVars[r1]);
-			} break;
-
-			case SET_NOT_EQUAL: {
-				r1 = PopDataStack();
-				r2 = PopDataStack();
-
-				PushDataStack(int(r1 != r2));
-			} break;
-			case SET_EQUAL: {
-				r1 = PopDataStack();
-				r2 = PopDataStack();
-
-				PushDataStack(int(r1 == r2));
-			} break;
-
-			case SET_LESS: {
-				r2 = PopDataStack();
-				r1 = PopDataStack();
-
-				PushDataStack(int(r1 < r2));
-			} break;
-			case SET_LESS_OR_EQUAL: {
-				r2 = PopDataStack();
-				r1 = PopDataStack();
-
-				PushDataStack(int(r1 <= r2));
-			} break;
-
-			case SET_GREATER: {
-				r2 = PopDataStack();
-				r1 = PopDataStack();
-
-				PushDataStack(int(r1 > r2));
-			} break;
-			case SET_GREATER_OR_EQUAL: {
-				r2 = PopDataStack();
-				r1 = PopDataStack();
-
-				PushDataStack(int(r1 >= r2));
-			} break;
-
-			case RAND: {
-				r2 = PopDataStack();
-				r1 = PopDataStack();
-				r3 = gsRNG.NextInt(r2 - r1 + 1) + r1;
-				PushDataStack(r3);
-			} break;
-			case EMIT_SFX: {
-				r1 = PopDataStack();
-				r2 = GET_LONG_PC();
-				cobInst->EmitSfx(r1, r2);
-			} break;
-			case MUL: {
-				r1 = PopDataStack();
-				r2 = PopDataStack();
-				PushDataStack(r1 * r2);
-			} break;
-
-
-			case SIGNAL: {
-				r1 = PopDataStack();
-				cobInst->Signal(r1);
-			} break;
-			case SET_SIGNAL_MASK: {
-				r1 = PopDataStack();
-				signalMask = r1;
-			} break;
-
-
-			case TURN: {
-				r2 = PopDataStack();
-				r1 = PopDataStack();
-				r3 = GET_LONG_PC(); // piece
-				r4 = GET_LONG_PC(); // axis
-
-				cobInst->Turn(r3, r4, r1, r2);
-			} break;
-			case GET: {
-				r5 = PopDataStack();
-				r4 = PopDataStack();
-				r3 = PopDataStack();
-				r2 = PopDataStack();
-				r1 = PopDataStack();
-				if ((r1 >= LUA0) && (r1 <= LUA9)) {
-					PushDataStack(luaArgs[r1 - LUA0]);
-					break;
-				}
-				r6 = cobInst->GetUnitVal(r1, r2, r3, r4, r5);
-				PushDataStack(r6);
-			} break;
-			case ADD: {
-				r2 = PopDataStack();
-				r1 = PopDataStack();
-				PushDataStack(r1 + r2);
-			} break;
-			case SUB: {
-				r2 = PopDataStack();
-				r1 = PopDataStack();
-				r3 = r1 - r2;
-				PushDataStack(r3);
-			} break;
-
-			case DIV: {
-				r2 = PopDataStack();
-				r1 = PopDataStack();
-
-				if (r2 != 0) {
-					r3 = r1 / r2;
-				} else {
-					r3 = 1000; // infinity!
-					ShowError("division by zero");
-				}
-				PushDataStack(r3);
-			} break;
-			case MOD: {
-				r2 = PopDataStack();
-				r1 = PopDataStack();
-
-				if (r2 != 0) {
-					PushDataStack(r1 % r2);
-				} else {
-					PushDataStack(0);
-					ShowError("modulo division by zero");
-				}
-			} break;
-
-
-			case MOVE: {
-				r1 = GET_LONG_PC();
-				r2 = GET_LONG_PC();
-				r4 = PopDataStack();
-				r3 = PopDataStack();
-				cobInst->Move(r1, r2, r3, r4);
-			} break;
-			case MOVE_NOW: {
-				r1 = GET_LONG_PC();
-				r2 = GET_LONG_PC();
-				r3 = PopDataStack();
-				cobInst->MoveNow(r1, r2, r3);
-			} break;
-			case TURN_NOW: {
-				r1 = GET_LONG_PC();
-				r2 = GET_LONG_PC();
-				r3 = PopDataStack();
-				cobInst->TurnNow(r1, r2, r3);
-			} break;
-
-
-			case WAIT_TURN: {
-				r1 = GET_LONG_PC();
-				r2 = GET_LONG_PC();
-
-				if (cobInst->NeedsWait(CCobInstance::ATurn, r1, r2)) {
-					state = WaitTurn;
-					waitPiece = r1;
-					waitAxis = r2;
-					return true;
-				}
-			} break;
-			case WAIT_MOVE: {
-				r1 = GET_LONG_PC();
-				r2 = GET_LONG_PC();
-
-				if (cobInst->NeedsWait(CCobInstance::AMove, r1, r2)) {
-					state = WaitMove;
-					waitPiece = r1;
-					waitAxis = r2;
-					return true;
-				}
-			} break;
-
-
-			case SET: {
-				r2 = PopDataStack();
-				r1 = PopDataStack();
-
-				if ((r1 >= LUA0) && (r1 <= LUA9)) {
-					luaArgs[r1 - LUA0] = r2;
-					break;
-				}
-
-				cobInst->SetUnitVal(r1, r2);
-			} break;
-
-
-			case ATTACH: {
-				r3 = PopDataStack();
-				r2 = PopDataStack();
-				r1 = PopDataStack();
-				cobInst->AttachUnit(r2, r1);
-			} break;
-			case DROP: {
-				r1 = PopDataStack();
-				cobInst->DropUnit(r1);
-			} break;
-
-			// like bitwise ops, but only on values 1 and 0
-			case LOGICAL_NOT: {
-				r1 = PopDataStack();
-				PushDataStack(int(r1 == 0));
-			} break;
-			case LOGICAL_AND: {
-				r1 = PopDataStack();
-				r2 = PopDataStack();
-				PushDataStack(int(r1 && r2));
-			} break;
-			case LOGICAL_OR: {
-				r1 = PopDataStack();
-				r2 = PopDataStack();
-				PushDataStack(int(r1 || r2));
-			} break;
-			case LOGICAL_XOR: {
-				r1 = PopDataStack();
-				r2 = PopDataStack();
-				PushDataStack(int((!!r1) ^ (!!r2)));
-			} break;
-
-
-			case HIDE: {
-				r1 = GET_LONG_PC();
-				cobInst->SetVisibility(r1, false);
-			} break;
-
-			case SHOW: {
-				r1 = GET_LONG_PC();
-
-				int i;
-				for (i = 0; i < MAX_WEAPONS_PER_UNIT; ++i)
-					if (LocalFunctionID() == cobFile->scriptIndex[COBFN_FirePrimary + COBFN_Weapon_Funcs * i])
-						break;
-
-				// if true, we are in a Fire-script and should show a special flare effect
-				if (i < MAX_WEAPONS_PER_UNIT) {
-					cobInst->ShowFlare(r1);
-				} else {
-					cobInst->SetVisibility(r1, true);
-				}
-			} break;
-
-			default: {
-				const char* name = cobFile->name.c_str();
-				const char* func = cobFile->scriptNames[LocalFunctionID()].c_str();
-
-				LOG_L(L_ERROR, "[COBThread::%s] unknown opcode %x (in %s:%s at %x)", __func__, opcode, name, func, pc - 1);
-
-				#if 0
-				auto ei = execTrace.begin();
-				while (ei != execTrace.end()) {
-					LOG_L(L_ERROR, "\tprogctr: %3x  opcode: %s", __func__, *ei, GetOpcodeName(cobFile->code[*ei]));
-					++ei;
-				}
-				#endif
 
+			return true;
+		}
+		COB_OP(SPIN) {
+			const int speed = PopDataStack();
+			const int accel = PopDataStack();
+			cobInst->Spin(inst->a, inst->b, speed, accel);
+		} COB_NEXT_CHECKED();
+		COB_OP(STOP_SPIN) {
+			const int decel = PopDataStack();
+			cobInst->StopSpin(inst->a, inst->b, decel);
+		} COB_NEXT_CHECKED();
+		COB_OP(RETURN) {
+			retCode = PopDataStack();
+
+			if (LocalReturnAddr() == -1) {
 				state = Dead;
+
+				// leave values intact on stack in case caller wants to check them
+				// callStackSize -= 1;
 				return false;
-			} break;
+			}
+
+			// return to caller
+			pc = ClampPC(LocalReturnAddr());
+			dataStackSize = std::min(dataStackSize, LocalStackFrame());
+			callStackSize -= 1;
+		} COB_NEXT();
+
+
+		COB_OP(SHADE) {
+		} COB_NEXT();
+		COB_OP(DONT_SHADE) {
+		} COB_NEXT();
+		COB_OP(CACHE) {
+		} COB_NEXT();
+		COB_OP(DONT_CACHE) {
+		} COB_NEXT();
+		COB_OP(NOP) {
+		} COB_NEXT();
+
+
+		COB_OP(REAL_CALL) {
+			// do not call zero-length functions
+			if (cobFile->scriptLengths[inst->a] == 0)
+				COB_NEXT();
+
+			CallInfo& ci = PushCallStackRef();
+			ci.functionId = inst->a;
+			ci.returnAddr = pc;
+			ci.stackTop = dataStackSize - inst->b;
+
+			paramCount = inst->b;
+
+			// call cobFile->scriptNames[inst->a]
+			pc = ClampPC(cobFile->scriptOffsets[inst->a]);
+		} COB_NEXT();
+		COB_OP(LUA_CALL) {
+			LuaCall(inst->a, inst->b);
+		} COB_NEXT_CHECKED();
+
+
+		COB_OP(POP_STATIC) {
+			assert(static_cast<size_t>(inst->a) < cobInst->staticVars.size());
+			cobInst->staticVars[inst->a] = PopDataStack();
+		} COB_NEXT();
+		COB_OP(POP_STACK) {
+			PopDataStack();
+		} COB_NEXT();
+		COB_OP(POP_NOP) {
+			PopDataStack();
+		} COB_NEXT();
+
+
+		COB_OP(START) {
+			if (cobFile->scriptLengths[inst->a] == 0)
+				COB_NEXT();
+
+			CCobThread t(cobInst);
+
+			t.SetID(cobEngine->GenThreadID());
+			t.InitStack(inst->b, this);
+			t.Start(inst->a, signalMask, {{0}}, true);
+
+			// calling AddThread directly might move <this>, defer it
+			cobEngine->QueueAddThread(std::move(t));
+		} COB_NEXT_CHECKED();
+
+		COB_OP(CREATE_LOCAL_VAR) {
+			if (paramCount == 0) {
+				PushDataStack(0);
+			} else {
+				paramCount--;
+			}
+		} COB_NEXT();
+		COB_OP(GET_UNIT_VALUE) {
+			const int r1 = PopDataStack();
+
+			if (IsLuaArgIndex(r1)) {
+				PushDataStack(luaArgs[r1 - LUA0]);
+				COB_NEXT();
+			}
+
+			PushDataStack(cobInst->GetUnitVal(r1, 0, 0, 0, 0));
+		} COB_NEXT_CHECKED();
+
+
+		COB_OP(JUMP_NOT_EQUAL) {
+			if (PopDataStack() == 0)
+				pc = inst->a;
+		} COB_NEXT();
+		COB_OP(JUMP) {
+			// this seem to be an error in the docs..
+			//r2 = cobFile->scriptOffsets[LocalFunctionID()] + r1;
+			pc = inst->a;
+		} COB_NEXT();
+
+
+		COB_OP(POP_LOCAL_VAR) {
+			const int r2 = PopDataStack();
+			dataStack[LocalStackFrame() + inst->a] = r2;
+		} COB_NEXT();
+		COB_OP(PUSH_LOCAL_VAR) {
+			PushDataStack(dataStack[LocalStackFrame() + inst->a]);
+		} COB_NEXT();
+
+
+		COB_BINARY_OP(BITWISE_AND, lhs & rhs)
+		COB_BINARY_OP(BITWISE_OR , lhs | rhs)
+		COB_BINARY_OP(BITWISE_XOR, lhs ^ rhs)
+		COB_OP(BITWISE_NOT) {
+			PushDataStack(~PopDataStack());
+		} COB_NEXT();
+
+		COB_OP(EXPLODE) {
+			cobInst->Explode(inst->a, PopDataStack());
+		} COB_NEXT_CHECKED();
+
+		COB_OP(PLAY_SOUND) {
+			cobInst->PlayUnitSound(inst->a, PopDataStack());
+		} COB_NEXT_CHECKED();
+
+		COB_OP(PUSH_STATIC) {
+			assert(static_cast<size_t>(inst->a) < cobInst->staticVars.size());
+			PushDataStack(cobInst->staticVars[inst->a]);
+		} COB_NEXT();
+
+		COB_BINARY_OP(SET_NOT_EQUAL       , int(lhs != rhs))
+		COB_BINARY_OP(SET_EQUAL           , int(lhs == rhs))
+		COB_BINARY_OP(SET_LESS            , int(lhs <  rhs))
+		COB_BINARY_OP(SET_LESS_OR_EQUAL   , int(lhs <= rhs))
+		COB_BINARY_OP(SET_GREATER         , int(lhs >  rhs))
+		COB_BINARY_OP(SET_GREATER_OR_EQUAL, int(lhs >= rhs))
+
+		COB_OP(RAND) {
+			const int r2 = PopDataStack();
+			const int r1 = PopDataStack();
+			PushDataStack(gsRNG.NextInt(r2 - r1 + 1) + r1);
+		} COB_NEXT();
+		COB_OP(EMIT_SFX) {
+			cobInst->EmitSfx(PopDataStack(), inst->a);
+		} COB_NEXT_CHECKED();
+
+
+		COB_OP(SIGNAL) {
+			cobInst->Signal(PopDataStack());
+		} COB_NEXT_CHECKED();
+		COB_OP(SET_SIGNAL_MASK) {
+			signalMask = PopDataStack();
+		} COB_NEXT();
+
+
+		COB_OP(TURN) {
+			const int r2 = PopDataStack();
+			const int r1 = PopDataStack();
+
+			cobInst->Turn(inst->a, inst->b, r1, r2);
+		} COB_NEXT_CHECKED();
+		COB_OP(GET) {
+			const int r5 = PopDataStack();
+			const int r4 = PopDataStack();
+			const int r3 = PopDataStack();
+			const int r2 = PopDataStack();
+			const int r1 = PopDataStack();
+
+			if (IsLuaArgIndex(r1)) {
+				PushDataStack(luaArgs[r1 - LUA0]);
+				COB_NEXT();
+			}
+
+			PushDataStack(cobInst->GetUnitVal(r1, r2, r3, r4, r5));
+		} COB_NEXT_CHECKED();
+
+		COB_BINARY_OP(ADD, lhs + rhs)
+		COB_BINARY_OP(SUB, lhs - rhs)
+		COB_BINARY_OP(MUL, lhs * rhs)
+
+		COB_OP(DIV) {
+			const int r2 = PopDataStack();
+			const int r1 = PopDataStack();
+
+			if (r2 != 0) {
+				PushDataStack(r1 / r2);
+			} else {
+				PushDataStack(1000); // infinity!
+				ShowError("division by zero");
+			}
+		} COB_NEXT();
+		COB_OP(MOD) {
+			const int r2 = PopDataStack();
+			const int r1 = PopDataStack();
+
+			if (r2 != 0) {
+				PushDataStack(r1 % r2);
+			} else {
+				PushDataStack(0);
+				ShowError("modulo division by zero");
+			}
+		} COB_NEXT();
+
+
+		COB_OP(MOVE) {
+			const int r4 = PopDataStack();
+			const int r3 = PopDataStack();
+			cobInst->Move(inst->a, inst->b, r3, r4);
+		} COB_NEXT_CHECKED();
+		COB_OP(MOVE_NOW) {
+			cobInst->MoveNow(inst->a, inst->b, PopDataStack());
+		} COB_NEXT_CHECKED();
+		COB_OP(TURN_NOW) {
+			cobInst->TurnNow(inst->a, inst->b, PopDataStack());
+		} COB_NEXT_CHECKED();
+
+
+		COB_OP(WAIT_TURN) {
+			if (cobInst->NeedsWait(CCobInstance::ATurn, inst->a, inst->b)) {
+				state = WaitTurn;
+				waitPiece = inst->a;
+				waitAxis = inst->b;
+				return true;
+			}
+		} COB_NEXT();
+		COB_OP(WAIT_MOVE) {
+			if (cobInst->NeedsWait(CCobInstance::AMove, inst->a, inst->b)) {
+				state = WaitMove;
+				waitPiece = inst->a;
+				waitAxis = inst->b;
+				return true;
+			}
+		} COB_NEXT();
+
+
+		COB_OP(SET) {
+			const int r2 = PopDataStack();
+			const int r1 = PopDataStack();
+
+			if (IsLuaArgIndex(r1)) {
+				luaArgs[r1 - LUA0] = r2;
+				COB_NEXT();
+			}
+
+			cobInst->SetUnitVal(r1, r2);
+		} COB_NEXT_CHECKED();
+
+
+		COB_OP(ATTACH) {
+			PopDataStack();
+			const int r2 = PopDataStack();
+			const int r1 = PopDataStack();
+			cobInst->AttachUnit(r2, r1);
+		} COB_NEXT_CHECKED();
+		COB_OP(DROP) {
+			cobInst->DropUnit(PopDataStack());
+		} COB_NEXT_CHECKED();
+
+		// like bitwise ops, but only on values 1 and 0
+		COB_OP(LOGICAL_NOT) {
+			PushDataStack(int(PopDataStack() == 0));
+		} COB_NEXT();
+		COB_BINARY_OP(LOGICAL_AND, int(lhs && rhs))
+		COB_BINARY_OP(LOGICAL_OR , int(lhs || rhs))
+		COB_BINARY_OP(LOGICAL_XOR, int((!!lhs) ^ (!!rhs)))
+
+
+		COB_OP(HIDE) {
+			cobInst->SetVisibility(inst->a, false);
+		} COB_NEXT_CHECKED();
+
+		COB_OP(SHOW) {
+			// if true, we are in a Fire-script and should show a special flare effect
+			if (InFireScript()) {
+				cobInst->ShowFlare(inst->a);
+			} else {
+				cobInst->SetVisibility(inst->a, true);
+			}
+		} COB_NEXT_CHECKED();
+
+
+		COB_OP(BAD_PC) {
+			// mantis #5981, same as the bounds-checked fetch this replaced
+			throw std::out_of_range("[COBThread::Tick] program counter out of range in " + cobFile->name);
 		}
+
+		// calls are resolved by CCobFile, a raw one here had an invalid target
+		COB_LABEL(CALL)
+		COB_LABEL(UNKNOWN) {
+			const char* name = cobFile->name.c_str();
+			const char* func = cobFile->scriptNames[LocalFunctionID()].c_str();
+
+			LOG_L(L_ERROR, "[COBThread::%s] unknown opcode %x (in %s:%s at %x)", __func__, cobFile->code[pc], name, func, pc);
+
+			state = Dead;
+			return false;
+		}
+	#if (COB_DIRECT_THREADED == 0)
+		}
+	#endif
 	}
 
+	#undef COB_BINARY_OP
+	#undef COB_NEXT_CHECKED
+	#undef COB_OP
+	#undef COB_NEXT
+	#undef COB_LABEL
+	#undef COB_FETCH
+
+done:
 	// can arrive here as dead, through CCobInstance::Signal()
 	return (state != Dead);
 }
@@ -880,10 +730,9 @@ void CCobThread::ShowError(const char* msg)
 }
 
 
-void CCobThread::LuaCall()
+void CCobThread::LuaCall(int r1, int r2)
 {
-	const int r1 = GET_LONG_PC(); // script id
-	const int r2 = GET_LONG_PC(); // arg count
+	// r1 is the script id, r2 the arg count
 
 	// setup the parameter array
 	const int size = dataStackSize;
@@ -11,6 +11,7 @@
 
 class CCobFile;
 class CCobInstance;
+struct CobInstruction;
 
 
 class CCobThread
@@ -37,6 +38,13 @@ public:
 	 * Returns false if this thread is dead and needs to be killed.
 	 */
 	bool Tick();
+	/**
+	 * Like Tick, but safe to call concurrently for threads of different
+	 * script instances: the thread is not (re)scheduled and it yields just
+	 * before any opcode that could touch state outside of its own instance,
+	 * leaving that for a regular Tick. See CCobEngine::TickThreads.
+	 */
+	bool TickLocal();
 	/**
 	 * This function sets the thread in motion. Should only be called once.
 	 * If schedule is false the thread is not added to the scheduler, and thus
@@ -92,12 +100,18 @@ public:
 	bool IsDead() const { return (state == Dead); }
 	bool IsGarbage() const { return (cobInst == nullptr); }
 	bool IsWaiting() const { return (waitAxis != -1); }
+	bool IsYielded() const { return yielded; }
 
 	// script instance that owns this thread
 	CCobInstance* cobInst = nullptr;
 	CCobFile* cobFile = nullptr;
 
 protected:
+	template<bool localOnly> bool TickImpl();
+
+	bool IsLocalInstruction(const CobInstruction& inst) const;
+	bool InFireScript() const;
+
 	struct CallInfo {
 		CR_DECLARE_STRUCT(CallInfo)
 		int functionId = -1;
@@ -105,7 +119,7 @@ protected:
 		int stackTop = -1;
 	};
 
-	void LuaCall();
+	void LuaCall(int r1, int r2);
 
 	bool PushCallStack(CallInfo v) { return (callStackSize < callStack.size() && PushCallStackRaw(v)); }
 	bool PushDataStack(     int v) { return (dataStackSize < dataStack.size() && PushDataStackRaw(v)); }
@@ -133,6 +147,13 @@ protected:
 
 		return 0;
 	}
+	// n-th value from the top, what the (n+1)-th PopDataStack would return
+	int PeekDataStack(int n) const {
+		if (n < dataStackSize)
+			return dataStack[dataStackSize - 1 - n];
+
+		return 0;
+	}
 
 protected:
 	int id = -1;
@@ -161,6 +182,9 @@ protected:
 
 	State state = Init;
 
+	// set if the last TickLocal stopped before a non-local opcode
+	bool yielded = false;
+
 	CCobInstance::ThreadCallbackType cbType = CCobInstance::CBNone;
 };
 
@@ -327,6 +327,26 @@ void CUnitScript::AddAnim(AnimType type, int piece, int axis, float speed, float
 }
 
 
+bool CUnitScript::IsLocalAnimChange(AnimType type, int piece, int axis)
+{
+	if (!PieceExists(piece))
+		return false;
+	// adding the first animation registers us with the engine
+	if (!HaveAnimations())
+		return false;
+
+	switch (type) {
+		case ATurn: { return (!IsInAnimation(ASpin, piece, axis)); } break;
+		case ASpin: { return (IsInAnimation(ASpin, piece, axis) || !IsInAnimation(ATurn, piece, axis)); } break;
+		case AMove: { return true; } break;
+		default: {
+		} break;
+	}
+
+	return false;
+}
+
+
 void CUnitScript::Spin(int piece, int axis, float speed, float accel)
 {
 	auto animInfoIt = FindAnim(ASpin, piece, axis);
@@ -144,6 +144,13 @@ public:
 	bool HaveAnimations() const {
 		return (!anims[ATurn].empty() || !anims[ASpin].empty() || !anims[AMove].empty());
 	}
+	/**
+	 * True if Turn, Spin or Move would only change this script's own
+	 * animation state, i.e. not (un)register it with unitScriptEngine,
+	 * end an overridden animation (rescheduling its waiting threads) or
+	 * report an error. Used by CCobThread::TickLocal.
+	 */
+	bool IsLocalAnimChange(AnimType type, int piece, int axis);
 
 	// checks for callin existence
 	bool HasSetSFXOccupy () const { return hasSetSFXOccupy; }
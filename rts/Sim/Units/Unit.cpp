@@ -861,16 +861,22 @@ void CUnit::SetLosStatus(int at, unsigned short newStatus)
 
 unsigned short CUnit::CalcLosStatus(int at)
 {
-	const unsigned short currStatus = losStatus[at];
+	const bool inLos = losHandler->InLos(this, at);
+	const bool inRadar = !inLos && losHandler->InRadar(this, at);
+
+	return (CalcLosStatus(losStatus[at], inLos, inRadar));
+}
 
+unsigned short CUnit::CalcLosStatus(unsigned short currStatus, bool inLos, bool inRadar)
+{
 	unsigned short newStatus = currStatus;
 	unsigned short mask = ~(currStatus >> LOS_MASK_SHIFT);
 
-	if (losHandler->InLos(this, at)) {
+	if (inLos) {
 		newStatus |= (mask & (LOS_INLOS   | LOS_INRADAR |
 		                      LOS_PREVLOS | LOS_CONTRADAR));
 	}
-	else if (losHandler->InRadar(this, at)) {
+	else if (inRadar) {
 		newStatus |=  (mask & LOS_INRADAR);
 		newStatus &= ~(mask & LOS_INLOS);
 	}
@@ -891,6 +897,22 @@ void CUnit::UpdateLosStatus(int at)
 	SetLosStatus(at, CalcLosStatus(at));
 }
 
+void CUnit::UpdateLosStatus(int at, bool inLos, bool inRadar)
+{
+	const unsigned short currStatus = losStatus[at];
+	if ((currStatus & LOS_ALL_MASK_BITS) == LOS_ALL_MASK_BITS) {
+		return;
+	}
+
+	const unsigned short newStatus = CalcLosStatus(currStatus, inLos, inRadar);
+
+	// SetLosStatus is a no-op without changed bits, skip the call entirely
+	if (newStatus == currStatus)
+		return;
+
+	SetLosStatus(at, newStatus);
+}
+
 
 void CUnit::SetStunned(bool stun) {
 	stunned = stun;
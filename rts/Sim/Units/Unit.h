@@ -178,6 +178,10 @@ public:
 	void SetLosStatus(int allyTeam, unsigned short newStatus);
 	unsigned short CalcLosStatus(int allyTeam);
 	void UpdateLosStatus(int allyTeam);
+	// applies precomputed visibility (see CUnitHandler::UpdateUnitLosStates)
+	void UpdateLosStatus(int allyTeam, bool inLos, bool inRadar);
+
+	static unsigned short CalcLosStatus(unsigned short currStatus, bool inLos, bool inRadar);
 
 	void UpdateWeapons();
 
@@ -11,14 +11,18 @@
 #include "UnitTypes/Factory.h"
 
 #include "CommandAI/BuilderCAI.h"
+#include "Game/GameHelper.h"
 #include "Sim/Misc/GlobalSynced.h"
+#include "Sim/Misc/LosHandler.h"
 #include "Sim/Misc/TeamHandler.h"
 #include "Sim/MoveTypes/MoveType.h"
 #include "Sim/Weapons/Weapon.h"
 #include "System/EventHandler.h"
+#include "System/Config/ConfigHandler.h"
 #include "System/Log/ILog.h"
 #include "System/SpringMath.h"
 #include "System/TimeProfiler.h"
+#include "System/Threading/ThreadPool.h" // for_mt
 #include "System/creg/STL_Deque.h"
 #include "System/creg/STL_Set.h"
 
@@ -33,6 +37,7 @@ CR_REG_METADATA(CUnitHandler, (
 	CR_MEMBER(unitsToBeRemoved),
 
 	CR_MEMBER(builderCAIs),
+	CR_IGNORED(hotState),
 
 	CR_MEMBER(activeSlowUpdateUnit),
 	CR_MEMBER(activeUpdateUnit),
@@ -40,10 +45,14 @@ CR_REG_METADATA(CUnitHandler, (
 	CR_MEMBER(maxUnits),
 	CR_MEMBER(maxUnitRadius),
 
-	CR_MEMBER(inUpdateCall)
+	CR_MEMBER(inUpdateCall),
+	CR_IGNORED(hotStateSyncTest)
 ))
 
 
+CONFIG(bool, UnitHotStateSyncTest).defaultValue(false).description("Compare the batched LOS pass over UnitHotState against the per-unit CLosHandler tests for every unit and allyteam (debug).");
+
+
 
 UnitMemPool unitMemPool;
 
@@ -94,6 +103,9 @@ void CUnitHandler::Init() {
 		maxUnits = CalcMaxUnits();
 		maxUnitRadius = 0.0f;
 	}
+	{
+		hotStateSyncTest = configHandler->GetBool("UnitHotStateSyncTest");
+	}
 	{
 		activeSlowUpdateUnit = 0;
 		activeUpdateUnit = 0;
@@ -112,6 +124,8 @@ void CUnitHandler::Init() {
 		for (int teamNum = 0; teamNum < teamHandler.ActiveTeams(); teamNum++) {
 			unitsByDefs[teamNum].resize(unitDefHandler->NumUnitDefs() + 1);
 		}
+
+		hotState.Init(maxUnits, teamHandler.ActiveAllyTeams());
 	}
 }
 
@@ -143,6 +157,8 @@ void CUnitHandler::Kill()
 
 		// only iterated by unsynced code, GetBuilderCAIs has no synced callers
 		builderCAIs.clear();
+
+		hotState.Kill();
 	}
 	{
 		maxUnits = 0;
@@ -291,6 +307,9 @@ void CUnitHandler::DeleteUnit(CUnit* delUnit)
 
 	units[delUnit->id] = nullptr;
 
+	if (delUnit->id < hotState.positions.size())
+		hotState.Clear(delUnit->id);
+
 	CSolidObject::SetDeletingRefID(delUnit->id);
 	unitMemPool.free(delUnit);
 	CSolidObject::SetDeletingRefID(-1);
@@ -321,11 +340,65 @@ void CUnitHandler::UpdateUnitMoveTypes()
 	}
 }
 
-void CUnitHandler::UpdateUnitLosStates()
+void CUnitHandler::UpdateUnitHotState()
 {
-	for (CUnit* unit: activeUnits) {
+	// not serialized; (re)size after loading a savegame
+	if (!hotState.IsValid(maxUnits, teamHandler.ActiveAllyTeams()))
+		hotState.Init(maxUnits, teamHandler.ActiveAllyTeams());
+
+	hotState.activeIDs.resize(activeUnits.size());
+
+	for_mt(0, activeUnits.size(), [&](const int i) {
+		hotState.Gather(activeUnits[i]);
+		hotState.activeIDs[i] = activeUnits[i]->id;
+	});
+}
+
+void CUnitHandler::CheckUnitHotState() const
+{
+	// runs before any callin of this pass, so units still match their snapshot
+	for (const CUnit* unit: activeUnits) {
+		const UnitHotState::Entry gathered = hotState.GetEntry(unit->id);
+		const UnitHotState::Entry expected = UnitHotState::MakeEntry(unit);
+
+		if (gathered.pos != expected.pos || gathered.speed != expected.speed || gathered.allyTeam != expected.allyTeam || gathered.flags != expected.flags)
+			LOG_L(L_ERROR, "[UnitHandler::%s] stale hot state for unit %d", __func__, unit->id);
+
 		for (int at = 0; at < teamHandler.ActiveAllyTeams(); ++at) {
-			unit->UpdateLosStatus(at);
+			const bool inLos = losHandler->InLos(unit, at);
+			const bool inRadar = !inLos && losHandler->InRadar(unit, at);
+			const unsigned char losBits = (UnitHotState::LOS_BIT_INLOS * inLos) | (UnitHotState::LOS_BIT_INRADAR * inRadar);
+
+			if (hotState.GetLosBits(at, unit->id) != losBits)
+				LOG_L(L_ERROR, "[UnitHandler::%s] LOS bits %d instead of %d for unit %d and allyteam %d", __func__, hotState.GetLosBits(at, unit->id), losBits, unit->id, at);
+		}
+	}
+}
+
+void CUnitHandler::UpdateUnitLosStates()
+{
+	SCOPED_TIMER("Sim::Unit::LosStates");
+
+	UpdateUnitHotState();
+
+	// units created by callins below are handled next frame
+	const size_t numUnits = activeUnits.size();
+	const int numAllyTeams = teamHandler.ActiveAllyTeams();
+
+	// phase 1: visibility tests only read the SoA snapshot and LOS maps
+	losHandler->CalcUnitLosBits(hotState);
+
+	if (hotStateSyncTest)
+		CheckUnitHotState();
+
+	// phase 2: status changes run callins, must be serial and in-order
+	for (size_t i = 0; i < numUnits; i++) {
+		CUnit* unit = activeUnits[i];
+
+		for (int at = 0; at < numAllyTeams; ++at) {
+			const unsigned char losBits = hotState.GetLosBits(at, unit->id);
+
+			unit->UpdateLosStatus(at, (losBits & UnitHotState::LOS_BIT_INLOS) != 0, (losBits & UnitHotState::LOS_BIT_INRADAR) != 0);
 		}
 	}
 }
@@ -340,6 +413,10 @@ void CUnitHandler::SlowUpdateUnits()
 	if ((gs->frameNum % UNIT_SLOWUPDATE_RATE) == 0)
 		activeSlowUpdateUnit = 0;
 
+	// auto-targeting requests made by SlowUpdateWeapons are deferred and
+	// resolved (in parallel, then applied in queue order) after the loop
+	helper->BeginWeaponTargetBatch();
+
 	// stagger the SlowUpdate's
 	for (size_t n = (activeUnits.size() / UNIT_SLOWUPDATE_RATE) + 1; (activeSlowUpdateUnit < activeUnits.size() && n != 0); ++activeSlowUpdateUnit) {
 		CUnit* unit = activeUnits[activeSlowUpdateUnit];
@@ -352,6 +429,8 @@ void CUnitHandler::SlowUpdateUnits()
 
 		n--;
 	}
+
+	helper->EndWeaponTargetBatch();
 }
 
 void CUnitHandler::UpdateUnits()
@@ -6,6 +6,7 @@
 #include <array>
 #include <vector>
 
+#include "UnitHotState.h"
 #include "Sim/Misc/GlobalConstants.h"
 #include "Sim/Misc/SimObjectIDPool.h"
 #include "System/creg/STL_Map.h"
@@ -73,6 +74,8 @@ public:
 
 	const spring::unordered_map<unsigned int, CBuilderCAI*>& GetBuilderCAIs() const { return builderCAIs; }
 
+	const UnitHotState& GetHotState() const { return hotState; }
+
 private:
 	void InsertActiveUnit(CUnit* unit);
 	bool QueueDeleteUnit(CUnit* unit);
@@ -81,6 +84,8 @@ private:
 	void DeleteUnits();
 	void SlowUpdateUnits();
 	void UpdateUnitMoveTypes();
+	void UpdateUnitHotState();
+	void CheckUnitHotState() const;
 	void UpdateUnitLosStates();
 	void UpdateUnits();
 	void UpdateUnitWeapons();
@@ -96,6 +101,9 @@ private:
 
 	spring::unordered_map<unsigned int, CBuilderCAI*> builderCAIs;
 
+	///< SoA snapshot of per-unit state, refreshed every frame
+	UnitHotState hotState;
+
 
 	size_t activeSlowUpdateUnit = 0;  ///< first unit of batch that will be SlowUpdate'd this frame
 	size_t activeUpdateUnit = 0;      ///< first unit of batch that will be SlowUpdate'd this frame
@@ -110,6 +118,7 @@ private:
 	float maxUnitRadius = 0.0f;
 
 	bool inUpdateCall = false;
+	bool hotStateSyncTest = false;
 };
 
 extern CUnitHandler unitHandler;
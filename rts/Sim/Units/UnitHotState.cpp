@@ -0,0 +1,31 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "UnitHotState.h"
+#include "Unit.h"
+
+void UnitHotState::Gather(const CUnit* unit)
+{
+	const Entry e = MakeEntry(unit);
+
+	positions[unit->id] = e.pos;
+	speeds[unit->id] = unit->speed;
+
+	allyTeams[unit->id] = e.allyTeam;
+	flags[unit->id] = e.flags;
+}
+
+UnitHotState::Entry UnitHotState::MakeEntry(const CUnit* unit)
+{
+	unsigned int f = FLAG_ACTIVE;
+
+	f |= (FLAG_BEING_BUILT    * unit->beingBuilt);
+	f |= (FLAG_CLOAKED        * unit->isCloaked);
+	f |= (FLAG_ALWAYS_VISIBLE * unit->alwaysVisible);
+	f |= (FLAG_AIR_LOS        * unit->useAirLos);
+	f |= (FLAG_STEALTH        * unit->stealth);
+	f |= (FLAG_SONAR_STEALTH  * unit->sonarStealth);
+	f |= (FLAG_IN_WATER       * unit->IsInWater());
+	f |= (FLAG_UNDER_WATER    * unit->IsUnderWater());
+
+	return {unit->pos, unit->speed, unit->allyteam, f};
+}
@@ -0,0 +1,107 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef UNIT_HOT_STATE_H
+#define UNIT_HOT_STATE_H
+
+#include <vector>
+
+#include "System/float3.h"
+#include "System/float4.h"
+
+class CUnit;
+
+/**
+ * Structure-of-arrays copy of the per-unit state read by frame-wide
+ * passes (LOS status updates, bulk queries), indexed by unit ID.
+ *
+ * CUnit stays authoritative; entries are refreshed via Gather, which
+ * CUnitHandler does for all active units at the start of each LOS pass
+ * so the pass itself only streams these arrays instead of chasing every
+ * CUnit object once per allyteam. Entries of inactive IDs are stale.
+ */
+struct UnitHotState {
+public:
+	enum {
+		FLAG_ACTIVE         = (1 << 0),
+		FLAG_BEING_BUILT    = (1 << 1),
+		FLAG_CLOAKED        = (1 << 2),
+		FLAG_ALWAYS_VISIBLE = (1 << 3),
+		FLAG_AIR_LOS        = (1 << 4),
+		FLAG_STEALTH        = (1 << 5),
+		FLAG_SONAR_STEALTH  = (1 << 6),
+		FLAG_IN_WATER       = (1 << 7),
+		FLAG_UNDER_WATER    = (1 << 8),
+	};
+
+	enum {
+		LOS_BIT_INLOS   = (1 << 0),
+		LOS_BIT_INRADAR = (1 << 1),
+	};
+
+	// the subset of state needed by CLosHandler's unit-visibility tests
+	struct Entry {
+		bool HasFlag(unsigned int f) const { return ((flags & f) != 0); }
+
+		float3 pos;
+		float3 speed;
+
+		int allyTeam;
+		unsigned int flags;
+	};
+
+public:
+	void Init(unsigned int maxUnits, unsigned int numAllyTeams) {
+		positions.clear();
+		positions.resize(maxUnits, float3());
+		speeds.clear();
+		speeds.resize(maxUnits, float4());
+
+		allyTeams.clear();
+		allyTeams.resize(maxUnits, 0);
+		flags.clear();
+		flags.resize(maxUnits, 0);
+
+		losBits.clear();
+		losBits.resize(maxUnits * numAllyTeams, 0);
+
+		activeIDs.clear();
+		activeIDs.reserve(maxUnits);
+
+		losBitsPlanes = numAllyTeams;
+	}
+	void Kill() { Init(0, 0); }
+
+	void Gather(const CUnit* unit);
+	void Clear(unsigned int unitID) { flags[unitID] = 0; }
+
+	bool IsValid(unsigned int maxUnits, unsigned int numAllyTeams) const {
+		return (positions.size() == maxUnits && losBitsPlanes == numAllyTeams);
+	}
+
+	static Entry MakeEntry(const CUnit* unit);
+
+	Entry GetEntry(unsigned int unitID) const {
+		return {positions[unitID], speeds[unitID], allyTeams[unitID], flags[unitID]};
+	}
+
+	// LOS_BIT_* results of the last visibility pass, one plane per allyteam
+	unsigned char  GetLosBits(unsigned int allyTeam, unsigned int unitID) const { return losBits[allyTeam * positions.size() + unitID]; }
+	unsigned char& GetLosBits(unsigned int allyTeam, unsigned int unitID)       { return losBits[allyTeam * positions.size() + unitID]; }
+
+public:
+	std::vector<float3> positions;
+	std::vector<float4> speeds;
+
+	std::vector<int> allyTeams;
+	std::vector<unsigned int> flags;
+
+	std::vector<unsigned char> losBits;
+
+	// IDs of the units gathered this frame, in activeUnits order
+	std::vector<int> activeIDs;
+
+private:
+	unsigned int losBitsPlanes = 0;
+};
+
+#endif
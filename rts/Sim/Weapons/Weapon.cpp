@@ -612,7 +612,7 @@ bool CWeapon::AllowWeaponAutoTarget() const
 	return (gs->frameNum > (lastTargetRetry + 65));
 }
 
-bool CWeapon::AutoTarget()
+bool CWeapon::AutoTarget(bool deferred)
 {
 	if (!AllowWeaponAutoTarget())
 		return false;
@@ -622,16 +622,28 @@ bool CWeapon::AutoTarget()
 
 	const CUnit* avoidUnit = (avoidTarget && HaveUnitTarget()) ? currentTarget.unit : nullptr;
 
-	CUnit* goodTargetUnit = nullptr;
-	CUnit*  badTargetUnit = nullptr;
+	// if deferred (SlowUpdate inside CUnitHandler::SlowUpdateUnits) the helper
+	// generates our targets together with those of all other weapons in the
+	// batch and calls PickAutoTarget for us; the result is not known here yet
+	if (deferred && helper->QueueWeaponTargets(this, avoidUnit))
+		return false;
 
 	auto& targetPairs = helper->targetPairs;
 
+	CGameHelper::GenerateWeaponTargets(this, avoidUnit, targetPairs);
+	return (PickAutoTarget(targetPairs));
+}
+
+bool CWeapon::PickAutoTarget(const std::vector<std::pair<float, CUnit*>>& targetPairs)
+{
+	CUnit* goodTargetUnit = nullptr;
+	CUnit*  badTargetUnit = nullptr;
+
 	// NOTE:
 	//   GenerateWeaponTargets sorts by INCREASING order of priority, so lower equals better
 	//   <targetPairs> is normally sorted such that all bad TargetCategory units live at the
 	//   end, but Lua can mess with the ordering arbitrarily
-	for (size_t i = 0, n = CGameHelper::GenerateWeaponTargets(this, avoidUnit, targetPairs); i < n; i++, assert(n == targetPairs.size())) {
+	for (size_t i = 0, n = targetPairs.size(); i < n; i++, assert(n == targetPairs.size())) {
 		CUnit* unit = targetPairs[i].second;
 
 		// save the "best" bad target in case we have no other
@@ -701,7 +713,7 @@ void CWeapon::SlowUpdate()
 		Attack(owner->lastAttacker);
 	}
 	// AutoTarget: Find new/better Target
-	AutoTarget();
+	AutoTarget(true);
 }
 
 
@@ -82,7 +82,8 @@ public:
 	virtual void UpdateProjectileSpeed(const float val) { projectileSpeed = val; }
 	virtual void UpdateRange(const float val) { range = val; }
 
-	bool AutoTarget();
+	bool AutoTarget(bool deferred = false);
+	bool PickAutoTarget(const std::vector<std::pair<float, CUnit*>>& targetPairs);
 	void AimReady(const int value);
 	void Fire(const bool scriptCall);
 
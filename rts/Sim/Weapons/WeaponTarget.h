@@ -8,6 +8,7 @@
 
 
 class CUnit;
+class CWeapon;
 class CWeaponProjectile;
 
 
@@ -48,4 +49,14 @@ public:
 	float3 groundPos;             // if targettype=ground: the ground position
 };
 
+
+// auto-target candidate passed to the batched AllowWeaponTargets callin
+struct SWeaponTargetCandidate {
+	const CWeapon* weapon;
+	const CUnit* unit;
+
+	float priority;
+	bool allowed;
+};
+
 #endif // WEAPONTARGET_H
@@ -28,6 +28,7 @@ class CProjectile;
 struct Command;
 class IArchive;
 struct SRectangle;
+struct SWeaponTargetCandidate;
 struct UnitDef;
 struct BuildInfo;
 struct FeatureDef;
@@ -114,6 +115,7 @@ class CEventClient
 		virtual void GameOver(const std::vector<unsigned char>& winningAllyTeams) {}
 		virtual void GamePaused(int playerID, bool paused) {}
 		virtual void GameFrame(int gameFrame) {}
+		virtual void GameFramePost(int gameFrame) {}
 		virtual void GameID(const unsigned char* gameID, unsigned int numBytes) {}
 
 		virtual void TeamDied(int teamID) {}
@@ -226,6 +228,8 @@ class CEventClient
 			unsigned int attackerWeaponDefID,
 			float* targetPriority
 		) { return true; }
+		// batched (once per frame) variant of AllowWeaponTarget
+		virtual void AllowWeaponTargets(std::vector<SWeaponTargetCandidate>& candidates) {}
 		virtual bool AllowWeaponInterceptTarget(const CUnit* interceptorUnit, const CWeapon* interceptorWeapon, const CProjectile* interceptorTarget) { return true; }
 
 		virtual bool UnitPreDamaged(
@@ -377,7 +377,39 @@ bool CEventHandler::AllowWeaponTarget(
 	unsigned int attackerWeaponDefID,
 	float* targetPriority
 ) {
-	return ControlIterateDefTrue(listAllowWeaponTarget, &CEventClient::AllowWeaponTarget, attackerID, targetID, attackerWeaponNum, attackerWeaponDefID, targetPriority);
+	// CAI checks (no priority) go to every client
+	if (targetPriority == nullptr)
+		return ControlIterateDefTrue(listAllowWeaponTarget, &CEventClient::AllowWeaponTarget, attackerID, targetID, attackerWeaponNum, attackerWeaponDefID, targetPriority);
+
+	bool result = true;
+
+	for (size_t i = 0; i < listAllowWeaponTarget.size(); ) {
+		CEventClient* ec = listAllowWeaponTarget[i];
+
+		// auto-target candidates reach clients with the batched callin through AllowWeaponTargets instead
+		if (std::find(listAllowWeaponTargets.begin(), listAllowWeaponTargets.end(), ec) == listAllowWeaponTargets.end())
+			result &= ec->AllowWeaponTarget(attackerID, targetID, attackerWeaponNum, attackerWeaponDefID, targetPriority);
+
+		// the call-in may remove itself from the list
+		i += (i < listAllowWeaponTarget.size() && ec == listAllowWeaponTarget[i]);
+	}
+
+	return result;
+}
+
+void CEventHandler::AllowWeaponTargets(std::vector<SWeaponTargetCandidate>& candidates)
+{
+	if (candidates.empty())
+		return;
+
+	for (size_t i = 0; i < listAllowWeaponTargets.size(); ) {
+		CEventClient* ec = listAllowWeaponTargets[i];
+
+		ec->AllowWeaponTargets(candidates);
+
+		// the call-in may remove itself from the list
+		i += (i < listAllowWeaponTargets.size() && ec == listAllowWeaponTargets[i]);
+	}
 }
 
 bool CEventHandler::AllowWeaponInterceptTarget(const CUnit* interceptorUnit, const CWeapon* interceptorWeapon, const CProjectile* interceptorTarget)
@@ -499,6 +531,11 @@ void CEventHandler::GameFrame(int gameFrame)
 	ITERATE_EVENTCLIENTLIST(GameFrame, gameFrame);
 }
 
+void CEventHandler::GameFramePost(int gameFrame)
+{
+	ITERATE_EVENTCLIENTLIST(GameFramePost, gameFrame);
+}
+
 void CEventHandler::GameProgress(int gameFrame)
 {
 	ITERATE_EVENTCLIENTLIST(GameProgress, gameFrame);
@@ -53,6 +53,7 @@ class CEventHandler
 		void GameOver(const std::vector<unsigned char>& winningAllyTeams);
 		void GamePaused(int playerID, bool paused);
 		void GameFrame(int gameFrame);
+		void GameFramePost(int gameFrame);
 		void GameID(const unsigned char* gameID, unsigned int numBytes);
 
 		void TeamDied(int teamID);
@@ -164,6 +165,8 @@ class CEventHandler
 			unsigned int attackerWeaponDefID,
 			float* targetPriority
 		);
+		void AllowWeaponTargets(std::vector<SWeaponTargetCandidate>& candidates);
+		bool HaveAllowWeaponTargets() const { return (!listAllowWeaponTargets.empty()); }
 		bool AllowWeaponInterceptTarget(const CUnit* interceptorUnit, const CWeapon* interceptorWeapon, const CProjectile* interceptorTarget);
 
 		bool UnitPreDamaged(
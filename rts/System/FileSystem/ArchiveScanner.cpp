@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <array>
 #include <cstdio>
+#include <cstring>
 #include <memory>
 
 #include <sys/types.h>
@@ -18,6 +19,7 @@
 #include "DataDirsAccess.h"
 #include "FileSystem.h"
 #include "FileQueryFlags.h"
+#include "MappedFile.h"
 #include "Lua/LuaParser.h"
 #include "System/ContainerUtil.h"
 #include "System/StringUtil.h"
@@ -380,6 +382,12 @@ static spring::recursive_mutex scannerMutex;
 static std::atomic<uint32_t> numScannedArchives{0};
 
 
+static std::string GetBinaryCacheFileName(const std::string& luaCacheFileName)
+{
+	return (FileSystem::GetDirectory(luaCacheFileName) + FileSystem::GetBasename(luaCacheFileName) + ".bin");
+}
+
+
 /*
  * CArchiveScanner
  */
@@ -471,8 +479,6 @@ void CArchiveScanner::ScanDirs(const std::vector<std::string>& scanDirs)
 	std::lock_guard<decltype(scannerMutex)> lck(scannerMutex);
 	std::deque<std::string> foundArchives;
 
-	isDirty = true;
-
 	// scan for all archives
 	for (const std::string& dir: scanDirs) {
 		if (!FileSystem::DirExists(dir))
@@ -499,11 +505,48 @@ void CArchiveScanner::ScanDirs(const std::vector<std::string>& scanDirs)
 	}*/
 
 	// Create archiveInfos etc. if not in cache already
-	for (const std::string& archive: foundArchives) {
-		ScanArchive(archive, false);
-	#if !defined(DEDICATED) && !defined(UNITSYNC)
-		Watchdog::ClearTimer(WDT_MAIN);
-	#endif
+	{
+		std::vector<unsigned> modifiedTimes(foundArchives.size(), 0);
+		std::vector<size_t> scanIndices;
+		std::vector<ArchiveScanResult> scanResults;
+
+		// stat'ing thousands of archives adds up even when all are cached
+		for_mt(0, foundArchives.size(), [&](const int i) {
+			modifiedTimes[i] = GetArchiveModificationTime(foundArchives[i]);
+		});
+
+		// the cache-check updates the index and detects duplicates, keep it serial
+		for (size_t i = 0; i < foundArchives.size(); i++) {
+			if (CheckCachedData(foundArchives[i], modifiedTimes[i], false))
+				continue;
+
+			scanIndices.push_back(i);
+		}
+
+		scanResults.resize(scanIndices.size());
+
+		{
+			assert(!isInScan);
+			isInScan = true;
+
+			for_mt(0, scanIndices.size(), [&](const int i) {
+				ScanArchiveData(foundArchives[scanIndices[i]], modifiedTimes[scanIndices[i]], false, scanResults[i]);
+
+				#if !defined(DEDICATED) && !defined(UNITSYNC)
+				Watchdog::ClearTimer(WDT_MAIN);
+				#endif
+			});
+
+			isInScan = false;
+		}
+
+		// merge in scan order, so the first of two same-named archives wins as before
+		for (size_t i = 0; i < scanIndices.size(); i++) {
+			if (CheckCachedData(foundArchives[scanIndices[i]], modifiedTimes[scanIndices[i]], false))
+				continue;
+
+			StoreScanResult(scanResults[i]);
+		}
 	}
 
 	// Now we'll have to parse the replaces-stuff found in the mods
@@ -524,6 +567,10 @@ void CArchiveScanner::ScanDirs(const std::vector<std::string>& scanDirs)
 			ai.replaced = lcOriginalName;
 		}
 	}
+
+	// rewrite the cache if any entry has gone stale, e.g. because its archive was deleted
+	isDirty |= std::any_of(archiveInfos.begin(), archiveInfos.end(), [](const ArchiveInfo& ai) { return (!ai.updated); });
+	isDirty |= std::any_of(brokenArchives.begin(), brokenArchives.end(), [](const BrokenArchive& ba) { return (!ba.updated); });
 }
 
 
@@ -640,16 +687,13 @@ CArchiveScanner::BrokenArchive& CArchiveScanner::GetAddBrokenArchive(const std::
 
 void CArchiveScanner::ScanArchive(const std::string& fullName, bool doChecksum)
 {
-	unsigned modifiedTime = 0;
+	const unsigned modifiedTime = GetArchiveModificationTime(fullName);
 
 	assert(!isInScan);
 
 	if (CheckCachedData(fullName, modifiedTime, doChecksum))
 		return;
 
-	isDirty = true;
-	isInScan = true;
-
 	struct ScanScope {
 		 ScanScope(bool* b) { p = b; *p =  true; }
 		~ScanScope(       ) {        *p = false; }
@@ -659,6 +703,14 @@ void CArchiveScanner::ScanArchive(const std::string& fullName, bool doChecksum)
 
 	const ScanScope scanScope(&isInScan);
 
+	ArchiveScanResult result;
+	ScanArchiveData(fullName, modifiedTime, doChecksum, result);
+	StoreScanResult(result);
+}
+
+
+void CArchiveScanner::ScanArchiveData(const std::string& fullName, unsigned modifiedTime, bool doChecksum, ArchiveScanResult& result)
+{
 	const std::string& fname = FileSystem::GetFilename(fullName);
 	const std::string& fpath = FileSystem::GetDirectory(fullName);
 	const std::string& lcfn  = StringToLower(fname);
@@ -669,7 +721,7 @@ void CArchiveScanner::ScanArchive(const std::string& fullName, bool doChecksum)
 		LOG_L(L_WARNING, "[AS::%s] unable to open archive \"%s\"", __func__, fullName.c_str());
 
 		// record it as broken, so we don't need to look inside everytime
-		BrokenArchive& ba = GetAddBrokenArchive(lcfn);
+		BrokenArchive& ba = result.brokenArchive;
 		ba.name = lcfn;
 		ba.path = fpath;
 		ba.modified = modifiedTime;
@@ -677,7 +729,8 @@ void CArchiveScanner::ScanArchive(const std::string& fullName, bool doChecksum)
 		ba.problem = "Unable to open archive";
 
 		// does not count as a scan
-		// numScannedArchives += 1;
+		result.broken = true;
+		result.scanned = false;
 		return;
 	}
 
@@ -690,7 +743,7 @@ void CArchiveScanner::ScanArchive(const std::string& fullName, bool doChecksum)
 	const bool hasMapInfo = ar->FileExists("mapinfo.lua");
 
 
-	ArchiveInfo ai;
+	ArchiveInfo& ai = result.archiveInfo;
 	ArchiveData& ad = ai.archiveData;
 
 	// execute the respective .lua, otherwise assume this archive is a map
@@ -713,7 +766,7 @@ void CArchiveScanner::ScanArchive(const std::string& fullName, bool doChecksum)
 		LOG_L(L_WARNING, "[AS::%s] failed to scan \"%s\" (%s)", __func__, fullName.c_str(), error.c_str());
 
 		// mark archive as broken, so we don't need to look inside everytime
-		BrokenArchive& ba = GetAddBrokenArchive(lcfn);
+		BrokenArchive& ba = result.brokenArchive;
 		ba.name = lcfn;
 		ba.path = fpath;
 		ba.modified = modifiedTime;
@@ -721,7 +774,8 @@ void CArchiveScanner::ScanArchive(const std::string& fullName, bool doChecksum)
 		ba.problem = error;
 
 		// does count as a scan
-		numScannedArchives += 1;
+		result.broken = true;
+		result.scanned = true;
 		return;
 	}
 
@@ -765,24 +819,43 @@ void CArchiveScanner::ScanArchive(const std::string& fullName, bool doChecksum)
 	ai.updated = true;
 	ai.hashed = doChecksum && GetArchiveChecksum(fullName, ai);
 
-	archiveInfosIndex.insert(lcfn, archiveInfos.size());
-	archiveInfos.emplace_back(std::move(ai));
+	result.broken = false;
+	result.scanned = true;
+}
+
 
-	numScannedArchives += 1;
+void CArchiveScanner::StoreScanResult(ArchiveScanResult& result)
+{
+	isDirty = true;
+	numScannedArchives += result.scanned;
+
+	if (result.broken) {
+		BrokenArchive& ba = GetAddBrokenArchive(result.brokenArchive.name);
+		ba = std::move(result.brokenArchive);
+		return;
+	}
+
+	archiveInfosIndex.insert(StringToLower(result.archiveInfo.origName), archiveInfos.size());
+	archiveInfos.emplace_back(std::move(result.archiveInfo));
 }
 
 
-bool CArchiveScanner::CheckCachedData(const std::string& fullName, unsigned& modified, bool doChecksum)
+unsigned CArchiveScanner::GetArchiveModificationTime(const std::string& fullName)
 {
 	// virtual archives do not exist on disk, and thus do not have a modification time
 	// they should still be scanned as normal archives so we only skip the cache-check
 	if (FileSystem::GetExtension(fullName) == "sva")
-		return false;
+		return 0;
 
-	// if stat fails, assume the archive is not broken nor cached
-	// it would also fail in the case of virtual archives and cause
-	// warning-spam which is suppressed by the extension-test above
-	if ((modified = FileSystemAbstraction::GetFileModificationTime(fullName)) == 0)
+	// stat would also fail for them, which causes warning-spam
+	return (FileSystemAbstraction::GetFileModificationTime(fullName));
+}
+
+
+bool CArchiveScanner::CheckCachedData(const std::string& fullName, unsigned modified, bool doChecksum)
+{
+	// if stat failed, assume the archive is not broken nor cached
+	if (modified == 0)
 		return false;
 
 	const std::string& fileName      = FileSystem::GetFilename(fullName);
@@ -976,6 +1049,10 @@ bool CArchiveScanner::GetArchiveChecksum(const std::string& archiveName, Archive
 void CArchiveScanner::ReadCacheData(const std::string& filename)
 {
 	std::lock_guard<decltype(scannerMutex)> lck(scannerMutex);
+
+	if (ReadBinaryCacheData(GetBinaryCacheFileName(filename)))
+		return;
+
 	if (!FileSystem::FileExists(filename)) {
 		LOG_L(L_INFO, "[AS::%s] ArchiveCache %s doesn't exist", __func__, filename.c_str());
 		return;
@@ -1050,7 +1127,8 @@ void CArchiveScanner::ReadCacheData(const std::string& filename)
 		ba.problem = curArchive.GetString("problem", "unknown");
 	}
 
-	isDirty = false;
+	// (re)create the binary cache on the next write
+	isDirty = true;
 }
 
 static inline void SafeStr(FILE* out, const char* prefix, const std::string& str)
@@ -1077,9 +1155,12 @@ void CArchiveScanner::WriteCacheData(const std::string& filename)
 	if (!isDirty)
 		return;
 
-	FILE* out = fopen(filename.c_str(), "wt");
+	// written to a temporary first, other processes may be reading the cache
+	const std::string tmpFileName = FileSystem::GetTemporaryPath(filename);
+
+	FILE* out = fopen(tmpFileName.c_str(), "wt");
 	if (out == nullptr) {
-		LOG_L(L_ERROR, "[AS::%s] failed to write to \"%s\"!", __func__, filename.c_str());
+		LOG_L(L_ERROR, "[AS::%s] failed to write to \"%s\"!", __func__, tmpFileName.c_str());
 		return;
 	}
 
@@ -1179,13 +1260,273 @@ void CArchiveScanner::WriteCacheData(const std::string& filename)
 	fprintf(out, "}\n\n"); // close 'archiveCache'
 	fprintf(out, "return archiveCache\n");
 
-	if (fclose(out) == EOF)
-		LOG_L(L_ERROR, "[AS::%s] failed to write to \"%s\"!", __func__, filename.c_str());
+	if (fclose(out) == EOF) {
+		LOG_L(L_ERROR, "[AS::%s] failed to write to \"%s\"!", __func__, tmpFileName.c_str());
+		FileSystem::Remove(tmpFileName);
+	} else if (!FileSystem::RenameFile(tmpFileName, filename)) {
+		FileSystem::Remove(tmpFileName);
+	}
+
+	// written last so it is never older than the Lua cache
+	WriteBinaryCacheData(GetBinaryCacheFileName(filename));
 
 	isDirty = false;
 }
 
 
+/*
+ * Binary ArchiveCache
+ *
+ * Holds exactly what ReadCacheData takes from the Lua cache, but can be
+ * read straight from a mapped view without running a Lua state. Layout
+ * (native byte-order, strings are prefixed by their uint32 length):
+ *
+ *   uint32 magic, uint32 BINARY_CACHE_VER, uint32 INTERNAL_VER
+ *   uint32 numArchives, {archive}, uint32 numBrokenArchives, {brokenArchive}
+ *   uint32 magic
+ */
+constexpr static uint32_t BINARY_CACHE_MAGIC = 0x43534153; // "SASC"
+constexpr static uint32_t BINARY_CACHE_VER = 1;
+
+struct BinaryCacheWriter {
+	template<typename T> void Write(T v) {
+		const std::uint8_t* p = reinterpret_cast<const std::uint8_t*>(&v);
+		buffer.insert(buffer.end(), p, p + sizeof(T));
+	}
+	void Write(const std::string& s) {
+		Write<uint32_t>(s.size());
+		buffer.insert(buffer.end(), s.begin(), s.end());
+	}
+
+	std::vector<std::uint8_t> buffer;
+};
+
+struct BinaryCacheReader {
+	template<typename T> T Read() {
+		T v = {};
+
+		if ((valid &= (size_t(end - pos) >= sizeof(T))))
+			std::memcpy(&v, pos, sizeof(T));
+
+		pos += (sizeof(T) * valid);
+		return v;
+	}
+	std::string ReadString() {
+		const uint32_t size = Read<uint32_t>();
+
+		if (!(valid &= (size_t(end - pos) >= size)))
+			return "";
+
+		pos += size;
+		return std::string(reinterpret_cast<const char*>(pos - size), size);
+	}
+
+	const std::uint8_t* pos;
+	const std::uint8_t* end;
+
+	bool valid;
+};
+
+
+bool CArchiveScanner::ReadBinaryCacheData(const std::string& filename)
+{
+	if (!FileSystem::FileExists(filename))
+		return false;
+
+	const CMappedFile file(filename);
+
+	if (!file.IsOpen()) {
+		LOG_L(L_WARNING, "[AS::%s] failed to map ArchiveCache \"%s\"", __func__, filename.c_str());
+		return false;
+	}
+
+	BinaryCacheReader reader = {file.GetData(), file.GetData() + file.GetSize(), true};
+
+	if (reader.Read<uint32_t>() != BINARY_CACHE_MAGIC)
+		return false;
+	// do not load caches from other versions
+	if (reader.Read<uint32_t>() != BINARY_CACHE_VER)
+		return false;
+	if (reader.Read<uint32_t>() != INTERNAL_VER)
+		return false;
+
+	std::vector<ArchiveInfo> cachedInfos(reader.Read<uint32_t>());
+	std::vector<BrokenArchive> cachedBroken;
+
+	// fail before allocating garbage if the count is bogus
+	if (!reader.valid || cachedInfos.size() > file.GetSize())
+		return false;
+
+	for (ArchiveInfo& ai: cachedInfos) {
+		ArchiveInfo tmp; // used to compare against all-zero hash
+
+		ai.origName = reader.ReadString();
+		ai.path = reader.ReadString();
+		ai.archiveDataPath = reader.ReadString();
+		ai.modified = reader.Read<uint32_t>();
+		ai.modifiedArchiveData = reader.Read<uint32_t>();
+
+		for (uint8_t& b: ai.checksum) {
+			b = reader.Read<uint8_t>();
+		}
+
+		ai.updated = false;
+		ai.hashed = (memcmp(ai.checksum, tmp.checksum, sha512::SHA_LEN) != 0);
+
+		ArchiveData& ad = ai.archiveData;
+
+		for (uint32_t n = reader.Read<uint32_t>(); reader.valid && n > 0; n--) {
+			const std::string& key = reader.ReadString();
+
+			switch (reader.Read<uint8_t>()) {
+				case INFO_VALUE_TYPE_STRING : { ad.SetInfoItemValueString (key, reader.ReadString()    ); } break;
+				case INFO_VALUE_TYPE_INTEGER: { ad.SetInfoItemValueInteger(key, reader.Read<int32_t>()); } break;
+				case INFO_VALUE_TYPE_FLOAT  : { ad.SetInfoItemValueFloat  (key, reader.Read<float>()  ); } break;
+				case INFO_VALUE_TYPE_BOOL   : { ad.SetInfoItemValueBool   (key, reader.Read<uint8_t>()); } break;
+				default                     : { reader.valid = false;                                    } break;
+			}
+		}
+
+		for (uint32_t n = reader.Read<uint32_t>(); reader.valid && n > 0; n--) {
+			ad.GetDependencies().push_back(reader.ReadString());
+		}
+
+		if (ad.IsMap()) {
+			AddDependency(ad.GetDependencies(), GetMapHelperContentName());
+		} else if (ad.IsGame()) {
+			AddDependency(ad.GetDependencies(), GetSpringBaseContentName());
+		}
+
+		if (!reader.valid)
+			break;
+	}
+
+	cachedBroken.resize(reader.Read<uint32_t>() * reader.valid);
+
+	if (cachedBroken.size() > file.GetSize())
+		return false;
+
+	for (BrokenArchive& ba: cachedBroken) {
+		ba.name = reader.ReadString();
+		ba.path = reader.ReadString();
+		ba.modified = reader.Read<uint32_t>();
+		ba.problem = reader.ReadString();
+		ba.updated = false;
+	}
+
+	if (reader.Read<uint32_t>() != BINARY_CACHE_MAGIC || !reader.valid) {
+		LOG_L(L_WARNING, "[AS::%s] ArchiveCache \"%s\" is truncated or corrupt", __func__, filename.c_str());
+		return false;
+	}
+
+	for (ArchiveInfo& ai: cachedInfos) {
+		GetAddArchiveInfo(StringToLower(ai.origName)) = std::move(ai);
+	}
+	for (BrokenArchive& ba: cachedBroken) {
+		GetAddBrokenArchive(ba.name) = std::move(ba);
+	}
+
+	isDirty = false;
+	return true;
+}
+
+void CArchiveScanner::WriteBinaryCacheData(const std::string& filename)
+{
+	BinaryCacheWriter writer;
+
+	writer.buffer.reserve(archiveInfos.size() * 512);
+	writer.Write<uint32_t>(BINARY_CACHE_MAGIC);
+	writer.Write<uint32_t>(BINARY_CACHE_VER);
+	writer.Write<uint32_t>(INTERNAL_VER);
+	writer.Write<uint32_t>(archiveInfos.size());
+
+	for (const ArchiveInfo& ai: archiveInfos) {
+		writer.Write(ai.origName);
+		writer.Write(ai.path);
+		writer.Write(ai.archiveDataPath);
+		writer.Write<uint32_t>(ai.modified);
+		writer.Write<uint32_t>(ai.modifiedArchiveData);
+
+		for (uint8_t b: ai.checksum) {
+			writer.Write<uint8_t>(b);
+		}
+
+		// same filtering as the Lua cache
+		const ArchiveData& ad = ai.archiveData;
+		const bool hasData = !ad.GetName().empty();
+
+		writer.Write<uint32_t>(ad.GetInfo().size() * hasData);
+
+		for (size_t n = 0, m = ad.GetInfo().size() * hasData; n < m; n++) {
+			const auto& ii = ad.GetInfo()[n];
+
+			writer.Write(ii.first);
+			writer.Write<uint8_t>(ii.second.valueType);
+
+			switch (ii.second.valueType) {
+				case INFO_VALUE_TYPE_STRING : { writer.Write(ii.second.valueTypeString);           } break;
+				case INFO_VALUE_TYPE_INTEGER: { writer.Write<int32_t>(ii.second.value.typeInteger); } break;
+				case INFO_VALUE_TYPE_FLOAT  : { writer.Write<float>(ii.second.value.typeFloat);     } break;
+				case INFO_VALUE_TYPE_BOOL   : { writer.Write<uint8_t>(ii.second.value.typeBool);    } break;
+				default                     : { assert(false);                                      } break;
+			}
+		}
+
+		std::vector<std::string> deps;
+
+		if (hasData) {
+			deps = ad.GetDependencies();
+
+			if (ad.IsMap()) {
+				FilterDep(deps, GetMapHelperContentName());
+			} else if (ad.IsGame()) {
+				FilterDep(deps, GetSpringBaseContentName());
+			}
+		}
+
+		writer.Write<uint32_t>(deps.size());
+
+		for (const std::string& dep: deps) {
+			writer.Write(dep);
+		}
+	}
+
+	writer.Write<uint32_t>(brokenArchives.size());
+
+	for (const BrokenArchive& ba: brokenArchives) {
+		writer.Write(ba.name);
+		writer.Write(ba.path);
+		writer.Write<uint32_t>(ba.modified);
+		writer.Write(ba.problem);
+	}
+
+	writer.Write<uint32_t>(BINARY_CACHE_MAGIC);
+
+	// other processes may have the old cache mapped, truncating it in-place
+	// would fault their reads; replace it by a complete new file instead
+	const std::string tmpFileName = FileSystem::GetTemporaryPath(filename);
+
+	FILE* out = fopen(tmpFileName.c_str(), "wb");
+
+	if (out == nullptr) {
+		LOG_L(L_ERROR, "[AS::%s] failed to write to \"%s\"!", __func__, tmpFileName.c_str());
+		return;
+	}
+
+	const bool written = (fwrite(writer.buffer.data(), writer.buffer.size(), 1, out) == 1);
+
+	if ((fclose(out) == EOF) || !written) {
+		LOG_L(L_ERROR, "[AS::%s] failed to write to \"%s\"!", __func__, tmpFileName.c_str());
+		// never leave a partial cache behind
+		FileSystem::Remove(tmpFileName);
+		return;
+	}
+
+	if (!FileSystem::RenameFile(tmpFileName, filename))
+		FileSystem::Remove(tmpFileName);
+}
+
+
 static void sortByName(std::vector<CArchiveScanner::ArchiveData>& data)
 {
 	std::stable_sort(data.begin(), data.end(), [](const CArchiveScanner::ArchiveData& a, const CArchiveScanner::ArchiveData& b) {
@@ -184,6 +184,15 @@ private:
 		uint32_t modified = 0;
 		bool updated = false;
 	};
+	struct ArchiveScanResult {
+		ArchiveInfo archiveInfo;
+		BrokenArchive brokenArchive;
+
+		// set if the archive could not be opened or failed the compression-check
+		bool broken = false;
+		// set if the scan counts toward numScannedArchives
+		bool scanned = false;
+	};
 
 private:
 	ArchiveInfo& GetAddArchiveInfo(const std::string& lcfn);
@@ -192,6 +201,14 @@ private:
 	void ScanDirs(const std::vector<std::string>& dirs);
 	void ScanDir(const std::string& curPath, std::deque<std::string>& foundArchives);
 
+	/**
+	 * Opens and inspects a single archive without touching any scanner state,
+	 * so it can run for multiple archives in parallel; StoreScanResult merges
+	 * the outcome.
+	 */
+	void ScanArchiveData(const std::string& fullName, unsigned modified, bool doChecksum, ArchiveScanResult& result);
+	void StoreScanResult(ArchiveScanResult& result);
+
 	/// scan mapinfo / modinfo lua files
 	bool ScanArchiveLua(IArchive* ar, const std::string& fileName, ArchiveInfo& ai, std::string& err);
 
@@ -205,6 +222,10 @@ private:
 	void ReadCacheData(const std::string& filename);
 	void WriteCacheData(const std::string& filename);
 
+	/// binary counterpart of the Lua ArchiveCache, preferred when present and current
+	bool ReadBinaryCacheData(const std::string& filename);
+	void WriteBinaryCacheData(const std::string& filename);
+
 	IFileFilter* CreateIgnoreFilter(IArchive* ar);
 
 	/**
@@ -213,7 +234,10 @@ private:
 	 */
 	bool GetArchiveChecksum(const std::string& filename, ArchiveInfo& archiveInfo);
 
-	bool CheckCachedData(const std::string& fullName, unsigned& modified, bool doChecksum);
+	bool CheckCachedData(const std::string& fullName, unsigned modified, bool doChecksum);
+
+	/// returns 0 for virtual archives and if stat fails
+	static unsigned GetArchiveModificationTime(const std::string& fullName);
 
 	/**
 	 * Returns a value > 0 if the file is rated as a meta-file.
@@ -63,6 +63,23 @@ bool CDirArchive::GetFile(unsigned int fid, std::vector<std::uint8_t>& buffer)
 	return true;
 }
 
+bool CDirArchive::GetFileView(unsigned int fid, MappedFileView& view)
+{
+	assert(IsFileId(fid));
+
+	const std::string rawpath = dataDirsAccess.LocateFile(dirName + searchFiles[fid]);
+	const auto mapping = std::make_shared<const CMappedFile>(rawpath);
+
+	// empty files can not be mapped, GetFile handles those
+	if (!mapping->IsOpen())
+		return false;
+
+	view.mapping = mapping;
+	view.data = mapping->GetData();
+	view.size = mapping->GetSize();
+	return true;
+}
+
 void CDirArchive::FileInfo(unsigned int fid, std::string& name, int& size) const
 {
 	assert(IsFileId(fid));
@@ -17,6 +17,14 @@ unsigned int IArchive::FindFile(const std::string& filePath) const
 
 bool IArchive::CalcHash(uint32_t fid, uint8_t hash[sha512::SHA_LEN], std::vector<std::uint8_t>& fb)
 {
+	MappedFileView view;
+
+	// hash mappable files in-place
+	if (GetFileView(fid, view)) {
+		sha512::calc_digest(view.data, view.size, hash);
+		return true;
+	}
+
 	// NOTE: should be possible to avoid a re-read for buffered archives
 	if (!GetFile(fid, fb))
 		return false;
@@ -39,3 +47,13 @@ bool IArchive::GetFile(const std::string& name, std::vector<std::uint8_t>& buffe
 	return true;
 }
 
+
+bool IArchive::GetFileView(const std::string& name, MappedFileView& view)
+{
+	const unsigned int fid = FindFile(name);
+
+	if (!IsFileId(fid))
+		return false;
+
+	return (GetFileView(fid, view));
+}
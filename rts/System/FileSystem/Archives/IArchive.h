@@ -8,6 +8,7 @@
 #include <cinttypes>
 
 #include "ArchiveTypes.h"
+#include "System/FileSystem/MappedFile.h"
 #include "System/Sync/SHA512.hpp"
 #include "System/UnorderedMap.hpp"
 
@@ -82,6 +83,16 @@ public:
 	 */
 	bool GetFile(const std::string& name, std::vector<std::uint8_t>& buffer);
 
+	/**
+	 * Zero-copy alternative to GetFile for archive types that can expose
+	 * a file as a memory-mapped range, i.e. plain files in directories
+	 * and uncompressed entries of zip archives.
+	 * @return false if the file can not be mapped; callers should fall
+	 *   back to GetFile in that case
+	 */
+	virtual bool GetFileView(unsigned int fid, MappedFileView& view) { return false; }
+	bool GetFileView(const std::string& name, MappedFileView& view);
+
 	std::pair<std::string, int> FileInfo(unsigned int fid) const {
 		std::pair<std::string, int> info;
 		FileInfo(fid, info.first, info.second);
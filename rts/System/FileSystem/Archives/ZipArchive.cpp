@@ -55,6 +55,8 @@ CZipArchive::CZipArchive(const std::string& archiveName): CBufferedArchive(archi
 		fd.size = info.uncompressed_size;
 		fd.origName = fName;
 		fd.crc = info.crc;
+		fd.stored = (info.compression_method == 0 && (info.flag & 1) == 0 && info.compressed_size == info.uncompressed_size);
+		fd.dataOffset = 0;
 
 		lcNameIndex.emplace(StringToLower(fd.origName), fileEntries.size());
 		fileEntries.emplace_back(std::move(fd));
@@ -81,6 +83,45 @@ void CZipArchive::FileInfo(unsigned int fid, std::string& name, int& size) const
 }
 
 
+bool CZipArchive::GetFileView(unsigned int fid, MappedFileView& view)
+{
+	assert(IsFileId(fid));
+
+	FileEntry& fe = fileEntries[fid];
+
+	// compressed entries have to go through GetFile
+	if (zip == nullptr || !fe.stored || fe.size <= 0)
+		return false;
+
+	std::lock_guard<spring::mutex> lck(archiveLock);
+
+	if (mapping == nullptr)
+		mapping = std::make_shared<const CMappedFile>(archiveFile);
+
+	if (!mapping->IsOpen())
+		return false;
+
+	if (fe.dataOffset == 0) {
+		// the local header has a variable-size extra field, let minizip parse it
+		unzGoToFilePos(zip, &fe.fp);
+
+		if (unzOpenCurrentFile(zip) != UNZ_OK)
+			return false;
+
+		fe.dataOffset = unzGetCurrentFileZStreamPos64(zip);
+		unzCloseCurrentFile(zip);
+	}
+
+	if ((fe.dataOffset + fe.size) > mapping->GetSize())
+		return false;
+
+	view.mapping = mapping;
+	view.data = mapping->GetData() + fe.dataOffset;
+	view.size = fe.size;
+	return true;
+}
+
+
 // To simplify things, files are always read completely into memory from
 // the zip-file, since zlib does not provide any way of reading more
 // than one file at a time
@@ -39,6 +39,7 @@ public:
 
 	unsigned int NumFiles() const override { return (fileEntries.size()); }
 	void FileInfo(unsigned int fid, std::string& name, int& size) const override;
+	bool GetFileView(unsigned int fid, MappedFileView& view) override;
 
 	#if 0
 	unsigned int GetCrc32(unsigned int fid) {
@@ -56,10 +57,18 @@ protected:
 		int size;
 		std::string origName;
 		unsigned int crc;
+
+		// set for entries that are neither compressed nor encrypted
+		bool stored;
+		// offset of a stored entry's data, resolved on first access
+		uint64_t dataOffset;
 	};
 
 	std::vector<FileEntry> fileEntries;
 
+	// created on the first GetFileView call, shared by all views
+	std::shared_ptr<const CMappedFile> mapping;
+
 	int GetFileImpl(unsigned int fid, std::vector<std::uint8_t>& buffer) override;
 };
 
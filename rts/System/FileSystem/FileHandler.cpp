@@ -92,7 +92,15 @@ bool CFileHandler::TryReadFromVFS(const string& fileName, int section)
 	if (vfsHandler == nullptr)
 		return (loadCode = -2, false);
 
-	if ((loadCode = vfsHandler->LoadFile(StringToLower(fileName), fileBuffer, (CVFSHandler::Section) section)) == 1) {
+	const std::string& lcFileName = StringToLower(fileName);
+
+	// prefer zero-copy access, falls through if the file has to be decompressed
+	if ((loadCode = vfsHandler->LoadFileView(lcFileName, fileView, (CVFSHandler::Section) section)) == 1) {
+		fileSize = fileView.size;
+		return true;
+	}
+
+	if ((loadCode = vfsHandler->LoadFile(lcFileName, fileBuffer, (CVFSHandler::Section) section)) == 1) {
 		// capacity can exceed size if FH was used to open more than one file
 		// assert(fileBuffer.size() == fileBuffer.capacity());
 
@@ -130,6 +138,8 @@ void CFileHandler::Close()
 
 	ifs.close();
 	fileBuffer.clear();
+
+	fileView = {};
 }
 
 
@@ -173,15 +183,15 @@ int CFileHandler::Read(void* buf, int length)
 		return ifs.gcount();
 	}
 
-	if (fileBuffer.empty())
+	if (!IsBuffered())
 		return 0;
 
 	if ((length + filePos) > fileSize)
 		length = fileSize - filePos;
 
 	if (length > 0) {
-		assert(fileBuffer.size() >= (filePos + length));
-		memcpy(buf, &fileBuffer[filePos], length);
+		assert(fileSize >= (filePos + length));
+		memcpy(buf, GetBufferData() + filePos, length);
 		filePos += length;
 	}
 
@@ -218,7 +228,7 @@ void CFileHandler::Seek(int length, std::ios_base::seekdir where)
 		ifs.seekg(length, where);
 		return;
 	}
-	if (fileBuffer.empty())
+	if (!IsBuffered())
 		return;
 
 	switch (where) {
@@ -234,7 +244,7 @@ bool CFileHandler::Eof() const
 	if (ifs.is_open())
 		return ifs.eof();
 
-	if (!fileBuffer.empty())
+	if (IsBuffered())
 		return (filePos >= fileSize);
 
 	return true;
@@ -250,6 +260,18 @@ int CFileHandler::GetPos()
 }
 
 
+std::vector<std::uint8_t>& CFileHandler::GetBuffer()
+{
+	if (!fileView.IsValid())
+		return fileBuffer;
+
+	// callers want to own (or move) the contents, detach them from the mapping
+	fileBuffer.assign(fileView.data, fileView.data + fileView.size);
+	fileView = {};
+	return fileBuffer;
+}
+
+
 bool CFileHandler::LoadStringData(string& data)
 {
 	if (!FileExists())
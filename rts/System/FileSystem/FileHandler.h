@@ -8,6 +8,7 @@
 #include <fstream>
 #include <cinttypes>
 
+#include "MappedFile.h"
 #include "VFSModes.h"
 
 /**
@@ -37,7 +38,9 @@ public:
 	// true if any of TryReadFrom{RawFS,PWD,VFS} succeed
 	bool FileExists() const { return (fileSize >= 0); }
 	// true if (and only if) TryReadFromVFS succeeds
-	bool IsBuffered() const { return (!fileBuffer.empty()); }
+	bool IsBuffered() const { return (fileView.IsValid() || !fileBuffer.empty()); }
+	// true if the VFS file is memory-mapped rather than copied into fileBuffer
+	bool IsMapped() const { return (fileView.IsValid()); }
 
 	bool Eof() const;
 	int GetPos();
@@ -49,7 +52,10 @@ public:
 	static std::string GetFileAbsolutePath(const std::string& filePath, const std::string& modes);
 	static std::string GetArchiveContainingFile(const std::string& filePath, const std::string& modes);
 
-	std::vector<std::uint8_t>& GetBuffer() { return fileBuffer; }
+	// copies mapped contents, prefer GetBufferData where a pointer suffices
+	std::vector<std::uint8_t>& GetBuffer();
+	// contents of a buffered file (FileSize() bytes), without copying
+	const std::uint8_t* GetBufferData() const { return (fileView.IsValid()? fileView.data: fileBuffer.data()); }
 
 	static bool InReadDir(const std::string& path);
 	static bool InWriteDir(const std::string& path);
@@ -79,6 +85,8 @@ protected:
 	std::ifstream ifs;
 	std::vector<std::uint8_t> fileBuffer;
 
+	MappedFileView fileView;
+
 	int filePos = 0;
 	int fileSize = -1;
 	int loadCode = -3; // {-1,0,1} if loaded from VFS
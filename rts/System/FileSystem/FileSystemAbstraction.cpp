@@ -29,6 +29,7 @@
 	#include <io.h>
 	#include <direct.h>
 	#include <fstream>
+	#include <process.h>
 	// Win-API redefines these, which breaks things
 	#if defined(CreateDirectory)
 		#undef CreateDirectory
@@ -283,6 +284,33 @@ bool FileSystemAbstraction::DeleteFile(const std::string& file)
 	return true;
 }
 
+bool FileSystemAbstraction::RenameFile(const std::string& src, const std::string& dst)
+{
+#ifdef _WIN32
+	if (!MoveFileExA(src.c_str(), dst.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+		LOG_L(L_WARNING, "[FSA::%s] error %lu renaming file '%s' to '%s'", __func__, GetLastError(), src.c_str(), dst.c_str());
+		return false;
+	}
+#else
+	if (rename(src.c_str(), dst.c_str()) != 0) {
+		LOG_L(L_WARNING, "[FSA::%s] error '%s' renaming file '%s' to '%s'", __func__, strerror(errno), src.c_str(), dst.c_str());
+		return false;
+	}
+#endif
+
+	return true;
+}
+
+std::string FileSystemAbstraction::GetTemporaryPath(const std::string& file)
+{
+	// concurrent writers (other processes) never share a temporary
+#ifdef _WIN32
+	return (file + ".tmp" + std::to_string(_getpid()));
+#else
+	return (file + ".tmp" + std::to_string(getpid()));
+#endif
+}
+
 
 bool FileSystemAbstraction::FileExists(const std::string& file)
 {
@@ -27,6 +27,10 @@ public:
 	// almost direct wrappers to system calls
 	static bool MkDir(const std::string& dir);
 	static bool DeleteFile(const std::string& file);
+	/// replaces dst if it exists; readers that have it open or mapped keep the old contents
+	static bool RenameFile(const std::string& src, const std::string& dst);
+	/// per-process name next to file, for writing it via RenameFile
+	static std::string GetTemporaryPath(const std::string& file);
 	/// Returns true if the file exists, and is not a directory
 	static bool FileExists(const std::string& file);
 	static bool DirExists(const std::string& dir);
@@ -65,7 +65,14 @@ bool CGZFileHandler::ReadToBuffer(const std::string& path)
 bool CGZFileHandler::UncompressBuffer()
 {
 	std::vector<std::uint8_t> compressed;
-	std::swap(compressed, fileBuffer);
+
+	// mapped files are inflated in-place, the view is released afterwards
+	if (!fileView.IsValid())
+		std::swap(compressed, fileBuffer);
+
+	const MappedFileView view = std::move(fileView);
+
+	fileView = {};
 
 
 	z_stream zstream;
@@ -77,8 +84,8 @@ bool CGZFileHandler::UncompressBuffer()
 	//+16 marks it's a gzip header
 	inflateInit2(&zstream, 15 + 16);
 
-	zstream.next_in   = &compressed[0];
-	zstream.avail_in  = compressed.size();
+	zstream.next_in   = const_cast<std::uint8_t*>(view.IsValid()? view.data: compressed.data());
+	zstream.avail_in  = view.IsValid()? view.size: compressed.size();
 
 	std::uint8_t unzipBuffer[BUFFER_SIZE];
 
@@ -86,7 +93,11 @@ bool CGZFileHandler::UncompressBuffer()
 		zstream.avail_out = BUFFER_SIZE;
 		zstream.next_out = unzipBuffer;
 		const int ret = inflate(&zstream, Z_NO_FLUSH);
-		if (ret != Z_OK) {
+
+		// a truncated final member (e.g. a demo whose recorder was killed) ends in
+		// Z_BUF_ERROR without any input left; keep what was decoded, like gzread
+		if (ret != Z_OK && ret != Z_STREAM_END && (ret != Z_BUF_ERROR || zstream.avail_in != 0)) {
+			inflateEnd(&zstream);
 			fileBuffer.clear();
 			fileSize = -1;
 			return false;
@@ -95,8 +106,17 @@ bool CGZFileHandler::UncompressBuffer()
 		const size_t unzippedBytes = BUFFER_SIZE - zstream.avail_out;
 		fileBuffer.insert(fileBuffer.end(), unzipBuffer, unzipBuffer + unzippedBytes);
 
-		if (ret == Z_STREAM_END)
+		if (ret == Z_BUF_ERROR)
 			break;
+
+		if (ret != Z_STREAM_END)
+			continue;
+
+		// files can consist of multiple concatenated gzip members (see CDemoStreamWriter)
+		if (zstream.avail_in == 0)
+			break;
+
+		inflateReset(&zstream);
 	}
 
 	inflateEnd(&zstream);
@@ -0,0 +1,104 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "MappedFile.h"
+
+#ifndef _WIN32
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#else
+	#include <windows.h>
+#endif
+
+
+CMappedFile::CMappedFile(const std::string& filePath)
+{
+#ifndef _WIN32
+	if ((fileDesc = open(filePath.c_str(), O_RDONLY)) == -1)
+		return;
+
+	struct stat info;
+
+	if (fstat(fileDesc, &info) != 0 || info.st_size <= 0) {
+		Close();
+		return;
+	}
+
+	void* view = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fileDesc, 0);
+
+	if (view == MAP_FAILED) {
+		Close();
+		return;
+	}
+
+	data = reinterpret_cast<const std::uint8_t*>(view);
+	size = info.st_size;
+
+#else
+
+	HANDLE fh = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+	if (fh == INVALID_HANDLE_VALUE)
+		return;
+
+	fileHandle = fh;
+
+	LARGE_INTEGER fileSize;
+
+	if (!GetFileSizeEx(fh, &fileSize) || fileSize.QuadPart <= 0) {
+		Close();
+		return;
+	}
+
+	if ((mapHandle = CreateFileMappingA(fh, nullptr, PAGE_READONLY, 0, 0, nullptr)) == nullptr) {
+		Close();
+		return;
+	}
+
+	void* view = MapViewOfFile(mapHandle, FILE_MAP_READ, 0, 0, 0);
+
+	if (view == nullptr) {
+		Close();
+		return;
+	}
+
+	data = reinterpret_cast<const std::uint8_t*>(view);
+	size = fileSize.QuadPart;
+#endif
+}
+
+CMappedFile::~CMappedFile()
+{
+	Close();
+}
+
+
+void CMappedFile::Close()
+{
+#ifndef _WIN32
+	if (data != nullptr)
+		munmap(const_cast<std::uint8_t*>(data), size);
+
+	if (fileDesc != -1)
+		close(fileDesc);
+
+	fileDesc = -1;
+
+#else
+
+	if (data != nullptr)
+		UnmapViewOfFile(data);
+
+	if (mapHandle != nullptr)
+		CloseHandle(mapHandle);
+	if (fileHandle != nullptr)
+		CloseHandle(fileHandle);
+
+	mapHandle = nullptr;
+	fileHandle = nullptr;
+#endif
+
+	data = nullptr;
+	size = 0;
+}
@@ -0,0 +1,60 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cinttypes>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "System/Misc/NonCopyable.h"
+
+/**
+ * Read-only memory-mapping of a file on disk (not the VFS).
+ * The view stays valid for the lifetime of the object; callers
+ * have to cope with IsOpen() being false, e.g. for empty files
+ * or when the platform refuses to map.
+ */
+class CMappedFile : public spring::noncopyable
+{
+public:
+	explicit CMappedFile(const std::string& filePath);
+	~CMappedFile();
+
+	bool IsOpen() const { return (data != nullptr); }
+
+	const std::uint8_t* GetData() const { return data; }
+	size_t GetSize() const { return size; }
+
+private:
+	void Close();
+
+private:
+	const std::uint8_t* data = nullptr;
+	size_t size = 0;
+
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mapHandle = nullptr;
+#else
+	int fileDesc = -1;
+#endif
+};
+
+
+/**
+ * (Sub-)range of a shared mapping, e.g. one stored entry of a zip
+ * archive. Holding the view keeps the mapping alive even after the
+ * archive it came from has been closed.
+ */
+struct MappedFileView {
+	bool IsValid() const { return (mapping != nullptr); }
+
+	std::shared_ptr<const CMappedFile> mapping;
+
+	const std::uint8_t* data = nullptr;
+	size_t size = 0;
+};
+
+#endif // MAPPED_FILE_H
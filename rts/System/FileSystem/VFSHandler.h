@@ -8,6 +8,8 @@
 #include <vector>
 #include <cinttypes>
 
+#include "MappedFile.h"
+
 #include "System/UnorderedMap.hpp"
 
 class IArchive;
@@ -103,6 +105,12 @@ public:
 	 * @return 1 if the file exists in the VFS and was successfully read
 	 */
 	int LoadFile(const std::string& filePath, std::vector<std::uint8_t>& buffer, Section section);
+	/**
+	 * Maps the contents of a file from within the VFS without copying them.
+	 * @return 1 if the file was mapped, 0 if it exists but has to be read
+	 *   via LoadFile (e.g. compressed entries), -1 if it does not exist
+	 */
+	int LoadFileView(const std::string& filePath, MappedFileView& view, Section section);
 
 
 	/**
@@ -81,6 +81,7 @@ public:
 	}
 
 	val_type state() const { return val; }
+	void state(const val_type _val) { val = _val; }
 
 public:
 	static constexpr res_type min_res = std::numeric_limits<res_type>::min();
@@ -115,6 +116,13 @@ public:
 	rng_val_type GetInitSeed() const { return initSeed; }
 	rng_val_type GetLastSeed() const { return lastSeed; }
 	rng_val_type GetGenState() const { return (gen.state()); }
+	// only for transferring the state of a running game, sequence-id is not touched
+	void SetGenState(rng_val_type state, rng_val_type iseed, rng_val_type lseed) {
+		gen.state(state);
+
+		initSeed = iseed;
+		lastSeed = lseed;
+	}
 
 	// needed for std::{random_}shuffle
 	rng_res_type operator()(              ) { return (gen. next( )); }
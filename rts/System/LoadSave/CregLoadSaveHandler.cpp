@@ -1,7 +1,6 @@
 /* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
 
 #include <sstream>
-#include <zlib.h>
 
 #include "ExternalAI/SkirmishAIHandler.h"
 #include "ExternalAI/EngineOutHandler.h"
@@ -11,7 +10,9 @@
 #include "Game/GameSetup.h"
 #include "Game/GameVersion.h"
 #include "Game/GlobalUnsynced.h"
+#include "Game/SelectedUnitsHandler.h"
 #include "Game/WaitCommandsAI.h"
+#include "Game/Players/PlayerHandler.h"
 #include "Game/UI/Groups/GroupHandler.h"
 #include "Lua/LuaGaia.h"
 #include "Lua/LuaRules.h"
@@ -34,17 +35,21 @@
 #include "Sim/Units/Scripts/NullUnitScript.h"
 #include "Sim/Weapons/PlasmaRepulser.h"
 #include "System/SafeUtil.h"
+#include "System/Sync/SyncChecker.h"
 #include "System/Platform/errorhandler.h"
 #include "System/FileSystem/DataDirsAccess.h"
 #include "System/FileSystem/FileQueryFlags.h"
+#include "System/FileSystem/FileSystem.h"
 #include "System/FileSystem/GZFileHandler.h"
-#include "System/Threading/ThreadPool.h"
+#include "System/LoadSave/GzipStreamBuffer.h"
+#include "System/Misc/SpringTime.h"
 #include "System/creg/SerializeLuaState.h"
 #include "System/creg/Serializer.h"
 #include "System/Exceptions.h"
 #include "System/Log/ILog.h"
 
 #define MAX_STRING_SIZE (1 << 19) // 512kB excluding null-term
+#define SAVE_BLOCK_SIZE (1 << 20)
 
 
 CCregLoadSaveHandler::CCregLoadSaveHandler()
@@ -101,6 +106,74 @@ void CGameStateCollector::Serialize(creg::ISerializer* s)
 }
 
 
+/// unsynced parts of a running game which clients joining it must share
+class CSessionStateCollector
+{
+	CR_DECLARE_STRUCT(CSessionStateCollector)
+
+public:
+	CSessionStateCollector() = default;
+
+	void Collect();
+	void Apply();
+	void Serialize(creg::ISerializer* s);
+
+	std::vector< std::vector<int> > netSelected;
+
+	std::uint64_t rngState = 0;
+	std::uint64_t rngInitSeed = 0;
+	std::uint64_t rngLastSeed = 0;
+
+	unsigned int syncChecksum = 0;
+};
+
+CR_BIND(CSessionStateCollector, )
+CR_REG_METADATA(CSessionStateCollector, (
+	CR_MEMBER(netSelected),
+	CR_MEMBER(rngState),
+	CR_MEMBER(rngInitSeed),
+	CR_MEMBER(rngLastSeed),
+	CR_MEMBER(syncChecksum),
+	CR_SERIALIZER(Serialize)
+))
+
+
+void CSessionStateCollector::Collect()
+{
+	netSelected = selectedUnitsHandler.netSelected;
+
+	rngState = gsRNG.GetGenState();
+	rngInitSeed = gsRNG.GetInitSeed();
+	rngLastSeed = gsRNG.GetLastSeed();
+
+	#ifdef SYNCCHECK
+	syncChecksum = CSyncChecker::GetChecksum();
+	#endif
+}
+
+void CSessionStateCollector::Apply()
+{
+	selectedUnitsHandler.netSelected = std::move(netSelected);
+	selectedUnitsHandler.netSelected.resize(playerHandler.ActivePlayers());
+
+	gsRNG.SetGenState(rngState, rngInitSeed, rngLastSeed);
+
+	#ifdef SYNCCHECK
+	// the checksum is reset right after the sync-response of these frames
+	if ((gs->frameNum & 4095) == 0) {
+		CSyncChecker::NewFrame();
+	} else {
+		CSyncChecker::SetChecksum(syncChecksum);
+	}
+	#endif
+}
+
+void CSessionStateCollector::Serialize(creg::ISerializer* s)
+{
+	s->SerializeObjectInstance(&playerHandler, playerHandler.GetClass());
+}
+
+
 class CLuaStateCollector
 {
 	CR_DECLARE_STRUCT(CLuaStateCollector)
@@ -137,18 +210,33 @@ static void WriteString(std::ostream& s, const std::string& str)
 	s.write(str.c_str(), str.length() + 1);
 }
 
-static void PrintSize(const char* txt, int size)
+static void PrintSize(const char* txt, int size, spring_time time)
 {
 	if (size > (1024 * 1024 * 1024)) {
-		LOG("%s %.1f GB", txt, size / (1024.0f * 1024 * 1024));
+		LOG("%s %.1f GB (%ims)", txt, size / (1024.0f * 1024 * 1024), int(time.toMilliSecsi()));
 	} else if (size >  (1024 * 1024)) {
-		LOG("%s %.1f MB", txt, size / (1024.0f * 1024));
+		LOG("%s %.1f MB (%ims)", txt, size / (1024.0f * 1024), int(time.toMilliSecsi()));
 	} else if (size > 1024) {
-		LOG("%s %.1f KB", txt, size / (1024.0f));
+		LOG("%s %.1f KB (%ims)", txt, size / (1024.0f), int(time.toMilliSecsi()));
 	} else {
-		LOG("%s %u B",    txt, size);
+		LOG("%s %u B (%ims)",    txt, size, int(time.toMilliSecsi()));
 	}
 }
+
+static void SavePackage(creg::COutputStreamSerializer& os, std::ostream& oss, void* obj, creg::Class* cls)
+{
+	// SavePackage seeks back to its header at the end, which a
+	// streamed save-file has to keep writable until then
+	CGzipStreamBuffer* sbuf = dynamic_cast<CGzipStreamBuffer*>(oss.rdbuf());
+
+	if (sbuf != nullptr)
+		sbuf->Pin();
+
+	os.SavePackage(&oss, obj, cls);
+
+	if (sbuf != nullptr)
+		sbuf->Unpin();
+}
 #endif //USING_CREG
 
 static void ReadString(std::istream& s, std::string& str)
@@ -160,7 +248,7 @@ static void ReadString(std::istream& s, std::string& str)
 }
 
 
-static void SaveLuaState(CSplitLuaHandle* handle, creg::COutputStreamSerializer& os, std::stringstream& oss)
+static void SaveLuaState(CSplitLuaHandle* handle, creg::COutputStreamSerializer& os, std::ostream& oss)
 {
 	CLuaStateCollector lsc;
 	lsc.valid = (handle != nullptr) && handle->syncedLuaHandle.IsValid();
@@ -169,7 +257,7 @@ static void SaveLuaState(CSplitLuaHandle* handle, creg::COutputStreamSerializer&
 		lsc.L_GC = handle->syncedLuaHandle.GetLuaGCState();
 		lua_gc(lsc.L_GC, LUA_GCCOLLECT, 0);
 	}
-	os.SavePackage(&oss, &lsc, lsc.GetClass());
+	SavePackage(os, oss, &lsc, lsc.GetClass());
 }
 
 
@@ -196,12 +284,57 @@ static void LoadLuaState(CSplitLuaHandle* handle, creg::CInputStreamSerializer&
 
 void CCregLoadSaveHandler::SaveGame(const std::string& path)
 {
-#ifdef USING_CREG
 	LOG("[LSH::%s] saving game to \"%s\"", __func__, path.c_str());
 
-	try {
-		std::stringstream oss;
+	// compressed and written while being serialized, so the
+	// uncompressed state never has to be held in memory as whole
+	// the stream goes to a temporary file first; a failed save must
+	// not have truncated an existing save-file of the same name
+	const std::string fileName = dataDirsAccess.LocateFile(path, FileQueryFlags::WRITE);
+	const std::string tmpFileName = FileSystem::GetTemporaryPath(fileName);
+
+	CGzipStreamBuffer sbuf(tmpFileName, SAVE_BLOCK_SIZE, 5);
+
+	if (!sbuf.IsOpen()) {
+		LOG_L(L_ERROR, "[LSH::%s] could not open save-file", __func__);
+		return;
+	}
 
+	std::ostream oss(&sbuf);
+
+	const spring_time startTime = spring_gettime();
+	const bool ret = SaveGameState(oss);
+
+	if (!sbuf.Close() || !ret) {
+		LOG_L(L_ERROR, "[LSH::%s] could not write save-file \"%s\"", __func__, path.c_str());
+		FileSystem::Remove(tmpFileName);
+		return;
+	}
+
+	if (!FileSystem::RenameFile(tmpFileName, fileName)) {
+		LOG_L(L_ERROR, "[LSH::%s] could not replace save-file \"%s\"", __func__, path.c_str());
+		FileSystem::Remove(tmpFileName);
+		return;
+	}
+
+	LOG("[LSH::%s] saved game in %ims", __func__, int((spring_gettime() - startTime).toMilliSecsi()));
+}
+
+bool CCregLoadSaveHandler::SaveGameState(std::string& data, bool withSession)
+{
+	std::stringstream oss;
+
+	if (!SaveGameState(oss, withSession))
+		return false;
+
+	data = std::move(oss.str());
+	return true;
+}
+
+bool CCregLoadSaveHandler::SaveGameState(std::ostream& oss, bool withSession)
+{
+#ifdef USING_CREG
+	try {
 		// write our own header. SavePackage() will add its own
 		WriteString(oss, SpringVersion::GetSync());
 		WriteString(oss, gameSetup->setupText);
@@ -214,21 +347,33 @@ void CCregLoadSaveHandler::SaveGame(const std::string& path)
 
 			// save lua state first as lua unit scripts depend on it
 			const int luaStart = oss.tellp();
+			const spring_time luaTime = spring_gettime();
 			SaveLuaState(luaGaia, os, oss);
 			SaveLuaState(luaRules, os, oss);
-			PrintSize("Lua", ((int)oss.tellp()) - luaStart);
+			PrintSize("Lua", ((int)oss.tellp()) - luaStart, spring_gettime() - luaTime);
 
 			// save creg state
 			const int gameStart = oss.tellp();
+			const spring_time gameTime = spring_gettime();
 			CGameStateCollector gsc;
-			os.SavePackage(&oss, &gsc, gsc.GetClass());
-			PrintSize("Game", ((int)oss.tellp()) - gameStart);
+			SavePackage(os, oss, &gsc, gsc.GetClass());
+			PrintSize("Game", ((int)oss.tellp()) - gameStart, spring_gettime() - gameTime);
+
+			if (withSession) {
+				CSessionStateCollector ssc;
+				ssc.Collect();
+				SavePackage(os, oss, &ssc, ssc.GetClass());
+			}
 
 
-			// save AI state
+			// save AI state; a joining client can not host any of them
 			const int aiStart = oss.tellp();
+			const spring_time aiTime = spring_gettime();
 
 			for (const auto& ai: skirmishAIHandler.GetAllSkirmishAIs()) {
+				if (withSession)
+					break;
+
 				std::stringstream aiData;
 				eoh->Save(&aiData, ai.first);
 
@@ -237,30 +382,13 @@ void CCregLoadSaveHandler::SaveGame(const std::string& path)
 				if (aiSize > 0)
 					oss << aiData.rdbuf();
 			}
-			PrintSize("AIs", ((int)oss.tellp()) - aiStart);
+			PrintSize("AIs", ((int)oss.tellp()) - aiStart, spring_gettime() - aiTime);
 		}
 
-		{
-			gzFile file = gzopen(dataDirsAccess.LocateFile(path, FileQueryFlags::WRITE).c_str(), "wb5");
-
-			if (file == nullptr) {
-				LOG_L(L_ERROR, "[LSH::%s] could not open save-file", __func__);
-				return;
-			}
-
-			std::string data = std::move(oss.str());
-			std::function<void(gzFile, std::string&&)> func = [](gzFile file, std::string&& data) {
-				gzwrite(file, data.c_str(), data.size());
-				gzflush(file, Z_FINISH);
-				gzclose(file);
-			};
-
-			// gzFile is just a plain typedef (struct gzFile_s {}* gzFile), can be copied
-			// need to keep a reference to the future around or its destructor will block
-			ThreadPool::AddExtJob(std::move(std::async(std::launch::async, std::move(func), file, std::move(data))));
-		}
+		if (oss.fail())
+			throw content_error("[creg::SaveGameState] stream write error");
 
-		//FIXME add lua state
+		return true;
 	} catch (const content_error& ex) {
 		LOG_L(L_ERROR, "[LSH::%s] content error \"%s\"", __func__, ex.what());
 	} catch (const std::exception& ex) {
@@ -275,6 +403,8 @@ void CCregLoadSaveHandler::SaveGame(const std::string& path)
 #else //USING_CREG
 	LOG_L(L_ERROR, "[LSH::%s] creg is disabled", __func__);
 #endif //USING_CREG
+
+	return false;
 }
 
 /// loads the data (map&mod-name,setup-script) needed by PreGame
@@ -283,28 +413,46 @@ bool CCregLoadSaveHandler::LoadGameStartInfo(const std::string& path)
 	CGZFileHandler saveFile(dataDirsAccess.LocateFile(FindSaveFile(path)), SPRING_VFS_RAW_FIRST);
 
 	std::stringbuf* sbuf = iss.rdbuf();
-	std::string saveVersion;
-	std::string syncVersion = SpringVersion::GetSync();
 
 	char buf[4096];
 	int len;
 	while ((len = saveFile.Read(buf, sizeof(buf))) > 0)
 		sbuf->sputn(buf, len);
 
+	const bool ret = ReadGameStartInfo(path);
+
+	CGameSetup::LoadSavedScript(path, scriptText);
+	return ret;
+}
+
+/// like LoadGameStartInfo, but for a state saved by SaveGameState (eg. a demo keyframe)
+bool CCregLoadSaveHandler::LoadGameStateStartInfo(const std::string& data, const std::string& name, bool session)
+{
+	iss.str(data);
+	withSession = session;
+
+	// the script is not used, whoever owns the state already has one
+	return (ReadGameStartInfo(name));
+}
+
+bool CCregLoadSaveHandler::ReadGameStartInfo(const std::string& name)
+{
+	std::string saveVersion;
+	std::string syncVersion = SpringVersion::GetSync();
+
 	ReadString(iss, saveVersion);
 
 	// check saved engine version against current build
 	// in general these will *not* be binary-compatible
 	// (so prefer to terminate loading from PreGame)
 	if (saveVersion != syncVersion)
-		LOG_L(L_WARNING, "[LSH::%s][release=%d] file \"%s\" saved by engine version \"%s\" incompatible with \"%s\"", __func__, SpringVersion::IsRelease(), path.c_str(), saveVersion.c_str(), syncVersion.c_str());
+		LOG_L(L_WARNING, "[LSH::%s][release=%d] file \"%s\" saved by engine version \"%s\" incompatible with \"%s\"", __func__, SpringVersion::IsRelease(), name.c_str(), saveVersion.c_str(), syncVersion.c_str());
 
 	// read our own header
 	ReadString(iss, scriptText);
 	ReadString(iss, modName);
 	ReadString(iss, mapName);
 
-	CGameSetup::LoadSavedScript(path, scriptText);
 	return (saveVersion == syncVersion);
 }
 
@@ -312,6 +460,10 @@ bool CCregLoadSaveHandler::LoadGameStartInfo(const std::string& path)
 void CCregLoadSaveHandler::LoadGame()
 {
 #ifdef USING_CREG
+	// gu and the player list are overwritten by the loaded state
+	const int myPlayerNum = gu->myPlayerNum;
+	const CPlayer myPlayer = *playerHandler.Player(myPlayerNum);
+
 	ENTER_SYNCED_CODE();
 	{
 		creg::CInputStreamSerializer inputStream;
@@ -331,8 +483,34 @@ void CCregLoadSaveHandler::LoadGame()
 		CGameStateCollector* gsc = static_cast<CGameStateCollector*>(pGSC);
 		spring::SafeDelete(gsc);
 
+		if (withSession) {
+			void* pSSC = nullptr;
+			creg::Class* ssccls = nullptr;
+
+			inputStream.LoadPackage(&iss, pSSC, ssccls);
+			assert(pSSC && ssccls == CSessionStateCollector::StaticClass());
+
+			// a joining player is not yet part of the state it received
+			if (!playerHandler.IsValidPlayer(myPlayerNum) || playerHandler.Player(myPlayerNum)->name != myPlayer.name)
+				playerHandler.AddPlayer(myPlayer);
+
+			for (int i = 0; i < playerHandler.ActivePlayers(); ++i) {
+				CPlayer* player = playerHandler.Player(i);
+				player->fpsController.SetControllerPlayer(player);
+			}
+
+			gu->SetMyPlayer(myPlayerNum);
+
+			CSessionStateCollector* ssc = static_cast<CSessionStateCollector*>(pSSC);
+			ssc->Apply();
+			spring::SafeDelete(ssc);
+		}
+
 		// load ai state
 		for (const auto& ai: skirmishAIHandler.GetAllSkirmishAIs()) {
+			if (withSession)
+				break;
+
 			std::streamsize aiSize;
 			inputStream.SerializeInt(&aiSize, sizeof(aiSize));
 
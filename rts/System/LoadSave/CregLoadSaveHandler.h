@@ -17,8 +17,20 @@ public:
 	void LoadGame() override;
 	void SaveGame(const std::string& path) override;
 
+	/// serializes the current game state (uncompressed .ssf contents) into data
+	/// withSession additionally stores what a client joining the running game
+	/// needs to continue the simulation (players, synced RNG, sync checksum)
+	bool SaveGameState(std::string& data, bool withSession = false);
+	bool SaveGameState(std::ostream& oss, bool withSession = false);
+	bool LoadGameStateStartInfo(const std::string& data, const std::string& name, bool withSession = false);
+
+protected:
+	bool ReadGameStartInfo(const std::string& name);
+
 protected:
 	std::stringstream iss;
+
+	bool withSession = false;
 };
 
 #endif // CREG_LOAD_SAVE_HANDLER_H
@@ -15,23 +15,36 @@ CONFIG(bool, DisableDemoVersionCheck).defaultValue(false).description("Allow to
 #include "System/Log/ILog.h"
 #include "System/Net/RawPacket.h"
 
+#include <algorithm>
 #include <array>
 #include <climits>
+#include <cstddef>
 #include <stdexcept>
 #include <cassert>
 #include <cstring>
 
 
+// v5 headers end where the frame index fields begin
+static constexpr int DEMOFILE_V5_HEADER_SIZE = offsetof(DemoFileHeader, frameIndexSize);
+
 static bool CheckDemoHeader(const DemoFileHeader& fileHeader)
 {
 	if (memcmp(fileHeader.magic, DEMOFILE_MAGIC, sizeof(fileHeader.magic)) != 0)
 		return false;
 
-	if (fileHeader.version != DEMOFILE_VERSION)
-		return false;
-
-	if (fileHeader.headerSize != sizeof(DemoFileHeader))
-		return false;
+	switch (fileHeader.version) {
+		case DEMOFILE_VERSION: {
+			if (fileHeader.headerSize != sizeof(DemoFileHeader))
+				return false;
+		} break;
+		case 5: {
+			if (fileHeader.headerSize != DEMOFILE_V5_HEADER_SIZE)
+				return false;
+		} break;
+		default: {
+			return false;
+		} break;
+	}
 
 	if (fileHeader.playerStatElemSize != sizeof(PlayerStatistics))
 		return false;
@@ -61,6 +74,13 @@ CDemoReader::CDemoReader(const std::string& filename, float curTime): playbackDe
 	playbackDemo->Read((char*)&fileHeader, sizeof(fileHeader));
 	fileHeader.swab();
 
+	if (fileHeader.version == 5 && fileHeader.headerSize == DEMOFILE_V5_HEADER_SIZE) {
+		// the tail of what was read belongs to the script
+		fileHeader.frameIndexSize = 0;
+		fileHeader.keyFrameSize = 0;
+		playbackDemo->Seek(fileHeader.headerSize);
+	}
+
 	if (!CheckDemoHeader(fileHeader)) {
 			char buf[1024];
 			const char* fmt = "[%s] demo-file \"%s\" (%d bytes, magic \"%s\") corrupt or created by a different Spring version, expected \"%s\"";
@@ -75,6 +95,8 @@ CDemoReader::CDemoReader(const std::string& filename, float curTime): playbackDe
 			LOG_L(L_WARNING, "%s", buf);
 	}
 
+	streamStartPos = fileHeader.headerSize + fileHeader.scriptSize;
+
 	if (fileHeader.scriptSize != 0) {
 		setupScript.resize(fileHeader.scriptSize, 0);
 		playbackDemo->Read(const_cast<char*>(setupScript.data()), setupScript.size());
@@ -99,6 +121,8 @@ CDemoReader::CDemoReader(const std::string& filename, float curTime): playbackDe
 		// (if this had still used CFileHandler that would have been easier ;-))
 		bytesRemaining = playbackDemoSize - curPos;
 	}
+
+	LoadFrameIndex();
 	playbackDemo->Seek(curPos);
 }
 
@@ -153,6 +177,107 @@ bool CDemoReader::ReachedEnd()
 }
 
 
+int CDemoReader::SeekToFrame(int frameNum)
+{
+	// last entry at or before frameNum
+	const auto pred = [](int f, const DemoFrameIndexEntry& e) { return (f < e.frameNum); };
+	const auto iter = std::upper_bound(frameIndex.begin(), frameIndex.end(), frameNum, pred);
+
+	if (iter == frameIndex.begin())
+		return -1;
+
+	const DemoFrameIndexEntry& entry = *(iter - 1);
+
+	if (entry.streamOffset < 0 || entry.streamOffset >= fileHeader.demoStreamSize)
+		return -1;
+
+	playbackDemo->Seek(streamStartPos + entry.streamOffset);
+
+	if (playbackDemo->Read((char*)&chunkHeader, sizeof(chunkHeader)) < sizeof(chunkHeader)) {
+		bytesRemaining = 0;
+		return -1;
+	}
+
+	chunkHeader.swab();
+
+	// keep demoTimeOffset; callers resync their clocks via GetModGameTime
+	nextDemoReadTime = chunkHeader.modGameTime + demoTimeOffset;
+	bytesRemaining = fileHeader.demoStreamSize - entry.streamOffset;
+	return entry.frameNum;
+}
+
+int CDemoReader::FindKeyFrame(int frameNum) const
+{
+	const auto pred = [](int f, const DemoKeyFrameHeader& h) { return (f < h.frameNum); };
+	const auto iter = std::upper_bound(keyFrames.begin(), keyFrames.end(), frameNum, pred);
+
+	return ((iter - keyFrames.begin()) - 1);
+}
+
+bool CDemoReader::ReadKeyFrame(int keyFrameIdx, std::string& data)
+{
+	if (keyFrameIdx < 0 || keyFrameIdx >= keyFrames.size())
+		return false;
+
+	const int curPos = playbackDemo->GetPos();
+
+	data.clear();
+	data.resize(keyFrames[keyFrameIdx].dataSize);
+
+	playbackDemo->Seek(keyFrameDataPos[keyFrameIdx]);
+	const bool ret = (playbackDemo->Read(&data[0], data.size()) == data.size());
+	playbackDemo->Seek(curPos);
+	return ret;
+}
+
+
+void CDemoReader::LoadFrameIndex()
+{
+	// crashed demos (and v5 demos) have no index, use DemoTool to add one
+	if (fileHeader.demoStreamSize == 0 || fileHeader.frameIndexSize <= 0)
+		return;
+
+	int pos = streamStartPos + fileHeader.demoStreamSize;
+	pos += fileHeader.winningAllyTeamsSize;
+	pos += fileHeader.playerStatSize;
+	pos += fileHeader.teamStatSize;
+
+	if ((pos + fileHeader.frameIndexSize + fileHeader.keyFrameSize) > playbackDemoSize) {
+		LOG_L(L_WARNING, "[DemoReader::%s] frame index is truncated, seeking disabled", __func__);
+		return;
+	}
+
+	playbackDemo->Seek(pos);
+
+	frameIndex.resize(fileHeader.frameIndexSize / sizeof(DemoFrameIndexEntry));
+	playbackDemo->Read(reinterpret_cast<char*>(frameIndex.data()), frameIndex.size() * sizeof(DemoFrameIndexEntry));
+
+	for (DemoFrameIndexEntry& entry: frameIndex) {
+		entry.swab();
+	}
+
+	pos += fileHeader.frameIndexSize;
+
+	for (const int end = pos + fileHeader.keyFrameSize; (pos + int(sizeof(DemoKeyFrameHeader))) <= end; ) {
+		DemoKeyFrameHeader header;
+
+		playbackDemo->Seek(pos);
+		playbackDemo->Read(reinterpret_cast<char*>(&header), sizeof(header));
+		header.swab();
+
+		pos += sizeof(header);
+
+		if (header.dataSize < 0 || (pos + header.dataSize) > end)
+			break;
+
+		keyFrames.push_back(header);
+		keyFrameDataPos.push_back(pos);
+
+		pos += header.dataSize;
+	}
+}
+
+
 void CDemoReader::LoadStats()
 {
 	// Stats are not available if Spring crashed while writing the demo.
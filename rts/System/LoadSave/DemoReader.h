@@ -55,6 +55,23 @@ public:
 	/// Not needed for normal demo watching
 	void LoadStats();
 
+	/**
+	@brief continue reading at the last indexed frame at or before frameNum
+	@return the frame that was reached (its NEWFRAME chunk is skipped), or -1 if there is none
+	*/
+	int SeekToFrame(int frameNum);
+
+	/// @return index of the last keyframe at or before frameNum, or -1
+	int FindKeyFrame(int frameNum) const;
+	/// copies the savestate of keyframe keyFrameIdx into data
+	bool ReadKeyFrame(int keyFrameIdx, std::string& data);
+
+	const std::vector<DemoFrameIndexEntry>& GetFrameIndex() const { return frameIndex; }
+	const std::vector<DemoKeyFrameHeader>& GetKeyFrames() const { return keyFrames; }
+
+private:
+	void LoadFrameIndex();
+
 private:
 	CFileHandler* playbackDemo;
 
@@ -62,6 +79,7 @@ private:
 	float nextDemoReadTime;
 	int bytesRemaining;
 	int playbackDemoSize;
+	int streamStartPos;
 
 	DemoStreamChunkHeader chunkHeader;
 
@@ -70,6 +88,10 @@ private:
 	std::vector<PlayerStatistics> playerStats; // one stat per player
 	std::vector< std::vector<TeamStatistics> > teamStats; // many stats per team
 	std::vector<unsigned char> winningAllyTeams;
+
+	std::vector<DemoFrameIndexEntry> frameIndex;
+	std::vector<DemoKeyFrameHeader> keyFrames;
+	std::vector<int> keyFrameDataPos; // file position of each keyframe's savestate
 };
 
 #endif
@@ -7,6 +7,7 @@
 
 #include "DemoRecorder.h"
 #include "Game/GameVersion.h"
+#include "Net/Protocol/BaseNetProtocol.h"
 #include "Sim/Misc/TeamStatistics.h"
 #include "System/TimeUtil.h"
 #include "System/StringUtil.h"
@@ -14,6 +15,7 @@
 #include "System/FileSystem/FileSystem.h"
 #include "System/FileSystem/FileQueryFlags.h"
 #include "System/FileSystem/FileHandler.h"
+#include "System/Config/ConfigHandler.h"
 #include "System/Log/ILog.h"
 #include "System/Threading/ThreadPool.h"
 
@@ -26,42 +28,33 @@
 #endif
 
 
-// server and client memory-streams
-static std::string demoStreams[2];
-static spring::mutex demoMutex;
+CONFIG(int, DemoChunkSize).defaultValue(1024).minimumValue(16).description("Size (in KB) of the uncompressed chunks in which demos are compressed and written to disk while recording.");
+CONFIG(float, DemoFlushInterval).defaultValue(30.0f).minimumValue(1.0f).description("Maximum amount of game-time (in seconds) between two demo chunk writes; bounds how much of a demo is lost if the process is killed.");
 
 
 CDemoRecorder::CDemoRecorder(const std::string& mapName, const std::string& modName, bool serverDemo): isServerDemo(serverDemo)
 {
-	std::lock_guard<spring::mutex> lock(demoMutex);
-
-	SetStream();
 	SetName(mapName, modName);
 	SetFileHeader();
-	WriteFileHeader(false);
 
-	file = gzopen(demoName.c_str(), "wb9");
+	writer.reset(new CDemoStreamWriter(demoName, configHandler->GetInt("DemoChunkSize") * 1024, configHandler->GetFloat("DemoFlushInterval")));
+
+	WriteFileHeader(false);
 }
 
 CDemoRecorder::~CDemoRecorder()
 {
-	if (file == nullptr)
+	if (!IsValid())
 		return;
 
 	WriteWinnerList();
 	WritePlayerStats();
 	WriteTeamStats();
-	WriteFileHeader(true);
+	WriteFrameIndex();
+	WriteKeyFrames();
 	WriteDemoFile();
 }
 
-
-void CDemoRecorder::SetStream()
-{
-	demoStreams[isServerDemo].clear();
-	demoStreams[isServerDemo].reserve(8 * 1024 * 1024);
-}
-
 void CDemoRecorder::SetFileHeader()
 {
 	memset(&fileHeader, 0, sizeof(DemoFileHeader));
@@ -78,28 +71,25 @@ void CDemoRecorder::SetFileHeader()
 
 void CDemoRecorder::WriteDemoFile()
 {
-	// zlib FAQ claims the lib is thread-safe, "however any library routines that zlib uses and
-	// any application-provided memory allocation routines must also be thread-safe. zlib's gz*
-	// functions use stdio library routines, and most of zlib's functions use the library memory
-	// allocation routines by default" (so code below should be OK)
-	// gz* should usually be finished before ctor runs again when reloading, but take no chances
-	std::string& data = demoStreams[isServerDemo];
-	std::function<void(gzFile, std::string&)> func = [](gzFile file, std::string& data) {
-		std::lock_guard<spring::mutex> lock(demoMutex);
-
-		gzwrite(file, data.c_str(), data.size());
-		gzflush(file, Z_FINISH);
-		gzclose(file);
+	// all chunks up to here (including stats) have to be queued before the final header
+	writer->Flush();
+
+	WriteFileHeader(true);
+
+	// the writer thread drains its queue (at most a few chunks) before Close returns
+	std::function<void(CDemoStreamWriter*)> func = [](CDemoStreamWriter* w) {
+		w->Close();
+		delete w;
 	};
 
-	LOG("[DemoRecorder::%s] writing %s-demo \"%s\" (" _STPF_ " bytes)", __func__, (isServerDemo? "server": "client"), demoName.c_str(), data.size());
+	LOG("[DemoRecorder::%s] writing %s-demo \"%s\" (%d bytes)", __func__, (isServerDemo? "server": "client"), demoName.c_str(), fileHeader.demoStreamSize);
 
 	#ifndef _WIN32
 	// NOTE: can not use ThreadPool for this directly here, workers are already gone
 	// FIXME: does not currently (august 2017) compile on Windows mingw buildbots
-	ThreadPool::AddExtJob(spring::thread(std::move(func), file, std::ref(data)));
+	ThreadPool::AddExtJob(spring::thread(std::move(func), writer.release()));
 	#else
-	ThreadPool::AddExtJob(std::move(std::async(std::launch::async, std::move(func), file, std::ref(data))));
+	ThreadPool::AddExtJob(std::move(std::async(std::launch::async, std::move(func), writer.release())));
 	#endif
 }
 
@@ -111,7 +101,15 @@ void CDemoRecorder::WriteSetupText(const std::string& text)
 	}
 
 	fileHeader.scriptSize = length;
-	demoStreams[isServerDemo].append(text.c_str(), length);
+
+	if (!IsValid())
+		return;
+
+	// flushed right away, so scriptSize in the header is never ahead of the file
+	writer->Write(text.c_str(), length);
+	writer->Flush();
+
+	WriteFileHeader(false);
 }
 
 void CDemoRecorder::SaveToDemo(const unsigned char* buf, const unsigned length, const float modGameTime)
@@ -121,9 +119,53 @@ void CDemoRecorder::SaveToDemo(const unsigned char* buf, const unsigned length,
 	chunkHeader.modGameTime = modGameTime;
 	chunkHeader.length = length;
 	chunkHeader.swab();
-	demoStreams[isServerDemo].append(reinterpret_cast<const char*>(&chunkHeader), sizeof(chunkHeader));
-	demoStreams[isServerDemo].append(reinterpret_cast<const char*>(buf), length);
 	fileHeader.demoStreamSize += (length + sizeof(chunkHeader));
+
+	if (!IsValid())
+		return;
+
+	if (length > 0 && (buf[0] == NETMSG_NEWFRAME || buf[0] == NETMSG_KEYFRAME)) {
+		// offset points past this chunk, see DemoFrameIndexEntry
+		if (((++streamFrameNum) % DEMOFILE_INDEX_INTERVAL) == 0)
+			frameIndex.push_back({streamFrameNum, fileHeader.demoStreamSize, modGameTime});
+	}
+
+	writer->Write(&chunkHeader, sizeof(chunkHeader));
+	writer->WriteStream(buf, length, modGameTime);
+}
+
+void CDemoRecorder::AddKeyFrame(int frameNum, const std::string& data)
+{
+	if (!IsValid())
+		return;
+
+	// the state has to belong to the end of the stream written so far
+	if (frameNum != streamFrameNum) {
+		LOG_L(L_WARNING, "[DemoRecorder::%s] keyframe for frame %d does not match demo frame %d", __func__, frameNum, streamFrameNum);
+		return;
+	}
+
+	if (keyFrameFile == nullptr && (keyFrameFile = std::tmpfile()) == nullptr) {
+		LOG_L(L_ERROR, "[DemoRecorder::%s] could not create keyframe spool-file (errno %d)", __func__, errno);
+		return;
+	}
+
+	DemoKeyFrameHeader keyFrameHeader = {frameNum, fileHeader.demoStreamSize, int(data.size())};
+	keyFrameHeader.swab();
+
+	bool ret = true;
+	ret &= (fwrite(&keyFrameHeader, sizeof(keyFrameHeader), 1, keyFrameFile) == 1);
+	ret &= (fwrite(data.data(), data.size(), 1, keyFrameFile) == 1);
+
+	if (!ret) {
+		// only keep the keyframes written before this one
+		LOG_L(L_ERROR, "[DemoRecorder::%s] could not spool keyframe for frame %d", __func__, frameNum);
+		fclose(keyFrameFile);
+		keyFrameFile = nullptr;
+		return;
+	}
+
+	fileHeader.keyFrameSize += (sizeof(keyFrameHeader) + data.size());
 }
 
 void CDemoRecorder::SetName(const std::string& mapName, const std::string& modName)
@@ -216,9 +258,9 @@ void CDemoRecorder::SetWinningAllyTeams(const std::vector<unsigned char>& winnin
 }
 
 /** @brief Write DemoFileHeader
-Write the DemoFileHeader at the start of the file and restores the original
-position in the file afterwards. */
-unsigned int CDemoRecorder::WriteFileHeader(bool updateStreamLength)
+(Re)writes the DemoFileHeader at the start of the file; demoStreamSize
+stays 0 until the demo is finished so partial demos are read until EOF. */
+void CDemoRecorder::WriteFileHeader(bool updateStreamLength)
 {
 	DemoFileHeader tmpHeader;
 	memcpy(&tmpHeader, &fileHeader, sizeof(fileHeader));
@@ -229,28 +271,22 @@ unsigned int CDemoRecorder::WriteFileHeader(bool updateStreamLength)
 	// to little endian
 	tmpHeader.swab();
 
-	if (demoStreams[isServerDemo].empty()) {
-		demoStreams[isServerDemo].append(reinterpret_cast<const char*>(&tmpHeader), sizeof(tmpHeader));
-	} else {
-		assert(demoStreams[isServerDemo].size() >= sizeof(tmpHeader));
-		memcpy(&demoStreams[isServerDemo][0], reinterpret_cast<const char*>(&tmpHeader), sizeof(tmpHeader)); // no non-const .data() until C++17
-	}
+	if (!IsValid())
+		return;
 
-	return (demoStreams[isServerDemo].size());
+	writer->WriteHeader(tmpHeader);
 }
 
 /** @brief Write the CPlayer::Statistics at the current position in the file. */
 void CDemoRecorder::WritePlayerStats()
 {
-	const size_t pos = demoStreams[isServerDemo].size();
-
 	for (PlayerStatistics& stats: playerStats) {
 		stats.swab();
-		demoStreams[isServerDemo].append(reinterpret_cast<const char*>(&stats), sizeof(PlayerStatistics));
+		writer->Write(&stats, sizeof(PlayerStatistics));
 	}
 
 	fileHeader.numPlayers = playerStats.size();
-	fileHeader.playerStatSize = int(demoStreams[isServerDemo].size() - pos);
+	fileHeader.playerStatSize = int(playerStats.size() * sizeof(PlayerStatistics));
 
 	playerStats.clear();
 }
@@ -260,41 +296,88 @@ void CDemoRecorder::WritePlayerStats()
 /** @brief Write the winningAllyTeams at the current position in the file. */
 void CDemoRecorder::WriteWinnerList()
 {
-	if (fileHeader.numTeams == 0)
+	if (fileHeader.numTeams == 0) {
+		fileHeader.winningAllyTeamsSize = 0;
 		return;
-
-	const size_t pos = demoStreams[isServerDemo].size();
+	}
 
 	// Write the array of winningAllyTeams.
 	for (size_t i = 0; i < winningAllyTeams.size(); i++) { // NOLINT{modernize-loop-convert}
-		demoStreams[isServerDemo].append(reinterpret_cast<const char*>(&winningAllyTeams[i]), sizeof(unsigned char));
+		writer->Write(&winningAllyTeams[i], sizeof(unsigned char));
 	}
 
-	winningAllyTeams.clear();
+	fileHeader.winningAllyTeamsSize = int(winningAllyTeams.size() * sizeof(unsigned char));
 
-	fileHeader.winningAllyTeamsSize = int(demoStreams[isServerDemo].size() - pos);
+	winningAllyTeams.clear();
 }
 
 /** @brief Write the TeamStatistics at the current position in the file. */
 void CDemoRecorder::WriteTeamStats()
 {
-	const size_t pos = demoStreams[isServerDemo].size();
+	size_t size = 0;
 
 	// Write array of dwords indicating number of TeamStatistics per team.
 	for (std::vector<TeamStatistics>& history: teamStats) {
 		unsigned int c = swabDWord(history.size());
-		demoStreams[isServerDemo].append(reinterpret_cast<const char*>(&c), sizeof(unsigned int));
+		writer->Write(&c, sizeof(unsigned int));
+		size += sizeof(unsigned int);
 	}
 
 	// Write big array of TeamStatistics.
 	for (std::vector<TeamStatistics>& history: teamStats) {
 		for (TeamStatistics& stats: history) {
 			stats.swab();
-			demoStreams[isServerDemo].append(reinterpret_cast<const char*>(&stats), sizeof(TeamStatistics));
+			writer->Write(&stats, sizeof(TeamStatistics));
+			size += sizeof(TeamStatistics);
 		}
 	}
 
-	fileHeader.teamStatSize = int(demoStreams[isServerDemo].size() - pos);
+	fileHeader.teamStatSize = int(size);
 
 	teamStats.clear();
 }
+
+/** @brief Write the frame index at the current position in the file. */
+void CDemoRecorder::WriteFrameIndex()
+{
+	for (DemoFrameIndexEntry& entry: frameIndex) {
+		entry.swab();
+		writer->Write(&entry, sizeof(DemoFrameIndexEntry));
+	}
+
+	fileHeader.frameIndexSize = int(frameIndex.size() * sizeof(DemoFrameIndexEntry));
+
+	frameIndex.clear();
+}
+
+/** @brief Copy the spooled keyframes to the current position in the file. */
+void CDemoRecorder::WriteKeyFrames()
+{
+	if (keyFrameFile == nullptr) {
+		fileHeader.keyFrameSize = 0;
+		return;
+	}
+
+	std::vector<char> buf(1024 * 1024);
+
+	size_t size = 0;
+	size_t numRead = 0;
+
+	rewind(keyFrameFile);
+
+	// flush per block, the writer's queue keeps memory use bounded
+	while ((numRead = fread(buf.data(), 1, buf.size(), keyFrameFile)) > 0) {
+		writer->Write(buf.data(), numRead);
+		writer->Flush();
+
+		size += numRead;
+	}
+
+	if (size != fileHeader.keyFrameSize)
+		LOG_L(L_ERROR, "[DemoRecorder::%s] read " _STPF_ " of %d keyframe bytes", __func__, size, fileHeader.keyFrameSize);
+
+	fileHeader.keyFrameSize = int(size);
+
+	fclose(keyFrameFile);
+	keyFrameFile = nullptr;
+}
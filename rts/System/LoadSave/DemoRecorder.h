@@ -3,11 +3,13 @@
 #ifndef DEMO_RECORDER
 #define DEMO_RECORDER
 
+#include <cstdio>
+#include <memory>
 #include <vector>
 #include <sstream>
-#include <zlib.h>
 
 #include "Demo.h"
+#include "DemoStreamWriter.h"
 #include "Game/Players/PlayerStatistics.h"
 #include "Sim/Misc/TeamStatistics.h"
 
@@ -32,24 +34,29 @@ public:
 		memcpy(&fileHeader, &r.fileHeader, sizeof(fileHeader));
 		memset(&r.fileHeader, 0, sizeof(fileHeader));
 
-		std::swap(file, r.file);
+		std::swap(writer, r.writer);
 
 		std::swap(demoName, r.demoName);
 		std::swap(playerStats, r.playerStats);
 		std::swap(teamStats, r.teamStats);
 		std::swap(winningAllyTeams, r.winningAllyTeams);
 
+		std::swap(frameIndex, r.frameIndex);
+		std::swap(keyFrameFile, r.keyFrameFile);
+		std::swap(streamFrameNum, r.streamFrameNum);
+
 		std::swap(isServerDemo, r.isServerDemo);
 		return *this;
 	}
 
 
-	bool IsValid() const { return (file != nullptr); }
+	bool IsValid() const { return (writer != nullptr && writer->IsOpen()); }
 
 	void WriteSetupText(const std::string& text);
 	void SaveToDemo(const unsigned char* buf, const unsigned length, const float modGameTime);
+	/// stores a savestate taken at the end of frameNum, which must be the last frame passed to SaveToDemo
+	void AddKeyFrame(int frameNum, const std::string& data);
 
-	void SetStream();
 	void SetName(const std::string& mapName, const std::string& modName);
 	const std::string& GetName() const { return demoName; }
 
@@ -63,20 +70,30 @@ public:
 	void SetWinningAllyTeams(const std::vector<unsigned char>& winningAllyTeams);
 
 private:
-	unsigned int WriteFileHeader(bool updateStreamLength);
+	void WriteFileHeader(bool updateStreamLength);
 	void SetFileHeader();
 	void WritePlayerStats();
 	void WriteTeamStats();
 	void WriteWinnerList();
+	void WriteFrameIndex();
+	void WriteKeyFrames();
 	void WriteDemoFile();
 
 private:
-	gzFile file = nullptr;
+	// owned via pointer, recorders are moved around (see CNetProtocol)
+	std::unique_ptr<CDemoStreamWriter> writer;
 
 	std::vector<PlayerStatistics> playerStats;
 	std::vector< std::vector<TeamStatistics> > teamStats;
 	std::vector<unsigned char> winningAllyTeams;
 
+	std::vector<DemoFrameIndexEntry> frameIndex;
+
+	// keyframes are spooled here until the stream is complete
+	std::FILE* keyFrameFile = nullptr;
+
+	int streamFrameNum = -1;
+
 	bool isServerDemo = false;
 };
 
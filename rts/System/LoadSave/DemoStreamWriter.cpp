@@ -0,0 +1,172 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include <zlib.h>
+
+#include "DemoStreamWriter.h"
+#include "System/Log/ILog.h"
+#include "System/StringUtil.h"
+#include "System/Platform/Threading.h"
+
+
+CDemoStreamWriter::CDemoStreamWriter(const std::string& fileName, size_t chunkSize_, float flushInterval_)
+	: chunkSize(chunkSize_)
+	, flushInterval(flushInterval_)
+{
+	if ((file = fopen(fileName.c_str(), "wb")) == nullptr) {
+		LOG_L(L_ERROR, "[DemoStreamWriter::%s] could not open \"%s\" for writing", __func__, fileName.c_str());
+		return;
+	}
+
+	chunk.reserve(chunkSize);
+	thread = spring::thread(&CDemoStreamWriter::ThreadFunc, this);
+}
+
+CDemoStreamWriter::~CDemoStreamWriter()
+{
+	Close();
+}
+
+
+void CDemoStreamWriter::WriteHeader(const DemoFileHeader& header)
+{
+	if (file == nullptr)
+		return;
+
+	PushJob({true, std::string(reinterpret_cast<const char*>(&header), sizeof(header))});
+}
+
+void CDemoStreamWriter::Write(const void* data, size_t size)
+{
+	chunk.append(reinterpret_cast<const char*>(data), size);
+}
+
+void CDemoStreamWriter::WriteStream(const void* data, size_t size, float gameTime)
+{
+	Write(data, size);
+
+	if (chunk.size() < chunkSize && (gameTime - lastFlushTime) < flushInterval)
+		return;
+
+	lastFlushTime = gameTime;
+	Flush();
+}
+
+void CDemoStreamWriter::Flush()
+{
+	if (file == nullptr || chunk.empty())
+		return;
+
+	PushJob({false, std::move(chunk)});
+
+	chunk.clear();
+	chunk.reserve(chunkSize);
+}
+
+void CDemoStreamWriter::Close()
+{
+	if (file == nullptr)
+		return;
+
+	Flush();
+
+	{
+		std::lock_guard<spring::mutex> lock(mutex);
+		quit = true;
+	}
+
+	jobCond.notify_all();
+	thread.join();
+
+	fclose(file);
+	file = nullptr;
+
+	if (error)
+		LOG_L(L_ERROR, "[DemoStreamWriter::%s] errors occurred while writing, demo may be incomplete", __func__);
+}
+
+
+void CDemoStreamWriter::PushJob(Job&& job)
+{
+	std::unique_lock<spring::mutex> lock(mutex);
+
+	// bounds memory use if the disk or compressor can not keep up
+	doneCond.wait(lock, [&]() { return (jobs.size() < MAX_QUEUED_CHUNKS); });
+	jobs.emplace_back(std::move(job));
+
+	lock.unlock();
+	jobCond.notify_one();
+}
+
+void CDemoStreamWriter::ThreadFunc()
+{
+	Threading::SetThreadName("demo-writer");
+
+	while (true) {
+		Job job;
+
+		{
+			std::unique_lock<spring::mutex> lock(mutex);
+			jobCond.wait(lock, [&]() { return (quit || !jobs.empty()); });
+
+			// drain the queue before quitting
+			if (jobs.empty())
+				break;
+
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+
+		doneCond.notify_all();
+
+		const bool ret = job.isHeader? WriteHeaderMember(job.data): WriteChunkMember(job.data);
+
+		if (ret)
+			continue;
+
+		std::lock_guard<spring::mutex> lock(mutex);
+		error = true;
+	}
+}
+
+
+bool CDemoStreamWriter::WriteHeaderMember(const std::string& data)
+{
+	std::string member;
+
+	// stored (level 0) so the member size only depends on sizeof(DemoFileHeader)
+	if (!zlib::gzip(data, Z_NO_COMPRESSION, member))
+		return false;
+
+	if (headerMemberSize == 0) {
+		headerMemberSize = member.size();
+	} else {
+		if (member.size() != headerMemberSize)
+			return false;
+
+		fseek(file, 0, SEEK_SET);
+	}
+
+	const bool ret = (fwrite(member.data(), member.size(), 1, file) == 1);
+
+	fseek(file, 0, SEEK_END);
+	fflush(file);
+	return ret;
+}
+
+bool CDemoStreamWriter::WriteChunkMember(const std::string& data)
+{
+	std::string member;
+
+	// header member must come first
+	if (headerMemberSize == 0)
+		return false;
+
+	if (!zlib::gzip(data, Z_BEST_COMPRESSION, member))
+		return false;
+
+	const bool ret = (fwrite(member.data(), member.size(), 1, file) == 1);
+
+	// make the chunk visible to readers (and survive a crash) right away
+	fflush(file);
+	return ret;
+}
@@ -0,0 +1,83 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef DEMO_STREAM_WRITER_H
+#define DEMO_STREAM_WRITER_H
+
+#include <cstdio>
+#include <deque>
+#include <string>
+
+#include "demofile.h"
+#include "System/Threading/SpringThreading.h"
+
+
+/**
+ * @brief Appends a demo to disk while it is being recorded
+ *
+ * The file is a sequence of concatenated gzip members, which gzread (and
+ * any other gzip reader) treats as one stream. The first member holds only
+ * the DemoFileHeader and is stored uncompressed so it has a constant size
+ * and can be rewritten in-place whenever the header changes; everything
+ * else is buffered into chunks which a background thread compresses and
+ * appends. Memory use is bounded by chunkSize * MAX_QUEUED_CHUNKS, and a
+ * killed process leaves a demo that plays back up to the last written
+ * chunk (demoStreamSize stays 0 until Close, see DemoFileHeader).
+ */
+class CDemoStreamWriter
+{
+public:
+	CDemoStreamWriter(const std::string& fileName, size_t chunkSize, float flushInterval);
+	~CDemoStreamWriter();
+
+	CDemoStreamWriter(const CDemoStreamWriter&) = delete;
+	CDemoStreamWriter& operator = (const CDemoStreamWriter&) = delete;
+
+	bool IsOpen() const { return (file != nullptr); }
+
+	/// queues a rewrite of the leading header member
+	void WriteHeader(const DemoFileHeader& header);
+	/// appends raw (uncompressed) bytes following the header
+	void Write(const void* data, size_t size);
+	/// like Write, but also flushes the current chunk when it is full or older than flushInterval
+	void WriteStream(const void* data, size_t size, float gameTime);
+
+	void Flush();
+	/// flushes, waits for all queued jobs and closes the file
+	void Close();
+
+private:
+	struct Job {
+		bool isHeader;
+		std::string data;
+	};
+
+	void PushJob(Job&& job);
+	void ThreadFunc();
+
+	bool WriteHeaderMember(const std::string& data);
+	bool WriteChunkMember(const std::string& data);
+
+private:
+	static constexpr size_t MAX_QUEUED_CHUNKS = 4;
+
+	FILE* file = nullptr;
+
+	std::string chunk;
+	std::deque<Job> jobs;
+
+	spring::thread thread;
+	spring::mutex mutex;
+	spring::condition_variable_any jobCond;
+	spring::condition_variable_any doneCond;
+
+	size_t chunkSize = 0;
+	size_t headerMemberSize = 0;
+
+	float flushInterval = 0.0f;
+	float lastFlushTime = 0.0f;
+
+	bool quit = false;
+	bool error = false;
+};
+
+#endif
@@ -0,0 +1,322 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include <algorithm>
+#include <cstring>
+
+#include "GzipStreamBuffer.h"
+#include "System/Log/ILog.h"
+#include "System/StringUtil.h"
+#include "System/Platform/Threading.h"
+
+
+CGzipStreamBuffer::CGzipStreamBuffer(const std::string& fileName, size_t blockSize_, int level_)
+	: blockSize(std::max(blockSize_, size_t(1)))
+	, level(level_)
+{
+	if ((file = fopen(fileName.c_str(), "wb")) == nullptr) {
+		LOG_L(L_ERROR, "[GzipStreamBuffer::%s] could not open \"%s\" for writing", __func__, fileName.c_str());
+		return;
+	}
+
+	// the serializer runs on the main thread meanwhile, keep one core for it
+	const int numThreads = std::max(1, std::min(Threading::GetPhysicalCpuCores() - 1, int(MAX_QUEUED_BLOCKS / 2)));
+
+	for (int i = 0; i < numThreads; i++) {
+		threads.emplace_back(&CGzipStreamBuffer::ThreadFunc, this);
+	}
+
+	StartBlock();
+}
+
+CGzipStreamBuffer::~CGzipStreamBuffer()
+{
+	Close();
+}
+
+
+void CGzipStreamBuffer::Pin()
+{
+	if (file == nullptr)
+		return;
+
+	Unpin();
+
+	// let the held block begin exactly at the pinned position
+	if (GetFillSize() > 0) {
+		SubmitBlock();
+		StartBlock();
+	}
+
+	pinned = true;
+}
+
+void CGzipStreamBuffer::Unpin()
+{
+	if (!pinned)
+		return;
+
+	if (inHeldBlock) {
+		inHeldBlock = false;
+		SetPutArea(curBlock->data, curBlockFill);
+	}
+
+	pinned = false;
+
+	if (heldBlock == nullptr)
+		return;
+
+	{
+		std::lock_guard<spring::mutex> lock(mutex);
+
+		heldBlock->state = BLOCK_QUEUED;
+		heldBlock = nullptr;
+		numPendingBlocks += 1;
+	}
+
+	jobCond.notify_one();
+}
+
+bool CGzipStreamBuffer::Close()
+{
+	if (file == nullptr)
+		return false;
+
+	Unpin();
+	SubmitBlock();
+
+	curBlock.reset();
+	setp(nullptr, nullptr);
+
+	{
+		std::lock_guard<spring::mutex> lock(mutex);
+		quit = true;
+	}
+
+	jobCond.notify_all();
+
+	for (spring::thread& t: threads) {
+		t.join();
+	}
+
+	threads.clear();
+
+	error |= !blocks.empty();
+	error |= (fclose(file) != 0);
+	file = nullptr;
+
+	if (error)
+		LOG_L(L_ERROR, "[GzipStreamBuffer::%s] errors occurred while writing, file is incomplete", __func__);
+
+	return !error;
+}
+
+
+CGzipStreamBuffer::int_type CGzipStreamBuffer::overflow(int_type c)
+{
+	// held blocks can only be rewritten, not extended
+	if (file == nullptr || inHeldBlock)
+		return traits_type::eof();
+
+	SubmitBlock();
+	StartBlock();
+
+	if (traits_type::eq_int_type(c, traits_type::eof()))
+		return traits_type::not_eof(c);
+
+	*pptr() = traits_type::to_char_type(c);
+	pbump(1);
+	return c;
+}
+
+std::streamsize CGzipStreamBuffer::xsputn(const char* s, std::streamsize n)
+{
+	std::streamsize numWritten = 0;
+
+	while (numWritten < n) {
+		if (pptr() == epptr() && traits_type::eq_int_type(overflow(traits_type::eof()), traits_type::eof()))
+			break;
+
+		const std::streamsize numCopied = std::min(n - numWritten, std::streamsize(epptr() - pptr()));
+
+		memcpy(pptr(), s + numWritten, numCopied);
+		pbump(numCopied);
+
+		numWritten += numCopied;
+	}
+
+	return numWritten;
+}
+
+
+CGzipStreamBuffer::pos_type CGzipStreamBuffer::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+	if ((which & std::ios_base::out) == 0 || file == nullptr)
+		return pos_type(off_type(-1));
+
+	switch (dir) {
+		case std::ios_base::beg: { return (seekpos(pos_type(off), which)); } break;
+		case std::ios_base::end: { return (seekpos(pos_type(curBlockStart + GetFillSize() + off), which)); } break;
+		default: {} break;
+	}
+
+	// tellp
+	if (off == 0)
+		return pos_type(GetPutPos());
+
+	return (seekpos(pos_type(GetPutPos() + off), which));
+}
+
+CGzipStreamBuffer::pos_type CGzipStreamBuffer::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+	if ((which & std::ios_base::out) == 0 || file == nullptr)
+		return pos_type(off_type(-1));
+
+	const std::streamoff off = pos;
+
+	curBlockFill = GetFillSize();
+
+	if (off >= curBlockStart && off <= (curBlockStart + std::streamoff(curBlockFill))) {
+		inHeldBlock = false;
+		SetPutArea(curBlock->data, off - curBlockStart);
+		return pos;
+	}
+
+	if (heldBlock != nullptr && off >= heldBlockStart && off < (heldBlockStart + std::streamoff(heldBlock->data.size()))) {
+		inHeldBlock = true;
+		SetPutArea(heldBlock->data, off - heldBlockStart);
+		return pos;
+	}
+
+	// already handed to the compressor threads
+	return pos_type(off_type(-1));
+}
+
+
+void CGzipStreamBuffer::StartBlock()
+{
+	curBlock.reset(new Block());
+	curBlock->data.resize(blockSize);
+	curBlockFill = 0;
+
+	inHeldBlock = false;
+	SetPutArea(curBlock->data, 0);
+}
+
+void CGzipStreamBuffer::SubmitBlock()
+{
+	if (curBlock == nullptr || (curBlockFill = GetFillSize()) == 0)
+		return;
+
+	curBlock->data.resize(curBlockFill);
+
+	{
+		std::unique_lock<spring::mutex> lock(mutex);
+
+		// bounds memory use if the compressors can not keep up
+		doneCond.wait(lock, [&]() { return (numPendingBlocks < MAX_QUEUED_BLOCKS); });
+
+		if (pinned && heldBlock == nullptr) {
+			curBlock->state = BLOCK_HELD;
+			heldBlock = curBlock.get();
+			heldBlockStart = curBlockStart;
+		} else {
+			curBlock->state = BLOCK_QUEUED;
+			numPendingBlocks += 1;
+		}
+
+		blocks.emplace_back(std::move(curBlock));
+	}
+
+	jobCond.notify_one();
+
+	curBlockStart += curBlockFill;
+	curBlockFill = 0;
+}
+
+void CGzipStreamBuffer::SetPutArea(std::string& data, size_t offset)
+{
+	char* base = &data[0];
+
+	setp(base, base + data.size());
+	pbump(offset);
+}
+
+
+size_t CGzipStreamBuffer::GetFillSize() const
+{
+	if (inHeldBlock || curBlock == nullptr)
+		return curBlockFill;
+
+	return (std::max(curBlockFill, size_t(pptr() - pbase())));
+}
+
+std::streamoff CGzipStreamBuffer::GetPutPos() const
+{
+	return ((inHeldBlock? heldBlockStart: curBlockStart) + (pptr() - pbase()));
+}
+
+
+void CGzipStreamBuffer::ThreadFunc()
+{
+	Threading::SetThreadName("gzip-writer");
+
+	std::unique_lock<spring::mutex> lock(mutex);
+
+	const auto findQueuedBlock = [&]() -> Block* {
+		for (const auto& block: blocks) {
+			if (block->state == BLOCK_QUEUED)
+				return block.get();
+		}
+		return nullptr;
+	};
+
+	while (true) {
+		Block* block = nullptr;
+
+		jobCond.wait(lock, [&]() { return ((block = findQueuedBlock()) != nullptr || quit); });
+
+		// quit once everything queued has been picked up
+		if (block == nullptr)
+			break;
+
+		block->state = BLOCK_COMPRESSING;
+		lock.unlock();
+
+		std::string member;
+		const bool ret = zlib::gzip(block->data, level, member);
+
+		lock.lock();
+
+		block->member = std::move(member);
+		block->data = std::string();
+		block->state = BLOCK_DONE;
+
+		numPendingBlocks -= 1;
+		error |= !ret;
+
+		doneCond.notify_all();
+		WriteDoneBlocks(lock);
+	}
+}
+
+void CGzipStreamBuffer::WriteDoneBlocks(std::unique_lock<spring::mutex>& lock)
+{
+	// members have to be appended in order, by one thread at a time
+	if (writing)
+		return;
+
+	writing = true;
+
+	while (!blocks.empty() && blocks.front()->state == BLOCK_DONE) {
+		std::unique_ptr<Block> block = std::move(blocks.front());
+		blocks.pop_front();
+
+		lock.unlock();
+		const bool ret = (fwrite(block->member.data(), block->member.size(), 1, file) == 1);
+		lock.lock();
+
+		error |= !ret;
+	}
+
+	writing = false;
+}
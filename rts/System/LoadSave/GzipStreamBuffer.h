@@ -0,0 +1,113 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef GZIP_STREAM_BUFFER_H
+#define GZIP_STREAM_BUFFER_H
+
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "System/Threading/SpringThreading.h"
+
+
+/**
+ * @brief Output streambuf that gzips to a file while it is being written
+ *
+ * Data is cut into blocks which a few background threads compress into
+ * independent gzip members; these are appended to the file in order, so
+ * the result reads like any other .gz file (see CGZFileHandler). Memory
+ * use is bounded by blockSize * MAX_QUEUED_BLOCKS uncompressed bytes.
+ *
+ * Positions are uncompressed stream offsets. Seeking is restricted to the
+ * current block, and to the block started by Pin() until Unpin() is called
+ * which lets creg::COutputStreamSerializer::SavePackage rewrite its header.
+ */
+class CGzipStreamBuffer : public std::streambuf
+{
+public:
+	CGzipStreamBuffer(const std::string& fileName, size_t blockSize, int level);
+	~CGzipStreamBuffer();
+
+	CGzipStreamBuffer(const CGzipStreamBuffer&) = delete;
+	CGzipStreamBuffer& operator = (const CGzipStreamBuffer&) = delete;
+
+	bool IsOpen() const { return (file != nullptr); }
+
+	/// keeps the block beginning at the current position writable until Unpin
+	void Pin();
+	void Unpin();
+
+	/// compresses and writes all remaining data, returns false if any of it was lost
+	bool Close();
+
+protected:
+	int_type overflow(int_type c) override;
+	std::streamsize xsputn(const char* s, std::streamsize n) override;
+
+	pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+	pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+
+private:
+	enum BlockState {
+		BLOCK_HELD,
+		BLOCK_QUEUED,
+		BLOCK_COMPRESSING,
+		BLOCK_DONE,
+	};
+
+	struct Block {
+		std::string data;
+		std::string member;
+
+		BlockState state;
+	};
+
+	void StartBlock();
+	void SubmitBlock();
+	void SetPutArea(std::string& data, size_t offset);
+
+	size_t GetFillSize() const;
+	std::streamoff GetPutPos() const;
+
+	void ThreadFunc();
+	void WriteDoneBlocks(std::unique_lock<spring::mutex>& lock);
+
+private:
+	static constexpr size_t MAX_QUEUED_BLOCKS = 8;
+
+	FILE* file = nullptr;
+
+	// block being filled
+	std::unique_ptr<Block> curBlock;
+	// pinned block already submitted, still writable
+	Block* heldBlock = nullptr;
+
+	// blocks not yet written to the file, in stream order
+	std::deque< std::unique_ptr<Block> > blocks;
+	std::vector<spring::thread> threads;
+
+	spring::mutex mutex;
+	spring::condition_variable_any jobCond;
+	spring::condition_variable_any doneCond;
+
+	std::streamoff curBlockStart = 0;
+	std::streamoff heldBlockStart = 0;
+
+	// high-water mark of curBlock, pptr may be behind it after a seek
+	size_t curBlockFill = 0;
+	size_t blockSize = 0;
+	size_t numPendingBlocks = 0;
+
+	int level = 0;
+
+	bool pinned = false;
+	bool inHeldBlock = false;
+	bool writing = false;
+	bool quit = false;
+	bool error = false;
+};
+
+#endif
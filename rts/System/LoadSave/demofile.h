@@ -21,7 +21,10 @@
  * The current demofile version. Only change on major modifications for which
  * appending stuff to DemoFileHeader is not sufficient.
  */
-#define DEMOFILE_VERSION 5
+#define DEMOFILE_VERSION 6
+
+/** Number of frames between two DemoFrameIndexEntry's (one per game-second). */
+#define DEMOFILE_INDEX_INTERVAL 30
 
 #pragma pack(push, 1)
 
@@ -40,6 +43,9 @@
  *         CTeam::Statistics for each team.
  *       - Array of all CTeam::Statistics (total number of items is the
  *         sum of the elements in the array of dwords).
+ *     - Frame index (frameIndexSize), array of DemoFrameIndexEntry
+ *     - Keyframes (keyFrameSize), each a DemoKeyFrameHeader followed by
+ *       dataSize bytes of savestate (see CCregLoadSaveHandler)
  *
  * The header is designed to be extensible: it contains a version field and a
  * headerSize field to support this. The version field is a major version number
@@ -48,7 +54,15 @@
  * minor version number, which happens to be equal to sizeof(DemoFileHeader).
  *
  * If Spring did not cleanup properly (crashed), the demoStreamSize is 0 and it
- * can be assumed the demo stream continues until the end of the file.
+ * can be assumed the demo stream continues until the end of the file. Such a
+ * demo has no frame index either.
+ *
+ * Version 5 demos are identical up to the team statistics, their header ends
+ * before frameIndexSize.
+ *
+ * The (uncompressed) layout above is stored as a series of concatenated gzip
+ * members, written while recording (see CDemoStreamWriter); the first holds
+ * only the DemoFileHeader so it can be updated in-place.
  */
 struct DemoFileHeader
 {
@@ -70,6 +84,8 @@ struct DemoFileHeader
 	int teamStatElemSize;         ///< sizeof(CTeam::Statistics)
 	int teamStatPeriod;           ///< Interval (in seconds) between team stats.
 	int winningAllyTeamsSize;     ///< The size of the vector of the winning ally teams
+	int frameIndexSize;           ///< Size of the entire frame index chunk.
+	int keyFrameSize;             ///< Size of the entire keyframe chunk (headers and data).
 
 
 	/// Change structure from host endian to little endian or vice versa.
@@ -89,6 +105,48 @@ struct DemoFileHeader
 		swabDWordInPlace(teamStatElemSize);
 		swabDWordInPlace(teamStatPeriod);
 		swabDWordInPlace(winningAllyTeamsSize);
+		swabDWordInPlace(frameIndexSize);
+		swabDWordInPlace(keyFrameSize);
+	}
+};
+
+/**
+ * @brief Spring demo frame index entry
+ *
+ * Written for every DEMOFILE_INDEX_INTERVAL'th frame. streamOffset is relative
+ * to the start of the demo stream and points just past the chunk holding the
+ * NETMSG_NEWFRAME or NETMSG_KEYFRAME of frameNum, i.e. at the first chunk to
+ * be read when resuming playback from the state at the end of frameNum.
+ */
+struct DemoFrameIndexEntry
+{
+	int frameNum;
+	int streamOffset;
+	float modGameTime;
+
+	void swab() {
+		swabDWordInPlace(frameNum);
+		swabDWordInPlace(streamOffset);
+		swabFloatInPlace(modGameTime);
+	}
+};
+
+/**
+ * @brief Spring demo keyframe header
+ *
+ * A savestate taken at the end of frameNum; playback can load it and
+ * continue reading the demo stream at streamOffset (as for the index).
+ */
+struct DemoKeyFrameHeader
+{
+	int frameNum;
+	int streamOffset;
+	int dataSize;               ///< Size of the savestate following this header.
+
+	void swab() {
+		swabDWordInPlace(frameNum);
+		swabDWordInPlace(streamOffset);
+		swabDWordInPlace(dataSize);
 	}
 };
 
@@ -288,4 +288,29 @@ std::vector<std::uint8_t> zlib::inflate(const std::uint8_t* deflData, unsigned l
 
 	return inflData;
 }
+
+bool zlib::gzip(const std::string& src, int level, std::string& dst)
+{
+	z_stream zs;
+	memset(&zs, 0, sizeof(zs));
+
+	// +16 writes a gzip instead of a zlib wrapper
+	if (deflateInit2(&zs, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		return false;
+
+	dst.clear();
+	dst.resize(deflateBound(&zs, src.size()));
+
+	zs.next_in   = reinterpret_cast<Bytef*>(const_cast<char*>(src.data()));
+	zs.avail_in  = src.size();
+	zs.next_out  = reinterpret_cast<Bytef*>(&dst[0]);
+	zs.avail_out = dst.size();
+
+	const int ret = deflate(&zs, Z_FINISH);
+
+	dst.resize(zs.total_out);
+	deflateEnd(&zs);
+
+	return (ret == Z_STREAM_END);
+}
 #endif //UNITSYNC
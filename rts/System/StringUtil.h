@@ -241,6 +241,9 @@ namespace zlib {
 
 	std::vector<std::uint8_t> deflate(const std::vector<std::uint8_t>& inflData);
 	std::vector<std::uint8_t> inflate(const std::vector<std::uint8_t>& deflData);
+
+	/// compresses src into a single gzip member, these can be concatenated into one stream
+	bool gzip(const std::string& src, int level, std::string& dst);
 };
 #endif //UNITSYNC
 
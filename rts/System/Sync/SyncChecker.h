@@ -32,6 +32,11 @@ class CSyncChecker {
 		 */
 		static unsigned GetChecksum() { return g_checksum; }
 		static void NewFrame() { g_checksum = 0xfade1eaf; }
+		/**
+		 * Continues the running checksum of another client, e.g. after
+		 * loading its savestate when joining a game in progress.
+		 */
+		static void SetChecksum(unsigned checksum) { g_checksum = checksum; }
 
 		static void Sync(const void* p, unsigned size) {
 			// most common cases first, make it easy for compiler to optimize for it
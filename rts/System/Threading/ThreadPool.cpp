@@ -76,7 +76,7 @@ static spring::signal newTasksSignal[2];
 
 static _threadlocal int threadnum(0);
 
-#ifndef UNITSYNC
+#if (!defined(UNITSYNC) && !defined(UNIT_TEST))
 // if enabled, allows OpenGL calls from ThreadPool tasks
 // so certain logic (e.g. loading models) can be written
 // without forcing GL code to run within the main thread
@@ -350,7 +350,7 @@ void NotifyWorkerThreads(bool force, bool async)
 
 static void SpawnThreads(int wantedNumThreads, int curNumThreads)
 {
-#ifndef UNITSYNC
+#if (!defined(UNITSYNC) && !defined(UNIT_TEST))
 	if (glThreadSupport) {
 		try {
 			for (int i = curNumThreads; i < wantedNumThreads; ++i) {
@@ -390,7 +390,7 @@ static void KillThreads(int wantedNumThreads, int curNumThreads)
 		assert(!workerThreads[false].empty());
 		assert(!workerThreads[ true].empty());
 
-	#ifndef UNITSYNC
+	#if (!defined(UNITSYNC) && !defined(UNIT_TEST))
 		if (glThreadSupport) {
 			{ auto th = reinterpret_cast<COffscreenGLThread*>(workerThreads[false].back()); th->join(); delete th; }
 			{ auto th = reinterpret_cast<COffscreenGLThread*>(workerThreads[ true].back()); th->join(); delete th; }
@@ -2,12 +2,14 @@
 
 #include <algorithm>
 #include <climits>
+#include <cstdio>
 #include <cstring>
 
 #include "System/TimeProfiler.h"
 #include "System/GlobalRNG.h"
 #include "System/StringHash.h"
 #include "System/Log/ILog.h"
+#include "System/Platform/Threading.h"
 #include "System/Threading/SpringThreading.h"
 
 #ifdef THREADPOOL
@@ -16,11 +18,14 @@
 
 static spring::spinlock profileMutex;
 static spring::spinlock hashToNameMutex;
+static spring::spinlock traceBuffersMutex;
 static spring::unordered_map<unsigned, std::string> hashToName;
 static spring::unordered_map<unsigned, int> refCounters;
 
 static CGlobalUnsyncedRNG profileColorRNG;
 
+static thread_local void* threadTraceBuffer = nullptr;
+
 
 spring_time BasicTimer::GetDuration() const
 {
@@ -53,6 +58,9 @@ ScopedTimer::~ScopedTimer()
 
 	if (--(iter->second) == 0) {
 		profiler.AddTime(nameHash, startTime, GetDuration(), autoShowGraph, specialTimer, false);
+
+		if (profiler.IsTracing())
+			profiler.AddTraceEvent(nameHash, startTime, spring_gettime());
 	}
 }
 
@@ -97,6 +105,9 @@ ScopedMtTimer::ScopedMtTimer(unsigned _nameHash, bool _autoShowGraph)
 ScopedMtTimer::~ScopedMtTimer()
 {
 	profiler.AddTime(nameHash, startTime, GetDuration(), autoShowGraph, false, true);
+
+	if (profiler.IsTracing())
+		profiler.AddTraceEvent(nameHash, startTime, spring_gettime());
 }
 
 
@@ -411,3 +422,145 @@ void CTimeProfiler::PrintProfilingInfo() const
 	}
 }
 
+
+
+
+void CTimeProfiler::StartTrace(unsigned int eventsPerThread)
+{
+	{
+		std::lock_guard<spring::spinlock> lock(traceBuffersMutex);
+
+		// buffers already handed out keep their size
+		if (traceBuffers.empty())
+			traceBufferSize = std::max(eventsPerThread, 1u);
+	}
+
+	traceEnabled = true;
+}
+
+CTimeProfiler::TraceBuffer* CTimeProfiler::GetThreadTraceBuffer()
+{
+	if (threadTraceBuffer != nullptr)
+		return (static_cast<TraceBuffer*>(threadTraceBuffer));
+
+	std::lock_guard<spring::spinlock> lock(traceBuffersMutex);
+
+	traceBuffers.emplace_back();
+
+	TraceBuffer& buffer = traceBuffers.back();
+	buffer.events.resize(traceBufferSize);
+
+	#ifdef THREADPOOL
+	const int poolThreadNum = ThreadPool::GetThreadNum();
+	#else
+	const int poolThreadNum = 0;
+	#endif
+
+	char threadName[64];
+
+	if (Threading::IsMainThread()) {
+		snprintf(threadName, sizeof(threadName), "main");
+	} else if (poolThreadNum > 0) {
+		snprintf(threadName, sizeof(threadName), "worker-%d", poolThreadNum);
+	} else if (Threading::IsGameLoadThread()) {
+		snprintf(threadName, sizeof(threadName), "load");
+	} else {
+		snprintf(threadName, sizeof(threadName), "thread-%u", unsigned(traceBuffers.size() - 1));
+	}
+
+	buffer.threadName = threadName;
+	return (static_cast<TraceBuffer*>(threadTraceBuffer = &buffer));
+}
+
+void CTimeProfiler::AddTraceEvent(unsigned nameHash, const spring_time startTime, const spring_time endTime)
+{
+	TraceBuffer* buffer = GetThreadTraceBuffer();
+
+	const std::uint64_t writeIdx = buffer->writeIdx.load(std::memory_order_relaxed);
+
+	buffer->events[writeIdx % buffer->events.size()] = {startTime, endTime, nameHash, traceFrameNum.load(std::memory_order_relaxed)};
+	buffer->writeIdx.store(writeIdx + 1, std::memory_order_release);
+}
+
+bool CTimeProfiler::DumpTrace(const std::string& fileName) const
+{
+	FILE* file = fopen(fileName.c_str(), "w");
+
+	if (file == nullptr) {
+		LOG_L(L_ERROR, "[TimeProfiler::%s] could not open \"%s\" for writing", __func__, fileName.c_str());
+		return false;
+	}
+
+	std::vector<TraceEvent> events;
+	spring::unordered_map<unsigned, std::string> names;
+
+	{
+		std::lock_guard<spring::spinlock> lock(hashToNameMutex);
+		names = hashToName;
+	}
+
+	size_t numEvents = 0;
+	bool firstEvent = true;
+
+	fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+
+	std::vector<const TraceBuffer*> buffers;
+
+	{
+		// threads may add buffers while we are dumping, those are simply skipped
+		std::lock_guard<spring::spinlock> lock(traceBuffersMutex);
+
+		for (const TraceBuffer& buffer: traceBuffers)
+			buffers.push_back(&buffer);
+	}
+
+	for (size_t tid = 0; tid < buffers.size(); tid++) {
+		const TraceBuffer& buffer = *buffers[tid];
+
+		const std::uint64_t bufSize = buffer.events.size();
+		const std::uint64_t endIdx = buffer.writeIdx.load(std::memory_order_acquire);
+		const std::uint64_t begIdx = endIdx - std::min(endIdx, bufSize);
+
+		events.clear();
+		events.reserve(endIdx - begIdx);
+
+		for (std::uint64_t i = begIdx; i < endIdx; i++) {
+			events.push_back(buffer.events[i % bufSize]);
+		}
+
+		// the owning thread kept writing while we copied; drop whatever it
+		// overwrote, including the slot it might be in the middle of writing
+		const std::uint64_t newEndIdx = buffer.writeIdx.load(std::memory_order_acquire) + 1;
+		const std::uint64_t validIdx = newEndIdx - std::min(newEndIdx, bufSize);
+		const std::uint64_t numStale = std::min<std::uint64_t>(events.size(), std::max(validIdx, begIdx) - begIdx);
+
+		fprintf(file, "%s{\"ph\": \"M\", \"pid\": 0, \"tid\": %u, \"name\": \"thread_name\", \"args\": {\"name\": \"%s\"}}", firstEvent? "": ",\n", unsigned(tid), buffer.threadName.c_str());
+		firstEvent = false;
+
+		for (size_t i = numStale; i < events.size(); i++) {
+			const TraceEvent& e = events[i];
+			const auto iter = names.find(e.nameHash);
+
+			fprintf(file, ",\n{\"ph\": \"X\", \"pid\": 0, \"tid\": %u, ", unsigned(tid));
+
+			if (iter != names.end()) {
+				fprintf(file, "\"name\": \"%s\", ", iter->second.c_str());
+			} else {
+				fprintf(file, "\"name\": \"0x%08x\", ", e.nameHash);
+			}
+
+			fprintf(file, "\"ts\": %.3f, \"dur\": %.3f, \"args\": {\"frame\": %d}}", e.startTime.toNanoSecsi() * 1e-3, (e.endTime - e.startTime).toNanoSecsi() * 1e-3, e.frameNum);
+		}
+
+		numEvents += (events.size() - numStale);
+	}
+
+	fprintf(file, "\n]}\n");
+
+	const bool ret = (ferror(file) == 0);
+
+	fclose(file);
+
+	LOG("[TimeProfiler::%s] wrote %u events of %u threads to \"%s\"", __func__, unsigned(numEvents), unsigned(buffers.size()), fileName.c_str());
+	return ret;
+}
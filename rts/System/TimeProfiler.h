@@ -4,6 +4,7 @@
 #define TIME_PROFILER_H
 
 #include <atomic>
+#include <cstdint>
 #include <cstring> // memset
 #include <string>
 #include <deque>
@@ -24,7 +25,7 @@
 #define SCOPED_SPECIAL_TIMER(      name)  static TimerNameRegistrar __stnr(name); ScopedTimer __scopedTimer(hashString(name), false, true);
 #define SCOPED_SPECIAL_TIMER_NOREG(name)                                          ScopedTimer __scopedTimer(hashString(name), false, true);
 
-#define SCOPED_MT_TIMER(name)  ScopedMtTimer __scopedTimer(hashString(name));
+#define SCOPED_MT_TIMER(name)  static TimerNameRegistrar __tnr(name); ScopedMtTimer __scopedTimer(hashString(name));
 
 
 class BasicTimer : public spring::noncopyable
@@ -167,6 +168,22 @@ public:
 	void SetEnabled(bool b) { enabled = b; }
 	void PrintProfilingInfo() const;
 
+	/**
+	 * Trace mode: every timer additionally records its (start, end) pair
+	 * tagged with the current sim frame into a ring buffer owned by the
+	 * calling thread, so recording needs no locks; DumpTrace writes what
+	 * the buffers still hold in Chrome trace-event format (chrome://tracing,
+	 * ui.perfetto.dev). Events are stored as complete ("X") events, which
+	 * the viewers nest by time and which can not be split by wrap-around.
+	 */
+	void StartTrace(unsigned int eventsPerThread);
+	void StopTrace() { traceEnabled = false; }
+	bool IsTracing() const { return (traceEnabled.load(std::memory_order_relaxed)); }
+	bool DumpTrace(const std::string& fileName) const;
+
+	void SetTraceFrame(int frameNum) { traceFrameNum.store(frameNum, std::memory_order_relaxed); }
+	void AddTraceEvent(unsigned nameHash, const spring_time startTime, const spring_time endTime);
+
 	void AddTime(
 		unsigned nameHash,
 		const spring_time startTime,
@@ -183,6 +200,25 @@ public:
 		const bool threadTimer
 	);
 
+private:
+	struct TraceEvent {
+		spring_time startTime;
+		spring_time endTime;
+
+		unsigned nameHash;
+		int frameNum;
+	};
+
+	struct TraceBuffer {
+		std::vector<TraceEvent> events;
+		// total number of events ever written, only the owning thread increments it
+		std::atomic<std::uint64_t> writeIdx = {0};
+
+		std::string threadName;
+	};
+
+	TraceBuffer* GetThreadTraceBuffer();
+
 private:
 	spring::unordered_map<unsigned, TimeRecord> profiles;
 
@@ -197,6 +233,14 @@ private:
 
 	// if false, AddTime is a no-op for (almost) all timers
 	std::atomic<bool> enabled;
+
+	// never shrinks, threads keep pointers to their buffer
+	std::deque<TraceBuffer> traceBuffers;
+
+	unsigned int traceBufferSize = 0;
+
+	std::atomic<int> traceFrameNum = {-1};
+	std::atomic<bool> traceEnabled = {false};
 };
 
 
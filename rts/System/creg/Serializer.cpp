@@ -18,6 +18,7 @@
 #include <fstream>
 #include <cassert>
 #include <stdexcept>
+#include <chrono>
 #include <map>
 #include <vector>
 #include <string>
@@ -99,27 +100,24 @@ void ReadVarSizeUInt(std::istream* stream, T* buf)
 }
 
 
-template<typename T>
-void WriteVarSizeUInt(std::ostream* stream, T val)
-{
-	std::uint64_t v = val;
-	do {
-		unsigned char a = v & 0x7F;
-		v >>= 7;
-
-		if (v > 0)
-			a |= 0x80;
-
-		stream->write((char*)&a, sizeof(char));
-	} while (v > 0);
-}
-
 //-------------------------------------------------------------------------
 // Base output serializer
 //-------------------------------------------------------------------------
+static std::int64_t GetTimeNanoSecs()
+{
+	return (std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+
 COutputStreamSerializer::COutputStreamSerializer()
 {
 	stream = nullptr;
+
+	numBytesWritten = 0;
+	nestedBytes = 0;
+	nestedTime = 0;
+
+	collectClassStats = false;
 }
 
 bool COutputStreamSerializer::IsWriting()
@@ -127,26 +125,91 @@ bool COutputStreamSerializer::IsWriting()
 	return true;
 }
 
+void COutputStreamSerializer::WriteVarSizeUInt(std::uint64_t v)
+{
+	// at most ceil(64 / 7) bytes, written with a single call
+	char buf[10];
+	int len = 0;
+
+	do {
+		unsigned char a = v & 0x7F;
+		v >>= 7;
+
+		if (v > 0)
+			a |= 0x80;
+
+		buf[len++] = a;
+	} while (v > 0);
+
+	stream->write(buf, len);
+	numBytesWritten += len;
+}
+
 COutputStreamSerializer::ObjectRef* COutputStreamSerializer::FindObjectRef(void* inst, creg::Class* objClass, bool isEmbedded)
 {
-	std::vector<ObjectRef*>& refs = ptrToId[inst];
-	for (auto& obj: refs) {
+	const auto it = ptrToId.find(inst);
+
+	if (it == ptrToId.end())
+		return nullptr;
+
+	for (ObjectRef* obj = it->second; obj != nullptr; obj = obj->nextRef) {
 		if (obj->isThisObject(inst, objClass, isEmbedded))
 			return obj;
 	}
 	return nullptr;
 }
 
-void COutputStreamSerializer::SerializeObject(Class* c, void* ptr, ObjectRef* objr)
+COutputStreamSerializer::ObjectRef* COutputStreamSerializer::AddObjectRef(void* inst, creg::Class* objClass, bool isEmbedded)
 {
-	const unsigned objstart = stream->tellp();
+	objects.emplace_back(inst, objects.size(), isEmbedded, objClass);
 
-	if (c->base())
-		SerializeObject(c->base(), ptr, objr);
+	ObjectRef* obj = &objects.back();
+	ObjectRef** ref = &ptrToId[inst];
+
+	// deque never relocates its elements, so the chain stays valid;
+	// append to keep the lookup order of the previous vector storage
+	while (*ref != nullptr)
+		ref = &(*ref)->nextRef;
 
-	ObjectMemberGroup omg;
-	omg.membersClass = c;
-	omg.size = 0;
+	*ref = obj;
+	return obj;
+}
+
+void COutputStreamSerializer::SerializeObject(Class* c, void* ptr)
+{
+	// the per-class table is only printed at this log level, skip the
+	// clock reads and map updates (one of each per object) otherwise
+	if (!collectClassStats) {
+		SerializeObjectMembers(c, ptr);
+		return;
+	}
+
+	const std::uint64_t startBytes = numBytesWritten;
+	const std::uint64_t outerNestedBytes = nestedBytes;
+	const std::int64_t startTime = GetTimeNanoSecs();
+	const std::int64_t outerNestedTime = nestedTime;
+
+	nestedBytes = 0;
+	nestedTime = 0;
+
+	SerializeObjectMembers(c, ptr);
+
+	const std::uint64_t size = numBytesWritten - startBytes;
+	const std::int64_t time = GetTimeNanoSecs() - startTime;
+
+	ClassStats& stats = classStats[c];
+	stats.size += (size - nestedBytes);
+	stats.time += (time - nestedTime);
+	stats.count += 1;
+
+	nestedBytes = outerNestedBytes + size;
+	nestedTime = outerNestedTime + time;
+}
+
+void COutputStreamSerializer::SerializeObjectMembers(Class* c, void* ptr)
+{
+	if (c->base())
+		SerializeObjectMembers(c->base(), ptr);
 
 	for (uint a = 0; a < c->members.size(); a++)
 	{
@@ -154,39 +217,15 @@ void COutputStreamSerializer::SerializeObject(Class* c, void* ptr, ObjectRef* ob
 		if (m->flags & CM_NoSerialize)
 			continue;
 
-		ObjectMember om;
-		om.member = m;
-		om.memberId = a;
 		void* memberAddr = ((char*)ptr) + m->offset;
-		unsigned mstart = stream->tellp();
+		const std::uint64_t mstart = numBytesWritten;
 		LOG_SL(LOG_SECTION_CREG_SERIALIZER, L_DEBUG, "Serialized %s::%s type:%s", c->name, m->name, m->type->GetName().c_str());
 		m->type->Serialize(this, memberAddr);
-		unsigned mend = stream->tellp();
-		om.size = mend - mstart;
-		omg.members.push_back(om);
-		omg.size += om.size;
-		LOG_SL(LOG_SECTION_CREG_SERIALIZER, L_DEBUG, "Serialized %s::%s type:%s size:%d", c->name, m->name, m->type->GetName().c_str(), om.size);
+		LOG_SL(LOG_SECTION_CREG_SERIALIZER, L_DEBUG, "Serialized %s::%s type:%s size:%d", c->name, m->name, m->type->GetName().c_str(), int(numBytesWritten - mstart));
 	}
 
-
-	if (c->HasSerialize()) {
-		ObjectMember om;
-		om.member = nullptr;
-		om.memberId = -1;
-		unsigned mstart = stream->tellp();
+	if (c->HasSerialize())
 		c->CallSerializeProc(ptr, this);
-		unsigned mend = stream->tellp();
-		om.size = mend - mstart;
-		omg.members.push_back(om);
-		omg.size += om.size;
-	}
-
-	objr->memberGroups.push_back(omg);
-
-	const unsigned objend = stream->tellp();
-	const int sz = objend - objstart;
-	classSizes[c] += sz;
-	classCounts[c]++;
 }
 
 void COutputStreamSerializer::SerializeObjectInstance(void* inst, creg::Class* objClass)
@@ -194,53 +233,47 @@ void COutputStreamSerializer::SerializeObjectInstance(void* inst, creg::Class* o
 	// register the object, and mark it as embedded if a pointer was already referencing it
 	ObjectRef* obj = FindObjectRef(inst, objClass, true);
 	if (!obj) {
-		objects.emplace_back(inst, objects.size(), true, objClass);
-		obj = &objects.back();
-		ptrToId[inst].push_back(obj);
+		obj = AddObjectRef(inst, objClass, true);
 	} else if (obj->isEmbedded) {
 		throw std::string("Reserialization of embedded object (") + objClass->name + ")";
+	} else if (!obj->isPending) {
+		throw std::string("Object pointer was serialized (") + objClass->name + ")";
 	} else {
-		std::vector<ObjectRef*>::iterator it = std::find(pendingObjects.begin(), pendingObjects.end(), obj);
-		if (it == pendingObjects.end()) {
-			throw std::string("Object pointer was serialized (") + objClass->name + ")";
-		} else {
-			pendingObjects.erase(it);
-		}
+		// SavePackage skips it when it reaches the pendingObjects entry
+		obj->isPending = false;
 	}
 	obj->class_ = objClass;
 	obj->isEmbedded = true;
 
 	// write an object ID
-	WriteVarSizeUInt(stream, obj->id);
+	WriteVarSizeUInt(obj->id);
 
 	// write the object
-	SerializeObject(objClass, inst, obj);
+	SerializeObject(objClass, inst);
 }
 
 void COutputStreamSerializer::SerializeObjectPtr(void** ptr, creg::Class* objClass)
 {
 	if (*ptr) {
 		// valid pointer, write a one and the object ID
-		int id;
 		ObjectRef* obj = FindObjectRef(*ptr, objClass, false);
 		if (!obj) {
-			objects.emplace_back(*ptr, objects.size(), false, objClass);
-			obj = &objects.back();
-			ptrToId[*ptr].push_back(obj);
+			obj = AddObjectRef(*ptr, objClass, false);
+			obj->isPending = true;
 			pendingObjects.push_back(obj);
 		}
-		id = obj->id;
 
-		WriteVarSizeUInt(stream, id);
+		WriteVarSizeUInt(obj->id);
 	} else {
 		// null pointer, write a zero
-		WriteVarSizeUInt(stream, 0);
+		WriteVarSizeUInt(0);
 	}
 }
 
 void COutputStreamSerializer::Serialize(void* data, int byteSize)
 {
 	stream->write((char*)data, byteSize);
+	numBytesWritten += byteSize;
 }
 
 void COutputStreamSerializer::SerializeInt(void* data, int byteSize)
@@ -258,7 +291,7 @@ void COutputStreamSerializer::SerializeInt(void* data, int byteSize)
 			throw "Unknown int type";
 		}
 	}
-	WriteVarSizeUInt(stream, x);
+	WriteVarSizeUInt(x);
 }
 
 
@@ -273,6 +306,8 @@ void COutputStreamSerializer::SavePackage(std::ostream* s, void* rootObj, Class*
 	PackageHeader ph;
 
 	stream = s;
+	collectClassStats = LOG_IS_ENABLED_S(LOG_SECTION_CREG_SERIALIZER, L_INFO);
+
 	unsigned startOffset = stream->tellp();
 	stream->write((char*)&ph, sizeof(PackageHeader));
 	stream->seekp(startOffset + sizeof(PackageHeader));
@@ -284,25 +319,32 @@ void COutputStreamSerializer::SavePackage(std::ostream* s, void* rootObj, Class*
 	obj->classIndex = 0;
 
 	// Insert the first object that will provide references to everything
-	objects.emplace_back(rootObj, objects.size(), false, rootObjClass);
-	obj = &objects.back();
-	ptrToId[rootObj].push_back(obj);
+	obj = AddObjectRef(rootObj, rootObjClass, false);
+	obj->isPending = true;
 	pendingObjects.push_back(obj);
 
+	std::vector<ObjectRef*> po;
+
 	// Save until all the referenced objects have been stored
 	while (!pendingObjects.empty())
 	{
-		const std::vector<ObjectRef*> po = pendingObjects;
-		pendingObjects.clear();
+		po.clear();
+		po.swap(pendingObjects);
+
+		// drop those written as embedded instances in the meantime, the
+		// remaining ones can not be anymore once their batch is started
+		po.erase(std::remove_if(po.begin(), po.end(), [](const ObjectRef* o) { return !o->isPending; }), po.end());
 
 		for (ObjectRef* obj: po) {
-			SerializeObject(obj->class_, obj->ptr, obj);
-			//LOG_SL(LOG_SECTION_CREG_SERIALIZER, L_DEBUG, "Serialized %s size:%i", obj->class_->name.c_str(), sz);
+			obj->isPending = false;
+		}
+		for (ObjectRef* obj: po) {
+			SerializeObject(obj->class_, obj->ptr);
 		}
 	}
 
 	// Collect a set of all used classes
-	std::map<creg::Class*, ClassRef> classMap;
+	spring::unsynced_map<creg::Class*, ClassRef> classMap;
 	std::vector<ClassRef*> classRefs;
 	for (ObjectRef& oRef: objects) {
 		if (oRef.ptr == nullptr)
@@ -310,7 +352,7 @@ void COutputStreamSerializer::SavePackage(std::ostream* s, void* rootObj, Class*
 
 		creg::Class* c = oRef.class_;
 		while (c) {
-			std::map<creg::Class*, ClassRef>::iterator cr = classMap.find(c);
+			const auto cr = classMap.find(c);
 			if (cr == classMap.end()) {
 				ClassRef* pRef = &classMap[c];
 				pRef->index = classRefs.size();
@@ -320,21 +362,10 @@ void COutputStreamSerializer::SavePackage(std::ostream* s, void* rootObj, Class*
 			c = c->base();
 		}
 
-		std::map<creg::Class*, ClassRef>::iterator cr = classMap.find(oRef.class_);
-		oRef.classIndex = cr->second.index;
+		oRef.classIndex = classMap[oRef.class_].index;
 	}
 
-
-	if (LOG_IS_ENABLED(L_DEBUG)) {
-		for (auto &it: classSizes) {
-			LOG_L(L_DEBUG, "%30s %10u %10u",
-					it.first->name,
-					classCounts[it.first],
-					it.second);
-			it.second = 0;
-			classCounts[it.first] = 0;
-		}
-	}
+	LogClassStats();
 
 
 	// Write the class references & calc their checksum
@@ -351,10 +382,10 @@ void COutputStreamSerializer::SavePackage(std::ostream* s, void* rootObj, Class*
 	for (ObjectRef& oRef: objects) {
 		int classRefIndex = oRef.classIndex;
 		char isEmbedded = oRef.isEmbedded ? 1 : 0;
-		WriteVarSizeUInt(stream, classRefIndex);
+		WriteVarSizeUInt(classRefIndex);
 		stream->write((char*)&isEmbedded, sizeof(char));
 		if (!isEmbedded && oRef.class_ != nullptr && oRef.class_->HasGetSize())
-			WriteVarSizeUInt(stream, oRef.class_->CallGetSizeProc(oRef.ptr));
+			WriteVarSizeUInt(oRef.class_->CallGetSizeProc(oRef.ptr));
 	}
 
 	// Calculate a checksum for metadata verification
@@ -378,7 +409,41 @@ void COutputStreamSerializer::SavePackage(std::ostream* s, void* rootObj, Class*
 	ptrToId.clear();
 	pendingObjects.clear();
 	objects.clear();
-	classSizes.clear();
+	classStats.clear();
+
+	numBytesWritten = 0;
+	nestedBytes = 0;
+	nestedTime = 0;
+}
+
+void COutputStreamSerializer::LogClassStats() const
+{
+	if (!collectClassStats)
+		return;
+
+	std::vector< std::pair<Class*, ClassStats> > stats(classStats.begin(), classStats.end());
+	std::uint64_t totalSize = 0;
+	std::int64_t totalTime = 0;
+
+	// biggest first, these are what makes saving slow
+	std::sort(stats.begin(), stats.end(), [](const std::pair<Class*, ClassStats>& a, const std::pair<Class*, ClassStats>& b) {
+		return (a.second.size > b.second.size);
+	});
+
+	LOG_SL(LOG_SECTION_CREG_SERIALIZER, L_INFO, "%30s %10s %12s %10s", "class", "objects", "bytes", "ms");
+
+	for (const auto& p: stats) {
+		LOG_SL(LOG_SECTION_CREG_SERIALIZER, L_INFO, "%30s %10" PRIu64 " %12" PRIu64 " %10.2f",
+				p.first->name,
+				p.second.count,
+				p.second.size,
+				p.second.time * 1e-6);
+
+		totalSize += p.second.size;
+		totalTime += p.second.time;
+	}
+
+	LOG_SL(LOG_SECTION_CREG_SERIALIZER, L_INFO, "%30s %10u %12" PRIu64 " %10.2f", "total", unsigned(objects.size()), totalSize, totalTime * 1e-6);
 }
 
 //-------------------------------------------------------------------------
@@ -8,11 +8,13 @@
 
 #ifdef USING_CREG
 
-#include <map>
+#include <cinttypes>
 #include <vector>
 #include <deque>
 #include <istream>
 
+#include "System/UnorderedMap.hpp"
+
 namespace creg {
 
 	/**
@@ -23,43 +25,31 @@ namespace creg {
 	class COutputStreamSerializer : public ISerializer
 	{
 	protected:
-		struct ObjectMember {
-			Class::Member* member;
-			int memberId;
-			int size;
-		};
-		struct ObjectMemberGroup {
-			Class* membersClass;
-			std::vector<COutputStreamSerializer::ObjectMember> members;
-			int size;
-		};
 		struct ObjectRef {
 			ObjectRef() {
 				ptr = 0;
 				id=0;
 				classIndex=0;
 				isEmbedded=false;
+				isPending=false;
 				class_=0;
+				nextRef=nullptr;
 			}
 			ObjectRef(void* ptr, int id, bool isEmbedded, Class* class_) {
 				this->ptr = ptr;
 				this->id=id;
 				classIndex=0;
 				this->isEmbedded=isEmbedded;
+				isPending=false;
 				this->class_=class_;
-			}
-			ObjectRef(const ObjectRef&src) :memberGroups(src.memberGroups){
-				ptr=src.ptr;
-				id=src.id;
-				classIndex=src.classIndex;
-				isEmbedded=src.isEmbedded;
-				class_=src.class_;
+				nextRef=nullptr;
 			}
 			void* ptr;
 			int id, classIndex;
 			bool isEmbedded;
+			bool isPending; // still in pendingObjects
 			Class* class_;
-			std::vector<COutputStreamSerializer::ObjectMemberGroup> memberGroups;
+			ObjectRef* nextRef; // next object at the same address (e.g. an embedded first member)
 			bool isThisObject(void* objPtr, Class* objClass, bool objEmbedded) const
 			{
 				if (ptr != objPtr) return false;
@@ -77,24 +67,42 @@ namespace creg {
 			}
 		};
 
+		/// per-class totals of the current package, excluding nested objects
+		struct ClassStats {
+			std::uint64_t size = 0;
+			std::uint64_t count = 0;
+			std::int64_t time = 0; // ns
+		};
+
 		// Temporary class reference
 		struct ClassRef;
 
 		std::ostream* stream;
-		std::map<void*,std::vector<ObjectRef*> > ptrToId;
+		spring::unsynced_map<void*, ObjectRef*> ptrToId;
 		std::deque<ObjectRef> objects;
 		std::vector<ObjectRef*> pendingObjects; // these objects still have to be saved
-		std::map<Class*, int> classSizes;
-		std::map<Class*, int> classCounts;
+		spring::unsynced_map<Class*, ClassStats> classStats;
+
+		std::uint64_t numBytesWritten;
+		// size and time spent on the objects nested in the one currently being written
+		std::uint64_t nestedBytes;
+		std::int64_t nestedTime;
+
+		bool collectClassStats;
 
 		// Serialize all class names
 		void WriteObjectInfo();
 		// Helper for instance/ptr saving
 		void WriteObjectRef(void* inst, Class* cls, bool embedded);
+		void WriteVarSizeUInt(std::uint64_t val);
 
 		ObjectRef* FindObjectRef(void* inst, Class* objClass, bool isEmbedded);
+		ObjectRef* AddObjectRef(void* inst, Class* objClass, bool isEmbedded);
+
+		void SerializeObject(Class* c, void* ptr);
+		void SerializeObjectMembers(Class* c, void* ptr);
 
-		void SerializeObject(Class* c, void* ptr, ObjectRef* objr);
+		void LogClassStats() const;
 
 	public:
 		COutputStreamSerializer();
@@ -104,6 +112,7 @@ namespace creg {
 		 * @param rootObj the rootObj: the starting point for finding all the objects to save
 		 * @param cls the class of the root object
 		 * This method throws an std::runtime_error when something goes wrong
+		 * Per-class sizes and times are logged to the CregSerializer section
 		 */
 		void SavePackage(std::ostream* s, void* rootObj, Class* cls);
 
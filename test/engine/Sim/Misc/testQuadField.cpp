@@ -3,6 +3,12 @@
 #include "Sim/Misc/QuadField.h"
 #include "System/float3.h"
 #include "System/SpringMath.h"
+#include "System/Misc/SpringTime.h"
+#include "System/Platform/Threading.h"
+#include "System/Threading/ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <vector>
 #include <stdlib.h>
 #include <time.h>
 
@@ -14,6 +20,8 @@ static inline float randf()
 	return rand() / float(RAND_MAX);
 }
 
+InitSpringTime ist;
+
 
 
 TEST_CASE("QuadField")
@@ -99,3 +107,212 @@ TEST_CASE("QuadField")
 	INFO("Too little quads returned!");
 	CHECK_FALSE(fail);
 }
+
+
+
+TEST_CASE("QuadFieldConcurrentQueries")
+{
+	srand( time(nullptr) );
+
+	static constexpr int WIDTH  = 64;
+	static constexpr int HEIGHT = 64;
+	static constexpr int QUAD_SIZE = SQUARE_SIZE * 4;
+	static constexpr int NUM_QUERIES = 2000;
+	static constexpr int TEST_RUNS = 50;
+
+	Threading::DetectCores();
+	ThreadPool::SetThreadCount(std::min(ThreadPool::GetMaxThreads(), ThreadPool::MAX_THREADS));
+
+	quadField.Init(int2(WIDTH, HEIGHT), QUAD_SIZE);
+
+	struct Query {
+		float3 start;
+		float3 dir;
+		float length;
+
+		float3 mins;
+		float3 maxs;
+
+		std::vector<int> rayQuads;
+		std::vector<int> rectQuads;
+	};
+
+	std::vector<Query> queries(NUM_QUERIES);
+
+	// reference results, computed serially
+	for (Query& q: queries) {
+		q.start = float3(randf() * WIDTH, 0.0f, randf() * HEIGHT) * SQUARE_SIZE;
+		q.dir = float3(randf() - 0.5f, 0.0f, randf() - 0.5f).SafeNormalize();
+		q.length = randf() * (WIDTH + HEIGHT) * 0.25f * SQUARE_SIZE;
+
+		q.mins = float3(randf() * WIDTH, 0.0f, randf() * HEIGHT) * SQUARE_SIZE;
+		q.maxs = q.mins + float3(randf() * WIDTH, 0.0f, randf() * HEIGHT) * SQUARE_SIZE * 0.25f;
+
+		QuadFieldQuery rayQuery;
+		QuadFieldQuery rectQuery;
+		quadField.GetQuadsOnRay(rayQuery, q.start, q.dir, q.length);
+		quadField.GetQuadsRectangle(rectQuery, q.mins, q.maxs);
+
+		q.rayQuads = *rayQuery.quads;
+		q.rectQuads = *rectQuery.quads;
+	}
+
+	std::atomic<int> numMismatches = {0};
+	std::atomic<int> numQueries = {0};
+
+	for (int n = 0; n < TEST_RUNS; ++n) {
+		for_mt(0, NUM_QUERIES, [&](const int i) {
+			const Query& q = queries[(i + n * 7) % NUM_QUERIES];
+
+			// two queries alive at once on every thread
+			QuadFieldQuery rayQuery;
+			QuadFieldQuery rectQuery;
+			quadField.GetQuadsOnRay(rayQuery, q.start, q.dir, q.length);
+			quadField.GetQuadsRectangle(rectQuery, q.mins, q.maxs);
+
+			numMismatches += (*rayQuery.quads != q.rayQuads);
+			numMismatches += (*rectQuery.quads != q.rectQuads);
+			numQueries += 2;
+		});
+	}
+
+	ThreadPool::SetThreadCount(0);
+
+	CHECK(numQueries == (NUM_QUERIES * TEST_RUNS * 2));
+	CHECK(numMismatches == 0);
+}
+
+
+
+TEST_CASE("QuadFieldQueryMarksWrapAround")
+{
+	QueryMarks marks;
+
+	marks.Begin();
+	CHECK(marks.curMark == 1);
+	CHECK(marks.MarkUnit(5));
+	CHECK(marks.MarkFeature(5));
+	CHECK_FALSE(marks.MarkUnit(5));
+
+	// the next Begin wraps, a stale mark of 1 must not survive it
+	marks.curMark = ~0u;
+	marks.Begin();
+	CHECK(marks.curMark == 1);
+	CHECK(marks.MarkUnit(5));
+	CHECK(marks.MarkFeature(5));
+	CHECK(marks.MarkProjectile(5));
+	CHECK_FALSE(marks.MarkUnit(5));
+	CHECK_FALSE(marks.MarkFeature(5));
+	CHECK_FALSE(marks.MarkProjectile(5));
+}
+
+
+
+TEST_CASE("QuadFieldQueryMarks")
+{
+	srand( time(nullptr) );
+
+	static constexpr int WIDTH  = 64;
+	static constexpr int HEIGHT = 64;
+	static constexpr int QUAD_SIZE = SQUARE_SIZE * 4;
+	static constexpr int NUM_OBJECTS = 1000;
+	static constexpr int NUM_QUERIES = 2000;
+	static constexpr int TEST_RUNS = 20;
+
+	Threading::DetectCores();
+	ThreadPool::SetThreadCount(std::min(ThreadPool::GetMaxThreads(), ThreadPool::MAX_THREADS));
+
+	float3::maxxpos = WIDTH * SQUARE_SIZE - 1;
+	float3::maxzpos = HEIGHT * SQUARE_SIZE - 1;
+
+	quadField.Init(int2(WIDTH, HEIGHT), QUAD_SIZE);
+
+	// objects are as large as up to four quads, so most are listed in several
+	const int numQuads = quadField.GetNumQuadsX() * quadField.GetNumQuadsZ();
+
+	std::vector< std::vector<int> > quadObjects(numQuads);
+
+	for (int id = 0; id < NUM_OBJECTS; ++id) {
+		const float3 pos = float3(randf() * WIDTH, 0.0f, randf() * HEIGHT) * SQUARE_SIZE;
+		const float radius = randf() * QUAD_SIZE * 2.0f;
+
+		QuadFieldQuery qfQuery;
+		quadField.GetQuads(qfQuery, pos, radius);
+
+		for (const int qi: *qfQuery.quads) {
+			quadObjects[qi].push_back(id);
+		}
+	}
+
+	struct Query {
+		float3 pos;
+		float radius;
+
+		// ids of all objects listed in the query's quads, each once
+		std::vector<int> objects;
+	};
+
+	std::vector<Query> queries(NUM_QUERIES);
+
+	for (Query& q: queries) {
+		q.pos = float3(randf() * WIDTH, 0.0f, randf() * HEIGHT) * SQUARE_SIZE;
+		q.radius = randf() * QUAD_SIZE * 4.0f;
+
+		QuadFieldQuery qfQuery;
+		quadField.GetQuads(qfQuery, q.pos, q.radius);
+
+		for (const int qi: *qfQuery.quads) {
+			q.objects.insert(q.objects.end(), quadObjects[qi].begin(), quadObjects[qi].end());
+		}
+
+		std::sort(q.objects.begin(), q.objects.end());
+		q.objects.erase(std::unique(q.objects.begin(), q.objects.end()), q.objects.end());
+	}
+
+	std::atomic<int> numMismatches = {0};
+	std::atomic<int> numQueries = {0};
+
+	for (int n = 0; n < TEST_RUNS; ++n) {
+		for_mt(0, NUM_QUERIES, [&](const int i) {
+			const Query& q = queries[(i + n * 7) % NUM_QUERIES];
+
+			QueryMarks& marks = quadField.GetQueryMarks();
+
+			// after some queries skip ahead, so every thread keeps wrapping
+			// around with stale marks of its earlier queries left over
+			if (marks.curMark == 16)
+				marks.curMark = ~0u - 16;
+
+			QuadFieldQuery qfQuery;
+			quadField.GetQuads(qfQuery, q.pos, q.radius);
+
+			std::vector<int> units;
+			std::vector<int> features;
+
+			marks.Begin();
+
+			for (const int qi: *qfQuery.quads) {
+				for (const int id: quadObjects[qi]) {
+					if (marks.MarkUnit(id))
+						units.push_back(id);
+
+					// same mark, separate storage
+					if (marks.MarkFeature(NUM_OBJECTS - 1 - id))
+						features.push_back(id);
+				}
+			}
+
+			std::sort(units.begin(), units.end());
+			std::sort(features.begin(), features.end());
+
+			numMismatches += (units != q.objects);
+			numMismatches += (features != q.objects);
+			numQueries += 1;
+		});
+	}
+
+	ThreadPool::SetThreadCount(0);
+
+	CHECK(numQueries == (NUM_QUERIES * TEST_RUNS));
+	CHECK(numMismatches == 0);
+}
@@ -0,0 +1,230 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "Sim/Units/UnitHotState.h"
+#include "System/TimeProfiler.h"
+#include "System/Log/ILog.h"
+#include "System/Misc/SpringTime.h"
+
+#define CATCH_CONFIG_MAIN
+#include "lib/catch.hpp"
+
+InitSpringTime ist;
+
+
+static constexpr int NUM_UNITS = 10000;
+static constexpr int NUM_ALLYTEAMS = 8;
+static constexpr int NUM_RUNS = 50;
+
+static constexpr int LOS_MAP_SIZE = 256;
+
+
+// stand-in for CUnit: same allocation stride as the unit mempool
+// (sizeof(CBuilder)), hot fields spread over the object like they
+// are between CWorldObject, CSolidObject and CUnit
+struct FatUnit {
+	char pad0[16];
+	float3 pos;
+	float4 speed;
+	char pad1[512];
+	float health;
+	int allyteam;
+	char pad2[512];
+	bool isCloaked;
+	bool alwaysVisible;
+	char pad3[2048 - 16 - sizeof(float3) - sizeof(float4) - 512 - 8 - 512 - 2];
+};
+
+static_assert(sizeof(FatUnit) == 2048, "");
+
+
+struct LosMaps {
+	bool InSight(const float3& pos, int allyTeam) const {
+		const int x = std::min(std::max(int(pos.x), 0), LOS_MAP_SIZE - 1);
+		const int z = std::min(std::max(int(pos.z), 0), LOS_MAP_SIZE - 1);
+		return maps[allyTeam][z * LOS_MAP_SIZE + x];
+	}
+
+	std::vector<bool> maps[NUM_ALLYTEAMS];
+};
+
+
+// simplified stand-in for CLosHandler's unit rules, applied identically to
+// both layouts; CUnit and CLosHandler can not be instantiated without the
+// engine, their agreement with the hot state is checked in-game by the
+// UnitHotStateSyncTest config
+static bool InLos(const LosMaps& lm, const FatUnit* u, int at)
+{
+	if (u->isCloaked && u->allyteam != at)
+		return false;
+	if (u->alwaysVisible)
+		return true;
+
+	return (lm.InSight(u->pos, at) || lm.InSight(u->pos + u->speed, at));
+}
+
+static bool InLos(const LosMaps& lm, const UnitHotState::Entry& e, int at)
+{
+	if (e.HasFlag(UnitHotState::FLAG_CLOAKED) && e.allyTeam != at)
+		return false;
+	if (e.HasFlag(UnitHotState::FLAG_ALWAYS_VISIBLE))
+		return true;
+
+	return (lm.InSight(e.pos, at) || lm.InSight(e.pos + e.speed, at));
+}
+
+
+
+TEST_CASE("UnitHotStateStorage")
+{
+	UnitHotState hotState;
+	hotState.Init(NUM_UNITS, NUM_ALLYTEAMS);
+
+	CHECK(hotState.IsValid(NUM_UNITS, NUM_ALLYTEAMS));
+	CHECK_FALSE(hotState.IsValid(NUM_UNITS, NUM_ALLYTEAMS + 1));
+	CHECK_FALSE(hotState.IsValid(NUM_UNITS + 1, NUM_ALLYTEAMS));
+
+	const int unitID = NUM_UNITS - 1;
+
+	hotState.positions[unitID] = float3(1.0f, 2.0f, 3.0f);
+	hotState.speeds[unitID] = float4(float3(0.5f, 0.0f, -0.5f), 0.0f);
+	hotState.allyTeams[unitID] = NUM_ALLYTEAMS - 1;
+	hotState.flags[unitID] = UnitHotState::FLAG_ACTIVE | UnitHotState::FLAG_CLOAKED;
+
+	const UnitHotState::Entry e = hotState.GetEntry(unitID);
+
+	CHECK(e.pos == float3(1.0f, 2.0f, 3.0f));
+	CHECK(e.speed == float3(0.5f, 0.0f, -0.5f));
+	CHECK(e.allyTeam == NUM_ALLYTEAMS - 1);
+	CHECK(e.HasFlag(UnitHotState::FLAG_CLOAKED));
+	CHECK_FALSE(e.HasFlag(UnitHotState::FLAG_ALWAYS_VISIBLE));
+
+	// one plane per allyteam, planes do not overlap
+	for (int at = 0; at < NUM_ALLYTEAMS; at++) {
+		hotState.GetLosBits(at, unitID) = at;
+	}
+	for (int at = 0; at < NUM_ALLYTEAMS; at++) {
+		CHECK(hotState.GetLosBits(at, unitID) == at);
+		CHECK(hotState.GetLosBits(at, 0) == 0);
+	}
+
+	hotState.Clear(unitID);
+	CHECK_FALSE(hotState.GetEntry(unitID).HasFlag(UnitHotState::FLAG_ACTIVE));
+
+	hotState.Kill();
+	CHECK(hotState.IsValid(0, 0));
+}
+
+
+TEST_CASE("UnitHotStateLayout")
+{
+	std::mt19937 rng(0);
+	std::uniform_real_distribution<float> posDist(0.0f, LOS_MAP_SIZE);
+	std::uniform_real_distribution<float> spdDist(-2.0f, 2.0f);
+
+	LosMaps losMaps;
+
+	for (int at = 0; at < NUM_ALLYTEAMS; at++) {
+		losMaps.maps[at].resize(LOS_MAP_SIZE * LOS_MAP_SIZE);
+
+		for (size_t i = 0; i < losMaps.maps[at].size(); i++) {
+			losMaps.maps[at][i] = ((rng() & 3) == 0);
+		}
+	}
+
+	// units are iterated in activeUnits order, which is not memory order
+	std::vector<FatUnit> unitPool(NUM_UNITS);
+	std::vector<FatUnit*> activeUnits(NUM_UNITS);
+	std::vector<int> unitIDs(NUM_UNITS);
+
+	for (int i = 0; i < NUM_UNITS; i++) {
+		FatUnit& u = unitPool[i];
+
+		u.pos = float3(posDist(rng), 0.0f, posDist(rng));
+		u.speed = float4(float3(spdDist(rng), 0.0f, spdDist(rng)), 0.0f);
+		u.health = 100.0f;
+		u.allyteam = rng() % NUM_ALLYTEAMS;
+		u.isCloaked = ((rng() % 16) == 0);
+		u.alwaysVisible = ((rng() % 64) == 0);
+
+		activeUnits[i] = &u;
+		unitIDs[i] = i;
+	}
+
+	std::shuffle(activeUnits.begin(), activeUnits.end(), rng);
+
+	std::vector<unsigned char> aosBits(NUM_UNITS * NUM_ALLYTEAMS, 0);
+	std::vector<unsigned char> soaBits(NUM_UNITS * NUM_ALLYTEAMS, 0);
+
+	UnitHotState hotState;
+	hotState.Init(NUM_UNITS, NUM_ALLYTEAMS);
+
+	spring_time aosTime;
+	spring_time soaTime;
+	spring_time gatherTime;
+
+	{
+		ScopedOnceTimer timer("aos_unit_major");
+
+		for (int n = 0; n < NUM_RUNS; n++) {
+			for (const FatUnit* u: activeUnits) {
+				const int unitID = u - &unitPool[0];
+
+				for (int at = 0; at < NUM_ALLYTEAMS; at++) {
+					aosBits[at * NUM_UNITS + unitID] = InLos(losMaps, u, at);
+				}
+			}
+		}
+
+		aosTime = timer.GetDuration();
+	}
+	{
+		ScopedOnceTimer timer("soa_gather");
+
+		for (int n = 0; n < NUM_RUNS; n++) {
+			for (const FatUnit* u: activeUnits) {
+				const int unitID = u - &unitPool[0];
+
+				hotState.positions[unitID] = u->pos;
+				hotState.speeds[unitID] = u->speed;
+				hotState.allyTeams[unitID] = u->allyteam;
+				hotState.flags[unitID] = UnitHotState::FLAG_ACTIVE;
+				hotState.flags[unitID] |= (UnitHotState::FLAG_CLOAKED * u->isCloaked);
+				hotState.flags[unitID] |= (UnitHotState::FLAG_ALWAYS_VISIBLE * u->alwaysVisible);
+			}
+		}
+
+		gatherTime = timer.GetDuration();
+	}
+	{
+		ScopedOnceTimer timer("soa_stream");
+
+		for (int n = 0; n < NUM_RUNS; n++) {
+			for (const int unitID: unitIDs) {
+				const UnitHotState::Entry e = hotState.GetEntry(unitID);
+
+				for (int at = 0; at < NUM_ALLYTEAMS; at++) {
+					hotState.GetLosBits(at, unitID) = InLos(losMaps, e, at);
+				}
+			}
+		}
+
+		soaTime = timer.GetDuration();
+	}
+
+	for (int at = 0; at < NUM_ALLYTEAMS; at++) {
+		for (int unitID = 0; unitID < NUM_UNITS; unitID++) {
+			soaBits[at * NUM_UNITS + unitID] = hotState.GetLosBits(at, unitID);
+		}
+	}
+
+	CHECK(aosBits == soaBits);
+
+	{
+		LOG("[%s] units=%d allyteams=%d runs=%d", __func__, NUM_UNITS, NUM_ALLYTEAMS, NUM_RUNS);
+		LOG("[%s] time per pass: AoS=%.3fms SoA=%.3fms (+%.3fms gather)", __func__, aosTime.toMilliSecsf() / NUM_RUNS, soaTime.toMilliSecsf() / NUM_RUNS, gatherTime.toMilliSecsf() / NUM_RUNS);
+	}
+}
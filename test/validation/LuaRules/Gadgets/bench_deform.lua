@@ -0,0 +1,64 @@
+function gadget:GetInfo()
+return {
+	name    = "Bench-Deform",
+	desc    = "Digs craters at fixed positions and frames, drives terrain updates for bench_pathupdates",
+	author  = "agent",
+	date    = "Oct. 2026",
+	license = "GNU GPL, v2 or later",
+	layer   = 0,
+	enabled = true,
+}
+end
+
+if (not gadgetHandler:IsSyncedCode()) then
+	return
+end
+
+-- one crater every craterInterval frames until lastCraterFrame
+local craterInterval = 15
+local lastCraterFrame = 36000
+
+local craterRadius = 96 -- elmos
+local craterDepth = 24
+
+-- fixed-seed LCG, every run digs the same craters in the same order
+local seed = 12345
+
+local function NextRandom()
+	seed = (seed * 1103515245 + 12345) % 2147483648
+	return seed / 2147483648
+end
+
+local numCraters = 0
+
+local function DigCrater(cx, cz)
+	local x0 = math.max(0, math.floor((cx - craterRadius) / Game.squareSize) * Game.squareSize)
+	local z0 = math.max(0, math.floor((cz - craterRadius) / Game.squareSize) * Game.squareSize)
+	local x1 = math.min(Game.mapSizeX, cx + craterRadius)
+	local z1 = math.min(Game.mapSizeZ, cz + craterRadius)
+
+	for z = z0, z1, Game.squareSize do
+		for x = x0, x1, Game.squareSize do
+			local sqDist = (x - cx) * (x - cx) + (z - cz) * (z - cz)
+
+			if (sqDist < craterRadius * craterRadius) then
+				Spring.AddHeightMap(x, z, -craterDepth * (1 - sqDist / (craterRadius * craterRadius)))
+			end
+		end
+	end
+end
+
+function gadget:GameFrame(n)
+	if (n > lastCraterFrame or (n % craterInterval) ~= 0) then
+		return
+	end
+
+	-- keep whole craters on the map
+	local cx = craterRadius + NextRandom() * (Game.mapSizeX - craterRadius * 2)
+	local cz = craterRadius + NextRandom() * (Game.mapSizeZ - craterRadius * 2)
+
+	Spring.SetHeightMapFunc(DigCrater, cx, cz)
+
+	numCraters = numCraters + 1
+	Spring.SetGameRulesParam("bench_deform_craters", numCraters)
+end
@@ -0,0 +1,87 @@
+function widget:GetInfo()
+return {
+	name    = "Bench-PathUpdates",
+	desc    = "Reports per-frame path-manager update latencies while the bench_deform gadget digs craters",
+	author  = "agent",
+	date    = "Oct. 2026",
+	license = "GNU GPL, v2 or later",
+	layer   = 0,
+	enabled = true,
+}
+end
+
+-- terrain changes come from test/validation/LuaRules/Gadgets/bench_deform.lua,
+-- which the game's gadget handler has to load (e.g. copied into its LuaRules);
+-- without it only map damage from the AIs' fights changes the terrain
+
+-- frames at which the samples collected since the previous report are summarized
+local reportFrames = {[1800] = true, [9000] = true, [18000] = true, [36000] = true}
+
+-- total path-manager update, and the part of it spent on terrain changes (QTPFS only)
+local records = {"Sim::Path", "Sim::Path::QTPFS::LayerUpdates"}
+
+local spGetProfilerTimeRecord = Spring.GetProfilerTimeRecord
+
+local lastTotals = {}
+local samples = {}
+
+for i = 1, #records do
+	lastTotals[i] = 0
+	samples[i] = {}
+end
+
+local function Percentile(sorted, p)
+	return sorted[math.min(#sorted, math.floor(#sorted * p) + 1)]
+end
+
+local function Report(frame)
+	local pathFinder = (Spring.GetModOptions() or {}).pathfinder or "default"
+
+	local numCraters = Spring.GetGameRulesParam("bench_deform_craters")
+
+	Spring.Echo(string.format("[bench_pathupdates] frame %d: %d frames sampled, pathfinder=%s", frame, #samples[1], pathFinder))
+
+	if (numCraters == nil) then
+		Spring.Echo("[bench_pathupdates]   bench_deform gadget not loaded, terrain changes are not deterministic")
+	else
+		Spring.Echo(string.format("[bench_pathupdates]   %d craters dug by bench_deform", numCraters))
+	end
+
+	for i = 1, #records do
+		local sorted = samples[i]
+
+		if (#sorted > 0) then
+			table.sort(sorted)
+			Spring.Echo(string.format("[bench_pathupdates]   %s: p50=%.3fms p90=%.3fms p99=%.3fms max=%.3fms", records[i], Percentile(sorted, 0.5), Percentile(sorted, 0.9), Percentile(sorted, 0.99), sorted[#sorted]))
+		end
+
+		samples[i] = {}
+	end
+end
+
+function widget:Initialize()
+	-- timers are only recorded while the profiler is enabled
+	Spring.SendCommands("debug")
+
+	for i = 1, #records do
+		lastTotals[i] = spGetProfilerTimeRecord(records[i])
+	end
+end
+
+function widget:Shutdown()
+	Spring.SendCommands("debug")
+end
+
+function widget:GameFrame(n)
+	-- the profiler only keeps running totals, sample their per-frame deltas
+	for i = 1, #records do
+		local total = spGetProfilerTimeRecord(records[i])
+
+		samples[i][#samples[i] + 1] = total - lastTotals[i]
+		lastTotals[i] = total
+	end
+
+	if (reportFrames[n]) then
+		Report(n)
+	end
+end
@@ -0,0 +1,98 @@
+function widget:GetInfo()
+return {
+	name    = "Bench-UnitsData",
+	desc    = "Compares per-unit getters with Spring.GetUnitsData",
+	author  = "agent",
+	date    = "Oct. 2026",
+	license = "GNU GPL, v2 or later",
+	layer   = 0,
+	enabled = true,
+}
+end
+
+local numQueryUnits = 5000 -- unitIDs per query, existing units are repeated to reach this
+local numIterations = 20
+local benchFrames = {[900] = true, [9000] = true}
+
+local fields = {"x", "y", "z", "velX", "velY", "velZ", "speed", "health", "maxHealth"}
+
+local spGetUnitPosition = Spring.GetUnitPosition
+local spGetUnitVelocity = Spring.GetUnitVelocity
+local spGetUnitHealth   = Spring.GetUnitHealth
+local spGetUnitsData    = Spring.GetUnitsData
+local spGetTimer        = Spring.GetTimer
+local spDiffTimers      = Spring.DiffTimers
+
+-- per-unit results are written into flat arrays too, so both variants produce the same data
+local perUnit = {}
+local bulk = nil
+
+for i = 1, #fields do
+	perUnit[fields[i]] = {}
+end
+
+local function QueryPerUnit(unitIDs)
+	local x, y, z = perUnit.x, perUnit.y, perUnit.z
+	local vx, vy, vz, vw = perUnit.velX, perUnit.velY, perUnit.velZ, perUnit.speed
+	local h, mh = perUnit.health, perUnit.maxHealth
+
+	for i = 1, #unitIDs do
+		local unitID = unitIDs[i]
+		x[i], y[i], z[i] = spGetUnitPosition(unitID)
+		vx[i], vy[i], vz[i], vw[i] = spGetUnitVelocity(unitID)
+		h[i], mh[i] = spGetUnitHealth(unitID)
+	end
+end
+
+local function QueryBulk(unitIDs)
+	bulk = spGetUnitsData(unitIDs, fields, bulk)
+end
+
+local function Measure(func, unitIDs)
+	local t0 = spGetTimer()
+
+	for n = 1, numIterations do
+		func(unitIDs)
+	end
+
+	return (spDiffTimers(spGetTimer(), t0, true) / numIterations)
+end
+
+local function Verify(unitIDs)
+	for i = 1, #unitIDs do
+		for f = 1, #fields do
+			if (perUnit[fields[f]][i] ~= bulk[fields[f]][i]) then
+				Spring.Log("bench_unitsdata.lua", LOG.ERROR, string.format("field %s of unit %d differs", fields[f], unitIDs[i]))
+				return
+			end
+		end
+	end
+end
+
+local function RunBenchmark(frame)
+	local allUnits = Spring.GetAllUnits()
+
+	if (#allUnits == 0) then
+		return
+	end
+
+	local unitIDs = {}
+
+	for i = 1, numQueryUnits do
+		unitIDs[i] = allUnits[((i - 1) % #allUnits) + 1]
+	end
+
+	local perUnitTime = Measure(QueryPerUnit, unitIDs)
+	local bulkTime = Measure(QueryBulk, unitIDs)
+
+	Verify(unitIDs)
+
+	Spring.Echo(string.format("[bench_unitsdata] frame %d: %d queries (%d distinct units), %d fields", frame, numQueryUnits, #allUnits, #fields))
+	Spring.Echo(string.format("[bench_unitsdata]   per-unit: %.3fms bulk: %.3fms (%.2fx)", perUnitTime, bulkTime, perUnitTime / math.max(bulkTime, 0.001)))
+end
+
+function widget:GameFrame(n)
+	if (benchFrames[n]) then
+		RunBenchmark(n)
+	end
+end
@@ -0,0 +1,149 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+/*
+ * Standalone COB benchmark: loads a .cob file, creates a script instance
+ * per (stub) unit and times serial and threaded ticks of the script engine.
+ *
+ * The COB VM (CCobFile, CCobThread, CCobEngine, CCobInstance) is the engine
+ * code; the unit side of the scripts (CUnitScript: piece animations, SFX,
+ * unit values, attach/drop) and the units and their pieces are stand-ins,
+ * see CobBenchStubs.cpp. Ticks therefore measure decoding, interpreting and
+ * scheduling of the script threads, not their effects on the game.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "CobBenchStubs.h"
+#include "Sim/Misc/GlobalConstants.h"
+#include "Sim/Units/Scripts/CobEngine.h"
+#include "Sim/Units/Scripts/CobFile.h"
+#include "Sim/Units/Scripts/CobInstance.h"
+#include "Sim/Units/Scripts/CobScriptNames.h"
+#include "Sim/Units/Scripts/UnitScriptEngine.h"
+#include "System/FileSystem/FileHandler.h"
+#include "System/Log/ILog.h"
+#include "System/Misc/SpringTime.h"
+#include "System/Platform/Threading.h"
+#include "System/Threading/ThreadPool.h"
+
+
+struct BenchResult {
+	spring_time createTime;
+	spring_time tickTime;
+
+	unsigned int numThreads = 0;
+};
+
+static BenchResult RunBench(CCobFile* cobFile, int numUnits, int numTicks, bool threaded)
+{
+	BenchResult result;
+
+	// private engines, every run starts from the same fresh state
+	CCobEngine benchCobEngine;
+	CUnitScriptEngine benchScriptEngine;
+
+	cobEngine = &benchCobEngine;
+	unitScriptEngine = &benchScriptEngine;
+
+	benchCobEngine.SetThreaded(threaded);
+	benchScriptEngine.Init();
+
+	std::vector<std::unique_ptr<CUnit>> units;
+	std::vector<std::unique_ptr<CCobInstance>> instances;
+
+	units.reserve(numUnits);
+	instances.reserve(numUnits);
+
+	for (int i = 0; i < numUnits; i++) {
+		units.emplace_back(CobBench::CreateUnit(i, cobFile->pieceNames));
+	}
+
+	{
+		const spring_time t0 = spring_gettime();
+
+		for (const auto& unit: units) {
+			instances.emplace_back(new CCobInstance(cobFile, unit.get()));
+			instances.back()->Create();
+		}
+
+		result.createTime = spring_gettime() - t0;
+	}
+	{
+		const spring_time t0 = spring_gettime();
+
+		for (int i = 0; i < numTicks; i++) {
+			benchScriptEngine.Tick(1000 / GAME_SPEED);
+		}
+
+		result.tickTime = spring_gettime() - t0;
+	}
+
+	for (const auto& instance: instances) {
+		result.numThreads += instance->threadIDs.size();
+	}
+
+	// instances unregister their threads from the engines
+	instances.clear();
+	units.clear();
+
+	benchCobEngine.Kill();
+	benchScriptEngine.Kill();
+
+	cobEngine = nullptr;
+	unitScriptEngine = nullptr;
+	return result;
+}
+
+
+int main(int argc, char** argv)
+{
+	if (argc < 2) {
+		printf("usage: %s <script.cob> [numUnits=500] [numTicks=300] [numRuns=3]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	Threading::SetMainThread();
+	spring_clock::PushTickRate();
+	spring_time::setstarttime(spring_time::gettime(true));
+
+	const std::string fileName = argv[1];
+
+	const int numUnits = (argc > 2)? std::max(1, atoi(argv[2])): 500;
+	const int numTicks = (argc > 3)? std::max(1, atoi(argv[3])): 300;
+	const int numRuns  = (argc > 4)? std::max(1, atoi(argv[4])): 3;
+
+	CCobUnitScriptNames::InitScriptNames();
+	CFileHandler fileHandler(fileName, SPRING_VFS_PWD);
+
+	if (!fileHandler.FileExists()) {
+		LOG_L(L_ERROR, "[%s] could not open \"%s\"", __func__, fileName.c_str());
+		return EXIT_FAILURE;
+	}
+
+	CCobFile cobFile(fileHandler, fileName);
+
+	if (cobFile.code.empty()) {
+		LOG_L(L_ERROR, "[%s] \"%s\" holds no COB code", __func__, fileName.c_str());
+		return EXIT_FAILURE;
+	}
+
+	ThreadPool::SetMaximumThreadCount();
+
+	LOG("[%s] %s: %u functions, %u pieces, %u code words; %d units, %d ticks, %d threads", __func__, fileName.c_str(), unsigned(cobFile.scriptNames.size()), unsigned(cobFile.pieceNames.size()), unsigned(cobFile.code.size()), numUnits, numTicks, ThreadPool::GetNumThreads());
+
+	for (int run = 0; run < numRuns; run++) {
+		for (const bool threaded: {false, true}) {
+			const BenchResult result = RunBench(&cobFile, numUnits, numTicks, threaded);
+
+			LOG("[%s] run %d %-8s: Create %.3fms, %.3fms/tick, %u threads alive at the end", __func__, run, threaded? "threaded": "serial", result.createTime.toMilliSecsf(), result.tickTime.toMilliSecsf() / numTicks, result.numThreads);
+		}
+	}
+
+	ThreadPool::SetThreadCount(0);
+	return EXIT_SUCCESS;
+}
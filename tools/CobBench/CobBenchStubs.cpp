@@ -0,0 +1,176 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+/*
+ * Stand-ins for the parts of the engine a COB script reaches through its
+ * unit: CUnitScript's piece animation and unit interface, the unit itself,
+ * model pieces and the handlers referenced by CCobInstance and CCobThread.
+ *
+ * Animation calls (turn, spin, move) are accepted but never start an
+ * animation, so wait-for-turn and wait-for-move return immediately; unit
+ * values read as 0 and every write is dropped.
+ */
+
+#include "CobBenchStubs.h"
+
+#include <memory>
+
+#include "Rendering/GL/VBO.h"
+#include "Rendering/Models/3DModel.h"
+#include "Sim/Misc/GlobalSynced.h"
+#include "Sim/Units/Scripts/UnitScript.h"
+#include "Sim/Units/Scripts/UnitScriptFactory.h"
+#include "Sim/Units/Unit.h"
+#include "Sim/Units/UnitHandler.h"
+#include "Sim/Weapons/WeaponDefHandler.h"
+#include "Lua/LuaMaterial.h"
+#include "Lua/LuaRules.h"
+#include "System/Config/ConfigHandler.h"
+#include "System/Sound/ISound.h"
+#include "System/Sound/ISoundChannels.h"
+
+
+ConfigHandler* configHandler = nullptr;
+
+ISound* ISound::singleton = nullptr;
+IAudioChannel* Channels::UnitReply = nullptr;
+
+CLuaRules* luaRules = nullptr;
+CWeaponDefHandler* weaponDefHandler = nullptr;
+CUnitHandler unitHandler;
+CGlobalSyncedRNG gsRNG;
+
+
+
+/******************************************************************************/
+// units and pieces
+
+struct BenchPiece: public S3DModelPiece {
+	unsigned int GetVertexCount() const override { return 0; }
+	unsigned int GetVertexDrawIndexCount() const override { return 0; }
+	const float3& GetVertexPos(const int) const override { return ZeroVector; }
+	const float3& GetNormal(const int) const override { return UpVector; }
+
+	void UploadGeometryVBOs() override {}
+	void BindVertexAttribVBOs() const override {}
+	void UnbindVertexAttribVBOs() const override {}
+
+protected:
+	void DrawForList() const override {}
+	const std::vector<unsigned>& GetVertexIndices() const override { return indices; }
+
+private:
+	std::vector<unsigned> indices;
+};
+
+struct BenchUnit: public CUnit {
+	std::vector<std::unique_ptr<BenchPiece>> modelPieces;
+};
+
+
+CUnit* CobBench::CreateUnit(int id, const std::vector<std::string>& pieceNames)
+{
+	BenchUnit* unit = new BenchUnit();
+
+	unit->id = id;
+	unit->modelPieces.reserve(pieceNames.size());
+	unit->localModel.pieces.resize(pieceNames.size());
+
+	for (size_t i = 0; i < pieceNames.size(); i++) {
+		unit->modelPieces.emplace_back(new BenchPiece());
+		unit->modelPieces[i]->name = pieceNames[i];
+		unit->localModel.pieces[i].original = unit->modelPieces[i].get();
+	}
+
+	return unit;
+}
+
+
+CUnit::CUnit(): CSolidObject() {}
+CUnit::~CUnit() {}
+
+void CUnit::PreInit(const UnitLoadParams& params) {}
+void CUnit::PostInit(const CUnit* builder) {}
+void CUnit::Update() {}
+void CUnit::SlowUpdate() {}
+void CUnit::DoDamage(const DamageArray& damages, const float3& impulse, CUnit* attacker, int weaponDefID, int projectileID) {}
+void CUnit::DoWaterDamage() {}
+void CUnit::FinishedBuilding(bool postInit) {}
+bool CUnit::ChangeTeam(int team, ChangeType type) { return false; }
+void CUnit::StopAttackingAllyTeam(int ally) {}
+void CUnit::KillUnit(CUnit* attacker, bool selfDestruct, bool reclaimed, bool showDeathSequence) {}
+void CUnit::IncomingMissile(CMissileProjectile* missile) {}
+
+void CUnit::ApplyImpulse(const float3& impulse) {}
+bool CUnit::AddBuildPower(CUnit* builder, float amount) { return false; }
+void CUnit::ForcedMove(const float3& newPos) {}
+void CUnit::DependentDied(CObject* o) {}
+void CUnit::SetMass(float newMass) {}
+void CUnit::UpdatePhysicalState(float eps) {}
+CMatrix44f CUnit::GetTransformMatrix(bool synced, bool fullread) const { return {}; }
+
+void CSolidObject::Kill(CUnit* killer, const float3& impulse, bool crushed) {}
+void CSolidObject::ForcedSpin(const float3& newDir) {}
+void CSolidObject::UpdatePhysicalState(float eps) {}
+void CSolidObject::SetMass(float newMass) {}
+
+float3 S3DModelPiece::GetEmitPos() const { return ZeroVector; }
+float3 S3DModelPiece::GetEmitDir() const { return FwdVector; }
+void S3DModelPiece::DeleteDispList() {}
+void LocalModelPiece::UpdateParentMatricesRec() const {}
+
+LuaMatRef::~LuaMatRef() {}
+
+VBO::VBO(GLenum _defTarget, const bool storage) { defTarget = _defTarget; }
+VBO::~VBO() {}
+VBO& VBO::operator=(VBO&& other) { return *this; }
+
+
+
+/******************************************************************************/
+// unit-side script interface
+
+CUnitScript::CUnitScript(CUnit* unit)
+	: unit(unit)
+	, busy(false)
+	, hasSetSFXOccupy(false)
+	, hasRockUnit(false)
+	, hasStartBuilding(false)
+{ }
+
+CUnitScript::~CUnitScript() {}
+
+CUnitScript::AnimContainerTypeIt CUnitScript::FindAnim(AnimType type, int piece, int axis) { return anims[type].end(); }
+
+bool CUnitScript::Tick(int tickRate) { return false; }
+bool CUnitScript::IsLocalAnimChange(AnimType type, int piece, int axis) { return false; }
+bool CUnitScript::NeedsWait(AnimType type, int piece, int axis) { return false; }
+
+void CUnitScript::Spin(int piece, int axis, float speed, float accel) {}
+void CUnitScript::StopSpin(int piece, int axis, float decel) {}
+void CUnitScript::Turn(int piece, int axis, float speed, float destination) {}
+void CUnitScript::Move(int piece, int axis, float speed, float destination) {}
+void CUnitScript::MoveNow(int piece, int axis, float destination) {}
+void CUnitScript::TurnNow(int piece, int axis, float destination) {}
+
+void CUnitScript::SetVisibility(int piece, bool visible) {}
+bool CUnitScript::EmitSfx(int sfxType, int sfxPiece) { return true; }
+void CUnitScript::AttachUnit(int piece, int unit) {}
+void CUnitScript::DropUnit(int unit) {}
+void CUnitScript::Explode(int piece, int flags) {}
+void CUnitScript::ShowFlare(int piece) {}
+
+int CUnitScript::GetUnitVal(int val, int p1, int p2, int p3, int p4) { return 0; }
+void CUnitScript::SetUnitVal(int val, int param) {}
+
+CUnitScript* CUnitScriptFactory::CreateCOBScript(CUnit* unit, CCobFile* F) { return nullptr; }
+
+
+
+/******************************************************************************/
+// engine services
+
+void CLuaRules::Cob2Lua(const LuaHashString& funcName, const CUnit* unit, int& argsCount, int args[MAX_LUA_COB_ARGS]) {}
+
+const WeaponDef* CWeaponDefHandler::GetWeaponDefByID(int id) const { return nullptr; }
+
+void ConfigVariable::AddMetaData(const ConfigVariableMetaData* data) {}
@@ -0,0 +1,16 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef COB_BENCH_STUBS_H
+#define COB_BENCH_STUBS_H
+
+#include <string>
+#include <vector>
+
+class CUnit;
+
+namespace CobBench {
+	/// creates a stand-in unit with one model piece per COB piece name
+	CUnit* CreateUnit(int id, const std::vector<std::string>& pieceNames);
+}
+
+#endif
@@ -5,10 +5,15 @@
 #include <iostream>
 #include <gflags/gflags.h>
 #include <iomanip> //hex
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include <zlib.h>
 
 #include "StringSerializer.h"
 
 #include "Net/Protocol/BaseNetProtocol.h"
+#include "System/FileSystem/GZFileHandler.h"
 #include "System/LoadSave/DemoReader.h"
 #include "System/Net/RawPacket.h"
 #include "Sim/Units/CommandAI/Command.h"
@@ -32,10 +37,13 @@ no console output (you still could use this.exe > z.tzt though).
 	DEFINE_bool  (teamstats,    false, "Print teamstats");
 	DEFINE_int32 (team,         -1,    "Select team");
 	DEFINE_string(teamsstatcsv, "",    "Write teamstats in a csv file");
+	DEFINE_bool  (index,        false, "Write a copy of the demo with a frame index (for seeking)");
+	DEFINE_string(outfile,      "",    "Output path for --index (default: <demofile>_indexed.sdfz)");
 
 
 void TrafficDump(CDemoReader& reader, bool trafficStats);
 void WriteTeamstatHistory(CDemoReader& reader, unsigned team, const std::string& file);
+bool WriteIndexedDemo(const std::string& inFile, const std::string& outFile);
 
 int main (int argc, char* argv[])
 {
@@ -52,6 +60,14 @@ int main (int argc, char* argv[])
 		gflags::ShowUsageWithFlags(argv[0]);
 	}
 
+	if (FLAGS_index)
+	{
+		std::string outFile = FLAGS_outfile;
+		if (outFile.empty())
+			outFile = filename.substr(0, filename.rfind(".sdfz")) + "_indexed.sdfz";
+		return (WriteIndexedDemo(filename, outFile)? 0: 1);
+	}
+
 	CDemoReader reader(filename, 0.0f);
 	reader.LoadStats();
 	if (FLAGS_dump)
@@ -504,3 +520,112 @@ void WriteTeamstatHistory(CDemoReader& reader, unsigned team, const std::string&
 		exit(1);
 	}
 };
+
+
+bool WriteIndexedDemo(const std::string& inFile, const std::string& outFile)
+{
+	CGZFileHandler ifs(inFile, SPRING_VFS_PWD_ALL);
+	if (!ifs.FileExists())
+	{
+		std::cout << "Demofile not found: " << inFile << std::endl;
+		return false;
+	}
+
+	std::vector<unsigned char> buf(ifs.FileSize());
+	if (buf.size() < offsetof(DemoFileHeader, frameIndexSize) || !ifs.Read(buf.data(), buf.size()))
+	{
+		std::cout << "Demofile corrupt" << std::endl;
+		return false;
+	}
+
+	DemoFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(&header, buf.data(), std::min(buf.size(), sizeof(header)));
+	header.swab();
+
+	if (memcmp(header.magic, DEMOFILE_MAGIC, sizeof(header.magic)) != 0 || header.version < 5 || header.version > DEMOFILE_VERSION)
+	{
+		std::cout << "Demofile corrupt or of unsupported version " << header.version << std::endl;
+		return false;
+	}
+	if (header.version == 5)
+	{
+		header.frameIndexSize = 0;
+		header.keyFrameSize = 0;
+	}
+	if (header.frameIndexSize != 0)
+	{
+		std::cout << "Demofile is already indexed" << std::endl;
+		return false;
+	}
+	if (header.demoStreamSize == 0)
+	{
+		std::cout << "Demofile is incomplete (recording was not finished)" << std::endl;
+		return false;
+	}
+
+	const size_t streamPos = header.headerSize + header.scriptSize;
+	const size_t statsPos = streamPos + header.demoStreamSize;
+	const size_t statsSize = header.winningAllyTeamsSize + header.playerStatSize + header.teamStatSize;
+
+	if (statsPos + statsSize > buf.size())
+	{
+		std::cout << "Demofile corrupt" << std::endl;
+		return false;
+	}
+
+	// walk the stream chunks the same way CDemoRecorder::SaveToDemo counts frames
+	std::vector<DemoFrameIndexEntry> frameIndex;
+	size_t pos = 0;
+	int frame = -1;
+
+	while ((pos + sizeof(DemoStreamChunkHeader)) <= size_t(header.demoStreamSize))
+	{
+		DemoStreamChunkHeader chunkHeader;
+		memcpy(&chunkHeader, &buf[streamPos + pos], sizeof(chunkHeader));
+		chunkHeader.swab();
+
+		const unsigned char* data = &buf[streamPos + pos + sizeof(chunkHeader)];
+		pos += (sizeof(chunkHeader) + chunkHeader.length);
+
+		if (pos > size_t(header.demoStreamSize))
+			break;
+		if (chunkHeader.length == 0 || (data[0] != NETMSG_NEWFRAME && data[0] != NETMSG_KEYFRAME))
+			continue;
+		if (((++frame) % DEMOFILE_INDEX_INTERVAL) != 0)
+			continue;
+
+		DemoFrameIndexEntry entry = {frame, int(pos), chunkHeader.modGameTime};
+		entry.swab();
+		frameIndex.push_back(entry);
+	}
+
+	DemoFileHeader outHeader = header;
+	outHeader.version = DEMOFILE_VERSION;
+	outHeader.headerSize = sizeof(DemoFileHeader);
+	outHeader.frameIndexSize = frameIndex.size() * sizeof(DemoFrameIndexEntry);
+	outHeader.keyFrameSize = 0;
+	outHeader.swab();
+
+	gzFile file = gzopen(outFile.c_str(), "wb9");
+	if (file == nullptr)
+	{
+		std::cout << "Could not open " << outFile << " for writing" << std::endl;
+		return false;
+	}
+
+	bool ok = true;
+	ok = ok && (gzwrite(file, &outHeader, sizeof(outHeader)) == int(sizeof(outHeader)));
+	ok = ok && (gzwrite(file, &buf[header.headerSize], header.scriptSize + header.demoStreamSize + statsSize) == int(header.scriptSize + header.demoStreamSize + statsSize));
+	ok = ok && (frameIndex.empty() || gzwrite(file, frameIndex.data(), frameIndex.size() * sizeof(DemoFrameIndexEntry)) == int(frameIndex.size() * sizeof(DemoFrameIndexEntry)));
+	ok = (gzclose(file) == Z_OK) && ok;
+
+	if (!ok)
+	{
+		std::cout << "Error writing " << outFile << std::endl;
+		return false;
+	}
+
+	std::cout << "Wrote " << outFile << " (" << frameIndex.size() << " index entries, " << (frame + 1) << " frames)" << std::endl;
+	return true;
+}
@@ -41,6 +41,8 @@ wstringstream& operator<<(wstringstream& str, const DemoFileHeader& header)
 	str<<L"TeamStatElemSize: " <<header.teamStatElemSize<<endl;
 	str<<L"TeamStatPeriod: " <<header.teamStatPeriod<<endl;
 	str<<L"WinningAllyTeamsSize: " << header.winningAllyTeamsSize<<endl;
+	str<<L"FrameIndexSize: " << header.frameIndexSize<<endl;
+	str<<L"KeyFrameSize: " << header.keyFrameSize<<endl;
 	return str;
 }
 